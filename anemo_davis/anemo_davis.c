@@ -3,6 +3,9 @@
 #include "xtimer.h"
 #include "periph/gpio.h"
 #include "periph/adc.h"
+#ifdef MODULE_BENCH
+#include "../bench/bench.h"
+#endif
 
 #include <log.h>
 #include <math.h>
@@ -13,50 +16,47 @@
 #endif
 #include "debug.h"
 
-/* Anemometer physical interface and timer structure */
-static Anemo_davis anemo_davis;
-
-/* Direction offset from north in degrees * 10e1 */
-uint16_t _north_offset_10e1;
-
 /* Prototypes */
-static int _read_rotations (void);
-static int _read_single_counter_output (int mux_c_val, int mux_b_val, int mux_a_val);
-static int8_t _disable_and_reset_counter (void);
-static int8_t _is_counter_reset (void);
-static void _set_address_bits (int mux_c_val, int mux_b_val, int mux_a_val);
+static int _read_rotations (Anemo_davis *dev);
+static int _read_single_counter_output (Anemo_davis *dev,
+		int mux_c_val, int mux_b_val, int mux_a_val);
+static int8_t _disable_and_reset_counter (Anemo_davis *dev);
+static int8_t _is_counter_reset (Anemo_davis *dev);
+static void _set_address_bits (Anemo_davis *dev,
+		int mux_c_val, int mux_b_val, int mux_a_val);
 static void _wait_for_mux_output_propagation (void);
-static void _enable_counter_input (void);
-static void _disable_counter_input (void);
-static void _clear_counter (void);
+static void _enable_counter_input (Anemo_davis *dev);
+static void _disable_counter_input (Anemo_davis *dev);
+static void _clear_counter (Anemo_davis *dev);
 
 static int _calc_wind_speed_ms_10e2 (int rotations, uint64_t elapsed_time_us);
 
 
 /* Init anemometer counter, reseet and enable. */
 int8_t anemo_davis_init (
+		Anemo_davis *dev,
 		uint16_t north_offset_10e1,
 		gpio_t mux_out, gpio_t mux_c, gpio_t mux_b, gpio_t mux_a,
 		gpio_t counter_rst, gpio_t counter_n_en, adc_t adc_line)
 {
-	_north_offset_10e1 = north_offset_10e1;
-
-    anemo_davis.mux_out = mux_out;
-    anemo_davis.mux_c = mux_c;
-    anemo_davis.mux_b = mux_b;
-    anemo_davis.mux_a = mux_a;
-    anemo_davis.counter_rst = counter_rst;
-    anemo_davis.counter_n_en = counter_n_en;
-    anemo_davis.adc_line = adc_line;
-    anemo_davis.last_read_time_us = 0;
+    dev->north_offset_10e1 = north_offset_10e1;
+    dev->mux_out = mux_out;
+    dev->mux_c = mux_c;
+    dev->mux_b = mux_b;
+    dev->mux_a = mux_a;
+    dev->counter_rst = counter_rst;
+    dev->counter_n_en = counter_n_en;
+    dev->adc_line = adc_line;
+    dev->last_read_time_us = 0;
+    dev->latch_time_us = 0;
 
     int8_t gpio_error = 0;
-    gpio_error += gpio_init (anemo_davis.mux_out, GPIO_IN);
-    gpio_error += gpio_init (anemo_davis.mux_c, GPIO_OUT);
-    gpio_error += gpio_init (anemo_davis.mux_b, GPIO_OUT);
-    gpio_error += gpio_init (anemo_davis.mux_a, GPIO_OUT);
-    gpio_error += gpio_init (anemo_davis.counter_rst, GPIO_OUT);
-    gpio_error += gpio_init (anemo_davis.counter_n_en, GPIO_OUT);
+    gpio_error += gpio_init (dev->mux_out, GPIO_IN);
+    gpio_error += gpio_init (dev->mux_c, GPIO_OUT);
+    gpio_error += gpio_init (dev->mux_b, GPIO_OUT);
+    gpio_error += gpio_init (dev->mux_a, GPIO_OUT);
+    gpio_error += gpio_init (dev->counter_rst, GPIO_OUT);
+    gpio_error += gpio_init (dev->counter_n_en, GPIO_OUT);
 
     if (gpio_error != 0) {
     	LOG_ERROR("Failed: gpio_init\n");
@@ -64,18 +64,18 @@ int8_t anemo_davis_init (
     }
 
     /* Reset counter */
-    if (_disable_and_reset_counter() != 0) {
+    if (_disable_and_reset_counter(dev) != 0) {
         LOG_ERROR("Failed: _disable_and_reset_counter\n");
         return -1;
     }
 
     /* Start counting and timing */
-    _enable_counter_input();
-    anemo_davis.last_read_time_us = xtimer_now_usec64();
+    _enable_counter_input(dev);
+    dev->last_read_time_us = xtimer_now_usec64();
     _wait_for_mux_output_propagation();
 
     /* Enable ADC */
-    if (adc_init(anemo_davis.adc_line) != 0) {
+    if (adc_init(dev->adc_line) != 0) {
         LOG_ERROR("Failed: adc_init\n");
         return -1;
     }
@@ -88,26 +88,44 @@ int8_t anemo_davis_init (
 /**
  * Read and reset anemometer counter, while converting to kmh speed
  */
-int anemo_davis_calc_speed_ms_10e2 (void)
+int anemo_davis_calc_speed_ms_10e2 (Anemo_davis *dev)
+{
+    anemo_davis_latch(dev);
+    return anemo_davis_read_latched_speed_ms_10e2(dev);
+}
+
+
+/**
+ * Freeze counter and save time (no waiting, so several anemometers can be
+ * latched at the same instant)
+ */
+void anemo_davis_latch (Anemo_davis *dev)
+{
+    _disable_counter_input(dev);
+    dev->latch_time_us = xtimer_now_usec64();
+}
+
+
+/**
+ * Read and reset latched counter, while converting to ms speed
+ */
+int anemo_davis_read_latched_speed_ms_10e2 (Anemo_davis *dev)
 {
-    /* Disable counter and save time */
-    _disable_counter_input();
-    uint64_t read_time_us = xtimer_now_usec64();
     _wait_for_mux_output_propagation();
 
     /* Get elapsed time and number of rotations */
-    uint64_t elapsed_time_us = read_time_us - anemo_davis.last_read_time_us;
-    int rotations = _read_rotations();
+    uint64_t elapsed_time_us = dev->latch_time_us - dev->last_read_time_us;
+    int rotations = _read_rotations(dev);
 
     /* Reset counter */
-    if (_disable_and_reset_counter() != 0) {
+    if (_disable_and_reset_counter(dev) != 0) {
         LOG_ERROR("Failed: _disable_and_reset_counter\n");
         return -1;
     }
 
     /* Enable counter and reset timer */
-    _enable_counter_input();
-    anemo_davis.last_read_time_us = xtimer_now_usec64();
+    _enable_counter_input(dev);
+    dev->last_read_time_us = xtimer_now_usec64();
     _wait_for_mux_output_propagation();
 
     /* Calculate speed in m/s * 100 */
@@ -135,10 +153,10 @@ int _calc_wind_speed_ms_10e2 (int rotations, uint64_t elapsed_time_us)
 }
 
 
-int anemo_get_wind_direction_10e1 (void)
+int anemo_get_wind_direction_10e1 (Anemo_davis *dev)
 {
 	// Read ADC
-    int adc_value = adc_sample (anemo_davis.adc_line, DAVIS_ADC_RESOLUTION);
+    int adc_value = adc_sample (dev->adc_line, DAVIS_ADC_RESOLUTION);
 
     /* Catch error */
     if (adc_value == -1) {
@@ -152,37 +170,37 @@ int anemo_get_wind_direction_10e1 (void)
     DEBUG("adc_value: %d, wind_direction: %d, DAVIS_DIRECTION_RESOLUTION: %d\n",
     		adc_value, wind_direction, DAVIS_DIRECTION_RESOLUTION);
 
-	return wind_direction + _north_offset_10e1;
+	return wind_direction + dev->north_offset_10e1;
 }
 
 
 /**
  * Read number of rotations (counter value)
  */
-static int _read_rotations (void)
+static int _read_rotations (Anemo_davis *dev)
 {
 
     int rotations = 0;
 
-    rotations |= _read_single_counter_output(0,0,0) << 0;
-    rotations |= _read_single_counter_output(0,0,1) << 1;
-    rotations |= _read_single_counter_output(0,1,0) << 2;
-    rotations |= _read_single_counter_output(0,1,1) << 3;
+    rotations |= _read_single_counter_output(dev, 0,0,0) << 0;
+    rotations |= _read_single_counter_output(dev, 0,0,1) << 1;
+    rotations |= _read_single_counter_output(dev, 0,1,0) << 2;
+    rotations |= _read_single_counter_output(dev, 0,1,1) << 3;
 
-    rotations |= _read_single_counter_output(1,0,0) << 4;
-    rotations |= _read_single_counter_output(1,0,1) << 5;
-    rotations |= _read_single_counter_output(1,1,0) << 6;
-    rotations |= _read_single_counter_output(1,1,1) << 7;
+    rotations |= _read_single_counter_output(dev, 1,0,0) << 4;
+    rotations |= _read_single_counter_output(dev, 1,0,1) << 5;
+    rotations |= _read_single_counter_output(dev, 1,1,0) << 6;
+    rotations |= _read_single_counter_output(dev, 1,1,1) << 7;
 
     DEBUG("Rotations: %d, %d, %d, %d, %d, %d, %d, %d\n",
-        _read_single_counter_output(1,1,1),
-        _read_single_counter_output(1,1,0),
-        _read_single_counter_output(1,0,1),
-        _read_single_counter_output(1,0,0),
-        _read_single_counter_output(0,1,1),
-        _read_single_counter_output(0,1,0),
-        _read_single_counter_output(0,0,1),
-        _read_single_counter_output(0,0,0)
+        _read_single_counter_output(dev, 1,1,1),
+        _read_single_counter_output(dev, 1,1,0),
+        _read_single_counter_output(dev, 1,0,1),
+        _read_single_counter_output(dev, 1,0,0),
+        _read_single_counter_output(dev, 0,1,1),
+        _read_single_counter_output(dev, 0,1,0),
+        _read_single_counter_output(dev, 0,0,1),
+        _read_single_counter_output(dev, 0,0,0)
     );
 
     return rotations;
@@ -192,23 +210,25 @@ static int _read_rotations (void)
 /**
  * Read single counter output
  */
-static int _read_single_counter_output (int mux_c_val, int mux_b_val, int mux_a_val)
+static int _read_single_counter_output (Anemo_davis *dev,
+		int mux_c_val, int mux_b_val, int mux_a_val)
 {
-    _set_address_bits(mux_c_val, mux_b_val, mux_a_val);
+    _set_address_bits(dev, mux_c_val, mux_b_val, mux_a_val);
     _wait_for_mux_output_propagation();
 
-    return gpio_read (anemo_davis.mux_out);
+    return gpio_read (dev->mux_out);
 }
 
 
 /**
  * Set muliplexer address bis
  */
-static void _set_address_bits (int mux_c_val, int mux_b_val, int mux_a_val)
+static void _set_address_bits (Anemo_davis *dev,
+		int mux_c_val, int mux_b_val, int mux_a_val)
 {
-    gpio_write (anemo_davis.mux_c, mux_c_val);
-    gpio_write (anemo_davis.mux_b, mux_b_val);
-    gpio_write (anemo_davis.mux_a, mux_a_val);
+    gpio_write (dev->mux_c, mux_c_val);
+    gpio_write (dev->mux_b, mux_b_val);
+    gpio_write (dev->mux_a, mux_a_val);
 
     return;
 }
@@ -217,15 +237,15 @@ static void _set_address_bits (int mux_c_val, int mux_b_val, int mux_a_val)
 /**
  * Reset and enable counter
  */
-static int8_t _disable_and_reset_counter (void)
+static int8_t _disable_and_reset_counter (Anemo_davis *dev)
 {
-    _set_address_bits(0,0,0);
+    _set_address_bits(dev, 0,0,0);
 
-    _disable_counter_input();
+    _disable_counter_input(dev);
     _wait_for_mux_output_propagation();
-    _clear_counter();
+    _clear_counter(dev);
 
-    if (_is_counter_reset() != 0) {
+    if (_is_counter_reset(dev) != 0) {
         LOG_ERROR("Failed: _is_counter_reset\n");
         return -1;
     }
@@ -241,9 +261,9 @@ static int8_t _disable_and_reset_counter (void)
 /**
  * Check if counter is reset by reading it
  */
-static int8_t _is_counter_reset (void)
+static int8_t _is_counter_reset (Anemo_davis *dev)
 {
-    if (_read_rotations()) {
+    if (_read_rotations(dev)) {
          return -1;
     }
     return 0;
@@ -253,33 +273,33 @@ static int8_t _is_counter_reset (void)
 /**
  * Set switch (1st MUX) to enable counter input
  */
-static void _enable_counter_input (void)
+static void _enable_counter_input (Anemo_davis *dev)
 {
-    gpio_clear (anemo_davis.counter_n_en);
+    gpio_clear (dev->counter_n_en);
 }
 
 
 /**
  * Clear switch (1st MUX) to disable counter input
  */
-static void _disable_counter_input (void)
+static void _disable_counter_input (Anemo_davis *dev)
 {
-    gpio_set (anemo_davis.counter_n_en);
+    gpio_set (dev->counter_n_en);
 }
 
 
 /**
  * Clear (reset) counter
  */
-static void _clear_counter (void)
+static void _clear_counter (Anemo_davis *dev)
 {
-    gpio_clear (anemo_davis.counter_rst);
+    gpio_clear (dev->counter_rst);
     _wait_for_mux_output_propagation();
 
-    gpio_set (anemo_davis.counter_rst);
+    gpio_set (dev->counter_rst);
     _wait_for_mux_output_propagation();
 
-    gpio_clear (anemo_davis.counter_rst);
+    gpio_clear (dev->counter_rst);
     _wait_for_mux_output_propagation();
 }
 
@@ -291,3 +311,33 @@ static void _wait_for_mux_output_propagation (void)
 {
     xtimer_usleep(MUX_PROPAGATION_DELAY_US);
 }
+
+
+#ifdef MODULE_BENCH
+static void _bench_read_rotations (void *dev)
+{
+    _read_rotations(dev);
+}
+
+static void _bench_calc_speed (void *dev)
+{
+    anemo_davis_calc_speed_ms_10e2(dev);
+}
+
+static void _bench_get_direction (void *dev)
+{
+    anemo_get_wind_direction_10e1(dev);
+}
+
+
+/**
+ * Time counter read, speed and direction
+ */
+void anemo_davis_bench (Anemo_davis *dev)
+{
+    bench_run("_read_rotations", NULL, _bench_read_rotations, dev);
+    bench_run("anemo_davis_calc_speed_ms_10e2", NULL, _bench_calc_speed, dev);
+    bench_run("anemo_get_wind_direction_10e1", NULL, _bench_get_direction,
+            dev);
+}
+#endif
@@ -22,7 +22,7 @@
 #define DAVIS_DIRECTION_RESOLUTION		(1 << 10)
 
 
-/* Anemometer physical interface and timer structure */
+/* Anemometer physical interface and timer structure (one per anemometer) */
 typedef struct {
     gpio_t mux_out;
     gpio_t mux_c;
@@ -31,12 +31,15 @@ typedef struct {
     gpio_t counter_rst;
     gpio_t counter_n_en;
     adc_t adc_line;
+    uint16_t north_offset_10e1;
     uint64_t last_read_time_us;
+    uint64_t latch_time_us;
 } Anemo_davis;
 
 /**
  * @brief   Init anemometer counter, reseet and enable
  *
+ * @param[out] dev              	Anemometer to initialize
  * @param[in]  north_offset_10e1	Offset from north
  * @param[in]  mux_out          	Multiplexer output pin
  * @param[in]  mux_c            	Multiplexer select C pin
@@ -48,6 +51,7 @@ typedef struct {
  * @returns     0 on success, -1 on fail
  */
 int8_t anemo_davis_init (
+	Anemo_davis *dev,
 	uint16_t north_offset_10e1,
     gpio_t mux_out, gpio_t mux_c, gpio_t mux_b, gpio_t mux_a,
     gpio_t counter_rst, gpio_t counter_n_en, adc_t adc_line);
@@ -55,16 +59,48 @@ int8_t anemo_davis_init (
 /**
  * @brief   Read and reset anemometer counter, while converting to ms speed
  *
+ * @param[in]  dev              	Anemometer
+ *
  * @returns     Wind speed in ms * 100
  */
-int anemo_davis_calc_speed_ms_10e2 (void);
+int anemo_davis_calc_speed_ms_10e2 (Anemo_davis *dev);
+
+/**
+ * @brief   Freeze anemometer counter and save time, without waiting
+ *
+ * Counting stops until anemo_davis_read_latched_speed_ms_10e2() is called.
+ * Use to sample several anemometers at the same instant.
+ *
+ * @param[in]  dev              	Anemometer
+ */
+void anemo_davis_latch (Anemo_davis *dev);
+
+/**
+ * @brief   Read and reset latched anemometer counter, converting to ms speed
+ *
+ * @param[in]  dev              	Anemometer, latched by anemo_davis_latch()
+ *
+ * @returns     Wind speed in ms * 100, -1 on fail
+ */
+int anemo_davis_read_latched_speed_ms_10e2 (Anemo_davis *dev);
 
 /**
  * @brief   Read wind vane direction
  *
+ * @param[in]  dev              	Anemometer
+ *
  * @returns     Direction in degrees * 10
  */
-int anemo_get_wind_direction_10e1 (void);
+int anemo_get_wind_direction_10e1 (Anemo_davis *dev);
+
+#ifdef MODULE_BENCH
+/**
+ * @brief   Time counter read, speed and direction (bench module)
+ *
+ * @param[in]  dev              	Initialized anemometer
+ */
+void anemo_davis_bench (Anemo_davis *dev);
+#endif
 
 
 
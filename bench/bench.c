@@ -0,0 +1,96 @@
+#include "bench.h"
+
+#ifdef BOARD_NATIVE
+#include "native_internal.h"
+#include <time.h>			// clock_gettime
+#else
+#include "cpu.h"			// SysTick (CMSIS)
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>			// NULL
+
+
+/* Cost of timing an empty call */
+static uint32_t _overhead;
+
+
+/* Prototypes *****************************************************************/
+static uint32_t _time_call (Bench_fn fn, void *arg);
+static void _empty (void *arg);
+
+
+/* Functions ******************************************************************/
+
+/* Start the counter, measure timing overhead and print table header. */
+void init_bench (void) {
+#ifndef BOARD_NATIVE
+	SysTick->LOAD = BENCH_COUNTER_MASK;
+	SysTick->VAL = 0;
+	SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+#endif
+
+	_overhead = UINT32_MAX;
+	for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+		uint32_t t = _time_call(_empty, NULL);
+		if (t < _overhead) {
+			_overhead = t;
+		}
+	}
+
+	printf("bench,function,iterations,min,avg,max,unit\n");
+}
+
+/* Read the counter. */
+uint32_t bench_now (void) {
+#ifdef BOARD_NATIVE
+	struct timespec ts;
+	_native_syscall_enter();
+	real_clock_gettime(CLOCK_MONOTONIC, &ts);
+	_native_syscall_leave();
+	return (uint32_t)((uint64_t)ts.tv_sec * 1000000000UL + ts.tv_nsec);
+#else
+	/* SysTick counts down */
+	return BENCH_COUNTER_MASK - SysTick->VAL;
+#endif
+}
+
+/* Time a function and print its line of the table. */
+void bench_run (const char *name, Bench_fn setup, Bench_fn fn, void *arg) {
+	uint32_t min = UINT32_MAX;
+	uint32_t max = 0;
+	uint64_t sum = 0;
+
+	for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+		if (setup != NULL) {
+			setup(arg);
+		}
+		uint32_t t = _time_call(fn, arg);
+		t = (t > _overhead) ? t - _overhead : 0;
+		sum += t;
+		if (t < min) {
+			min = t;
+		}
+		if (t > max) {
+			max = t;
+		}
+	}
+
+	printf("bench,%s,%u,%lu,%lu,%lu,%s\n", name, BENCH_ITERATIONS,
+			(unsigned long)min, (unsigned long)(sum / BENCH_ITERATIONS),
+			(unsigned long)max, BENCH_UNIT);
+}
+
+
+/* Helpers ********************************************************************/
+
+static uint32_t _time_call (Bench_fn fn, void *arg) {
+	uint32_t start = bench_now();
+	fn(arg);
+	return (bench_now() - start) & BENCH_COUNTER_MASK;
+}
+
+static void _empty (void *arg) {
+	(void)arg;
+}
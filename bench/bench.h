@@ -0,0 +1,52 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+
+/* Microbenchmarks of hot functions, timed in isolation.
+ *  Cortex-M: CPU cycles, counted by SysTick (free running, 24 bit, so
+ * calls up to 2^24 cycles). Cortex-M0+ (SAMD21) has no DWT cycle counter,
+ * and RIOT doesn't use SysTick there. Native: nanoseconds (clock_gettime).
+ *  Each function is called BENCH_ITERATIONS times, and min, average and max
+ * time per call are printed, less the overhead of timing an empty call.
+ * Output is CSV, one line per function, prefixed with "bench,":
+ *  bench,function,iterations,min,avg,max,unit
+ */
+
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS		64
+#endif
+
+#ifdef BOARD_NATIVE
+#define BENCH_UNIT				"ns"
+#define BENCH_COUNTER_MASK		0xFFFFFFFFUL
+#else
+#define BENCH_UNIT				"cycles"
+#define BENCH_COUNTER_MASK		0x00FFFFFFUL
+#endif
+
+
+/* Function under test (and untimed setup before each call) */
+typedef void (*Bench_fn)(void *arg);
+
+
+/* Start the counter, measure timing overhead and print table header. */
+void init_bench (void);
+
+/* Read the counter (wraps at BENCH_COUNTER_MASK).
+ * return:
+ *  counter value in BENCH_UNIT
+ */
+uint32_t bench_now (void);
+
+/* Time a function and print its line of the table.
+ *  p1: name of the function
+ *  p2: setup, called before every (timed) call, or NULL
+ *  p3: function under test
+ *  p4: argument of both
+ */
+void bench_run (const char *name, Bench_fn setup, Bench_fn fn, void *arg);
+
+
+#endif
@@ -0,0 +1,425 @@
+#include "data_storage.h"
+
+#include "log.h"
+#include "checksum/crc16_ccitt.h"
+#ifdef MODULE_MTD_FLASHPAGE
+#include "periph/flashpage.h"
+#endif
+
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>		// size_t
+
+#ifndef ENABLE_DEBUG
+#define ENABLE_DEBUG (0)
+#endif
+#include "debug.h"
+
+
+#define _ALIGN4(x)				(((x) + 3U) & ~3U)
+#define _LEN_ERASED				0xFFFFU
+#define _STATE_PENDING			0xFFFFFFFFU
+#define _STATE_CONSUMED			0x00000000U
+
+_Static_assert(DATA_STORAGE_BLOCKS >= 2,
+		"Ring needs at least 2 blocks (one is erased when full)");
+
+#ifdef MODULE_MTD_FLASHPAGE
+_Static_assert(DATA_STORAGE_SECTORS <= SYS_CONFIG_FLASHPAGE &&
+		DATA_STORAGE_FIRST_SECTOR <=
+		SYS_CONFIG_FLASHPAGE - DATA_STORAGE_SECTORS,
+		"data_storage region overlaps the sys_config page");
+
+/* End of firmware image: code and constants, followed by initial values of
+ * data (cortexm_base.ld) */
+extern uint32_t _etext;
+extern uint32_t _srelocate;
+extern uint32_t _erelocate;
+#endif
+
+
+typedef struct {
+	uint32_t magic;
+	uint32_t seq;
+} Block_header;
+
+typedef struct {
+	uint16_t len;
+	uint16_t crc;
+	uint32_t state;
+} Record_header;
+
+/* Position within region */
+typedef struct {
+	uint8_t block;
+	uint32_t offset;
+} Position;
+
+
+static mtd_dev_t *_mtd;
+static uint32_t _block_len;
+static uint32_t _base;
+static uint32_t _head_seq;			/* Sequence of head block */
+static Position _head;				/* Next record is written here */
+static Position _tail;				/* Oldest record, possibly consumed */
+static Data_storage_stats _stats;
+
+
+/* Prototypes *****************************************************************/
+static int8_t _write (uint32_t addr, const void *buf, uint32_t len);
+static int8_t _open_block (uint8_t block);
+static int8_t _read_record (const Position *pos, Record_header *hdr);
+static int8_t _next_record (Position *pos);
+static int8_t _is_head (const Position *pos);
+static uint32_t _count_pending (Position from, uint8_t only_block);
+static uint32_t _addr (const Position *pos);
+
+
+/* Functions ******************************************************************/
+
+/* Init MTD and recover state by scanning block and record headers. */
+int8_t init_data_storage (void) {
+
+	_mtd = DATA_STORAGE_MTD;
+	memset(&_stats, 0, sizeof(_stats));
+
+	if (mtd_init(_mtd) != 0) {
+		LOG_ERROR("Failed: mtd_init\n");
+		_mtd = NULL;
+		return -1;
+	}
+
+	uint32_t sector_len = _mtd->pages_per_sector * _mtd->page_size;
+	_block_len = DATA_STORAGE_BLOCK_SECTORS * sector_len;
+	_base = DATA_STORAGE_FIRST_SECTOR * sector_len;
+
+	if (DATA_STORAGE_FIRST_SECTOR + DATA_STORAGE_SECTORS >
+			_mtd->sector_count) {
+		LOG_ERROR("Failed: data storage region exceeds MTD\n");
+		_mtd = NULL;
+		return -1;
+	}
+
+#ifdef MODULE_MTD_FLASHPAGE
+	/* Size of the image is known only after linking */
+	uintptr_t image_end = (uintptr_t)&_etext +
+			((uintptr_t)&_erelocate - (uintptr_t)&_srelocate);
+	if ((uintptr_t)flashpage_addr(DATA_STORAGE_FIRST_SECTOR) < image_end) {
+		LOG_ERROR("Failed: data storage region overlaps firmware\n");
+		_mtd = NULL;
+		return -1;
+	}
+#endif
+
+	/* Head is in the newest block, tail in the oldest one */
+	int16_t head = -1;
+	int16_t tail = -1;
+	uint32_t tail_seq = 0;
+	for (uint8_t i = 0; i < DATA_STORAGE_BLOCKS; i++) {
+		Block_header block;
+		if (mtd_read(_mtd, &block, _base + i * _block_len,
+				sizeof(block)) < 0) {
+			LOG_ERROR("Failed: mtd_read\n");
+			_mtd = NULL;
+			return -1;
+		}
+		if (block.magic != DATA_STORAGE_MAGIC) {
+			continue;
+		}
+		if (head < 0 || block.seq > _head_seq) {
+			head = i;
+			_head_seq = block.seq;
+		}
+		if (tail < 0 || block.seq < tail_seq) {
+			tail = i;
+			tail_seq = block.seq;
+		}
+	}
+
+	if (head < 0) {
+		/* Blank region */
+		_head_seq = 0;
+		if (_open_block(0) != 0) {
+			_mtd = NULL;
+			return -1;
+		}
+		_tail = _head;
+		return 0;
+	}
+
+	/* Find end of records in head block */
+	Position pos = { (uint8_t)head, DATA_STORAGE_BLOCK_HEADER_LEN };
+	Record_header hdr;
+	while (_read_record(&pos, &hdr) == 0) {
+		pos.offset += DATA_STORAGE_RECORD_HEADER_LEN + _ALIGN4(hdr.len);
+	}
+	_head = pos;
+
+	_tail.block = (uint8_t)tail;
+	_tail.offset = DATA_STORAGE_BLOCK_HEADER_LEN;
+	_stats.pending = _count_pending(_tail, 0);
+
+	DEBUG("data_storage: head %u/%lu, tail %u, pending %lu\n",
+			_head.block, (unsigned long)_head.offset, _tail.block,
+			(unsigned long)_stats.pending);
+
+	return 0;
+}
+
+/* Append record, move head to the next block if it doesn't fit. */
+int8_t data_storage_push (const uint8_t *buf, size_t len) {
+
+	if (!_mtd) {
+		return -1;
+	}
+
+	uint32_t rec_len = DATA_STORAGE_RECORD_HEADER_LEN + _ALIGN4(len);
+	if (len >= _LEN_ERASED ||
+			rec_len > _block_len - DATA_STORAGE_BLOCK_HEADER_LEN) {
+		LOG_ERROR("Failed: record too long\n");
+		return -1;
+	}
+
+	if (_head.offset + rec_len > _block_len) {
+		uint8_t next = (_head.block + 1) % DATA_STORAGE_BLOCKS;
+
+		/* Ring full, oldest block is lost */
+		if (next == _tail.block) {
+			Position from = { next, DATA_STORAGE_BLOCK_HEADER_LEN };
+			uint32_t lost = _count_pending(from, 1);
+			_stats.overwritten += lost;
+			_stats.pending -= lost;
+			_tail.block = (next + 1) % DATA_STORAGE_BLOCKS;
+			_tail.offset = DATA_STORAGE_BLOCK_HEADER_LEN;
+		}
+
+		if (_open_block(next) != 0) {
+			return -1;
+		}
+	}
+
+	/* Header first: if reset hits in between, record fails CRC, but its
+	 * space is never written again */
+	Record_header hdr;
+	hdr.len = (uint16_t)len;
+	hdr.crc = crc16_ccitt_calc(buf, len);
+	hdr.state = _STATE_PENDING;
+
+	uint32_t addr = _addr(&_head);
+	if (_write(addr, &hdr, sizeof(hdr)) != 0 ||
+			_write(addr + sizeof(hdr), buf, len) != 0) {
+		LOG_ERROR("Failed: mtd_write\n");
+		return -1;
+	}
+
+	_head.offset += rec_len;
+	_stats.stored++;
+	_stats.pending++;
+	_stats.bytes += sizeof(hdr) + len;
+
+	return 0;
+}
+
+/* Skip consumed and corrupt records, read the first pending one. */
+int data_storage_peek (uint8_t *buf, size_t len) {
+
+	if (!_mtd) {
+		return -1;
+	}
+
+	while (_stats.pending && !_is_head(&_tail)) {
+		Record_header hdr;
+		if (_read_record(&_tail, &hdr) != 0) {
+			/* End of block (or corrupt head), continue in the next one */
+			if (_next_record(&_tail) != 0) {
+				break;
+			}
+			continue;
+		}
+
+		if (hdr.state == _STATE_PENDING) {
+			if (hdr.len > len) {
+				LOG_ERROR("Failed: record too long\n");
+				return -1;
+			}
+			if (mtd_read(_mtd, buf, _addr(&_tail) + sizeof(hdr),
+					hdr.len) < 0) {
+				LOG_ERROR("Failed: mtd_read\n");
+				return -1;
+			}
+			if (crc16_ccitt_calc(buf, hdr.len) == hdr.crc) {
+				return hdr.len;
+			}
+		}
+
+		_next_record(&_tail);
+	}
+
+	return 0;
+}
+
+/* Mark tail record consumed and advance tail. */
+int8_t data_storage_pop (void) {
+
+	if (!_mtd || !_stats.pending) {
+		return -1;
+	}
+
+	uint32_t state = _STATE_CONSUMED;
+	if (_write(_addr(&_tail) + offsetof(Record_header, state), &state,
+			sizeof(state)) != 0) {
+		LOG_ERROR("Failed: mtd_write\n");
+		return -1;
+	}
+
+	_next_record(&_tail);
+	_stats.drained++;
+	_stats.pending--;
+	_stats.bytes += sizeof(state);
+
+	return 0;
+}
+
+uint32_t data_storage_pending (void) {
+	return _stats.pending;
+}
+
+void get_data_storage_stats (Data_storage_stats *stats) {
+	*stats = _stats;
+}
+
+
+/* Helpers ********************************************************************/
+
+/* Write, split at page boundaries (MTD drivers may refuse to cross them,
+ * records longer than a page always do).
+ * return:
+ *  0 on success, -1 on error
+ */
+static int8_t _write (uint32_t addr, const void *buf, uint32_t len) {
+	const uint8_t *src = buf;
+	while (len) {
+		uint32_t n = _mtd->page_size - addr % _mtd->page_size;
+		if (n > len) {
+			n = len;
+		}
+		if (mtd_write(_mtd, src, addr, n) < 0) {
+			return -1;
+		}
+		addr += n;
+		src += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* Erase block, write its header and move head to its start. */
+static int8_t _open_block (uint8_t block) {
+	uint32_t addr = _base + block * _block_len;
+
+	if (mtd_erase(_mtd, addr, _block_len) < 0) {
+		LOG_ERROR("Failed: mtd_erase\n");
+		return -1;
+	}
+
+	Block_header hdr = { DATA_STORAGE_MAGIC, ++_head_seq };
+	if (_write(addr, &hdr, sizeof(hdr)) != 0) {
+		LOG_ERROR("Failed: mtd_write\n");
+		return -1;
+	}
+
+	_head.block = block;
+	_head.offset = DATA_STORAGE_BLOCK_HEADER_LEN;
+	_stats.erases++;
+	_stats.bytes += sizeof(hdr);
+
+	return 0;
+}
+
+/* Read record header at position.
+ * return:
+ *  0 if there is a record, -1 at end of written records
+ */
+static int8_t _read_record (const Position *pos, Record_header *hdr) {
+	if (pos->offset + DATA_STORAGE_RECORD_HEADER_LEN > _block_len) {
+		return -1;
+	}
+	if (mtd_read(_mtd, hdr, _addr(pos), sizeof(*hdr)) < 0 ||
+			hdr->len == _LEN_ERASED ||
+			pos->offset + DATA_STORAGE_RECORD_HEADER_LEN +
+			_ALIGN4(hdr->len) > _block_len) {
+		return -1;
+	}
+	return 0;
+}
+
+/* Advance position to the next record (or the next block's first one).
+ * return:
+ *  0 on success, -1 if position is at head
+ */
+static int8_t _next_record (Position *pos) {
+	if (_is_head(pos)) {
+		return -1;
+	}
+
+	Record_header hdr;
+	if (_read_record(pos, &hdr) == 0) {
+		pos->offset += DATA_STORAGE_RECORD_HEADER_LEN + _ALIGN4(hdr.len);
+	} else {
+		pos->block = (pos->block + 1) % DATA_STORAGE_BLOCKS;
+		pos->offset = DATA_STORAGE_BLOCK_HEADER_LEN;
+	}
+	return 0;
+}
+
+/* Count pending records with a valid CRC, from position to head.
+ *  p1: position
+ *  p2: 1 to stop at end of position's block
+ */
+static uint32_t _count_pending (Position from, uint8_t only_block) {
+	uint32_t count = 0;
+	uint8_t block = from.block;
+	Record_header hdr;
+
+	while (!_is_head(&from)) {
+		if (_read_record(&from, &hdr) == 0) {
+			if (hdr.state == _STATE_PENDING) {
+				/* Verify CRC in chunks, records may be longer than stack */
+				uint8_t chunk[32];
+				uint16_t crc = 0;
+				uint32_t addr = _addr(&from) + sizeof(hdr);
+				for (uint16_t i = 0; i < hdr.len; i += sizeof(chunk)) {
+					uint16_t n = hdr.len - i;
+					if (n > sizeof(chunk)) {
+						n = sizeof(chunk);
+					}
+					mtd_read(_mtd, chunk, addr + i, n);
+					crc = (i == 0) ? crc16_ccitt_calc(chunk, n) :
+							crc16_ccitt_update(crc, chunk, n);
+				}
+				if (hdr.len == 0) {
+					crc = crc16_ccitt_calc(chunk, 0);
+				}
+				count += (crc == hdr.crc);
+			}
+		} else if (only_block) {
+			break;
+		}
+		_next_record(&from);
+		if (only_block && from.block != block) {
+			break;
+		}
+	}
+
+	return count;
+}
+
+/* Check if position reached head (no more records). */
+static int8_t _is_head (const Position *pos) {
+	return (pos->block == _head.block && pos->offset >= _head.offset);
+}
+
+/* Get MTD address of position. */
+static uint32_t _addr (const Position *pos) {
+	return _base + pos->block * _block_len + pos->offset;
+}
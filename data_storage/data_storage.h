@@ -0,0 +1,108 @@
+#ifndef DATA_STORAGE_H
+#define DATA_STORAGE_H
+
+#include "../sys_config/sys_config.h"
+
+#include "mtd.h"
+
+#include <stdint.h>
+#include <stddef.h>		// size_t
+
+
+/* Persistent FIFO of encoded payloads (store-and-forward), in flash.
+ *  The region is split into blocks, used as a ring. Records are only
+ * appended at head. A record is consumed by clearing its state word
+ * (1 -> 0 bits, no erase). A block is erased only when the head moves into
+ * it, so all blocks wear evenly. When the ring is full, the oldest block
+ * is erased together with any records still pending in it.
+ *  Block: header (magic u32, sequence u32), records.
+ *  Record: length (u16), CRC-16-CCITT of data (u16), state (u32), data
+ * padded to 4 bytes.
+ */
+
+/* MTD device and region (boards w/o MTD_0 need a flashpage MTD, native uses
+ * a file-backed one) */
+#ifndef DATA_STORAGE_MTD
+#define DATA_STORAGE_MTD				MTD_0
+#endif
+#ifndef DATA_STORAGE_BLOCK_SECTORS
+#define DATA_STORAGE_BLOCK_SECTORS		16		/* 4 kB on SAMD21 (256 B rows) */
+#endif
+#ifndef DATA_STORAGE_BLOCKS
+#define DATA_STORAGE_BLOCKS				8
+#endif
+#define DATA_STORAGE_SECTORS			\
+	(DATA_STORAGE_BLOCKS * DATA_STORAGE_BLOCK_SECTORS)
+
+/* Region start. The firmware and the sys_config page share the internal
+ * flash with a flashpage MTD (a sector per flash page): region defaults to
+ * the pages right below the sys_config page (the last one), and must lie
+ * between the end of the firmware (checked on init) and that page. On
+ * native, MTD_0 is a file of its own. Elsewhere, it must be set.
+ */
+#ifndef DATA_STORAGE_FIRST_SECTOR
+#if defined(MODULE_MTD_FLASHPAGE)
+#define DATA_STORAGE_FIRST_SECTOR		\
+	(SYS_CONFIG_FLASHPAGE - DATA_STORAGE_SECTORS)
+#elif defined(BOARD_NATIVE)
+#define DATA_STORAGE_FIRST_SECTOR		0
+#else
+#error "Set DATA_STORAGE_FIRST_SECTOR to a region of DATA_STORAGE_MTD, \
+which holds neither firmware nor sys_config"
+#endif
+#endif
+
+#define DATA_STORAGE_MAGIC				0x53444E41U		/* "ANDS" */
+#define DATA_STORAGE_BLOCK_HEADER_LEN	8
+#define DATA_STORAGE_RECORD_HEADER_LEN	8
+
+
+/* Storage statistics. */
+typedef struct {
+	uint32_t stored;				/* Records appended */
+	uint32_t drained;				/* Records consumed */
+	uint32_t overwritten;			/* Pending records erased (ring full) */
+	uint32_t erases;				/* Blocks erased */
+	uint32_t bytes;					/* Bytes programmed (incl. headers) */
+	uint32_t pending;				/* Records waiting to be drained */
+} Data_storage_stats;
+
+
+/* Init MTD and recover head, tail and pending records from flash.
+ * return:
+ *  0 on success, -1 on error
+ */
+int8_t init_data_storage (void);
+
+/* Append record at head.
+ *  p1: data
+ *  p2: data length (must fit into a block)
+ * return:
+ *  0 on success, -1 on error
+ */
+int8_t data_storage_push (const uint8_t *buf, size_t len);
+
+/* Read the oldest pending record, without consuming it.
+ *  p1: pointer to where data will be written
+ *  p2: buffer length
+ * return:
+ *  record length, 0 if empty, -1 on error
+ */
+int data_storage_peek (uint8_t *buf, size_t len);
+
+/* Consume the oldest pending record (the one returned by peek).
+ * return:
+ *  0 on success, -1 on error
+ */
+int8_t data_storage_pop (void);
+
+/* Get number of pending records. */
+uint32_t data_storage_pending (void);
+
+/* Copy storage statistics.
+ *  p1: pointer to where statistics will be written
+ */
+void get_data_storage_stats (Data_storage_stats *stats);
+
+
+#endif
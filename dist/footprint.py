@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""Per-module RAM/flash footprint, from the linker map file.
+
+Every input section of the map is attributed to the module which built its
+object (directory under BINDIR, or the library archive), and summed into
+text (code and constants, flash), data (initialized, flash and RAM) and bss
+(zeroed, RAM, incl. thread stacks). Newlib's formatted I/O and float
+support is listed apart from the rest of libc. Heap is the region left
+between the linker symbols _sheap and _eheap; buffers malloc'd at runtime
+come from it and are not part of the image.
+
+The table is compared against a budget file, where each line holds a
+module name and its max. text, data and bss [bytes]. "*" limits every
+module not listed, "TOTAL" the sums. Exits with 1 if a budget is exceeded.
+Without a budget file (none measured yet), the table is only printed.
+
+usage: footprint.py MAPFILE BINDIR BUDGET [--update [--margin PERCENT]]
+  --update  write current footprint to BUDGET instead of checking it
+  --margin  with --update, add PERCENT to every figure (rounded up)
+"""
+
+import os
+import re
+import sys
+
+COLUMNS = ("text", "data", "bss")
+
+# Output sections that don't take up memory on target
+SKIP_SECTIONS = (".debug", ".comment", ".ARM.attributes", ".stab", ".note",
+                 "/DISCARD/")
+
+# Newlib objects of printf/scanf and float conversions
+LIBC_FMT = re.compile(r"printf|scanf|dtoa|mprec|strtod|float|fpcl|_fp")
+
+SECTION = re.compile(r"^(\S+)(?:\s+0x[0-9a-fA-F]+\s+0x[0-9a-fA-F]+)?")
+INPUT = re.compile(r"^ (\S+)?\s*(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(\S.*)$")
+SYMBOL = re.compile(r"^\s+(0x[0-9a-fA-F]+)\s+(_sheap|_eheap)\s*=")
+
+
+def kind(section):
+    """Column of an input section, or None."""
+    if section.startswith((".bss", ".sbss", "COMMON", ".noinit", ".stack")):
+        return "bss"
+    if section.startswith((".data", ".sdata", ".ramfunc", ".relocate")):
+        return "data"
+    if section.startswith((".text", ".rodata", ".glue", ".ARM", ".init",
+                           ".fini", ".vectors", ".isr_vector")):
+        return "text"
+    return None
+
+
+def module(path, bindir):
+    """Module an object belongs to."""
+    member = None
+    match = re.match(r"^(.*)\((.*)\)$", path)
+    if match:
+        path, member = match.groups()
+    path = os.path.normpath(path)
+
+    rel = os.path.relpath(path, bindir)
+    if not rel.startswith(".."):
+        name = rel.split(os.sep)[0]
+    else:
+        name = os.path.basename(path)
+    name = re.sub(r"\.(a|o)$", "", name)
+
+    if name.startswith("libc") and member and LIBC_FMT.search(member):
+        name += "(printf/float)"
+    return name
+
+
+def parse(mapfile, bindir):
+    """Footprint per module, and heap size."""
+    table = {}
+    heap = {}
+    out_section = None
+    in_section = None
+
+    with open(mapfile) as f:
+        lines = iter(f)
+        for line in lines:
+            if line.startswith("Linker script and memory map"):
+                break
+
+        for line in lines:
+            line = line.rstrip("\n")
+            symbol = SYMBOL.match(line)
+            if symbol:
+                heap[symbol.group(2)] = int(symbol.group(1), 16)
+                continue
+
+            if line and not line[0].isspace():
+                out_section = SECTION.match(line).group(1)
+                continue
+            if out_section is None or out_section.startswith(SKIP_SECTIONS):
+                continue
+
+            # Long input section names are followed by a line break
+            match = re.match(r"^ (\S+)$", line)
+            if match:
+                in_section = match.group(1)
+                continue
+
+            match = INPUT.match(line)
+            if not match:
+                continue
+            name = match.group(1) or in_section
+            in_section = None
+            if name is None or name == "*fill*":
+                continue
+            column = kind(name) or kind(out_section)
+            size = int(match.group(3), 16)
+            if column is None or size == 0:
+                continue
+
+            row = table.setdefault(module(match.group(4), bindir),
+                                   dict.fromkeys(COLUMNS, 0))
+            row[column] += size
+
+    heap_len = 0
+    if "_sheap" in heap and "_eheap" in heap:
+        heap_len = heap["_eheap"] - heap["_sheap"]
+    return table, heap_len
+
+
+def read_budget(path):
+    budget = {}
+    with open(path) as f:
+        for line in f:
+            line = line.split("#")[0].split()
+            if not line:
+                continue
+            budget[line[0]] = dict(zip(COLUMNS, map(int, line[1:4])))
+    return budget
+
+
+def write_budget(path, table, total, margin):
+    with open(path, "w") as f:
+        f.write("# Footprint budget [bytes], checked by 'make footprint'\n")
+        f.write("# Max. text (flash), data (flash and RAM) and bss (RAM) per "
+                "module, TOTAL\n# for the sums. Measured footprint plus %d%% "
+                "margin ('make footprint-update').\n" % margin)
+        f.write("# module                        text    data     bss\n")
+        for name in sorted(table) + ["TOTAL"]:
+            row = total if name == "TOTAL" else table[name]
+            f.write("%-28s %7d %7d %7d\n" % ((name,) + tuple(
+                -(-row[c] * (100 + margin) // 100) for c in COLUMNS)))
+
+
+def main(argv):
+    options = argv[4:]
+    update = options[:1] == ["--update"]
+    margin = 0
+    if update and options[1:2] == ["--margin"] and len(options) == 3 and \
+            options[2].isdigit():
+        margin = int(options[2])
+    elif options and options != ["--update"]:
+        sys.stderr.write(__doc__)
+        return 2
+    if len(argv) < 4:
+        sys.stderr.write(__doc__)
+        return 2
+    mapfile, bindir, budget_file = argv[1:4]
+
+    table, heap_len = parse(mapfile, bindir)
+    total = {c: sum(row[c] for row in table.values()) for c in COLUMNS}
+
+    if update:
+        write_budget(budget_file, table, total, margin)
+        print("footprint: budget written to %s (%d%% margin)" %
+              (budget_file, margin))
+        return 0
+
+    budget = read_budget(budget_file) if os.path.exists(budget_file) else {}
+    failed = 0
+
+    print("%-28s %7s %7s %7s %7s %7s" % ("module", "text", "data", "bss",
+                                         "flash", "ram"))
+    for name in sorted(table) + ["TOTAL"]:
+        row = total if name == "TOTAL" else table[name]
+        limit = budget.get(name, budget.get("*") if name != "TOTAL" else None)
+        over = [c for c in COLUMNS if limit is not None and row[c] > limit[c]]
+        print("%-28s %7d %7d %7d %7d %7d%s" % (
+            name, row["text"], row["data"], row["bss"],
+            row["text"] + row["data"], row["data"] + row["bss"],
+            ("  OVER BUDGET: " + ", ".join(
+                "%s > %d" % (c, limit[c]) for c in over)) if over else ""))
+        failed |= bool(over)
+    print("%-28s %39d" % ("heap", heap_len))
+
+    if not budget:
+        print("footprint: no budget (%s), not checked; record the measured "
+              "one with 'make footprint-update'" % budget_file)
+    if failed:
+        print("footprint: budget exceeded (%s)" % budget_file)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
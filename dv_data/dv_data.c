@@ -0,0 +1,208 @@
+#include "dv_data.h"
+#include "../anemo_davis/anemo_davis.h"
+
+#include "irq.h"
+
+#include <log.h>
+#include <string.h>			// For 'memset'
+#include <math.h>				// logf(), roundf()
+#include <stdint.h>
+#include <stddef.h>				// size_t
+
+#ifndef ENABLE_DEBUG
+#define ENABLE_DEBUG (0)
+#endif
+#include "debug.h"
+
+
+/* Field descriptors (order is part of binary payload schema). */
+const Payload_field dv_data_fields[DV_DATA_FIELDS_NUMOF] = {
+	DV_DATA_FIELDS(PAYLOAD_FIELD_DESC)
+};
+
+
+/* Prototypes *****************************************************************/
+static int8_t _init_anemo (Anemo_davis *anemo,
+		const Dv_data_anemo_params *params);
+static void _latch_both (Dv_data_dev *dev);
+static void _calc_avg_dv_data (Dv_data_dev *dev,
+		Intermediate_dv_data *intermediate);
+static int _calc_avg (int sum, int counter);
+
+static Intermediate_dv_data *_get_closed_bank (Dv_data_dev *dev);
+static void _reset_intermediate_data (Intermediate_dv_data *intermediate);
+static void _reset_avg_data (Dv_data_dev *dev);
+
+
+/* Functions ******************************************************************/
+
+/* Initiate module instance (both anemometers). */
+int8_t init_dv_data (Dv_data_dev *dev, const Dv_data_params *params) {
+
+	/* Reset state variables */
+	dev->params = params;
+	dev->error_detected = 0;
+	dev->ln_height_ratio = 0;
+
+	for (int i = 0; i < SAMPLE_EPOCH_BANKS; i++) {
+		_reset_intermediate_data(&dev->intermediate[i]);
+	}
+	_reset_avg_data(dev);
+
+	if (params->height_low_cm == 0 ||
+			params->height_high_cm <= params->height_low_cm) {
+		LOG_ERROR("Failed: dv_data heights\n");
+		dev->error_detected = 1;
+		return -1;
+	}
+	dev->ln_height_ratio =
+			logf((float)params->height_high_cm / params->height_low_cm);
+
+	if (_init_anemo(&dev->low, &params->low) != 0 ||
+			_init_anemo(&dev->high, &params->high) != 0) {
+		LOG_ERROR("Failed: _init_anemo\n");
+		dev->error_detected = 1;
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Latch both anemometers, read them and update intermediate data. */
+int8_t read_intermediate_dv_data(Dv_data_dev *dev) {
+
+	/* Get epoch of the tick, which woke the thread */
+	Sample_epoch epoch;
+	sample_epoch_get(&epoch);
+
+	Intermediate_dv_data *intermediate =
+			&dev->intermediate[SAMPLE_EPOCH_BANK(epoch.period)];
+
+	if (dev->error_detected) {
+		_reset_intermediate_data(intermediate);
+		return -1;
+	}
+
+	_latch_both(dev);
+	uint32_t skew_us = sample_epoch_skew_us(&epoch);
+
+	int speed_low = anemo_davis_read_latched_speed_ms_10e2(&dev->low);
+	int speed_high = anemo_davis_read_latched_speed_ms_10e2(&dev->high);
+
+	if (speed_low == -1 || speed_high == -1) {
+		LOG_ERROR("Failed: anemo_davis_read_latched_speed_ms_10e2\n");
+		dev->error_detected = 1;
+		return -1;
+	}
+
+	intermediate->speed_diff_sum += speed_high - speed_low;
+
+	/* Shear exponent only from ticks with wind on both heights */
+	if (speed_low >= DV_DATA_MIN_SPEED_MS_10E2 &&
+			speed_high >= DV_DATA_MIN_SPEED_MS_10E2) {
+		float f_shear = logf((float)speed_high / speed_low)
+				/ dev->ln_height_ratio;
+		intermediate->shear_10e3_sum += (int)roundf(f_shear * 1000);
+		intermediate->shear_count++;
+	}
+	intermediate->average_counter++;
+
+	DEBUG("speed_low: %d, speed_high: %d\n", speed_low, speed_high);
+
+	/* Tag sample with epoch and keep the worst skew within period */
+	intermediate->epoch = epoch;
+	if (skew_us > intermediate->max_skew_us) {
+		intermediate->max_skew_us = skew_us;
+	}
+
+	return 0;
+}
+
+/* Finalize the closed period and get its averages. */
+const Dv_data *get_avg_dv_data(Dv_data_dev *dev) {
+
+	/* Finalize and clear bank of the closed period */
+	Intermediate_dv_data *intermediate = _get_closed_bank(dev);
+	_calc_avg_dv_data(dev, intermediate);
+	_reset_intermediate_data(intermediate);
+
+	return &dev->data;
+}
+
+
+
+/* Helpers ********************************************************************/
+
+/* Init single anemometer (direction isn't used, offset is irrelevant). */
+static int8_t _init_anemo (Anemo_davis *anemo,
+		const Dv_data_anemo_params *params) {
+	return anemo_davis_init (
+			anemo, 0,
+			params->mux_out,
+			params->mux_c,
+			params->mux_b,
+			params->mux_a,
+			params->counter_rst,
+			params->counter_n_en,
+			params->adc_line);
+}
+
+/* Freeze both counters at the same instant, so speeds share a time window.
+ * Only GPIO writes and a timestamp, so interrupts are off for a few us.
+ */
+static void _latch_both (Dv_data_dev *dev) {
+	unsigned state = irq_disable();
+	anemo_davis_latch(&dev->low);
+	anemo_davis_latch(&dev->high);
+	irq_restore(state);
+}
+
+static void _calc_avg_dv_data (Dv_data_dev *dev,
+		Intermediate_dv_data *intermediate) {
+
+	/* No samples in period (e.g. error), avoid dividing by zero */
+	if (dev->error_detected || intermediate->average_counter == 0) {
+		/* Set values to zero */
+		_reset_avg_data(dev);
+		return;
+	}
+
+	dev->data.speed_diff = _calc_avg(intermediate->speed_diff_sum,
+			intermediate->average_counter);
+	dev->data.shear_10e3 = _calc_avg(intermediate->shear_10e3_sum,
+			intermediate->shear_count);
+	dev->data.shear_count = intermediate->shear_count;
+	dev->data.dv_skew = intermediate->max_skew_us;
+
+	DEBUG("speed_diff: %d, shear_10e3: %d, shear_count: %d\n",
+			dev->data.speed_diff, dev->data.shear_10e3,
+			dev->data.shear_count);
+}
+
+/* Rounded average, 0 when there are no samples. */
+static int _calc_avg (int sum, int counter) {
+	if (counter == 0) {
+		return 0;
+	}
+	return (int)roundf((float)sum / counter);
+}
+
+/* Get bank of the last closed period. */
+static Intermediate_dv_data *_get_closed_bank (Dv_data_dev *dev) {
+	Sample_period period;
+	sample_epoch_get_period(&period);
+	return &dev->intermediate[SAMPLE_EPOCH_BANK(period.index)];
+}
+
+/* (re)Set intermediate structure values to 0. */
+static void _reset_intermediate_data (Intermediate_dv_data *intermediate) {
+	memset (intermediate, 0, sizeof(*intermediate));
+}
+
+/* (re)Set avg structure values to 0. */
+static void _reset_avg_data (Dv_data_dev *dev) {
+	dev->data.speed_diff = 0;
+	dev->data.shear_10e3 = 0;
+	dev->data.shear_count = 0;
+	dev->data.dv_skew = 0;
+}
@@ -0,0 +1,139 @@
+#ifndef DV_DATA_H
+#define DV_DATA_H
+
+#include "../sample_epoch/sample_epoch.h"
+#include "../payload/payload.h"
+#include "../anemo_davis/anemo_davis.h"
+
+#include "periph/gpio.h"
+#include "periph/adc.h"
+
+#include <stdint.h>
+#include <stddef.h>				// size_t
+
+
+/* Wind gradient (dv) data: two anemometers on one mast, at different heights.
+ *  Both counters are latched at the same instant on every tick, so the speed
+ * difference and the wind shear exponent (power law, v2/v1 = (h2/h1)^alpha)
+ * are computed from the same time window:
+ *  alpha = ln(v_high / v_low) / ln(h_high / h_low)
+ */
+
+/* Min. speed of both anemometers, for the tick to count towards shear
+ * exponent (ln of ratio is meaningless in calm) [m/s * 100] */
+#define DV_DATA_MIN_SPEED_MS_10E2		50
+
+/* WCET budgets (see tasks.h) [us]: a sample call reads both counters and the
+ * vane ADC line, a pass samples all instances.
+ */
+#define DV_DATA_WCET_STEP_US			(4U * 1000U)
+#define DV_DATA_WCET_PASS_US			(10U * 1000U)
+
+/* Longest JSON key prefix of an instance */
+#define DV_DATA_PREFIX_MAX_LEN			PAYLOAD_PREFIX_MAX_LEN
+
+/* Averaged data fields, X(struct, member, type, decimals, dead-band). Order
+ * is part of binary payload schema.
+ *  speed_diff : [m/s * 10e2] (high - low)
+ *  shear_10e3 : [alpha * 10e3]
+ *  shear_count : ticks used for shear exponent
+ *  dv_skew : [us]
+ */
+#define DV_DATA_FIELDS(X)								\
+	X(Dv_data, speed_diff, I16, 2, 20)					\
+	X(Dv_data, shear_10e3, I16, 3, 10)					\
+	X(Dv_data, shear_count, I16, 0, 0)					\
+	X(Dv_data, dv_skew, U32, 0, 1000)
+
+#define DV_DATA_FIELDS_NUMOF		PAYLOAD_FIELDS_NUMOF(DV_DATA_FIELDS)
+
+/* Max. JSON length of an instance's data (derived from fields) */
+#define DV_DATA_JSON_MAX_LEN		\
+	PAYLOAD_JSON_RECORD_MAX_LEN(DV_DATA_FIELDS, DV_DATA_PREFIX_MAX_LEN)
+
+
+typedef struct {
+	int speed_diff;
+	int shear_10e3;
+	int shear_count;
+	uint32_t dv_skew;
+} Dv_data;
+
+/* Field descriptors of Dv_data. */
+extern const Payload_field dv_data_fields[DV_DATA_FIELDS_NUMOF];
+
+typedef struct {
+	int speed_diff_sum;
+	int shear_10e3_sum;
+	int shear_count;
+	int average_counter;
+	Sample_epoch epoch;				/* Epoch of the latest sample */
+	uint32_t max_skew_us;			/* Worst delay between epoch and sample */
+} Intermediate_dv_data;
+
+/* Anemometer pins. */
+typedef struct {
+	gpio_t mux_out;
+	gpio_t mux_c;
+	gpio_t mux_b;
+	gpio_t mux_a;
+	gpio_t counter_rst;
+	gpio_t counter_n_en;
+	adc_t adc_line;
+} Dv_data_anemo_params;
+
+/* Instance parameters (see dv_data_params.h). */
+typedef struct {
+	const char *prefix;				/* JSON key prefix */
+	Dv_data_anemo_params low;		/* Lower anemometer */
+	Dv_data_anemo_params high;		/* Upper anemometer */
+	uint16_t height_low_cm;			/* Height above ground [cm] */
+	uint16_t height_high_cm;
+} Dv_data_params;
+
+/* Module instance, one per pair of anemometers.
+ *  RAM: ~210 B on SAMD21 (2 anemometer interfaces 2 x 48 B, 2 intermediate
+ * banks 2 x 36 B, averages and bookkeeping).
+ */
+typedef struct {
+	const Dv_data_params *params;
+	Anemo_davis low;
+	Anemo_davis high;
+	float ln_height_ratio;			/* ln(h_high / h_low), set on init */
+	/* One bank is written by the sensor thread, while the other (closed
+	 * period) is being finalized by the serial thread.
+	 */
+	Intermediate_dv_data intermediate[SAMPLE_EPOCH_BANKS];
+	Dv_data data;
+	/* internal error variable used to set values to 0 on error */
+	int8_t error_detected;
+} Dv_data_dev;
+
+
+/* Initiate module instance (both anemometers).
+ *  p1: instance
+ *  p2: instance parameters (pins, heights, JSON prefix)
+ * return:
+ *  0 on success, -1 on error
+ */
+int8_t init_dv_data (Dv_data_dev *dev, const Dv_data_params *params);
+
+/* Latch both anemometers at the same instant, read them and update speed
+ * difference and shear exponent (minor, [us] blocking).
+ *  p1: instance
+ * return:
+ *  0: Finished
+ *  -1: error
+ */
+int8_t read_intermediate_dv_data(Dv_data_dev *dev);
+
+/* Finalize the closed period (averages, all zero on error) and reset its
+ * intermediate data.
+ *  p1: instance
+ * return:
+ *  pointer to instance's averaged data
+ */
+const Dv_data *get_avg_dv_data(Dv_data_dev *dev);
+
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef DV_DATA_PARAMS_H
+#define DV_DATA_PARAMS_H
+
+#include "dv_data.h"
+#include "../pin_settings.h"
+
+
+/* Default heights of anemometers above ground [cm] */
+#ifndef DV_DATA_HEIGHT_LOW_CM
+#define DV_DATA_HEIGHT_LOW_CM		200
+#endif
+#ifndef DV_DATA_HEIGHT_HIGH_CM
+#define DV_DATA_HEIGHT_HIGH_CM		1000
+#endif
+
+/* Default instance: lower anemometer wired as the wind data one
+ * (ANEMO_DAVIS_*), upper one as DV_DATA_HIGH_* in pin_settings.h.
+ *  Override DV_DATA_PARAMS in pin_settings.h for other wiring, or to add
+ * masts (each with a unique JSON key prefix).
+ */
+#ifndef DV_DATA_PARAMS
+#ifndef DV_DATA_HIGH_MUX_OUT
+#error "dv_data: DV_DATA_HIGH_* pins not defined for this board"
+#endif
+#define DV_DATA_PARAMS		{								\
+		.prefix = "",										\
+		.low = {											\
+			.mux_out = ANEMO_DAVIS_MUX_OUT,					\
+			.mux_c = ANEMO_DAVIS_MUX_C,						\
+			.mux_b = ANEMO_DAVIS_MUX_B,						\
+			.mux_a = ANEMO_DAVIS_MUX_A,						\
+			.counter_rst = ANEMO_DAVIS_COUNTER_RST,			\
+			.counter_n_en = ANEMO_DAVIS_COUNTER_N_EN,		\
+			.adc_line = ANEMO_DAVIS_ADC_LINE,				\
+		},													\
+		.high = {											\
+			.mux_out = DV_DATA_HIGH_MUX_OUT,				\
+			.mux_c = DV_DATA_HIGH_MUX_C,					\
+			.mux_b = DV_DATA_HIGH_MUX_B,					\
+			.mux_a = DV_DATA_HIGH_MUX_A,					\
+			.counter_rst = DV_DATA_HIGH_COUNTER_RST,		\
+			.counter_n_en = DV_DATA_HIGH_COUNTER_N_EN,		\
+			.adc_line = DV_DATA_HIGH_ADC_LINE,				\
+		},													\
+		.height_low_cm = DV_DATA_HEIGHT_LOW_CM,				\
+		.height_high_cm = DV_DATA_HEIGHT_HIGH_CM,			\
+	}
+#endif
+
+static const Dv_data_params dv_data_params[] = {
+	DV_DATA_PARAMS
+};
+
+#define DV_DATA_NUMOF		\
+	(sizeof(dv_data_params) / sizeof(dv_data_params[0]))
+
+
+#endif
@@ -1,5 +1,4 @@
 #include "el_data.h"
-#include "../pin_settings.h"
 
 #include "log.h"
 #include "xtimer.h"
@@ -15,187 +14,196 @@
 #include "debug.h"
 
 
-/* Electrical data module's state variable. */
-static uint16_t _el_data_state;
+/* Relays switched and conversions triggered in a cycle (see el_data.h) */
+_Static_assert(EL_DATA_WCET_PASS_US >=
+		3 * EL_DATA_RELAY_DELAY_US + 3 * EL_DATA_INA_CONV_MAX_US,
+		"EL_DATA_WCET_PASS_US must cover relay delays and conversions");
 
-/* Intermediate data (sum of measurements, avg. counter...). */
-static Intermediate_el_data _intermediate_el_data;
-/* Data (measurements, buffer...). */
-static El_data _el_data;
 
-/* Last time relays were swithced (shared variable).
- * RL2 and RL3 switch simultaneously.
- * RL1 waits for RL2 and RL3 to finish, before switching itself.
- */
-static uint64_t _relay_switch_time;
-
-/* Shared INA device. */
-static ina220_t _dev_ina;
-
-/* internal error variable used to set values to 0 on error */
-static int8_t _error_detected;
+/* Field descriptors (order is part of binary payload schema). */
+const Payload_field el_data_fields[EL_DATA_FIELDS_NUMOF] = {
+	EL_DATA_FIELDS(PAYLOAD_FIELD_DESC)
+};
 
 
 /* Prototypes *****************************************************************/
 
-static void _calc_avg_el_data(void);
+static void _calc_avg_el_data(El_data_dev *dev,
+		Intermediate_el_data *intermediate);
 
-static int8_t _init_ina(void);
-static int8_t _init_relays(void);
+static int8_t _init_ina(El_data_dev *dev);
+static int8_t _init_relays(El_data_dev *dev);
 
 /* State manipulation */
-static int8_t _idle_state(void);
-static int8_t _start_vx_measurement(void);
-static int8_t _measure_vx(void);
-static int8_t _set_rl2_and_rl3(void);
-static int8_t _start_pv_uoc_measurement(void);
-static int8_t _measure_pv_uoc(void);
-static int8_t _set_rl1(void);
-static int8_t _start_pv_isc_measurement(void);
-static int8_t _measure_pv_isc(void);
-static int8_t _clear_rl1(void);
-static int8_t _clear_rl2_and_rl3(void);
-
-static void _change_state(int state_mask);
-static void _reset_switch_time(void);
-static int8_t _waiting_for_switch_time(void);
+static int8_t _idle_state(El_data_dev *dev);
+static int8_t _start_vx_measurement(El_data_dev *dev);
+static int8_t _measure_vx(El_data_dev *dev);
+static int8_t _set_rl2_and_rl3(El_data_dev *dev);
+static int8_t _start_pv_uoc_measurement(El_data_dev *dev);
+static int8_t _measure_pv_uoc(El_data_dev *dev);
+static int8_t _set_rl1(El_data_dev *dev);
+static int8_t _start_pv_isc_measurement(El_data_dev *dev);
+static int8_t _measure_pv_isc(El_data_dev *dev);
+static int8_t _clear_rl1(El_data_dev *dev);
+static int8_t _clear_rl2_and_rl3(El_data_dev *dev);
+
+static void _start_cycle(El_data_dev *dev);
+static void _update_skew(El_data_dev *dev);
+static void _change_state(El_data_dev *dev, int state_mask);
+static void _reset_switch_time(El_data_dev *dev);
+static int8_t _waiting_for_switch_time(El_data_dev *dev);
 
 /* Reset data */
-static void _reset_intermediate_data(void);
-static void _reset_avg_data(void);
+static Intermediate_el_data *_get_closed_bank(El_data_dev *dev);
+static void _reset_intermediate_data(Intermediate_el_data *intermediate);
+static void _reset_avg_data(El_data_dev *dev);
 
 
 /* Functions ******************************************************************/
-/* Initiate Ina module and relays for electrical measurements. */
-int8_t init_el_data (size_t *buffer_len) {
+/* Initiate module instance (Ina module and relays). */
+int8_t init_el_data (El_data_dev *dev, const El_data_params *params) {
 
 	/* Reset state variables */
-	_el_data_state = 0;
-	_relay_switch_time = 0;
-	_error_detected = 0;
-
-	*buffer_len = EL_DATA_BUFFER_LEN;
+	dev->params = params;
+	dev->state = 0;
+	dev->relay_switch_time = 0;
+	dev->error_detected = 0;
+
+	/* Reset intermediate values (also used, when init fails) */
+	for (int i = 0; i < SAMPLE_EPOCH_BANKS; i++) {
+		_reset_intermediate_data(&dev->intermediate[i]);
+	}
+	dev->cycle_data = &dev->intermediate[0];
+	_reset_avg_data(dev);
 
-	if (_init_ina() != 0) {
+	if (_init_ina(dev) != 0) {
 		LOG_ERROR("Failed: _init_ina\n");
-		_error_detected = 1;
+		dev->error_detected = 1;
 		return -1;
 	}
 
-	if (_init_relays() != 0) {
+	if (_init_relays(dev) != 0) {
 		LOG_ERROR("Failed: _init_relays\n");
-		_error_detected = 1;
+		dev->error_detected = 1;
 		return -1;
 	}
 
-	_change_state(EL_DATA_STATE_IDLE);
+	_change_state(dev, EL_DATA_STATE_IDLE);
 
 	/* Reset relay switch time */
-	_reset_switch_time();
-
-	/* Reset intermediate values */
-	_reset_intermediate_data();
+	_reset_switch_time(dev);
 
 	return 0;
 }
 
 /* Read electrical data without blocking further execution. */
-int8_t read_intermediate_el_data(void) {
+int8_t read_intermediate_el_data(El_data_dev *dev) {
 
-	if (_error_detected) {
-		_reset_intermediate_data();
+	if (dev->error_detected) {
+		_reset_intermediate_data(dev->cycle_data);
 		return -1;
 	}
 
 	/* Exit with busy status */
-	if (_waiting_for_switch_time()) {
+	if (_waiting_for_switch_time(dev)) {
 		return 1;
 	}
 
-	switch (_el_data_state) {
+	switch (dev->state) {
 
 		case EL_DATA_STATE_IDLE:
-			_intermediate_el_data.average_counter++;
-			return _idle_state();
+			_start_cycle(dev);
+			return _idle_state(dev);
 			break;
 		case EL_DATA_STATE_START_VX_MEAS:
-			return _start_vx_measurement();
+			return _start_vx_measurement(dev);
 			break;
 		case EL_DATA_STATE_MEASURE_VX:
-			return _measure_vx();
+			return _measure_vx(dev);
 			break;
 		case EL_DATA_STATE_SET_RL2_RL3:
-			return _set_rl2_and_rl3();
+			return _set_rl2_and_rl3(dev);
 			break;
 		case EL_DATA_STATE_START_PV_UOC_MEAS:
-			return _start_pv_uoc_measurement();
+			return _start_pv_uoc_measurement(dev);
 			break;
 		case EL_DATA_STATE_MEASURE_PV_UOC:
-			return _measure_pv_uoc();
+			return _measure_pv_uoc(dev);
 			break;
 		case EL_DATA_STATE_SET_RL1:
-			return _set_rl1();
+			return _set_rl1(dev);
 			break;
 		case EL_DATA_STATE_START_PV_ISC_MEAS:
-			return _start_pv_isc_measurement();
+			return _start_pv_isc_measurement(dev);
 			break;
 		case EL_DATA_STATE_MEASURE_PV_ISC:
-			return _measure_pv_isc();
+			return _measure_pv_isc(dev);
 			break;
 		case EL_DATA_STATE_CLEAR_RL1:
-			return _clear_rl1();
+			return _clear_rl1(dev);
 			break;
 		case EL_DATA_STATE_CLEAR_RL2_RL3:
-			return _clear_rl2_and_rl3();
+			return _clear_rl2_and_rl3(dev);
 			break;
 	}
 
 	return 1;
 }
 
-/* Format measurements to JSON and write to internal buffer. */
-char *get_avg_json_el_data(void) {
+/* Finalize the closed period and get its averages. */
+const El_data *get_avg_el_data(El_data_dev *dev) {
 
-	/* Calculate average values (all zero on error) */
-	_calc_avg_el_data();
+	/* Calculate average values of the closed period (all zero on error) */
+	Intermediate_el_data *intermediate = _get_closed_bank(dev);
+	_calc_avg_el_data(dev, intermediate);
 
-	snprintf(_el_data.buffer, EL_DATA_BUFFER_LEN, EL_DATA_JSON_FORMAT,
-			_el_data.vx,
-			_el_data.pv_uoc,
-			_el_data.pv_isc);
+	/* Reset intermediate values */
+	_reset_intermediate_data(intermediate);
 
-	DEBUG("%s\n", _el_data.buffer);
+	return &dev->data;
+}
 
-	return _el_data.buffer;
+/* Variance of the last finalized period (adaptive period). */
+uint32_t get_var_el_data(const El_data_dev *dev) {
+	return dev->pv_isc_var;
 }
 
+
 /* Calculate average values and save to static structure.
  * All values are set to zero when module error is detected.
  */
-void _calc_avg_el_data(void) {
+void _calc_avg_el_data(El_data_dev *dev,
+		Intermediate_el_data *intermediate) {
 
-	if (_error_detected) {
+	/* No samples in period (e.g. error), avoid dividing by zero */
+	if (dev->error_detected || intermediate->average_counter == 0) {
 		/* Set values to zero */
-		_reset_avg_data();
+		_reset_avg_data(dev);
 		return;
 	}
 
-	int average_counter = _intermediate_el_data.average_counter;
+	int average_counter = intermediate->average_counter;
 
-	float f_vx = (float)_intermediate_el_data.vx_sum / average_counter;
-	_el_data.vx = (int)roundf(f_vx);
+	float f_vx = (float)intermediate->vx_sum / average_counter;
+	dev->data.vx = (int)roundf(f_vx);
 
-	float f_pv_uoc = (float)_intermediate_el_data.pv_uoc_sum / average_counter;
-	_el_data.pv_uoc = (int)roundf(f_pv_uoc);
+	float f_pv_uoc = (float)intermediate->pv_uoc_sum / average_counter;
+	dev->data.pv_uoc = (int)roundf(f_pv_uoc);
 
-	float f_pv_isc = (float)_intermediate_el_data.pv_isc_sum / average_counter;
-	_el_data.pv_isc = (int)roundf(f_pv_isc);
+	float f_pv_isc = (float)intermediate->pv_isc_sum / average_counter;
+	dev->data.pv_isc = (int)roundf(f_pv_isc);
 
-	DEBUG("vx: %d, pv_uoc: %d, pv_isc: %d, avg: %d\n",
-			_el_data.vx, _el_data.pv_uoc, _el_data.pv_isc, average_counter);
+	/* Variance (population), from sum and sum of squares */
+	int64_t pv_isc_var = ((int64_t)intermediate->pv_isc_sq_sum -
+			(int64_t)intermediate->pv_isc_sum * intermediate->pv_isc_sum /
+			average_counter) / average_counter;
+	dev->pv_isc_var = (pv_isc_var < 0) ? 0 :
+			(pv_isc_var > UINT32_MAX) ? UINT32_MAX : (uint32_t)pv_isc_var;
 
-	/* Reset intermediate values */
-	_reset_intermediate_data();
+	dev->data.el_skew = intermediate->max_skew_us;
+
+	DEBUG("vx: %d, pv_uoc: %d, pv_isc: %d, avg: %d\n",
+			dev->data.vx, dev->data.pv_uoc, dev->data.pv_isc, average_counter);
 
 	return;
 }
@@ -208,20 +216,21 @@ void _calc_avg_el_data(void) {
  * 	0: Success
  * 	-1: Failed
  */
-int8_t _init_ina(void) {
-	if (ina220_init(&_dev_ina, EL_DATA_I2C_DEV, INA_I2C_ADDR) != 0) {
+int8_t _init_ina(El_data_dev *dev) {
+	if (ina220_init(&dev->ina, dev->params->i2c,
+			dev->params->addr) != 0) {
 		LOG_ERROR("Failed: ina220_init\n");
-		_error_detected = 1;
+		dev->error_detected = 1;
         return -1;
 	}
-	if (ina220_set_config(&_dev_ina, INA_CONFIG) != 0) {
+	if (ina220_set_config(&dev->ina, INA_CONFIG) != 0) {
 		LOG_ERROR("Failed: ina220_set_config\n");
-		_error_detected = 1;
+		dev->error_detected = 1;
 		return EL_DATA_DISCONNECTED;
 	}
-	if (ina220_set_calibration(&_dev_ina, INA_CALIBRATION) != 0) {
+	if (ina220_set_calibration(&dev->ina, INA_CALIBRATION) != 0) {
 		LOG_ERROR("Failed: ina220_set_calibration\n");
-		_error_detected = 1;
+		dev->error_detected = 1;
 		return -1;
 	}
 	return 0;
@@ -232,35 +241,35 @@ int8_t _init_ina(void) {
  * 	0: Success
  * 	-1: Failed
  */
-int8_t _init_relays(void) {
+int8_t _init_relays(El_data_dev *dev) {
 	/* Pin setup */
-    if (gpio_init (EL_DATA_RE1_PIN, GPIO_OUT) != 0) {
+    if (gpio_init (dev->params->re1, GPIO_OUT) != 0) {
     	LOG_ERROR("Failed: gpio_init\n");
-		_error_detected = 1;
+		dev->error_detected = 1;
 		return -1;
     }
 #if (EL_DATA_MODE & EL_DATA_MODE_VX)
-    if (gpio_init(EL_DATA_RE2_PIN, GPIO_OUT) != 0) {
+    if (gpio_init(dev->params->re2, GPIO_OUT) != 0) {
     	LOG_ERROR("Failed: gpio_init\n");
-		_error_detected = 1;
+		dev->error_detected = 1;
 		return -1;
     }
 #endif
 #if (EL_DATA_MODE & EL_DATA_MODE_CHARGE_EN)
-    if (gpio_init(EL_DATA_RE3_PIN, GPIO_OUT) != 0) {
+    if (gpio_init(dev->params->re3, GPIO_OUT) != 0) {
     	LOG_ERROR("Failed: gpio_init\n");
-		_error_detected = 1;
+		dev->error_detected = 1;
 		return -1;
     }
 #endif
 
     /* Clear pins */
-	gpio_clear(EL_DATA_RE1_PIN);
+	gpio_clear(dev->params->re1);
 #if (EL_DATA_MODE & EL_DATA_MODE_VX)
-	gpio_clear(EL_DATA_RE2_PIN);
+	gpio_clear(dev->params->re2);
 #endif
 #if (EL_DATA_MODE & EL_DATA_MODE_CHARGE_EN)
-	gpio_clear(EL_DATA_RE3_PIN);
+	gpio_clear(dev->params->re3);
 #endif
 
 	return 0;
@@ -271,17 +280,17 @@ int8_t _init_relays(void) {
 
 /* Reduntant state - for easier understanding of state machine.
  */
-int8_t _idle_state(void) {
+int8_t _idle_state(El_data_dev *dev) {
 
 #if (EL_DATA_MODE & EL_DATA_MODE_VX)
 	/* Next read interval will start by measuring Vx */
-	_change_state(EL_DATA_STATE_START_VX_MEAS);
+	_change_state(dev, EL_DATA_STATE_START_VX_MEAS);
 #elif (EL_DATA_MODE & EL_DATA_MODE_CHARGE_EN)
 	/* Next read interval will start by switching RL3 */
-	_change_state(EL_DATA_STATE_SET_RL2_RL3);
+	_change_state(dev, EL_DATA_STATE_SET_RL2_RL3);
 #else
 	/* Next read interval will start by measuring Uoc */
-	_change_state(EL_DATA_STATE_START_PV_UOC_MEAS);
+	_change_state(dev, EL_DATA_STATE_START_PV_UOC_MEAS);
 #endif
 
 	/* Return 'not yet finished' */
@@ -294,35 +303,36 @@ int8_t _idle_state(void) {
  *  1: Triggered
  *  -1: Failiure
  */
-int8_t _start_vx_measurement(void) {
-	if (ina220_set_config(&_dev_ina, INA_CONFIG) != 0) {
+int8_t _start_vx_measurement(El_data_dev *dev) {
+	if (ina220_set_config(&dev->ina, INA_CONFIG) != 0) {
 		LOG_ERROR("Failed: ina220_set_config\n");
-		_error_detected = 1;
+		dev->error_detected = 1;
 		return EL_DATA_DISCONNECTED;
 	}
-	_change_state(EL_DATA_STATE_MEASURE_VX);
+	_change_state(dev, EL_DATA_STATE_MEASURE_VX);
 	return 1;
 }
 
 
 /* Measure Vx.
  */
-int8_t _measure_vx(void) {
+int8_t _measure_vx(El_data_dev *dev) {
 
 	/* Check CNVR bit and exit if nothing new */
 	int16_t val;
-    ina220_read_bus(&_dev_ina, &val);
+    ina220_read_bus(&dev->ina, &val);
     if (!(val & INA_CNVR_READY_MASK)) {
     	return 1;
     }
 
     val = (val >> INA220_BUS_VOLTAGE_SHIFT) * 4;
 
-	_intermediate_el_data.vx_sum += (int)val;
-	_change_state(EL_DATA_STATE_SET_RL2_RL3);
+	dev->cycle_data->vx_sum += (int)val;
+	_update_skew(dev);
+	_change_state(dev, EL_DATA_STATE_SET_RL2_RL3);
 
 	DEBUG("bus: %6d mV, vx_sum: %d\n",
-			val, _intermediate_el_data.vx_sum);
+			val, dev->cycle_data->vx_sum);
 
 	/* Return 'not yet finished' */
 	return 1;
@@ -331,17 +341,17 @@ int8_t _measure_vx(void) {
 
 /* Connect relays RL2 and/or RL3.
  */
-int8_t _set_rl2_and_rl3(void) {
+int8_t _set_rl2_and_rl3(El_data_dev *dev) {
 	/* Set corresponding relay pins to high */
 #if (EL_DATA_MODE & EL_DATA_MODE_VX)
-	gpio_set(EL_DATA_RE2_PIN);
+	gpio_set(dev->params->re2);
 #endif
 #if (EL_DATA_MODE & EL_DATA_MODE_CHARGE_EN)
-	gpio_set(EL_DATA_RE3_PIN);
+	gpio_set(dev->params->re3);
 #endif
 	/* Reset timer and change state */
-	_reset_switch_time();
-	_change_state(EL_DATA_STATE_START_PV_UOC_MEAS);
+	_reset_switch_time(dev);
+	_change_state(dev, EL_DATA_STATE_START_PV_UOC_MEAS);
 	//_set_switching_mask();
 
 	/* Return 'not yet finished' */
@@ -354,35 +364,36 @@ int8_t _set_rl2_and_rl3(void) {
  *  1: Triggered
  *  -1: Failiure
  */
-int8_t _start_pv_uoc_measurement(void) {
-	if (ina220_set_config(&_dev_ina, INA_CONFIG) != 0) {
+int8_t _start_pv_uoc_measurement(El_data_dev *dev) {
+	if (ina220_set_config(&dev->ina, INA_CONFIG) != 0) {
 		LOG_ERROR("Failed: ina220_set_config\n");
-		_error_detected = 1;
+		dev->error_detected = 1;
 		return EL_DATA_DISCONNECTED;
 	}
-	_change_state(EL_DATA_STATE_MEASURE_PV_UOC);
+	_change_state(dev, EL_DATA_STATE_MEASURE_PV_UOC);
 	return 1;
 }
 
 
 /* Measure Uoc.
  */
-int8_t _measure_pv_uoc(void) {
+int8_t _measure_pv_uoc(El_data_dev *dev) {
 
 	/* Check CNVR bit and exit if nothing new */
 	int16_t val;
-    ina220_read_bus(&_dev_ina, &val);
+    ina220_read_bus(&dev->ina, &val);
     if (!(val & INA_CNVR_READY_MASK)) {
     	return 1;
     }
 
     val = (val >> INA220_BUS_VOLTAGE_SHIFT) * 4;
 
-	_intermediate_el_data.pv_uoc_sum += (int)val;
-	_change_state(EL_DATA_STATE_SET_RL1);
+	dev->cycle_data->pv_uoc_sum += (int)val;
+	_update_skew(dev);
+	_change_state(dev, EL_DATA_STATE_SET_RL1);
 
 	DEBUG("bus: %6d mV, pv_uoc_sum: %d\n",
-			val, _intermediate_el_data.pv_uoc_sum);
+			val, dev->cycle_data->pv_uoc_sum);
 
 	/* Return 'not yet finished' */
 	return 1;
@@ -391,12 +402,12 @@ int8_t _measure_pv_uoc(void) {
 
 /* Connect relay RL1.
  */
-int8_t _set_rl1(void) {
+int8_t _set_rl1(El_data_dev *dev) {
 	/* Set corresponding relay pin to high */
-	gpio_set(EL_DATA_RE1_PIN);
+	gpio_set(dev->params->re1);
 	/* Reset timer and change state */
-	_reset_switch_time();
-	_change_state(EL_DATA_STATE_START_PV_ISC_MEAS);
+	_reset_switch_time(dev);
+	_change_state(dev, EL_DATA_STATE_START_PV_ISC_MEAS);
 
 	/* Return 'not yet finished' */
 	return 1;
@@ -408,35 +419,37 @@ int8_t _set_rl1(void) {
  *  1: Triggered
  *  -1: Failure
  */
-int8_t _start_pv_isc_measurement(void) {
-	if (ina220_set_config(&_dev_ina, INA_CONFIG) != 0) {
+int8_t _start_pv_isc_measurement(El_data_dev *dev) {
+	if (ina220_set_config(&dev->ina, INA_CONFIG) != 0) {
 		LOG_ERROR("Failed: ina220_set_config\n");
-		_error_detected = 1;
+		dev->error_detected = 1;
 		return EL_DATA_DISCONNECTED;
 	}
-	_change_state(EL_DATA_STATE_MEASURE_PV_ISC);
+	_change_state(dev, EL_DATA_STATE_MEASURE_PV_ISC);
 	return 1;
 }
 
 
 /* Measure Isc.
  */
-int8_t _measure_pv_isc(void) {
+int8_t _measure_pv_isc(El_data_dev *dev) {
 
 	/* Check CNVR bit and exit if nothing new */
 	int16_t val;
-    ina220_read_bus(&_dev_ina, &val);
+    ina220_read_bus(&dev->ina, &val);
     if (!(val & INA_CNVR_READY_MASK)) {
     	return 1;
     }
 
-    ina220_read_current(&_dev_ina, &val);
+    ina220_read_current(&dev->ina, &val);
 
-	_intermediate_el_data.pv_isc_sum += (int)val;
-	_change_state(EL_DATA_STATE_CLEAR_RL1);
+	dev->cycle_data->pv_isc_sum += (int)val;
+	dev->cycle_data->pv_isc_sq_sum += (uint64_t)((int32_t)val * val);
+	_update_skew(dev);
+	_change_state(dev, EL_DATA_STATE_CLEAR_RL1);
 
 	DEBUG("current: %6d mA, pv_isc_sum: %d\n",
-			val, _intermediate_el_data.pv_isc_sum);
+			val, dev->cycle_data->pv_isc_sum);
 
 	/* Return 'not yet finished' */
 	return 1;
@@ -445,20 +458,20 @@ int8_t _measure_pv_isc(void) {
 
 /* Disconnect relay RL1.
  */
-int8_t _clear_rl1(void) {
+int8_t _clear_rl1(El_data_dev *dev) {
 	/* Set corresponding relay pin to high */
-	gpio_clear(EL_DATA_RE1_PIN);
+	gpio_clear(dev->params->re1);
 
 	/* Reset timer and change state */
-	_reset_switch_time();
+	_reset_switch_time(dev);
 
 #if (EL_DATA_MODE & EL_DATA_MODE_VX || EL_DATA_MODE & EL_DATA_MODE_CHARGE_EN)
 	/* Clear RL2, RL3 before proceding */
-	_change_state(EL_DATA_STATE_CLEAR_RL2_RL3);
+	_change_state(dev, EL_DATA_STATE_CLEAR_RL2_RL3);
 	/* Return 'not yet finished' */
 	return 1;
 #else
-	_change_state(EL_DATA_STATE_IDLE);
+	_change_state(dev, EL_DATA_STATE_IDLE);
 	/* Return 'finished' */
 	return 0;
 #endif
@@ -467,19 +480,19 @@ int8_t _clear_rl1(void) {
 
 /* Disconnect relays RL2 and/or RL3.
  */
-int8_t _clear_rl2_and_rl3(void) {
+int8_t _clear_rl2_and_rl3(El_data_dev *dev) {
 	/* Set corresponding relay pins to high */
 #if (EL_DATA_MODE & EL_DATA_MODE_VX)
-	gpio_clear(EL_DATA_RE2_PIN);
+	gpio_clear(dev->params->re2);
 #endif
 #if (EL_DATA_MODE & EL_DATA_MODE_CHARGE_EN)
-	gpio_clear(EL_DATA_RE3_PIN);
+	gpio_clear(dev->params->re3);
 #endif
 
 	/* Reset timer and change state */
-	_reset_switch_time();
+	_reset_switch_time(dev);
 
-	_change_state(EL_DATA_STATE_IDLE);
+	_change_state(dev, EL_DATA_STATE_IDLE);
 	/* Return 'finished' */
 	return 0;
 //#endif
@@ -488,43 +501,78 @@ int8_t _clear_rl2_and_rl3(void) {
 
 /* Helpers ********************************************************************/
 
+/* Tag measurement cycle with epoch of the waking tick, and select the bank of
+ * epoch's period for the whole cycle.
+ */
+void _start_cycle(El_data_dev *dev) {
+	Sample_epoch epoch;
+	sample_epoch_get(&epoch);
+	dev->cycle_data = &dev->intermediate[SAMPLE_EPOCH_BANK(epoch.period)];
+	dev->cycle_data->epoch = epoch;
+	dev->cycle_data->average_counter++;
+}
+
+
+/* Keep the worst delay between cycle's epoch and measurement within period.
+ */
+void _update_skew(El_data_dev *dev) {
+	uint32_t skew_us = sample_epoch_skew_us(&dev->cycle_data->epoch);
+	if (skew_us > dev->cycle_data->max_skew_us) {
+		dev->cycle_data->max_skew_us = skew_us;
+	}
+}
+
+
 /* Change el. data state.
  *  param1: new state's mask
  */
-void _change_state(int state_mask) {
-	_el_data_state &= EL_DATA_STATE_MASK_RST_STATE;
-	_el_data_state |= state_mask;
+void _change_state(El_data_dev *dev, int state_mask) {
+	dev->state &= EL_DATA_STATE_MASK_RST_STATE;
+	dev->state |= state_mask;
 }
 
 
 /* Reset relay switch timer.
  */
-void _reset_switch_time(void) {
-	_relay_switch_time = xtimer_now_usec64();
+void _reset_switch_time(El_data_dev *dev) {
+	dev->relay_switch_time = xtimer_now_usec64();
 }
 
 
 /* Check if relay timer has ended.
  */
-int8_t _waiting_for_switch_time(void) {
+int8_t _waiting_for_switch_time(El_data_dev *dev) {
 	return
-		(!(xtimer_now_usec64() - _relay_switch_time > EL_DATA_RELAY_DELAY_US));
+		(!(xtimer_now_usec64() - dev->relay_switch_time > EL_DATA_RELAY_DELAY_US));
+}
+
+
+/* Get bank of the last closed period.
+ */
+Intermediate_el_data *_get_closed_bank(El_data_dev *dev) {
+	Sample_period period;
+	sample_epoch_get_period(&period);
+	return &dev->intermediate[SAMPLE_EPOCH_BANK(period.index)];
 }
 
 
 /* (re)Set intermediate structure values to 0.
  */
-void _reset_intermediate_data (void) {
-	_intermediate_el_data.vx_sum = 0;
-	_intermediate_el_data.pv_uoc_sum = 0;
-	_intermediate_el_data.pv_isc_sum = 0;
-	_intermediate_el_data.average_counter = 0;
+void _reset_intermediate_data (Intermediate_el_data *intermediate) {
+	intermediate->vx_sum = 0;
+	intermediate->pv_uoc_sum = 0;
+	intermediate->pv_isc_sum = 0;
+	intermediate->pv_isc_sq_sum = 0;
+	intermediate->average_counter = 0;
+	intermediate->max_skew_us = 0;
 }
 
 /* (re)Set average structure values to 0.
  */
-static void _reset_avg_data (void) {
-	_el_data.vx = 0;
-	_el_data.pv_uoc = 0;
-	_el_data.pv_isc = 0;
+static void _reset_avg_data (El_data_dev *dev) {
+	dev->data.vx = 0;
+	dev->data.pv_uoc = 0;
+	dev->data.pv_isc = 0;
+	dev->data.el_skew = 0;
+	dev->pv_isc_var = 0;
 }
@@ -3,6 +3,10 @@
 
 
 #include "ina220.h"
+#include "periph/gpio.h"
+#include "periph/i2c.h"
+#include "../sample_epoch/sample_epoch.h"
+#include "../payload/payload.h"
 
 #include <stdint.h>
 #include <stddef.h>				// size_t
@@ -42,22 +46,46 @@
 /* HF3FD relay needs 10ms (datasheet) */
 #define EL_DATA_RELAY_DELAY_US				(20 * 1000)
 
-/* Json buffer format (%05d => sign + %04d).
- * 	vx : Sxxxx [mV]
- *  pv_uoc : Sxxxx [mV]
- *	pv_isc : Sxxxx [mA]
+/* Max. INA220 conversion time, shunt and bus at 12 bit (datasheet) [us] */
+#define EL_DATA_INA_CONV_MAX_US				(2 * 586)
+
+/* WCET budgets (see tasks.h) [us]: a sample call is a single state machine
+ * step (I2C transfers, no waiting). A pass goes through the whole cycle,
+ * including relay delays and INA220 conversions, of all instances.
+ * A cycle waits for 3 relay switches and 3 conversions, 63.5 ms at most
+ * (checked in el_data.c). In virtual time on the host it took 63224 us, and
+ * 86420 with 8512 us conversions (16 sample averaging, test-wcet). I2C
+ * transfer times aren't simulated.
+ */
+#define EL_DATA_WCET_STEP_US				(5U * 1000U)
+#define EL_DATA_WCET_PASS_US				(100U * 1000U)
+
+/* Adaptive period (see sys_control.h): period is variable, when variance of
+ * PV current exceeds (100 mA)^2 [mA^2], e.g. on passing clouds.
  */
-#define EL_DATA_JSON_FORMAT		""\
-	"\"vx\":%d,"\
-	"\"pv_uoc\":%d,"\
-	"\"pv_isc\":%d"
-//#define EL_DATA_JSON_FORMAT		""\
-//	"\"vx\":%05d,"\
-//	"\"pv_uoc\":%05d,"\
-//	"\"pv_isc\":%05d"
+#define EL_DATA_VAR_MAX						(100UL * 100UL)
+
+/* Max. length of an instance's JSON key prefix (e.g. "pv2_"). */
+#define EL_DATA_PREFIX_MAX_LEN				PAYLOAD_PREFIX_MAX_LEN
+
+/* Averaged data fields, X(struct, member, type, decimals, dead-band). Order
+ * is part of binary payload schema.
+ * 	vx : [mV]
+ *  pv_uoc : [mV]
+ *	pv_isc : [mA]
+ *	el_skew : [us]
+ */
+#define EL_DATA_FIELDS(X)								\
+	X(El_data, vx, I16, 0, 50)							\
+	X(El_data, pv_uoc, I16, 0, 100)						\
+	X(El_data, pv_isc, I16, 0, 20)						\
+	X(El_data, el_skew, U32, 0, 1000)
+
+#define EL_DATA_FIELDS_NUMOF		PAYLOAD_FIELDS_NUMOF(EL_DATA_FIELDS)
 
-/* Length of json data buffer */
-#define EL_DATA_BUFFER_LEN		64
+/* Max. JSON length of an instance's data (derived from fields) */
+#define EL_DATA_JSON_MAX_LEN		\
+	PAYLOAD_JSON_RECORD_MAX_LEN(EL_DATA_FIELDS, EL_DATA_PREFIX_MAX_LEN)
 
 
 /* Ina configuration and calibration ******************************************/
@@ -77,7 +105,10 @@ typedef struct {
 	int vx_sum;
 	int pv_isc_sum;
 	int pv_uoc_sum;
+	uint64_t pv_isc_sq_sum;			/* Sum of squares, for variance */
 	int average_counter;
+	Sample_epoch epoch;				/* Epoch of the latest cycle */
+	uint32_t max_skew_us;			/* Worst delay between epoch and sample */
 } Intermediate_el_data;
 
 /* Data (measurements, buffer...). */
@@ -85,30 +116,78 @@ typedef struct {
 int vx;
 int pv_isc;
 int pv_uoc;
-char buffer[EL_DATA_BUFFER_LEN];
+uint32_t el_skew;
 } El_data;
 
+/* Field descriptors of El_data. */
+extern const Payload_field el_data_fields[EL_DATA_FIELDS_NUMOF];
 
-/* Initiate Ina module and relays for electrical measurements.
- *  p1: pointer to where the module's buffer lenght will be written
+
+/* Instance parameters (one INA220 and set of relays per PV panel). */
+typedef struct {
+	const char *prefix;				/* JSON key prefix, unique per instance */
+	i2c_t i2c;						/* INA220 bus */
+	uint8_t addr;					/* INA220 address */
+	gpio_t re1;						/* Relay pins */
+	gpio_t re2;
+	gpio_t re3;
+} El_data_params;
+
+/* Instance state (~140 B of RAM per instance). */
+typedef struct {
+	const El_data_params *params;
+	uint16_t state;					/* State machine's state */
+	/* Last time relays were swithced (shared among instance's relays).
+	 * RL2 and RL3 switch simultaneously.
+	 * RL1 waits for RL2 and RL3 to finish, before switching itself.
+	 */
+	uint64_t relay_switch_time;
+	ina220_t ina;
+	/* One bank is written by the sensor thread, while the other (closed
+	 * period) is being finalized by the serial thread.
+	 */
+	Intermediate_el_data intermediate[SAMPLE_EPOCH_BANKS];
+	/* Bank of the running measurement cycle. A cycle spans several calls,
+	 * so the bank is chosen once, at cycle start, and kept until it finishes.
+	 */
+	Intermediate_el_data *cycle_data;
+	El_data data;
+	uint32_t pv_isc_var;			/* PV current variance, last period [mA^2] */
+	int8_t error_detected;			/* Set values to 0 on error */
+} El_data_dev;
+
+
+/* Initiate module instance (Ina module and relays).
+ *  p1: instance to initiate
+ *  p2: instance parameters (must outlive the instance)
  * return:
  *  0 on success, -1 on error
  */
-int8_t init_el_data (size_t *buffer_len);
+int8_t init_el_data (El_data_dev *dev, const El_data_params *params);
 
 /* Read electrical data without blocking further execution.
+ *  p1: instance
  * return:
  *  0: measurement cycle finished
  *  1: measurement cycle running
  *  -1: error
  */
-int8_t read_intermediate_el_data(void);
+int8_t read_intermediate_el_data(El_data_dev *dev);
+
+/* Finalize the closed period (averages, all zero on error) and reset its
+ * intermediate data.
+ *  p1: instance
+ * return:
+ *  pointer to instance's averaged data
+ */
+const El_data *get_avg_el_data(El_data_dev *dev);
 
-/* Format measurements to JSON and write to internal buffer.
+/* Get variance of PV current in the last finalized period.
+ *  p1: instance
  * return:
- *  pointer to array's (string's) start address
+ *  variance [mA^2]
  */
-char *get_avg_json_el_data(void);
+uint32_t get_var_el_data(const El_data_dev *dev);
 
 
 #endif
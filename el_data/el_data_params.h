@@ -0,0 +1,36 @@
+#ifndef EL_DATA_PARAMS_H
+#define EL_DATA_PARAMS_H
+
+#include "el_data.h"
+#include "../pin_settings.h"
+
+
+/* Default instance: single PV panel, wired as in pin_settings.h.
+ *  To measure more panels, define EL_DATA_PARAMS in pin_settings.h as a list
+ * of instances, each with its own INA220 address, relay pins and a unique
+ * JSON key prefix, e.g.:
+ *
+ *  #define EL_DATA_PARAMS \
+ *      { .prefix = "", .addr = 0x45, ... }, \
+ *      { .prefix = "pv2_", .addr = 0x44, ... }
+ */
+#ifndef EL_DATA_PARAMS
+#define EL_DATA_PARAMS		{								\
+		.prefix = "",										\
+		.i2c = EL_DATA_I2C_DEV,								\
+		.addr = INA_I2C_ADDR,								\
+		.re1 = EL_DATA_RE1_PIN,								\
+		.re2 = EL_DATA_RE2_PIN,								\
+		.re3 = EL_DATA_RE3_PIN,								\
+	}
+#endif
+
+static const El_data_params el_data_params[] = {
+	EL_DATA_PARAMS
+};
+
+#define EL_DATA_NUMOF		\
+	(sizeof(el_data_params) / sizeof(el_data_params[0]))
+
+
+#endif
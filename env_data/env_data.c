@@ -1,6 +1,5 @@
 #include "env_data.h"
 
-#include "bmx280_params.h"
 #include "bmx280.h"
 
 #include "log.h"
@@ -16,60 +15,67 @@
 #include "debug.h"
 
 
-/* Intermediate data (sum of measurements, avg. counter...). */
-static Intermediate_env_data _intermediate_env_data;
-/* Data (measurements, buffer...). */
-static Env_data _env_data;
-
-/* Shared BME280 device. */
-static bmx280_t _dev_bme;
-
-/* internal error variable used to set values to 0 on error */
-static int8_t _error_detected;
+/* Field descriptors (order is part of binary payload schema). */
+const Payload_field env_data_fields[ENV_DATA_FIELDS_NUMOF] = {
+	ENV_DATA_FIELDS(PAYLOAD_FIELD_DESC)
+};
 
 
 /* Prototypes *****************************************************************/
 
-static void _calc_avg_env_data(void);
+static void _calc_avg_env_data(Env_data_dev *dev,
+		Intermediate_env_data *intermediate);
 
-static int _get_rel_humidity_rh_10e1 (void);
-static int _get_air_temp_c_10e1 (void);
-static int _get_air_pressure_hpa_10e1 (void);
+static int _get_rel_humidity_rh_10e1 (Env_data_dev *dev);
+static int _get_air_temp_c_10e1 (Env_data_dev *dev);
+static int _get_air_pressure_hpa_10e1 (Env_data_dev *dev);
 
 static int16_t _is_temperature_valid (int temperature);
 
-static void _reset_intermediate_data (void);
-static void _reset_avg_data (void);
+static Intermediate_env_data *_get_closed_bank (Env_data_dev *dev);
+static void _reset_intermediate_data (Intermediate_env_data *intermediate);
+static void _reset_avg_data (Env_data_dev *dev);
 
 
 /* Functions ******************************************************************/
 
-/* Initiate Device. */
-int8_t init_env_data (size_t *buffer_len) {
+/* Initiate Device (module instance). */
+int8_t init_env_data (Env_data_dev *dev, const Env_data_params *params) {
 
 	/* Reset state variables */
-	_error_detected = 0;
-
-	*buffer_len = ENV_DATA_BUFFER_LEN;
+	dev->params = params;
+	dev->error_detected = 0;
 
-	if (bmx280_init(&_dev_bme, &bmx280_params[0]) != 0) {
+	if (bmx280_init(&dev->bme, params->bmx280) != 0) {
 		LOG_ERROR("Failed: bmx280_init\n");
-		_error_detected = 1;
+		dev->error_detected = 1;
 		return -1;
 	}
 
 	/* Reset intermediate values */
-	_reset_intermediate_data();
+	for (int i = 0; i < SAMPLE_EPOCH_BANKS; i++) {
+		_reset_intermediate_data(&dev->intermediate[i]);
+	}
 
 	return 0;
 }
 
 
 /* Read environmental data with(!) blocking further execution. */
-int8_t read_intermediate_env_data(void) {
+int8_t read_intermediate_env_data(Env_data_dev *dev) {
+
+	/* Get epoch of the tick, which woke the thread */
+	Sample_epoch epoch;
+	sample_epoch_get(&epoch);
 
-	if (_error_detected) {
-		_reset_intermediate_data();
+	/* Write whole sample to the bank of epoch's period, even if the period
+	 * is closed meanwhile (serial thread waits for this one to finish).
+	 */
+	Intermediate_env_data *intermediate =
+			&dev->intermediate[SAMPLE_EPOCH_BANK(epoch.period)];
+
+	if (dev->error_detected) {
+		_reset_intermediate_data(intermediate);
 		return -1;
 	}
 
@@ -78,23 +84,30 @@ int8_t read_intermediate_env_data(void) {
 	 */
 
 	/* Get air temperature in degrees Celsius * 10e1. */
-	int air_temp = _get_air_temp_c_10e1();
+	int air_temp = _get_air_temp_c_10e1(dev);
+	uint32_t skew_us = sample_epoch_skew_us(&epoch);
 
 	/* Catch device disconnected error (embedded in temperature measurement) */
 	if (_is_temperature_valid(air_temp) != 0) {
-		_error_detected = 1;
+		dev->error_detected = 1;
 		return ENV_DATA_DISCONNECTED;
 	}
 
-	_intermediate_env_data.air_temp_sum += air_temp;
+	intermediate->air_temp_sum += air_temp;
 	/* Get air pressure in hPa * 10e1. */
-	int air_pressure = _get_air_pressure_hpa_10e1();
-	_intermediate_env_data.air_pressure_sum += air_pressure;
+	int air_pressure = _get_air_pressure_hpa_10e1(dev);
+	intermediate->air_pressure_sum += air_pressure;
 	/* Get relative humidity in % * 10e1. */
-	int rel_humidity = _get_rel_humidity_rh_10e1();
-	_intermediate_env_data.rel_humidity_sum += (int)rel_humidity;
+	int rel_humidity = _get_rel_humidity_rh_10e1(dev);
+	intermediate->rel_humidity_sum += (int)rel_humidity;
 
-	_intermediate_env_data.average_counter++;
+	intermediate->average_counter++;
+
+	/* Tag sample with epoch and keep the worst skew within period */
+	intermediate->epoch = epoch;
+	if (skew_us > intermediate->max_skew_us) {
+		intermediate->max_skew_us = skew_us;
+	}
 
 	DEBUG(	"Pressure [hPa]: %d.%d "
 			"Temperature [°C]: %d.%d "
@@ -107,70 +120,69 @@ int8_t read_intermediate_env_data(void) {
 }
 
 
-/* Format measurements to JSON and write to internal buffer. */
-char *get_avg_json_env_data(void) {
-
-	/* Calculate average values (all zero on error) */
-	_calc_avg_env_data();
+/* Finalize the closed period and get its averages. */
+const Env_data *get_avg_env_data(Env_data_dev *dev) {
 
-	snprintf(_env_data.buffer, ENV_DATA_BUFFER_LEN, ENV_DATA_JSON_FORMAT,
-			_env_data.air_pressure,
-			_env_data.air_temp,
-			_env_data.rel_humidity);
+	/* Calculate average values of the closed period (all zero on error) */
+	Intermediate_env_data *intermediate = _get_closed_bank(dev);
+	_calc_avg_env_data(dev, intermediate);
 
-	DEBUG("%s\n", _env_data.buffer);
+	/* Reset intermediate values */
+	_reset_intermediate_data(intermediate);
 
-	return _env_data.buffer;
+	return &dev->data;
 }
 
 
+
 /* Helpers ********************************************************************/
 
 /* Calculate average values and save to static structure.
  * All values are set to zero when module error is detected.
  */
-static void _calc_avg_env_data(void) {
+static void _calc_avg_env_data(Env_data_dev *dev,
+		Intermediate_env_data *intermediate) {
 
-	if (_error_detected) {
+	/* No samples in period (e.g. error), avoid dividing by zero */
+	if (dev->error_detected || intermediate->average_counter == 0) {
 		/* Set values to zero */
-		_reset_avg_data();
+		_reset_avg_data(dev);
 		return;
 	}
 
-	int average_counter = _intermediate_env_data.average_counter;
+	int average_counter = intermediate->average_counter;
 
 	float f_air_pressure =
-			(float)_intermediate_env_data.air_pressure_sum / average_counter;
-	_env_data.air_pressure = (int)roundf(f_air_pressure);
+			(float)intermediate->air_pressure_sum / average_counter;
+	dev->data.air_pressure = (int)roundf(f_air_pressure);
 
 	float f_air_temp =
-			(float)_intermediate_env_data.air_temp_sum / average_counter;
-	_env_data.air_temp = (int)roundf(f_air_temp);
+			(float)intermediate->air_temp_sum / average_counter;
+	dev->data.air_temp = (int)roundf(f_air_temp);
 
 	float f_rel_humidity =
-			(float)_intermediate_env_data.rel_humidity_sum / average_counter;
-	_env_data.rel_humidity = (int)roundf(f_rel_humidity);
+			(float)intermediate->rel_humidity_sum / average_counter;
+	dev->data.rel_humidity = (int)roundf(f_rel_humidity);
+
+	dev->data.env_skew = intermediate->max_skew_us;
 
 	DEBUG(	"[hPa]: %d.%d, "
 			"[°C]: %d.%d, "
 			"[%%]: %d.%d, "
 			"Avg. c.: %d\n",
-			_env_data.air_pressure / 10, _env_data.air_pressure % 10,
-			_env_data.air_temp / 10, _env_data.air_temp % 10,
-			_env_data.rel_humidity / 10, _env_data.rel_humidity % 10,
+			dev->data.air_pressure / 10, dev->data.air_pressure % 10,
+			dev->data.air_temp / 10, dev->data.air_temp % 10,
+			dev->data.rel_humidity / 10, dev->data.rel_humidity % 10,
 			average_counter);
-
-	/* Reset intermediate values */
-	_reset_intermediate_data();
 }
 
 
 /* Get air pressure in hPa * 10e1.
  * return: air pressure
  */
-static int _get_air_pressure_hpa_10e1 (void) {
+static int _get_air_pressure_hpa_10e1 (Env_data_dev *dev) {
 	/* Get pressure in Pa */
-	volatile uint32_t air_pressure = bmx280_read_pressure(&_dev_bme);
+	volatile uint32_t air_pressure = bmx280_read_pressure(&dev->bme);
 	/* Transform pressure to hPa 10e1 */
 	float f_air_pressure = air_pressure / 10.0;
 	return (int)roundf(f_air_pressure);
@@ -180,9 +192,9 @@ static int _get_air_pressure_hpa_10e1 (void) {
 /* Get air temperature in degrees Celsius * 10e1.
  * return: air temperature
  */
-static int _get_air_temp_c_10e1 (void) {
+static int _get_air_temp_c_10e1 (Env_data_dev *dev) {
 	/* Get temperature in centi degrees Celsius */
-	int16_t temperature = bmx280_read_temperature(&_dev_bme);
+	int16_t temperature = bmx280_read_temperature(&dev->bme);
 
 	/* Catch device disconnected error and return */
 	if (_is_temperature_valid(temperature) != 0) {
@@ -198,9 +210,9 @@ static int _get_air_temp_c_10e1 (void) {
 /* Get relative humidity in % * 10e1.
  * return: relative humidity
  */
-static int _get_rel_humidity_rh_10e1 (void) {
+static int _get_rel_humidity_rh_10e1 (Env_data_dev *dev) {
 	/* Get pressure in %rH */
-	 uint16_t humidity = bme280_read_humidity(&_dev_bme);
+	 uint16_t humidity = bme280_read_humidity(&dev->bme);
 	/* Transform humidity to % 10e1 */
 	float f_humidity = humidity / 10.0;
 	return (int)roundf(f_humidity);
@@ -217,19 +229,30 @@ static int16_t _is_temperature_valid (int temperature) {
 }
 
 
+/* Get bank of the last closed period.
+ */
+static Intermediate_env_data *_get_closed_bank (Env_data_dev *dev) {
+	Sample_period period;
+	sample_epoch_get_period(&period);
+	return &dev->intermediate[SAMPLE_EPOCH_BANK(period.index)];
+}
+
+
 /* (re)Set intermediate structure values to 0.
  */
-static void _reset_intermediate_data (void) {
-	_intermediate_env_data.air_pressure_sum = 0;
-	_intermediate_env_data.air_temp_sum = 0;
-	_intermediate_env_data.rel_humidity_sum = 0;
-	_intermediate_env_data.average_counter = 0;
+static void _reset_intermediate_data (Intermediate_env_data *intermediate) {
+	intermediate->air_pressure_sum = 0;
+	intermediate->air_temp_sum = 0;
+	intermediate->rel_humidity_sum = 0;
+	intermediate->average_counter = 0;
+	intermediate->max_skew_us = 0;
 }
 
 /* (re)Set average structure values to 0.
  */
-static void _reset_avg_data (void) {
-	_env_data.air_pressure = 0;
-	_env_data.air_temp = 0;
-	_env_data.rel_humidity = 0;
+static void _reset_avg_data (Env_data_dev *dev) {
+	dev->data.air_pressure = 0;
+	dev->data.air_temp = 0;
+	dev->data.rel_humidity = 0;
+	dev->data.env_skew = 0;
 }
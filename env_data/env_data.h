@@ -2,6 +2,9 @@
 #define ENV_DATA_H
 
 #include "log.h"
+#include "bmx280.h"
+#include "../sample_epoch/sample_epoch.h"
+#include "../payload/payload.h"
 
 #include <stdint.h>
 #include <stddef.h>				// size_t
@@ -10,21 +13,33 @@
 #define ENV_DATA_DISCONNECTED		(-1)
 
 
-/* Json buffer format.
- * 	air_pressure : _xxxxx [hPa * 10e1]
- *  air_temp : Sxxx [deg.C * 10e1]
- *	rel_humidity : _xxx [% * 10e1]
+/* WCET budgets (see tasks.h) [us]: a sample call reads the BME280 over I2C,
+ * a pass samples all instances.
  */
-#define ENV_DATA_JSON_FORMAT	""\
-	"\"air_pressure\":%d,"\
-	"\"air_temp\":%d,"\
-	"\"rel_humidity\":%d"
-//#define ENV_DATA_JSON_FORMAT	""\
-//	"\"air_pressure\":%05d,"\
-//	"\"air_temp\":%04d,"\
-//	"\"rel_humidity\":%03d"
+#define ENV_DATA_WCET_STEP_US				(10U * 1000U)
+#define ENV_DATA_WCET_PASS_US				(20U * 1000U)
 
-#define ENV_DATA_BUFFER_LEN					64
+/* Longest JSON key prefix of an instance (e.g. "in_") */
+#define ENV_DATA_PREFIX_MAX_LEN				PAYLOAD_PREFIX_MAX_LEN
+
+/* Averaged data fields, X(struct, member, type, decimals, dead-band). Order
+ * is part of binary payload schema.
+ * 	air_pressure : [hPa * 10e1]
+ *  air_temp : [deg.C * 10e1]
+ *	rel_humidity : [% * 10e1]
+ *	env_skew : [us]
+ */
+#define ENV_DATA_FIELDS(X)								\
+	X(Env_data, air_pressure, I16, 1, 5)				\
+	X(Env_data, air_temp, I16, 1, 2)					\
+	X(Env_data, rel_humidity, I16, 1, 10)				\
+	X(Env_data, env_skew, U32, 0, 1000)
+
+#define ENV_DATA_FIELDS_NUMOF		PAYLOAD_FIELDS_NUMOF(ENV_DATA_FIELDS)
+
+/* Max. JSON length of an instance's data (derived from fields) */
+#define ENV_DATA_JSON_MAX_LEN		\
+	PAYLOAD_JSON_RECORD_MAX_LEN(ENV_DATA_FIELDS, ENV_DATA_PREFIX_MAX_LEN)
 
 /* Data (measurements, buffer...). */
 typedef struct {
@@ -32,6 +47,8 @@ typedef struct {
 	int air_temp_sum;
 	int rel_humidity_sum;
 	int average_counter;
+	Sample_epoch epoch;				/* Epoch of the latest sample */
+	uint32_t max_skew_us;			/* Worst delay between epoch and sample */
 } Intermediate_env_data;
 
 /* Intermediate data (sum of measurements, avg. counter...). */
@@ -39,29 +56,60 @@ typedef struct {
 	int air_pressure;
 	int air_temp;
 	int rel_humidity;
-	char buffer[ENV_DATA_BUFFER_LEN];
+	uint32_t env_skew;
 } Env_data;
 
+/* Field descriptors of Env_data. */
+extern const Payload_field env_data_fields[ENV_DATA_FIELDS_NUMOF];
+
+/* Instance parameters (see env_data_params.h). */
+typedef struct {
+	const char *prefix;						/* JSON key prefix */
+	const bmx280_params_t *bmx280;			/* BME280 bus and address */
+} Env_data_params;
+
+/* Module instance, one per BME280.
+ *  RAM: ~280 B on SAMD21 (2 intermediate banks ~2 x 36 B, JSON buffer 128 B,
+ * BME280 device with calibration ~60 B, averages and bookkeeping).
+ */
+typedef struct {
+	const Env_data_params *params;
+	bmx280_t bme;
+	/* Intermediate data (sum of measurements, avg. counter...).
+	 * One bank is written by the sensor thread, while the other (closed
+	 * period) is being finalized by the serial thread.
+	 */
+	Intermediate_env_data intermediate[SAMPLE_EPOCH_BANKS];
+	/* Data (measurements, buffer...). */
+	Env_data data;
+	/* internal error variable used to set values to 0 on error */
+	int8_t error_detected;
+} Env_data_dev;
+
 
-/* Initiate module.
- *  p1: pointer to where the module's buffer lenght will be written
+/* Initiate module instance.
+ *  p1: instance
+ *  p2: instance parameters (BME280 params, JSON prefix)
  * return:
  *  0 on success, -1 on error
  */
-int8_t init_env_data (size_t *buffer_len);
+int8_t init_env_data (Env_data_dev *dev, const Env_data_params *params);
 
 /* Read environmental data with(!) blocking further execution.
+ *  p1: instance
  * return:
  *  0: Finished
  *  -1: error
  */
-int8_t read_intermediate_env_data(void);
+int8_t read_intermediate_env_data(Env_data_dev *dev);
 
-/* Format measurements to JSON and write to internal buffer.
+/* Finalize the closed period (averages, all zero on error) and reset its
+ * intermediate data.
+ *  p1: instance
  * return:
- *  pointer to array's (string's) start address
+ *  pointer to instance's averaged data
  */
-char *get_avg_json_env_data(void);
+const Env_data *get_avg_env_data(Env_data_dev *dev);
 
 
 #endif
@@ -0,0 +1,34 @@
+#ifndef ENV_DATA_PARAMS_H
+#define ENV_DATA_PARAMS_H
+
+#include "env_data.h"
+#include "../pin_settings.h"
+
+#include "bmx280_params.h"
+
+
+/* Default instance: first BME280 defined by the board (bmx280_params.h).
+ *  To run more sensors, define BMX280_PARAMS with one entry per device, and
+ * ENV_DATA_PARAMS in pin_settings.h as a list of instances, each pointing to
+ * its BME280 and with a unique JSON key prefix, e.g.:
+ *
+ *  #define ENV_DATA_PARAMS \
+ *      { .prefix = "", .bmx280 = &bmx280_params[0] }, \
+ *      { .prefix = "in_", .bmx280 = &bmx280_params[1] }
+ */
+#ifndef ENV_DATA_PARAMS
+#define ENV_DATA_PARAMS		{								\
+		.prefix = "",										\
+		.bmx280 = &bmx280_params[0],						\
+	}
+#endif
+
+static const Env_data_params env_data_params[] = {
+	ENV_DATA_PARAMS
+};
+
+#define ENV_DATA_NUMOF		\
+	(sizeof(env_data_params) / sizeof(env_data_params[0]))
+
+
+#endif
@@ -0,0 +1,77 @@
+#include "lzss.h"
+
+#include <stdint.h>
+#include <stddef.h>		// size_t
+
+
+/* Functions ******************************************************************/
+
+size_t lzss_compress (const uint8_t *in, size_t in_len, uint8_t *out,
+		size_t out_len, uint16_t window) {
+
+	size_t pos = 0;
+	size_t n = 0;
+	size_t flags_idx = 0;
+	uint8_t item = 8;				/* Items in current group */
+
+	if (window > LZSS_DISTANCE_MAX) {
+		window = LZSS_DISTANCE_MAX;
+	}
+
+	while (pos < in_len) {
+		/* Start new group */
+		if (item == 8) {
+			if (n >= out_len) {
+				return 0;
+			}
+			flags_idx = n;
+			out[n++] = 0;
+			item = 0;
+		}
+
+		/* Longest match within window (brute force, window is small) */
+		size_t best_len = 0;
+		size_t best_dist = 0;
+		size_t max_len = in_len - pos;
+		if (max_len > LZSS_MAX_MATCH) {
+			max_len = LZSS_MAX_MATCH;
+		}
+		size_t start = (pos > window) ? pos - window : 0;
+		for (size_t i = start; i < pos && max_len >= LZSS_MIN_MATCH; i++) {
+			if (in[i] != in[pos]) {
+				continue;
+			}
+			size_t len = 1;
+			while (len < max_len && in[i + len] == in[pos + len]) {
+				len++;
+			}
+			/* Prefer the closest one on equal length */
+			if (len >= best_len) {
+				best_len = len;
+				best_dist = pos - i;
+				if (len == max_len) {
+					break;
+				}
+			}
+		}
+
+		if (best_len >= LZSS_MIN_MATCH) {
+			if (n + 2 > out_len) {
+				return 0;
+			}
+			out[n++] = (uint8_t)best_dist;
+			out[n++] = (uint8_t)(((best_dist >> 8) << 4) |
+					(best_len - LZSS_MIN_MATCH));
+			pos += best_len;
+		} else {
+			if (n + 1 > out_len) {
+				return 0;
+			}
+			out[flags_idx] |= (1U << item);
+			out[n++] = in[pos++];
+		}
+		item++;
+	}
+
+	return n;
+}
@@ -0,0 +1,37 @@
+#ifndef LZSS_H
+#define LZSS_H
+
+#include <stdint.h>
+#include <stddef.h>		// size_t
+
+
+/* LZSS compression (no dictionary besides the input itself, no state).
+ *  Output is a sequence of groups: flag byte, followed by up to 8 items,
+ * bit n (LSB first) of the flag byte describing item n:
+ *  1: literal byte
+ *  0: match, 2 bytes: distance (12 bits, 1..4095) and length - 3 (4 bits),
+ *     as b0 = distance[7:0], b1 = distance[11:8] << 4 | (length - 3)
+ *  The last group may hold fewer items, its flags are followed by the end
+ * of output.
+ */
+
+#define LZSS_MIN_MATCH			3
+#define LZSS_MAX_MATCH			18
+#define LZSS_DISTANCE_MAX		4095
+
+
+/* Compress buffer.
+ *  p1: input
+ *  p2: input length
+ *  p3: output
+ *  p4: output length (compression stops, if it would exceed it)
+ *  p5: window, how far back matches are searched (<= LZSS_DISTANCE_MAX),
+ *   bounds CPU time (input length * window comparisons at worst)
+ * return:
+ *  compressed length, 0 if output is too short
+ */
+size_t lzss_compress (const uint8_t *in, size_t in_len, uint8_t *out,
+		size_t out_len, uint16_t window);
+
+
+#endif
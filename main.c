@@ -6,11 +6,12 @@
  * device.
  *
  * Configuration
- * 	The use of different modules can be configured in "sys_config.h" by changing
- * the value of "SYS_CONFING". Correspinding to the system's configuration,
- * "DATA_FORMATER" must also be changed accordingly.
+ * 	The use of different modules is configured in the "Makefile" (USEMODULE).
+ * Each measuring module has an entry in the module table ("tasks/tasks.c"),
+ * from which "SYS_CONFING" and the payload format follow automatically.
  *  Another parameter, which can be adjuste is the time period in between
  * consective measurements, which can be set using "DATA_SEND_PERIOD_MIN"
+ * (or at runtime, with module "sys_config").
  *
  *
  * At this stage, in order to run, two modifications to RIOT-OS need to be made:
@@ -35,11 +36,25 @@
 #include "pin_settings.h"
 #include "hash.h"
 #include "tasks/tasks.h"
+#include "sample_epoch/sample_epoch.h"
+#include "wall_clock/wall_clock.h"
 
-#include "wind_data/wind_data.h"
-#include "el_data/el_data.h"
-#include "env_data/env_data.h"
 #include "serial_data/serial_data.h"
+#if (SYS_CONFING & SYS_DATA_STORAGE_MASK)
+#include "data_storage/data_storage.h"
+#endif
+#ifdef MODULE_SENSOR_SIM
+#include "sensor_sim/sensor_sim.h"
+#endif
+#ifdef MODULE_SIM_CLOCK
+#include "sim_clock/sim_clock.h"
+#endif
+#ifdef MODULE_BENCH
+#include "bench/bench.h"
+#endif
+#ifdef MODULE_SYS_CONFIG
+#include "sys_config/sys_config.h"
+#endif
 
 #include "log.h"
 #include "xtimer.h"
@@ -48,7 +63,6 @@
 
 #include <stdio.h>		// printf, ...
 #include <stdint.h>		// uint16_t, ...
-#include <stdlib.h>		// malloc, ...
 #include <stddef.h>		// size_t, NULL, ...
 
 
@@ -58,33 +72,101 @@
 #include "debug.h"
 
 
-/* Space in data buffer for symbols such as '{', '}' and ',' */
-#define DATA_BUFFER_BALAST_LEN		16
+/* Catch errors related to malfunctioning modules. */
+uint16_t sys_error = 0;
 
-/* Import tasks depending on system configuration */
-extern kernel_pid_t pid_th_serial_data;
-#if (SYS_CONFING & SYS_WIND_DATA_MASK)
-	extern kernel_pid_t pid_th_wind_data;
-#endif
-#if (SYS_CONFING & SYS_ENV_DATA_MASK)
-	extern kernel_pid_t pid_th_env_data;
-#endif
-#if (SYS_CONFING & SYS_EL_DATA_MASK)
-	extern kernel_pid_t pid_th_el_data;
-#endif
-#if (SYS_CONFING & SYS_DV_DATA_MASK)
-	extern kernel_pid_t pid_th_dv_data;
+/* Running measurement period (written by timer ISR only). */
+/* Uptime at period start [us]. */
+static uint64_t _period_start_us;
+/* Wall-clock time at period start [s], valid only if period is aligned. */
+static uint32_t _period_start_s;
+/* Period started on a wall-clock boundary. */
+static uint8_t _period_aligned;
+/* Wall-clock time of the last tick, divided by the period length. */
+static uint32_t _period_idx;
+/* Wall clock was already set on the last tick. */
+static uint8_t _period_synced;
+/* Period length in effect [s]. */
+static uint32_t _period_s = DATA_SEND_PERIOD_S;
+
+#ifndef ATIMER_DEV
+/* Tick from xtimer on boards without a spare timer (native) */
+static xtimer_t _atimer;
+static uint64_t _atimer_next_us;
 #endif
 
 
-/* Catch errors related to malfunctioning modules. */
-uint16_t sys_error = 0;
+/* Check whether the tick closes the running period, and close it if so.
+ *  Until the wall clock is set, a period lasts the period length in ticks.
+ * Afterwards, the first tick at or after each multiple of the period length
+ * in wall-clock time closes it, so periods of all nodes share boundaries
+ * (within one tick, i.e. ATIMER_PERIOD_S).
+ *  On the first tick after sync, the running period is either stretched to
+ * the next boundary, or closed at once, if that would make it longer than
+ * nominal. Periods not starting and ending on consecutive boundaries are
+ * reported as partial. The same happens, when the period length changes
+ * (runtime configuration, adaptive period).
+ *  p1: epoch of the current tick
+ *  p2: number of ticks since period start, including current one
+ * return:
+ *  1 if period was closed, 0 otherwise
+ */
+static int8_t _update_period(const Sample_epoch *epoch, uint16_t ticks)
+{
+	int8_t is_end;
+	uint8_t is_boundary = 0;
+	uint32_t period_s = get_sys_period_s();
+
+	if (period_s != _period_s) {
+		/* Re-sync to boundaries of the new length */
+		_period_s = period_s;
+		_period_synced = 0;
+		_period_aligned = 0;
+	}
 
-/* Length of buffer containing measurement data, used on averageing interval. */
-size_t data_buffer_len = 0;
+	if (wall_clock_is_set()) {
+		uint32_t now_s = wall_clock_unix_s(epoch->timestamp_us);
+		uint32_t period_idx = now_s / period_s;
+
+		if (!_period_synced) {
+			/* First partial period: ticks needed to reach the boundary */
+			uint32_t ticks_left =
+					(period_s - (now_s % period_s)
+					+ ATIMER_PERIOD_S - 1) / ATIMER_PERIOD_S;
+			is_end = (ticks + ticks_left > period_s / ATIMER_PERIOD_S);
+			_period_synced = 1;
+		} else {
+			is_boundary = (period_idx != _period_idx);
+			is_end = is_boundary;
+			/* Time reference jumped over one or more periods */
+			if (is_boundary && period_idx != _period_idx + 1) {
+				_period_aligned = 0;
+			}
+		}
+		_period_idx = period_idx;
+	} else {
+		is_end = (ticks >= period_s / ATIMER_PERIOD_S);
+	}
+
+	if (!is_end) {
+		return 0;
+	}
 
-/* Length of buffer containing both meas. data, config, error, delimiters... */
-size_t payload_buffer_len = 0;
+	Sample_period period;
+	period.epoch = epoch->sequence;
+	period.length_s = (uint16_t)period_s;
+	period.partial = !(_period_aligned && is_boundary);
+	period.start_s = _period_aligned ?
+			_period_start_s : wall_clock_unix_s(_period_start_us);
+	sample_epoch_close_period(&period);
+
+	/* Start next period */
+	_period_start_us = epoch->timestamp_us;
+	_period_start_s = _period_idx * period_s;
+	_period_aligned = is_boundary;
+
+	return 1;
+}
 
 
 static void cb(void *arg, int chan)
@@ -97,34 +179,24 @@ static void cb(void *arg, int chan)
 
 	static uint16_t ticks = 0;
 
+	/* Timestamp the tick, before waking any of the module threads */
+	Sample_epoch epoch;
+	sample_epoch_capture();
+	sample_epoch_get(&epoch);
+
 	ticks ++;
 
-#if (SYS_CONFING & SYS_WIND_DATA_MASK)
-	if (!(sys_error & SYS_WIND_DATA_MASK)) {
-		thread_wakeup(pid_th_wind_data);
-	}
-#endif
-#if (SYS_CONFING & SYS_ENV_DATA_MASK)
-	if (!(sys_error & SYS_ENV_DATA_MASK)) {
-		thread_wakeup(pid_th_env_data);
-	}
-#endif
-#if (SYS_CONFING & SYS_EL_DATA_MASK)
-	if (!(sys_error & SYS_EL_DATA_MASK)) {
-		thread_wakeup(pid_th_el_data);
-	}
-#endif
-#if (SYS_CONFING & SYS_DV_DATA_MASK)
-	if (!(sys_error & SYS_DV_DATA_MASK)) {
-		thread_wakeup(pid_th_dv_data);
-	}
-#endif
+	/* Close period before waking module threads, so samples of this tick
+	 * already go to the next period's accumulator bank.
+	 */
+	int8_t is_period_end = _update_period(&epoch, ticks);
 
-	if (ticks == TICKS_PER_PERIOD) {
-	//if (ticks == 2) {
-		if (!(sys_error & SYS_SERIAL_DATA_MASK)) {
-			thread_wakeup(pid_th_serial_data);
-		}
+	wakeup_sys_module_tasks(epoch.sequence);
+
+	if (is_period_end) {
+#if (SYS_CONFING & SYS_SERIAL_DATA_MASK)
+		wakeup_serial_data_task();
+#endif
 
 		printf("elapsed - anemo: %lu\n", (uint32_t)(xtimer_now_usec64()-last_major_time));
 		last_major_time = xtimer_now_usec64();
@@ -135,95 +207,127 @@ static void cb(void *arg, int chan)
 }
 
 
-int main(void)
+#ifndef ATIMER_DEV
+/* Re-arm relative to the previous target, so ticks don't drift. */
+static void _atimer_cb(void *arg)
 {
+	_atimer_next_us += ATIMER_PERIOD_S * US_PER_SEC;
+	uint64_t now_us = xtimer_now_usec64();
+	uint32_t offset_us = (_atimer_next_us > now_us) ?
+			(uint32_t)(_atimer_next_us - now_us) : 0;
+	xtimer_set(&_atimer, offset_us);
 
+	cb(arg, 0);
+}
+#endif
 
-	/* Save module's buffer lenght */
-	size_t tmp_buffer_len;
-
-	/* Add up lenght of all data buffers
-	 * Include balast ('{', '}', ',')
-	 */
-    data_buffer_len = DATA_BUFFER_BALAST_LEN;
 
-	/* INIT MODULES */
+#ifdef MODULE_SIM_CLOCK
+/* Print task throughput, and check aggregate results of a virtual-time run
+ * (same build and trace, same summary) against the golden one.
+ */
+static int8_t _sim_summary(void)
+{
+	Sys_task_stats task;
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		get_sys_module_task_stats(i, &task);
+		printf("throughput: %s: %lu samples, %lu ns/sample\n",
+				sys_modules[i].name, (unsigned long)task.samples,
+				(unsigned long)(task.samples ? task.busy_ns / task.samples : 0));
+	}
 
-#if (SYS_CONFING & SYS_WIND_DATA_MASK)
-	/*tmp_buffer_len = init_wind_data(NORTH_OFFSET_10E1);
-	if (tmp_buffer_len > 0){
-		data_buffer_len += tmp_buffer_len;
-	} else {
-		LOG_ERROR("Failed: init_wind_data\n");
-		sys_error |= SYS_WIND_DATA_MASK;
-	}*/
-    //init_wind_data(NORTH_OFFSET_10E1, &tmp_buffer_len);
-	if (init_wind_data(NORTH_OFFSET_10E1, &tmp_buffer_len) != 0){
-		LOG_ERROR("Failed: init_wind_data\n");
-		sys_error |= SYS_WIND_DATA_MASK;
+	char summary[SIM_CLOCK_GOLDEN_MAX_LEN];
+	int len = snprintf(summary, sizeof(summary), "summary: sys_error: 0x%04x",
+			sys_error);
+#if (SYS_CONFING & SYS_SERIAL_DATA_MASK)
+	get_serial_data_task_stats(&task);
+	printf("throughput: serial_data: %lu periods, %lu ns/period\n",
+			(unsigned long)task.samples,
+			(unsigned long)(task.samples ? task.busy_ns / task.samples : 0));
+
+	Serial_data_tx_stats stats;
+	get_serial_data_tx_stats(&stats);
+	len += snprintf(summary + len, sizeof(summary) - len,
+			", queued: %lu, sent: %lu, dropped: %lu, lost: %lu, bytes: %lu"
+			", digest: %08lx",
+			(unsigned long)stats.queued, (unsigned long)stats.sent,
+			(unsigned long)stats.dropped, (unsigned long)stats.lost,
+			(unsigned long)stats.bytes, (unsigned long)stats.digest);
+#endif
+	snprintf(summary + len, sizeof(summary) - len, "\n");
+	printf("%s", summary);
+
+	int8_t res = sim_clock_check_golden(summary);
+#if TASKS_WCET
+	/* Same build may fail by budgets, not by output */
+	if (check_sys_task_wcet() != 0) {
+		res = -1;
 	}
-	data_buffer_len += tmp_buffer_len;
+#endif
+	return res;
+}
 #endif
 
 
-#if (SYS_CONFING & SYS_ENV_DATA_MASK)
-	if (init_env_data(&tmp_buffer_len) != 0){
-		LOG_ERROR("Failed: init_env_data\n");
-		sys_error |= SYS_ENV_DATA_MASK;
-	}
-	data_buffer_len += tmp_buffer_len;
-#endif
+int main(void)
+{
+
 
+	/* INIT MODULES */
 
-#if (SYS_CONFING & SYS_EL_DATA_MASK)
-	if (init_el_data(&tmp_buffer_len) != 0){
-		LOG_ERROR("Failed: init_el_data\n");
-		sys_error |= SYS_EL_DATA_MASK;
+#ifdef MODULE_SIM_CLOCK
+	/* Virtual time advances only once main blocks */
+	if (init_sim_clock(_sim_summary) != 0) {
+		LOG_ERROR("Failed: init_sim_clock\n");
 	}
-	data_buffer_len += tmp_buffer_len;
 #endif
 
-
-#if (SYS_CONFING & SYS_DV_DATA_MASK)
+#ifdef MODULE_SENSOR_SIM
+	/* Simulated hardware first, modules init their sensors on it */
+	if (init_sensor_sim() != 0) {
+		LOG_ERROR("Failed: init_sensor_sim\n");
+	}
 #endif
 
-
-#if (SYS_CONFING & SYS_SERIAL_DATA_MASK)
-	init_serial_data(data_buffer_len, DEVICE_HASH, DEVICE_HASH_LEN);
-	/*if (init_serial_data(DEVICE_HASH) != 0) {
-		LOG_ERROR("Failed: init_serial_data\n");
-		sys_error |= SYS_SERIAL_DATA_MASK;
-		// GLOW RED, ERROR
-	}*/
+#ifdef MODULE_SYS_CONFIG
+	/* Before modules, which take over persisted settings */
+	if (init_sys_config() != 0) {
+		LOG_INFO("sys_config: defaults\n");
+	}
 #endif
 
+	init_sys_modules();
 
-	/* CREATE TASKS */
 
-#if (SYS_CONFING & SYS_WIND_DATA_MASK)
-	if (!(sys_error & SYS_WIND_DATA_MASK)) {
-		create_wind_data_task();
+#if (SYS_CONFING & SYS_DATA_STORAGE_MASK)
+	/* Before serial data, which forwards stored payloads */
+	if (init_data_storage() != 0) {
+		LOG_ERROR("Failed: init_data_storage\n");
+		sys_error |= SYS_DATA_STORAGE_MASK;
 	}
 #endif
 
-#if (SYS_CONFING & SYS_ENV_DATA_MASK)
-	if (!(sys_error & SYS_ENV_DATA_MASK)) {
-		create_env_data_task();
+#if (SYS_CONFING & SYS_SERIAL_DATA_MASK)
+	/* Buffers are static, sized for the modules in use */
+	if (init_serial_data(sys_payload_buf, sys_payload_buf_len, sys_data_len,
+			DEVICE_HASH, DEVICE_HASH_LEN) != 0) {
+		LOG_ERROR("Failed: init_serial_data\n");
+		sys_error |= SYS_SERIAL_DATA_MASK;
 	}
 #endif
 
-#if (SYS_CONFING & SYS_EL_DATA_MASK)
-	if (!(sys_error & SYS_EL_DATA_MASK)) {
-		create_el_data_task();
-	}
-#endif
 
-#if (SYS_CONFING & SYS_DV_DATA_MASK)
-	if (!(sys_error & SYS_DV_DATA_MASK)) {
-		create_dv_data_task();
-	}
+#ifdef MODULE_BENCH
+	/* Benchmark firmware: time hot functions once, don't start tasks */
+	init_bench();
+	bench_sys_modules();
+	thread_sleep();
 #endif
 
+	/* CREATE TASKS */
+
+	create_sys_module_tasks();
+
 #if (SYS_CONFING & SYS_SERIAL_DATA_MASK)
 	if (!(sys_error & SYS_SERIAL_DATA_MASK)) {
 		create_serial_data_task();
@@ -244,6 +348,7 @@ int main(void)
 	/* Start the timer */
 	//timer_start(TIMER_DEV(1));
 
+#ifdef ATIMER_DEV
 	timer_init(ATIMER_DEV, ATIMER_FREQ, cb, (void *)(COOKIE * 5));
 	/* Halt timer */
 	timer_stop(ATIMER_DEV);
@@ -251,9 +356,20 @@ int main(void)
 	timer_set_absolute(ATIMER_DEV, 0, ATIMER_PERIOD_TICKS);
 	/* Start the timer */
 	timer_start(ATIMER_DEV);
+#else
+	_atimer.callback = _atimer_cb;
+	_atimer.arg = (void *)(COOKIE * 5);
+	_atimer_next_us = xtimer_now_usec64() + ATIMER_PERIOD_S * US_PER_SEC;
+	xtimer_set(&_atimer, ATIMER_PERIOD_S * US_PER_SEC);
+#endif
 
 	DEBUG("XTIMER_DEV: %d\n", XTIMER_DEV);
 
+#ifdef MODULE_SIM_CLOCK
+	/* Don't wake up every few ms of virtual time */
+	thread_sleep();
+#endif
+
 	while (1) {
 		// Loop
 		// Missing sleep...
@@ -0,0 +1,397 @@
+#include "payload.h"
+
+#include <string.h>		// strlen, memcpy
+#include <stdint.h>
+#include <stddef.h>		// size_t
+
+#ifndef ENABLE_DEBUG
+#define ENABLE_DEBUG (0)
+#endif
+#include "debug.h"
+
+
+/* Wire width of field types (same order as PAYLOAD_TYPE_*) */
+static const uint8_t _type_len[] = { 1, 2, 4, 4 };
+
+/* Max. JSON value length of field types (same order as PAYLOAD_TYPE_*) */
+static const uint8_t _type_digits[] = {
+	PAYLOAD_DIGITS_I8, PAYLOAD_DIGITS_I16,
+	PAYLOAD_DIGITS_I32, PAYLOAD_DIGITS_U32
+};
+
+/* Two digit pairs "00".."99", so each division by 100 yields two digits */
+static const char _digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+
+/* Prototypes *****************************************************************/
+static int32_t _field_value (const Payload_field *field, const void *data);
+static int32_t _saturate (uint8_t type, int32_t val);
+static size_t _put_bits (uint8_t *buf, size_t bit, uint32_t val, uint8_t n);
+static size_t _put_field (uint8_t *buf, const Payload_field *field,
+		const void *data);
+static size_t _json_record (char *buf, size_t len, const char *prefix,
+		const Payload_field *fields, uint8_t numof, const void *data,
+		uint32_t present);
+
+
+/* Functions ******************************************************************/
+
+uint32_t payload_fnv1a(uint32_t h, const uint8_t *buf, size_t len) {
+	while (len--) {
+		h ^= *buf++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+uint16_t payload_device_id(const char *hash) {
+	uint32_t h = payload_fnv1a(PAYLOAD_FNV1A_INIT, (const uint8_t *)hash,
+			strlen(hash));
+	return (uint16_t)((h >> 16) ^ (h & 0xFFFF));
+}
+
+size_t payload_bin_frame_header(uint8_t *buf, uint8_t type, uint16_t body_len) {
+	size_t n = 0;
+	n += payload_put_u8(buf + n, PAYLOAD_SYNC);
+	n += payload_put_u8(buf + n, type);
+	n += payload_put_u8(buf + n, PAYLOAD_SCHEMA_VERSION);
+	n += payload_put_u16(buf + n, body_len);
+	return n;
+}
+
+size_t payload_bin_record(uint8_t *buf, size_t len, uint8_t id,
+		uint8_t instance, const Payload_field *fields, uint8_t numof,
+		const void *data) {
+
+	size_t record_len = payload_bin_record_len(fields, numof);
+	if (record_len > len) {
+		return 0;
+	}
+
+	size_t n = 0;
+	n += payload_put_u8(buf + n, id);
+	n += payload_put_u8(buf + n, instance);
+	n += payload_put_u8(buf + n,
+			(uint8_t)(record_len - PAYLOAD_RECORD_HEADER_LEN));
+
+	for (uint8_t i = 0; i < numof; i++) {
+		n += _put_field(buf + n, &fields[i], data);
+	}
+
+	return n;
+}
+
+uint8_t payload_rbe_select(const Payload_field *fields, uint8_t numof,
+		const void *data, const int32_t *last, int8_t is_heartbeat) {
+	uint8_t present = 0;
+
+	for (uint8_t i = 0; i < numof; i++) {
+		int32_t val = _field_value(&fields[i], data);
+		/* Unsigned difference, so large jumps don't overflow */
+		uint32_t diff = (val > last[i]) ?
+				(uint32_t)val - (uint32_t)last[i] :
+				(uint32_t)last[i] - (uint32_t)val;
+		if (is_heartbeat || diff > fields[i].deadband) {
+			present |= (1U << i);
+		}
+	}
+
+	return present;
+}
+
+void payload_rbe_commit(const Payload_field *fields, uint8_t numof,
+		const void *data, int32_t *last, uint8_t present) {
+	for (uint8_t i = 0; i < numof; i++) {
+		if (present & (1U << i)) {
+			last[i] = _field_value(&fields[i], data);
+		}
+	}
+}
+
+size_t payload_bin_record_rbe(uint8_t *buf, size_t len, uint8_t id,
+		uint8_t instance, const Payload_field *fields, uint8_t numof,
+		const void *data, uint8_t present) {
+
+	size_t record_len = payload_bin_record_len(fields, numof) + 1;
+	if (record_len > len) {
+		return 0;
+	}
+
+	/* Length is filled in once fields are written */
+	size_t n = 0;
+	n += payload_put_u8(buf + n, id | PAYLOAD_RECORD_RBE);
+	n += payload_put_u8(buf + n, instance);
+	n++;
+	n += payload_put_u8(buf + n, present);
+
+	for (uint8_t i = 0; i < numof; i++) {
+		if (present & (1U << i)) {
+			n += _put_field(buf + n, &fields[i], data);
+		}
+	}
+
+	payload_put_u8(buf + PAYLOAD_RECORD_HEADER_LEN - 1,
+			(uint8_t)(n - PAYLOAD_RECORD_HEADER_LEN));
+	return n;
+}
+
+size_t payload_delta_record(uint8_t *buf, size_t len, uint8_t id,
+		uint8_t instance, int8_t is_first, const Payload_field *fields,
+		uint8_t numof, const void *data, int32_t *prev) {
+
+	size_t n = 0;
+	if ((is_first ? PAYLOAD_DELTA_HEADER_LEN : 0) +
+			PAYLOAD_PACKED_MAX_LEN((size_t)numof) > len) {
+		return 0;
+	}
+
+	if (is_first) {
+		n += payload_put_u8(buf + n, id);
+		n += payload_put_u8(buf + n, instance);
+		n += payload_put_u8(buf + n, numof);
+		memset(prev, 0, numof * sizeof(prev[0]));
+	}
+
+	size_t bit = 0;
+	for (uint8_t i = 0; i < numof; i++) {
+		int32_t val = _field_value(&fields[i], data);
+		/* Unsigned difference, wraps like the decoder's sum */
+		bit = payload_put_packed(buf + n, bit,
+				(int32_t)((uint32_t)val - (uint32_t)prev[i]));
+		prev[i] = val;
+	}
+
+	return n + (bit + 7) / 8;
+}
+
+size_t payload_json_record(char *buf, size_t len, const char *prefix,
+		const Payload_field *fields, uint8_t numof, const void *data) {
+	return _json_record(buf, len, prefix, fields, numof, data, UINT32_MAX);
+}
+
+size_t payload_json_record_rbe(char *buf, size_t len, const char *prefix,
+		const Payload_field *fields, uint8_t numof, const void *data,
+		uint8_t present) {
+	return _json_record(buf, len, prefix, fields, numof, data, present);
+}
+
+size_t payload_json_key(char *buf, const char *prefix, const char *key) {
+	size_t n = 0;
+	buf[n++] = '"';
+	while (*prefix) {
+		buf[n++] = *prefix++;
+	}
+	while (*key) {
+		buf[n++] = *key++;
+	}
+	buf[n++] = '"';
+	buf[n++] = ':';
+	return n;
+}
+
+size_t payload_json_str(char *buf, const char *str) {
+	size_t n = 0;
+	buf[n++] = '"';
+	while (*str) {
+		buf[n++] = *str++;
+	}
+	buf[n++] = '"';
+	return n;
+}
+
+size_t payload_itoa(char *buf, int32_t val) {
+	if (val < 0) {
+		buf[0] = '-';
+		/* Negate as unsigned, so INT32_MIN doesn't overflow */
+		return 1 + payload_utoa(buf + 1, 0U - (uint32_t)val);
+	}
+	return payload_utoa(buf, (uint32_t)val);
+}
+
+size_t payload_utoa(char *buf, uint32_t val) {
+	char tmp[PAYLOAD_DIGITS_U32];
+	size_t i = sizeof(tmp);
+
+	/* Fill from the end, two digits at a time */
+	while (val >= 100) {
+		uint32_t pair = (val % 100) * 2;
+		val /= 100;
+		tmp[--i] = _digit_pairs[pair + 1];
+		tmp[--i] = _digit_pairs[pair];
+	}
+	if (val >= 10) {
+		tmp[--i] = _digit_pairs[val * 2 + 1];
+		tmp[--i] = _digit_pairs[val * 2];
+	} else {
+		tmp[--i] = (char)('0' + val);
+	}
+
+	size_t n = sizeof(tmp) - i;
+	memcpy(buf, tmp + i, n);
+	return n;
+}
+
+size_t payload_bin_record_len(const Payload_field *fields, uint8_t numof) {
+	size_t len = PAYLOAD_RECORD_HEADER_LEN;
+	for (uint8_t i = 0; i < numof; i++) {
+		len += _type_len[fields[i].type];
+	}
+	return len;
+}
+
+uint32_t payload_out_of_range(const Payload_field *fields, uint8_t numof,
+		const void *data) {
+	uint32_t out = 0;
+	for (uint8_t i = 0; i < numof && i < 32; i++) {
+		if (fields[i].type == PAYLOAD_TYPE_U32) {
+			continue;
+		}
+		int32_t val = _field_value(&fields[i], data);
+		if (_saturate(fields[i].type, val) != val) {
+			out |= (1UL << i);
+		}
+	}
+	return out;
+}
+
+size_t payload_put_u8(uint8_t *buf, uint8_t val) {
+	buf[0] = val;
+	return 1;
+}
+
+size_t payload_put_u16(uint8_t *buf, uint16_t val) {
+	buf[0] = (uint8_t)(val);
+	buf[1] = (uint8_t)(val >> 8);
+	return 2;
+}
+
+size_t payload_put_u32(uint8_t *buf, uint32_t val) {
+	buf[0] = (uint8_t)(val);
+	buf[1] = (uint8_t)(val >> 8);
+	buf[2] = (uint8_t)(val >> 16);
+	buf[3] = (uint8_t)(val >> 24);
+	return 4;
+}
+
+size_t payload_put_packed(uint8_t *buf, size_t bit, int32_t val) {
+	uint32_t z = ((uint32_t)val << 1) ^ (uint32_t)(val >> 31);
+
+	if (z == 0) {
+		return _put_bits(buf, bit, 0x0, 1);
+	}
+	if (z < (1U << 4)) {
+		return _put_bits(buf, _put_bits(buf, bit, 0x1, 2), z, 4);
+	}
+	if (z < (1U << 8)) {
+		return _put_bits(buf, _put_bits(buf, bit, 0x3, 3), z, 8);
+	}
+	if (z < (1U << 16)) {
+		return _put_bits(buf, _put_bits(buf, bit, 0x7, 4), z, 16);
+	}
+	bit = _put_bits(buf, bit, 0xF, 4);
+	return _put_bits(buf, _put_bits(buf, bit, z & 0xFFFF, 16), z >> 16, 16);
+}
+
+/* Helpers ********************************************************************/
+
+/* Write n (up to 16) bits of val, LSB first, at a bit offset. */
+static size_t _put_bits (uint8_t *buf, size_t bit, uint32_t val, uint8_t n) {
+	uint8_t *dst = buf + (bit >> 3);
+	uint8_t shift = bit & 7;
+	uint32_t bits = (val & ((1UL << n) - 1)) << shift;
+
+	if (shift == 0) {
+		*dst = 0;
+	}
+	*dst |= (uint8_t)bits;
+	/* Following bytes are entered with their first bit */
+	for (int8_t left = shift + n - 8; left > 0; left -= 8) {
+		bits >>= 8;
+		*++dst = (uint8_t)bits;
+	}
+	return bit + n;
+}
+
+/* Read field from module's data structure, as 32 bit value. */
+static int32_t _field_value (const Payload_field *field, const void *data) {
+	const uint8_t *src = (const uint8_t *)data + field->offset;
+	return (field->type == PAYLOAD_TYPE_U32) ?
+			(int32_t)*(const uint32_t *)src : *(const int *)src;
+}
+
+/* Limit a signed value to the range of its wire type. */
+static int32_t _saturate (uint8_t type, int32_t val) {
+	int32_t max = (type == PAYLOAD_TYPE_I8) ? INT8_MAX :
+			(type == PAYLOAD_TYPE_I16) ? INT16_MAX : INT32_MAX;
+	if (val > max) {
+		return max;
+	}
+	if (val < -max - 1) {
+		return -max - 1;
+	}
+	return val;
+}
+
+/* Write field at its natural width, saturated. */
+static size_t _put_field (uint8_t *buf, const Payload_field *field,
+		const void *data) {
+	const uint8_t *src = (const uint8_t *)data + field->offset;
+	switch (field->type) {
+	case PAYLOAD_TYPE_I8:
+		return payload_put_u8(buf,
+				(uint8_t)_saturate(field->type, *(const int *)src));
+	case PAYLOAD_TYPE_I16:
+		return payload_put_u16(buf,
+				(uint16_t)_saturate(field->type, *(const int *)src));
+	case PAYLOAD_TYPE_I32:
+		return payload_put_u32(buf, (uint32_t)*(const int *)src);
+	case PAYLOAD_TYPE_U32:
+		return payload_put_u32(buf, *(const uint32_t *)src);
+	}
+	return 0;
+}
+
+/* Write JSON record of fields present in bitmap. */
+static size_t _json_record (char *buf, size_t len, const char *prefix,
+		const Payload_field *fields, uint8_t numof, const void *data,
+		uint32_t present) {
+
+	size_t prefix_len = strlen(prefix);
+	size_t n = 0;
+
+	for (uint8_t i = 0; i < numof; i++) {
+		if (!(present & (1UL << i))) {
+			continue;
+		}
+		/* Worst case of this field (incl. separator) must fit */
+		size_t field_max_len = 4 + prefix_len + strlen(fields[i].key) +
+				_type_digits[fields[i].type];
+		if (n + field_max_len > len) {
+			return 0;
+		}
+
+		if (n != 0) {
+			buf[n++] = ',';
+		}
+		n += payload_json_key(buf + n, prefix, fields[i].key);
+
+		const uint8_t *src = (const uint8_t *)data + fields[i].offset;
+		if (fields[i].type == PAYLOAD_TYPE_U32) {
+			n += payload_utoa(buf + n, *(const uint32_t *)src);
+		} else {
+			n += payload_itoa(buf + n, *(const int *)src);
+		}
+	}
+
+	return n;
+}
@@ -0,0 +1,274 @@
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include <stdint.h>
+#include <stddef.h>		// size_t, offsetof
+
+
+/* Binary payload schema version. Bump on any change of frame layout, record
+ * layout or module field descriptors (order, type). 3: report-by-exception
+ * records (PAYLOAD_RECORD_RBE).
+ */
+#define PAYLOAD_SCHEMA_VERSION		3
+
+/* Frame: sync, type, schema version, body length (u16), body.
+ * All multi-byte values are little-endian.
+ */
+#define PAYLOAD_SYNC				0xA5
+#define PAYLOAD_FRAME_HELLO			'H'		/* Device id to hash mapping */
+#define PAYLOAD_FRAME_DATA			'D'		/* Period data */
+#define PAYLOAD_FRAME_BATCH			'B'		/* Data of several periods */
+#define PAYLOAD_FRAME_DELTA			'Z'		/* Batch, delta coded */
+#define PAYLOAD_FRAME_LZ			'L'		/* Compressed payload */
+#define PAYLOAD_FRAME_HEADER_LEN	5
+
+/* Record header: module id, instance, length of fields. */
+#define PAYLOAD_RECORD_HEADER_LEN	3
+
+/* Report-by-exception record: module id has this bit set, and the header is
+ * followed by a bitmap of the fields present (bit n: n-th descriptor).
+ */
+#define PAYLOAD_RECORD_RBE			0x80
+#define PAYLOAD_RBE_FIELDS_MAX		8
+
+/* Field types (type of the value in module's data structure -> on wire). */
+#define PAYLOAD_TYPE_I8				0		/* int -> int8 */
+#define PAYLOAD_TYPE_I16			1		/* int -> int16 */
+#define PAYLOAD_TYPE_I32			2		/* int -> int32 */
+#define PAYLOAD_TYPE_U32			3		/* uint32_t -> uint32 */
+
+/* Field descriptor.
+ *  Describes one value of module's averaged data, so it can be encoded
+ * without module specific code. Scale is the number of decimals the integer
+ * carries (e.g. 2 for m/s * 10e2). Dead-band is the change (raw units), a
+ * value has to exceed to be reported again (report-by-exception).
+ */
+typedef struct {
+	const char *key;				/* JSON key (w/o instance prefix) */
+	uint16_t offset;				/* offsetof() in module's data struct */
+	uint8_t type;					/* PAYLOAD_TYPE_* */
+	uint8_t scale;					/* Decimals (value = raw / 10^scale) */
+	uint16_t deadband;				/* Min. change to report [raw] */
+} Payload_field;
+
+/* Packed value (payload_put_packed()): zig-zag mapped (0, -1, 1, -2, ...
+ * -> 0, 1, 2, 3, ...), then a prefix giving its width and the value:
+ * 0 (zero), 10 + 4 bits, 110 + 8 bits, 1110 + 16 bits, 1111 + 32 bits.
+ * Bits are written LSB first, from bit 0 of the first byte on.
+ */
+#define PAYLOAD_PACKED_MAX_BITS		36
+/* Max. length of n packed values [bytes] */
+#define PAYLOAD_PACKED_MAX_LEN(n)	(((n) * PAYLOAD_PACKED_MAX_BITS + 7) / 8)
+
+/* FNV-1a offset basis */
+#define PAYLOAD_FNV1A_INIT			2166136261U
+
+/* Delta record header (first period of a batch): module id, instance,
+ * number of fields. */
+#define PAYLOAD_DELTA_HEADER_LEN	3
+
+/* Longest JSON key prefix of a module instance (e.g. "h2_") */
+#define PAYLOAD_PREFIX_MAX_LEN		8
+
+/* Max. number of characters of a JSON value of given type */
+#define PAYLOAD_DIGITS_I8			4		/* -128 */
+#define PAYLOAD_DIGITS_I16			6		/* -32768 */
+#define PAYLOAD_DIGITS_I32			11		/* -2147483648 */
+#define PAYLOAD_DIGITS_U32			10		/* 4294967295 */
+
+/* Modules list their fields as an X-macro,
+ * X(struct, member, type, scale, deadband), with type one of I8, I16, I32,
+ * U32. The helpers below expand such list to descriptors, field count and
+ * max. JSON length, all at compile time.
+ */
+#define PAYLOAD_FIELD_DESC(st, member, type, scale, deadband)	\
+	{ #member, offsetof(st, member), PAYLOAD_TYPE_##type, scale, deadband },
+#define PAYLOAD_FIELD_COUNT(st, member, type, scale, deadband)	+ 1
+/* "<prefix><member>":<value>, */
+#define PAYLOAD_FIELD_JSON_LEN(st, member, type, scale, deadband)	\
+	+ (sizeof("\"\":,") - 1) + (sizeof(#member) - 1) + PAYLOAD_DIGITS_##type
+
+/* Number of fields in list */
+#define PAYLOAD_FIELDS_NUMOF(fields)	(0 fields(PAYLOAD_FIELD_COUNT))
+
+/* Max. JSON length of a record (all fields, each key with longest prefix) */
+#define PAYLOAD_JSON_RECORD_MAX_LEN(fields, prefix_max_len)	\
+	((0 fields(PAYLOAD_FIELD_JSON_LEN)) +					\
+	 PAYLOAD_FIELDS_NUMOF(fields) * (prefix_max_len))
+
+
+/* Continue FNV-1a hash over buffer (start with PAYLOAD_FNV1A_INIT).
+ *  p1: hash so far
+ *  p2: data
+ *  p3: data length
+ * return:
+ *  hash
+ */
+uint32_t payload_fnv1a(uint32_t h, const uint8_t *buf, size_t len);
+
+/* Get short device id (folded FNV-1a of hash string).
+ *  p1: device hash (null terminated)
+ * return:
+ *  16 bit device id
+ */
+uint16_t payload_device_id(const char *hash);
+
+/* Write frame header.
+ *  p1: output buffer (at least PAYLOAD_FRAME_HEADER_LEN)
+ *  p2: frame type (PAYLOAD_FRAME_*)
+ *  p3: body length
+ * return:
+ *  number of bytes written
+ */
+size_t payload_bin_frame_header(uint8_t *buf, uint8_t type, uint16_t body_len);
+
+/* Write a module instance's record (header and fields at natural widths).
+ * Values out of range of their wire type are saturated (see
+ * payload_out_of_range()).
+ *  p1: output buffer
+ *  p2: output buffer length
+ *  p3: module id
+ *  p4: instance number
+ *  p5: field descriptors
+ *  p6: number of field descriptors
+ *  p7: module's data structure
+ * return:
+ *  number of bytes written, 0 if buffer is too short
+ */
+size_t payload_bin_record(uint8_t *buf, size_t len, uint8_t id,
+		uint8_t instance, const Payload_field *fields, uint8_t numof,
+		const void *data);
+
+/* Select fields to report (report-by-exception): those, which changed by
+ * more than their dead-band since last reported, or all on heartbeat.
+ * Last reported values are left as they are, see payload_rbe_commit().
+ *  p1: field descriptors
+ *  p2: number of field descriptors (at most PAYLOAD_RBE_FIELDS_MAX)
+ *  p3: module's data structure
+ *  p4: last reported values (numof)
+ *  p5: 1 to select all fields
+ * return:
+ *  bitmap of selected fields (bit n: n-th descriptor)
+ */
+uint8_t payload_rbe_select(const Payload_field *fields, uint8_t numof,
+		const void *data, const int32_t *last, int8_t is_heartbeat);
+
+/* Mark selected fields as reported, once their record is written (a record
+ * left out keeps its changes pending).
+ *  p1: field descriptors
+ *  p2: number of field descriptors
+ *  p3: module's data structure
+ *  p4: last reported values (numof), updated for written fields
+ *  p5: bitmap of written fields (payload_rbe_select())
+ */
+void payload_rbe_commit(const Payload_field *fields, uint8_t numof,
+		const void *data, int32_t *last, uint8_t present);
+
+/* Write a module instance's report-by-exception record: header (module id
+ * with PAYLOAD_RECORD_RBE set), bitmap of present fields, and those fields
+ * at natural widths.
+ *  p1: output buffer
+ *  p2: output buffer length
+ *  p3: module id
+ *  p4: instance number
+ *  p5: field descriptors
+ *  p6: number of field descriptors
+ *  p7: module's data structure
+ *  p8: bitmap of fields to write (payload_rbe_select())
+ * return:
+ *  number of bytes written, 0 if buffer is too short
+ */
+size_t payload_bin_record_rbe(uint8_t *buf, size_t len, uint8_t id,
+		uint8_t instance, const Payload_field *fields, uint8_t numof,
+		const void *data, uint8_t present);
+
+/* Write a module instance's delta record: the difference of each field to
+ * its previous value, packed (PAYLOAD_PACKED_MAX_BITS), last byte padded
+ * with zero bits. On the first period of a batch, previous values are zero
+ * and the record starts with a header (module id, instance, number of
+ * fields), later records in the batch go w/o header.
+ *  p1: output buffer
+ *  p2: output buffer length
+ *  p3: module id
+ *  p4: instance number
+ *  p5: 1 on first period of a batch
+ *  p6: field descriptors
+ *  p7: number of field descriptors
+ *  p8: module's data structure
+ *  p9: previous values (numof), updated
+ * return:
+ *  number of bytes written, 0 if buffer is too short
+ */
+size_t payload_delta_record(uint8_t *buf, size_t len, uint8_t id,
+		uint8_t instance, int8_t is_first, const Payload_field *fields,
+		uint8_t numof, const void *data, int32_t *prev);
+
+/* Write a module instance's JSON record ("<prefix><key>":<value>,...),
+ * without braces and without terminating null character.
+ *  p1: output buffer
+ *  p2: output buffer length
+ *  p3: key prefix
+ *  p4: field descriptors
+ *  p5: number of field descriptors
+ *  p6: module's data structure
+ * return:
+ *  number of characters written, 0 if buffer is too short
+ */
+size_t payload_json_record(char *buf, size_t len, const char *prefix,
+		const Payload_field *fields, uint8_t numof, const void *data);
+
+/* Same as payload_json_record(), with only the fields in bitmap present
+ * (report-by-exception, see payload_rbe_select()).
+ */
+size_t payload_json_record_rbe(char *buf, size_t len, const char *prefix,
+		const Payload_field *fields, uint8_t numof, const void *data,
+		uint8_t present);
+
+/* Write JSON key ("<prefix><key>":), w/o bounds check.
+ * return:
+ *  number of characters written
+ */
+size_t payload_json_key(char *buf, const char *prefix, const char *key);
+
+/* Write JSON string value ("<str>"), w/o bounds check. */
+size_t payload_json_str(char *buf, const char *str);
+
+/* Integer to ASCII, w/o null character and bounds check (see
+ * PAYLOAD_DIGITS_*).
+ * return:
+ *  number of characters written
+ */
+size_t payload_itoa(char *buf, int32_t val);
+size_t payload_utoa(char *buf, uint32_t val);
+
+/* Max. length of a record with given fields. */
+size_t payload_bin_record_len(const Payload_field *fields, uint8_t numof);
+
+/* Find fields out of range of their wire type (I8, I16), which binary
+ * records send saturated to the type's min. or max.
+ *  p1: field descriptors
+ *  p2: number of field descriptors (bits beyond 32 are lost)
+ *  p3: module's data structure
+ * return:
+ *  bitmap of fields out of range (bit n: n-th descriptor)
+ */
+uint32_t payload_out_of_range(const Payload_field *fields, uint8_t numof,
+		const void *data);
+
+/* Little-endian writers, return number of bytes written. */
+size_t payload_put_u8(uint8_t *buf, uint8_t val);
+size_t payload_put_u16(uint8_t *buf, uint16_t val);
+size_t payload_put_u32(uint8_t *buf, uint32_t val);
+
+/* Write a value packed (PAYLOAD_PACKED_MAX_BITS) at a bit offset. A byte is
+ * cleared when the first bit is written to it.
+ *  p1: output buffer
+ *  p2: bit offset
+ *  p3: value
+ * return:
+ *  bit offset behind the value
+ */
+size_t payload_put_packed(uint8_t *buf, size_t bit, int32_t val);
+
+
+#endif
@@ -7,6 +7,7 @@
 #define RHOMB_ZERO					0
 #define SAMD21_XPRO					1
 #define ARDUINO_DUE					2
+#define NATIVE						3
 
 
 
@@ -49,6 +50,15 @@
 
 #define ANEMO_DAVIS_ADC_LINE				ADC_LINE(0)
 
+/* Upper anemometer of wind gradient (dv) data, lower one uses ANEMO_DAVIS_* */
+#define DV_DATA_HIGH_MUX_OUT				GPIO_PIN(PA, 12)
+#define DV_DATA_HIGH_MUX_C					GPIO_PIN(PA, 13)
+#define DV_DATA_HIGH_MUX_B					GPIO_PIN(PB, 14)
+#define DV_DATA_HIGH_MUX_A					GPIO_PIN(PB, 15)
+#define DV_DATA_HIGH_COUNTER_RST			GPIO_PIN(PB, 16)
+#define DV_DATA_HIGH_COUNTER_N_EN			GPIO_PIN(PB, 17)
+#define DV_DATA_HIGH_ADC_LINE				ADC_LINE(1)
+
 
 
 #elif (BOARD_NUMBER == ARDUINO_DUE)
@@ -65,6 +75,35 @@
 
 
 
+#elif (BOARD_NUMBER == NATIVE)
+
+/* No ATIMER_DEV: xtimer takes the only timer, so main.c ticks from xtimer.
+ *  Pins and ADC lines are only keys into the simulated hardware (sensor_sim).
+ */
+
+#define EL_DATA_RE1_PIN		 				GPIO_PIN(0, 0)
+#define EL_DATA_RE2_PIN		 				GPIO_PIN(0, 1)
+#define EL_DATA_RE3_PIN		 				GPIO_PIN(0, 2)
+#define EL_DATA_I2C_DEV		 				I2C_DEV(0)
+
+#define ANEMO_DAVIS_MUX_OUT					GPIO_PIN(0, 3)
+#define ANEMO_DAVIS_MUX_C					GPIO_PIN(0, 4)
+#define ANEMO_DAVIS_MUX_B					GPIO_PIN(0, 5)
+#define ANEMO_DAVIS_MUX_A					GPIO_PIN(0, 6)
+#define ANEMO_DAVIS_COUNTER_RST				GPIO_PIN(0, 7)
+#define ANEMO_DAVIS_COUNTER_N_EN			GPIO_PIN(0, 8)
+#define ANEMO_DAVIS_ADC_LINE				ADC_LINE(0)
+
+#define DV_DATA_HIGH_MUX_OUT				GPIO_PIN(0, 9)
+#define DV_DATA_HIGH_MUX_C					GPIO_PIN(0, 10)
+#define DV_DATA_HIGH_MUX_B					GPIO_PIN(0, 11)
+#define DV_DATA_HIGH_MUX_A					GPIO_PIN(0, 12)
+#define DV_DATA_HIGH_COUNTER_RST			GPIO_PIN(0, 13)
+#define DV_DATA_HIGH_COUNTER_N_EN			GPIO_PIN(0, 14)
+#define DV_DATA_HIGH_ADC_LINE				ADC_LINE(1)
+
+
+
 #endif /* BOARD_NUMBER */
 
 
@@ -0,0 +1,48 @@
+#include "sample_epoch.h"
+
+#include "xtimer.h"
+#include "irq.h"
+
+#include <stdint.h>
+
+
+/* Latest epoch, written by ISR only. */
+static Sample_epoch _epoch;
+
+/* Last closed period, written by ISR only. */
+static Sample_period _period;
+
+
+/* Capture a new epoch (call from ISR only). */
+void sample_epoch_capture(void) {
+	_epoch.timestamp_us = xtimer_now_usec64();
+	_epoch.sequence++;
+}
+
+/* Copy the current epoch. The 64-bit timestamp can't be read atomically on a
+ * 32-bit core, so block the ISR while copying.
+ */
+void sample_epoch_get(Sample_epoch *epoch) {
+	unsigned state = irq_disable();
+	*epoch = _epoch;
+	irq_restore(state);
+}
+
+/* Time elapsed since the epoch was captured. */
+uint32_t sample_epoch_skew_us(const Sample_epoch *epoch) {
+	return (uint32_t)(xtimer_now_usec64() - epoch->timestamp_us);
+}
+
+/* Store the closed period and swap banks (call from ISR only). */
+void sample_epoch_close_period(Sample_period *period) {
+	period->index = _epoch.period;
+	_period = *period;
+	_epoch.period++;
+}
+
+/* Copy the last closed period. */
+void sample_epoch_get_period(Sample_period *period) {
+	unsigned state = irq_disable();
+	*period = _period;
+	irq_restore(state);
+}
@@ -0,0 +1,70 @@
+#ifndef SAMPLE_EPOCH_H
+#define SAMPLE_EPOCH_H
+
+#include <stdint.h>
+
+
+/* Number of accumulator banks per module. Samples of consecutive periods go
+ * to alternate banks, so the serial thread can finalize the closed bank while
+ * sensor threads already write to the other one.
+ */
+#define SAMPLE_EPOCH_BANKS			2
+/* Accumulator bank used by the given period. */
+#define SAMPLE_EPOCH_BANK(period)	((period) & (SAMPLE_EPOCH_BANKS - 1))
+
+/* Sample epoch.
+ *  Captured by the cyclic timer ISR on every tick. All modules woken by the
+ * same tick tag their intermediate samples with it, so samples taken by
+ * threads of different priorities refer to one and the same instant.
+ */
+typedef struct {
+	uint64_t timestamp_us;		/* Time of the tick [us] */
+	uint32_t sequence;			/* Number of ticks since boot */
+	uint32_t period;			/* Index of the period the tick belongs to */
+} Sample_epoch;
+
+/* Measurement period.
+ *  Closed by the timer ISR on a period boundary, and read by the serial
+ * thread, which reports it together with the period's data.
+ */
+typedef struct {
+	uint32_t index;				/* Index of the closed period */
+	uint32_t start_s;			/* Wall-clock time of period start [s], or 0 */
+	uint32_t epoch;				/* Sequence number of the closing tick */
+	uint16_t length_s;			/* Nominal length [s] (adaptive, configured) */
+	uint8_t partial;			/* Not aligned to wall-clock boundaries */
+} Sample_period;
+
+
+/* Capture a new epoch (timestamp and sequence number).
+ * Call from the timer ISR only.
+ */
+void sample_epoch_capture(void);
+
+/* Copy the current epoch, safe to call from any thread.
+ *  p1: pointer to where the epoch will be written
+ */
+void sample_epoch_get(Sample_epoch *epoch);
+
+/* Time elapsed since the epoch was captured (sampling skew).
+ *  p1: epoch the sample is tagged with
+ * return:
+ *  skew in [us]
+ */
+uint32_t sample_epoch_skew_us(const Sample_epoch *epoch);
+
+/* Store the period, which has just been closed, and move on to the next one.
+ * Samples of the current tick already belong to the next period, so this
+ * swaps accumulator banks of all modules at once. Call from the timer ISR
+ * only, before waking any of the module threads.
+ *  p1: closed period (index is filled in)
+ */
+void sample_epoch_close_period(Sample_period *period);
+
+/* Copy the last closed period, safe to call from any thread.
+ *  p1: pointer to where the period will be written
+ */
+void sample_epoch_get_period(Sample_period *period);
+
+
+#endif
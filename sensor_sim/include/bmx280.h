@@ -0,0 +1,35 @@
+/* Simulated BME280 (native board), same API as RIOT's driver.
+ *  Compensated values are served from sensor_sim channels, see
+ * sim_drivers.c.
+ */
+#ifndef BMX280_H
+#define BMX280_H
+
+#include "periph/i2c.h"
+
+#include <stdint.h>
+
+
+enum {
+	BMX280_OK = 0,
+	BMX280_ERR_NODEV = -1,
+	BMX280_ERR_BUS = -2,
+};
+
+typedef struct {
+	i2c_t i2c_dev;
+	uint8_t i2c_addr;
+} bmx280_params_t;
+
+typedef struct {
+	bmx280_params_t params;
+} bmx280_t;
+
+
+int bmx280_init(bmx280_t *dev, const bmx280_params_t *params);
+int16_t bmx280_read_temperature(const bmx280_t *dev);
+uint32_t bmx280_read_pressure(const bmx280_t *dev);
+uint16_t bme280_read_humidity(const bmx280_t *dev);
+
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef BMX280_PARAMS_H
+#define BMX280_PARAMS_H
+
+#include "bmx280.h"
+
+
+#ifndef BMX280_PARAMS
+#define BMX280_PARAMS		{ .i2c_dev = I2C_DEV(0), .i2c_addr = 0x77 }
+#endif
+
+static const bmx280_params_t bmx280_params[] = {
+	BMX280_PARAMS
+};
+
+
+#endif
@@ -0,0 +1,66 @@
+/* Simulated INA220 (native board), same API as RIOT's driver.
+ *  Registers are served from sensor_sim channels, see sim_drivers.c.
+ */
+#ifndef INA220_H
+#define INA220_H
+
+#include "periph/i2c.h"
+
+#include <stdint.h>
+
+
+#define INA220_BUS_VOLTAGE_SHIFT		(3)
+
+typedef enum {
+	INA220_MODE_POWERDOWN = 0x0000,
+	INA220_MODE_TRIGGER_SHUNT_ONLY = 0x0001,
+	INA220_MODE_TRIGGER_BUS_ONLY = 0x0002,
+	INA220_MODE_TRIGGER_SHUNT_BUS = 0x0003,
+	INA220_MODE_ADC_DISABLE = 0x0004,
+	INA220_MODE_CONTINUOUS_SHUNT_ONLY = 0x0005,
+	INA220_MODE_CONTINUOUS_BUS_ONLY = 0x0006,
+	INA220_MODE_CONTINUOUS_SHUNT_BUS = 0x0007,
+} ina220_mode_t;
+
+typedef enum {
+	INA220_RANGE_40MV = 0x0000,
+	INA220_RANGE_80MV = 0x0800,
+	INA220_RANGE_160MV = 0x1000,
+	INA220_RANGE_320MV = 0x1800,
+} ina220_range_t;
+
+typedef enum {
+	INA220_BRNG_16V_FSR = 0x0000,
+	INA220_BRNG_32V_FSR = 0x2000,
+} ina220_brng_t;
+
+typedef enum {
+	INA220_SADC_9BIT = 0x0000,
+	INA220_SADC_10BIT = 0x0008,
+	INA220_SADC_11BIT = 0x0010,
+	INA220_SADC_12BIT = 0x0018,
+} ina220_sadc_t;
+
+typedef enum {
+	INA220_BADC_9BIT = 0x0000,
+	INA220_BADC_10BIT = 0x0080,
+	INA220_BADC_11BIT = 0x0100,
+	INA220_BADC_12BIT = 0x0180,
+} ina220_badc_t;
+
+typedef struct {
+	i2c_t i2c;
+	uint8_t addr;
+} ina220_t;
+
+
+int ina220_init(ina220_t *dev, i2c_t i2c, uint8_t address);
+int ina220_set_config(const ina220_t *dev, uint16_t config);
+int ina220_set_calibration(const ina220_t *dev, uint16_t calibration);
+int ina220_read_shunt(const ina220_t *dev, int16_t *voltage);
+int ina220_read_bus(const ina220_t *dev, int16_t *voltage);
+int ina220_read_current(const ina220_t *dev, int16_t *current);
+int ina220_read_power(const ina220_t *dev, int16_t *power);
+
+
+#endif
@@ -0,0 +1,241 @@
+#include "sensor_sim.h"
+
+#include "xtimer.h"
+#include "native_internal.h"
+
+#include <log.h>
+#include <math.h>
+#include <stdio.h>			// FILE
+#include <stdlib.h>			// getenv, strtof
+#include <string.h>
+#include <stdint.h>
+
+#ifndef ENABLE_DEBUG
+#define ENABLE_DEBUG (0)
+#endif
+#include "debug.h"
+
+
+#define SENSOR_SIM_CH_WAVE(name, offset, amplitude, period_s, noise)		\
+	{ offset, amplitude, period_s, noise },
+#define SENSOR_SIM_CH_NAME(name, offset, amplitude, period_s, noise)		\
+	#name,
+
+static const char *_names[SENSOR_SIM_CHANNELS_NUMOF] = {
+	SENSOR_SIM_CHANNELS(SENSOR_SIM_CH_NAME)
+};
+
+static Sensor_sim_wave _waves[SENSOR_SIM_CHANNELS_NUMOF];
+
+/* Trace: time and value of each traced channel, per row */
+static char _trace_buf[SENSOR_SIM_TRACE_MAX_LEN + 1];
+static float _trace_t[SENSOR_SIM_TRACE_MAX_ROWS];
+static float _trace[SENSOR_SIM_TRACE_MAX_ROWS][SENSOR_SIM_CHANNELS_NUMOF];
+static uint8_t _is_traced[SENSOR_SIM_CHANNELS_NUMOF];
+static uint16_t _trace_rows;
+/* Row of the last lookup (time mostly moves forward) */
+static uint16_t _trace_pos;
+
+static uint32_t _rand_state;
+
+
+/* Prototypes *****************************************************************/
+static float _wave_value (const Sensor_sim_wave *wave, float t);
+static float _trace_value (Sensor_sim_channel ch, float t);
+static int8_t _parse_header (char **pos, int8_t *ch_of_col, uint8_t *cols);
+static float _noise (void);
+static char *_next_line (char *pos);
+
+
+/* Functions ******************************************************************/
+
+/* Init channels to their default waveforms, and load trace, if set. */
+int8_t init_sensor_sim (void) {
+	static const Sensor_sim_wave waves[SENSOR_SIM_CHANNELS_NUMOF] = {
+		SENSOR_SIM_CHANNELS(SENSOR_SIM_CH_WAVE)
+	};
+	memcpy(_waves, waves, sizeof(_waves));
+	memset(_is_traced, 0, sizeof(_is_traced));
+	_trace_rows = 0;
+	_trace_pos = 0;
+	_rand_state = SENSOR_SIM_SEED ? SENSOR_SIM_SEED : 1;
+
+	const char *path = getenv("SENSOR_SIM_TRACE");
+	if (path == NULL || *path == '\0') {
+		return 0;
+	}
+	if (sensor_sim_load_trace(path) != 0) {
+		LOG_ERROR("Failed: sensor_sim_load_trace\n");
+		return -1;
+	}
+	return 0;
+}
+
+/* Load CSV trace, replacing waveforms of its channels. */
+int8_t sensor_sim_load_trace (const char *path) {
+	_native_syscall_enter();
+	FILE *f = real_fopen(path, "r");
+	size_t len = 0;
+	if (f != NULL) {
+		len = real_fread(_trace_buf, 1, sizeof(_trace_buf), f);
+		real_fclose(f);
+	}
+	_native_syscall_leave();
+
+	if (f == NULL || len == 0 || len > SENSOR_SIM_TRACE_MAX_LEN) {
+		LOG_ERROR("Failed: read trace (missing, empty or too long)\n");
+		return -1;
+	}
+	_trace_buf[len] = '\0';
+
+	char *pos = _trace_buf;
+	int8_t ch_of_col[SENSOR_SIM_CHANNELS_NUMOF + 1];
+	uint8_t cols;
+	if (_parse_header(&pos, ch_of_col, &cols) != 0) {
+		LOG_ERROR("Failed: _parse_header\n");
+		return -1;
+	}
+
+	uint16_t rows = 0;
+	while (*pos != '\0' && rows < SENSOR_SIM_TRACE_MAX_ROWS) {
+		uint8_t col;
+		for (col = 0; col < cols; col++) {
+			/* strtof would skip line ends */
+			if (*pos == '\n' || *pos == '\r') {
+				break;
+			}
+			char *end;
+			float val = strtof(pos, &end);
+			if (end == pos) {
+				break;
+			}
+			if (ch_of_col[col] < 0) {
+				_trace_t[rows] = val;
+			}
+			else {
+				_trace[rows][ch_of_col[col]] = val;
+			}
+			pos = (*end == ',') ? end + 1 : end;
+		}
+		/* Keep complete rows with increasing time */
+		if (col == cols && (rows == 0 || _trace_t[rows] > _trace_t[rows - 1])) {
+			rows++;
+		}
+		pos = _next_line(pos);
+	}
+
+	if (rows < 2) {
+		LOG_ERROR("Failed: trace needs at least 2 rows\n");
+		return -1;
+	}
+
+	for (uint8_t col = 0; col < cols; col++) {
+		if (ch_of_col[col] >= 0) {
+			_is_traced[ch_of_col[col]] = 1;
+		}
+	}
+	_trace_rows = rows;
+	_trace_pos = 0;
+
+	DEBUG("trace: %u rows, %u columns, %.1f s\n",
+			rows, cols, _trace_t[rows - 1] - _trace_t[0]);
+	return 0;
+}
+
+/* Replace waveform of a channel. */
+void sensor_sim_set_wave (Sensor_sim_channel ch, const Sensor_sim_wave *wave) {
+	_waves[ch] = *wave;
+	_is_traced[ch] = 0;
+}
+
+/* Get current value of a channel. */
+float sensor_sim_value (Sensor_sim_channel ch) {
+	float t = xtimer_now_usec64() / (float)US_PER_SEC;
+
+	if (_trace_rows && _is_traced[ch]) {
+		return _trace_value(ch, t);
+	}
+	return _wave_value(&_waves[ch], t);
+}
+
+
+/* Helpers ********************************************************************/
+
+static float _wave_value (const Sensor_sim_wave *wave, float t) {
+	float val = wave->offset + wave->noise * _noise();
+	if (wave->period_s) {
+		val += wave->amplitude * sinf(2 * (float)M_PI * t / wave->period_s);
+	}
+	return val;
+}
+
+/* Interpolate trace, relative to its first row, wrapped around its length. */
+static float _trace_value (Sensor_sim_channel ch, float t) {
+	float t0 = _trace_t[0];
+	float len = _trace_t[_trace_rows - 1] - t0;
+	t = t0 + fmodf(t, len);
+
+	if (t < _trace_t[_trace_pos]) {
+		_trace_pos = 0;
+	}
+	while (_trace_pos + 2 < _trace_rows && t >= _trace_t[_trace_pos + 1]) {
+		_trace_pos++;
+	}
+
+	uint16_t i = _trace_pos;
+	float k = (t - _trace_t[i]) / (_trace_t[i + 1] - _trace_t[i]);
+	return _trace[i][ch] + k * (_trace[i + 1][ch] - _trace[i][ch]);
+}
+
+/* Map header columns to channels ('t' to -1), and move past header line. */
+static int8_t _parse_header (char **pos, int8_t *ch_of_col, uint8_t *cols) {
+	uint8_t has_t = 0;
+	*cols = 0;
+
+	char *name = *pos;
+	while (*name != '\0' && *name != '\n' && *name != '\r') {
+		size_t len = strcspn(name, ",\r\n");
+		if (*cols == SENSOR_SIM_CHANNELS_NUMOF + 1) {
+			return -1;
+		}
+
+		int8_t ch = -2;
+		if (len == 1 && *name == 't') {
+			ch = -1;
+			has_t = 1;
+		}
+		for (uint8_t i = 0; i < SENSOR_SIM_CHANNELS_NUMOF && ch == -2; i++) {
+			if (strlen(_names[i]) == len && strncmp(name, _names[i], len) == 0) {
+				ch = i;
+			}
+		}
+		if (ch == -2) {
+			LOG_ERROR("Failed: unknown trace column\n");
+			return -1;
+		}
+		ch_of_col[(*cols)++] = ch;
+
+		name += len;
+		if (*name == ',') {
+			name++;
+		}
+	}
+
+	*pos = _next_line(name);
+	return has_t ? 0 : -1;
+}
+
+/* Uniform noise in [-1, 1] (xorshift32, reproducible). */
+static float _noise (void) {
+	_rand_state ^= _rand_state << 13;
+	_rand_state ^= _rand_state >> 17;
+	_rand_state ^= _rand_state << 5;
+	return (float)_rand_state / UINT32_MAX * 2 - 1;
+}
+
+static char *_next_line (char *pos) {
+	while (*pos != '\0' && *pos != '\n') {
+		pos++;
+	}
+	return (*pos == '\n') ? pos + 1 : pos;
+}
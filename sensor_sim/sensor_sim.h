@@ -0,0 +1,108 @@
+#ifndef SENSOR_SIM_H
+#define SENSOR_SIM_H
+
+#include "periph/gpio.h"
+
+#include <stdint.h>
+#include <stddef.h>		// size_t
+
+
+/* Simulated sensors for the native board.
+ *  Replaces the hardware below the application's drivers: GPIOs (anemometer
+ * counter and mux, relays), the vane ADC, INA220 and BME280. Each physical
+ * quantity is a channel, driven by a waveform (offset + sine + uniform noise)
+ * or by a column of a CSV trace.
+ *  Trace: first line holds column names, 't' (time [s], ascending) and any of
+ * the channel names below. Values are interpolated linearly, and the trace
+ * restarts after its last row. Channels missing in the trace keep their
+ * waveform. Set the path in the SENSOR_SIM_TRACE environment variable.
+ */
+
+/* Channels: name, offset, amplitude, period [s], noise (peak).
+ *  Units: wind [m/s], direction [deg], temperature [degC], pressure [Pa],
+ * humidity [%RH], voltage [mV], current [mA].
+ */
+#ifndef SENSOR_SIM_CHANNELS
+#define SENSOR_SIM_CHANNELS(X)											\
+	X(wind_speed,		5.0f,		3.0f,		900,	1.0f)			\
+	X(wind_dir,			225.0f,		30.0f,		1800,	10.0f)			\
+	X(wind_speed_high,	7.0f,		3.5f,		900,	1.2f)			\
+	X(wind_dir_high,	230.0f,		30.0f,		1800,	10.0f)			\
+	X(air_temp,			15.0f,		5.0f,		86400,	0.1f)			\
+	X(air_pressure,		101325.0f,	300.0f,		86400,	5.0f)			\
+	X(rel_humidity,		60.0f,		20.0f,		86400,	1.0f)			\
+	X(vx,				3700.0f,	200.0f,		86400,	10.0f)			\
+	X(pv_uoc,			6000.0f,	1000.0f,	86400,	20.0f)			\
+	X(pv_isc,			150.0f,		100.0f,		86400,	5.0f)
+#endif
+
+/* Seed of the noise generator (same seed and timing, same values) */
+#ifndef SENSOR_SIM_SEED
+#define SENSOR_SIM_SEED					1
+#endif
+
+/* Trace limits (parsed once, at init) */
+#ifndef SENSOR_SIM_TRACE_MAX_LEN
+#define SENSOR_SIM_TRACE_MAX_LEN		(64 * 1024)
+#endif
+#ifndef SENSOR_SIM_TRACE_MAX_ROWS
+#define SENSOR_SIM_TRACE_MAX_ROWS		1024
+#endif
+
+/* INA220 conversion time, shunt and bus at 12 bit */
+#ifndef SENSOR_SIM_INA_CONV_US
+#define SENSOR_SIM_INA_CONV_US			1064
+#endif
+
+#define SENSOR_SIM_CH_ENUM(name, offset, amplitude, period_s, noise)		\
+	SENSOR_SIM_##name,
+
+typedef enum {
+	SENSOR_SIM_CHANNELS(SENSOR_SIM_CH_ENUM)
+	SENSOR_SIM_CHANNELS_NUMOF
+} Sensor_sim_channel;
+
+/* Waveform of a channel. */
+typedef struct {
+	float offset;
+	float amplitude;
+	uint32_t period_s;				/* 0: no sine */
+	float noise;					/* Peak of uniform noise */
+} Sensor_sim_wave;
+
+
+/* Init channels to their default waveforms, and load trace, if set.
+ * return:
+ *  0 on success, -1 on error (trace not loaded, waveforms used)
+ */
+int8_t init_sensor_sim (void);
+
+/* Load CSV trace (see above), replacing waveforms of its channels.
+ *  p1: path of the trace file
+ * return:
+ *  0 on success, -1 on error
+ */
+int8_t sensor_sim_load_trace (const char *path);
+
+/* Replace waveform of a channel (also when driven by trace).
+ *  p1: channel
+ *  p2: waveform
+ */
+void sensor_sim_set_wave (Sensor_sim_channel ch, const Sensor_sim_wave *wave);
+
+/* Get current value of a channel, in its units.
+ *  p1: channel
+ * return:
+ *  value
+ */
+float sensor_sim_value (Sensor_sim_channel ch);
+
+/* Get level of a simulated GPIO, as last written by the application.
+ *  p1: pin
+ * return:
+ *  0 or 1
+ */
+int sensor_sim_gpio_level (gpio_t pin);
+
+
+#endif
@@ -0,0 +1,140 @@
+/* Simulated INA220 and BME280 drivers (replace the ina220 and bme280
+ * modules, whose headers are shadowed by sensor_sim/include).
+ *  INA220: registers as the chip would return them. A triggered conversion
+ * sets CNVR after SENSOR_SIM_INA_CONV_US. The bus voltage follows the
+ * el_data relays: RL1 shorts the panel (bus 0, current Isc), RL2 or RL3
+ * connect the open panel (Uoc), otherwise Vx is measured. Current and shunt
+ * LSB is 1 mA resp. 10 uV (10 mOhm shunt), as el_data assumes.
+ *  BME280: compensated values (the driver's API), since the Bosch
+ * compensation would have to be inverted to serve raw registers.
+ */
+#include "sensor_sim.h"
+#include "../pin_settings.h"
+
+#include "xtimer.h"
+#include "ina220.h"
+#include "bmx280.h"
+
+#include <math.h>
+#include <stdint.h>
+
+#ifndef ENABLE_DEBUG
+#define ENABLE_DEBUG (0)
+#endif
+#include "debug.h"
+
+
+#define SIM_INA_MODE_MASK				0x0007U
+#define SIM_INA_MODE_CONTINUOUS			0x0004U
+#define SIM_INA_CNVR					(1U << 1)
+
+static uint16_t _ina_mode;
+static uint64_t _ina_trigger_us;
+
+
+/* Prototypes *****************************************************************/
+static int16_t _ina_bus_mv (void);
+static int16_t _ina_current_ma (void);
+static int32_t _clamp (float val, int32_t min, int32_t max);
+
+
+/* INA220 *********************************************************************/
+
+int ina220_init (ina220_t *dev, i2c_t i2c, uint8_t address) {
+	dev->i2c = i2c;
+	dev->addr = address;
+	return 0;
+}
+
+int ina220_set_config (const ina220_t *dev, uint16_t config) {
+	(void)dev;
+	_ina_mode = config & SIM_INA_MODE_MASK;
+	_ina_trigger_us = xtimer_now_usec64();
+	return 0;
+}
+
+int ina220_set_calibration (const ina220_t *dev, uint16_t calibration) {
+	(void)dev;
+	(void)calibration;
+	return 0;
+}
+
+int ina220_read_shunt (const ina220_t *dev, int16_t *voltage) {
+	(void)dev;
+	*voltage = _ina_current_ma();
+	return 0;
+}
+
+int ina220_read_bus (const ina220_t *dev, int16_t *voltage) {
+	(void)dev;
+	uint8_t is_ready = (_ina_mode & SIM_INA_MODE_CONTINUOUS) ||
+			(xtimer_now_usec64() - _ina_trigger_us >= SENSOR_SIM_INA_CONV_US);
+	*voltage = (int16_t)(((_ina_bus_mv() / 4) << INA220_BUS_VOLTAGE_SHIFT)
+			| (is_ready ? SIM_INA_CNVR : 0));
+	return 0;
+}
+
+int ina220_read_current (const ina220_t *dev, int16_t *current) {
+	(void)dev;
+	*current = _ina_current_ma();
+	return 0;
+}
+
+int ina220_read_power (const ina220_t *dev, int16_t *power) {
+	(void)dev;
+	/* LSB is 20 times the current LSB */
+	*power = (int16_t)((int32_t)_ina_bus_mv() * _ina_current_ma() / 1000 / 20);
+	return 0;
+}
+
+
+/* BME280 *********************************************************************/
+
+int bmx280_init (bmx280_t *dev, const bmx280_params_t *params) {
+	dev->params = *params;
+	return BMX280_OK;
+}
+
+int16_t bmx280_read_temperature (const bmx280_t *dev) {
+	(void)dev;
+	return (int16_t)_clamp(sensor_sim_value(SENSOR_SIM_air_temp) * 100,
+			-4000, 8500);
+}
+
+uint32_t bmx280_read_pressure (const bmx280_t *dev) {
+	(void)dev;
+	return (uint32_t)_clamp(sensor_sim_value(SENSOR_SIM_air_pressure),
+			30000, 110000);
+}
+
+uint16_t bme280_read_humidity (const bmx280_t *dev) {
+	(void)dev;
+	return (uint16_t)_clamp(sensor_sim_value(SENSOR_SIM_rel_humidity) * 100,
+			0, 10000);
+}
+
+
+/* Helpers ********************************************************************/
+
+static int16_t _ina_bus_mv (void) {
+	if (sensor_sim_gpio_level(EL_DATA_RE1_PIN)) {
+		return 0;
+	}
+	if (sensor_sim_gpio_level(EL_DATA_RE2_PIN) ||
+			sensor_sim_gpio_level(EL_DATA_RE3_PIN)) {
+		return (int16_t)_clamp(sensor_sim_value(SENSOR_SIM_pv_uoc), 0, 32000);
+	}
+	return (int16_t)_clamp(sensor_sim_value(SENSOR_SIM_vx), 0, 32000);
+}
+
+static int16_t _ina_current_ma (void) {
+	if (!sensor_sim_gpio_level(EL_DATA_RE1_PIN)) {
+		return 0;
+	}
+	return (int16_t)_clamp(sensor_sim_value(SENSOR_SIM_pv_isc), 0, 32000);
+}
+
+static int32_t _clamp (float val, int32_t min, int32_t max) {
+	int32_t i = (int32_t)roundf(val);
+	return (i < min) ? min : ((i > max) ? max : i);
+}
@@ -0,0 +1,225 @@
+/* Simulated GPIO and ADC peripherals (replace periph_gpio and periph_adc).
+ *  Anemometers: while the counter is enabled (N_EN low), rotations of the
+ * cup accumulate at the simulated wind speed. A rising edge on RST clears
+ * the 8 bit counter, and MUX_OUT shows the counter bit addressed by C, B, A.
+ * The vane ADC line returns the simulated direction. All other pins just
+ * keep the level written to them (e.g. el_data relays, see sim_drivers.c).
+ */
+#include "sensor_sim.h"
+#include "../pin_settings.h"
+#include "../anemo_davis/anemo_davis.h"
+
+#include "xtimer.h"
+#include "periph/gpio.h"
+#include "periph/adc.h"
+
+#include <log.h>
+#include <math.h>
+#include <stdint.h>
+
+#ifndef ENABLE_DEBUG
+#define ENABLE_DEBUG (0)
+#endif
+#include "debug.h"
+
+
+#define SENSOR_SIM_GPIO_NUMOF		32
+
+typedef struct {
+	gpio_t pin;
+	uint8_t level;
+} Sim_gpio;
+
+typedef struct {
+	gpio_t mux_out;
+	gpio_t mux_c;
+	gpio_t mux_b;
+	gpio_t mux_a;
+	gpio_t counter_rst;
+	gpio_t counter_n_en;
+	adc_t adc_line;
+	Sensor_sim_channel speed;
+	Sensor_sim_channel dir;
+	uint8_t count;					/* Counter value (8 bit, wraps) */
+	float rotations;				/* Rotation in progress (fraction) */
+	uint64_t last_us;
+} Sim_anemo;
+
+static Sim_gpio _gpio[SENSOR_SIM_GPIO_NUMOF];
+static uint8_t _gpio_numof;
+
+/* Anemometers of pin_settings.h */
+static Sim_anemo _anemo[] = {
+	{
+		.mux_out = ANEMO_DAVIS_MUX_OUT,
+		.mux_c = ANEMO_DAVIS_MUX_C,
+		.mux_b = ANEMO_DAVIS_MUX_B,
+		.mux_a = ANEMO_DAVIS_MUX_A,
+		.counter_rst = ANEMO_DAVIS_COUNTER_RST,
+		.counter_n_en = ANEMO_DAVIS_COUNTER_N_EN,
+		.adc_line = ANEMO_DAVIS_ADC_LINE,
+		.speed = SENSOR_SIM_wind_speed,
+		.dir = SENSOR_SIM_wind_dir,
+	},
+#ifdef DV_DATA_HIGH_MUX_OUT
+	{
+		.mux_out = DV_DATA_HIGH_MUX_OUT,
+		.mux_c = DV_DATA_HIGH_MUX_C,
+		.mux_b = DV_DATA_HIGH_MUX_B,
+		.mux_a = DV_DATA_HIGH_MUX_A,
+		.counter_rst = DV_DATA_HIGH_COUNTER_RST,
+		.counter_n_en = DV_DATA_HIGH_COUNTER_N_EN,
+		.adc_line = DV_DATA_HIGH_ADC_LINE,
+		.speed = SENSOR_SIM_wind_speed_high,
+		.dir = SENSOR_SIM_wind_dir_high,
+	},
+#endif
+};
+
+#define SIM_ANEMO_NUMOF		(sizeof(_anemo) / sizeof(_anemo[0]))
+
+
+/* Prototypes *****************************************************************/
+static Sim_gpio *_find_gpio (gpio_t pin);
+static void _write (gpio_t pin, uint8_t level);
+static void _count (Sim_anemo *anemo);
+
+
+/* Functions ******************************************************************/
+
+int gpio_init (gpio_t pin, gpio_mode_t mode) {
+	(void)mode;
+	if (_find_gpio(pin) != NULL) {
+		return 0;
+	}
+	if (_gpio_numof == SENSOR_SIM_GPIO_NUMOF) {
+		LOG_ERROR("Failed: sensor_sim out of GPIOs\n");
+		return -1;
+	}
+	_gpio[_gpio_numof].pin = pin;
+	_gpio[_gpio_numof].level = 0;
+	_gpio_numof++;
+	return 0;
+}
+
+int gpio_read (gpio_t pin) {
+	for (uint8_t i = 0; i < SIM_ANEMO_NUMOF; i++) {
+		Sim_anemo *anemo = &_anemo[i];
+		if (anemo->mux_out != pin) {
+			continue;
+		}
+		_count(anemo);
+		uint8_t addr = (sensor_sim_gpio_level(anemo->mux_c) << 2)
+				| (sensor_sim_gpio_level(anemo->mux_b) << 1)
+				| sensor_sim_gpio_level(anemo->mux_a);
+		return (anemo->count >> addr) & 1;
+	}
+	return sensor_sim_gpio_level(pin);
+}
+
+void gpio_set (gpio_t pin) {
+	_write(pin, 1);
+}
+
+void gpio_clear (gpio_t pin) {
+	_write(pin, 0);
+}
+
+void gpio_toggle (gpio_t pin) {
+	_write(pin, !sensor_sim_gpio_level(pin));
+}
+
+void gpio_write (gpio_t pin, int value) {
+	_write(pin, value ? 1 : 0);
+}
+
+int adc_init (adc_t line) {
+	for (uint8_t i = 0; i < SIM_ANEMO_NUMOF; i++) {
+		if (_anemo[i].adc_line == line) {
+			return 0;
+		}
+	}
+	return -1;
+}
+
+int adc_sample (adc_t line, adc_res_t res) {
+	int max;
+	switch (res) {
+	case ADC_RES_8BIT:	max = (1 << 8) - 1;		break;
+	case ADC_RES_10BIT:	max = (1 << 10) - 1;	break;
+	case ADC_RES_12BIT:	max = (1 << 12) - 1;	break;
+	default:
+		return -1;
+	}
+
+	for (uint8_t i = 0; i < SIM_ANEMO_NUMOF; i++) {
+		if (_anemo[i].adc_line != line) {
+			continue;
+		}
+		float dir = fmodf(sensor_sim_value(_anemo[i].dir), 360);
+		if (dir < 0) {
+			dir += 360;
+		}
+		return (int)roundf(dir / 360 * max);
+	}
+	return -1;
+}
+
+/* Get level of a simulated GPIO. */
+int sensor_sim_gpio_level (gpio_t pin) {
+	Sim_gpio *gpio = _find_gpio(pin);
+	return (gpio != NULL) ? gpio->level : 0;
+}
+
+
+/* Helpers ********************************************************************/
+
+static Sim_gpio *_find_gpio (gpio_t pin) {
+	for (uint8_t i = 0; i < _gpio_numof; i++) {
+		if (_gpio[i].pin == pin) {
+			return &_gpio[i];
+		}
+	}
+	return NULL;
+}
+
+/* Update counters, which depend on pin, before changing its level. */
+static void _write (gpio_t pin, uint8_t level) {
+	Sim_gpio *gpio = _find_gpio(pin);
+	if (gpio == NULL) {
+		return;
+	}
+
+	for (uint8_t i = 0; i < SIM_ANEMO_NUMOF; i++) {
+		Sim_anemo *anemo = &_anemo[i];
+		if (anemo->counter_n_en == pin) {
+			_count(anemo);
+		}
+		else if (anemo->counter_rst == pin && level && !gpio->level) {
+			_count(anemo);
+			anemo->count = 0;
+		}
+	}
+
+	gpio->level = level;
+}
+
+/* Add rotations since the last update, if counter is enabled. */
+static void _count (Sim_anemo *anemo) {
+	uint64_t now_us = xtimer_now_usec64();
+
+	if (!sensor_sim_gpio_level(anemo->counter_n_en) && anemo->last_us) {
+		float speed_ms = sensor_sim_value(anemo->speed);
+		if (speed_ms > 0) {
+			anemo->rotations += speed_ms / (float)(DAVIS_SPEED_MULTIPLIER_MS)
+					* (now_us - anemo->last_us) / US_PER_SEC;
+		}
+		uint32_t whole = (uint32_t)anemo->rotations;
+		anemo->count += (uint8_t)whole;
+		anemo->rotations -= whole;
+	}
+
+	anemo->last_us = now_us;
+
+	DEBUG("sim anemo: count %u\n", anemo->count);
+}
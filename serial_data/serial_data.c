@@ -1,65 +1,961 @@
 #include "serial_data.h"
+#include "../wall_clock/wall_clock.h"
+#include "../payload/payload.h"
+#if (SERIAL_DATA_LINK == SERIAL_DATA_LINK_FRAMED)
+#include "../serial_link/serial_link.h"
+#include "xtimer.h"
+#endif
+#ifdef MODULE_DATA_STORAGE
+#include "../data_storage/data_storage.h"
+#endif
+#if (SERIAL_DATA_LZ)
+#include "../lzss/lzss.h"
+#endif
+#ifdef MODULE_SYS_CONFIG
+#include "../sys_config/sys_config.h"
+#endif
 
 #include "log.h"
+#include "irq.h"
+#include "msg.h"
+#include "thread.h"
 #include "periph/uart.h"
 
 #include <string.h>
 #include <stdint.h>
 #include <stddef.h>		// size_t
-#include <stdlib.h>		// malloc
 
 #ifndef ENABLE_DEBUG
 #define ENABLE_DEBUG (0)
 #endif
 #include "debug.h"
 
-static size_t _payload_buf_len;
-static char *_payload_buf;
-static char *_hash_buf;
+/* Payload slots, each: head | module data slice | tail.
+ *  Head is constant (JSON) or of fixed length (binary), so module data is
+ * written to its final place and the slot goes to UART without copies.
+ *  Filled slots are queued to the TX thread, which writes them to UART in
+ * the background, so the serial thread never waits for transmission.
+ */
+static size_t _payload_buf_len;			/* Length of a single slot */
+static char *_payload_buf;				/* All slots (static, see init) */
+static size_t _slot_len[SERIAL_DATA_TX_SLOTS];	/* Bytes to send */
+static uint8_t _slot_busy[SERIAL_DATA_TX_SLOTS];	/* Filling, queued, sending */
+static int8_t _fill_slot = -1;			/* Slot being filled */
+static size_t _data_offset;			/* Module data (batch: 1st period) */
+static size_t _data_len_max;
+static const char *_hash;
+
+/* TX thread and its queue (slot index, hello, or config line) */
+static char _tx_stack[SERIAL_DATA_TX_STACKSIZE];
+static kernel_pid_t _tx_pid = KERNEL_PID_UNDEF;
+static msg_t _tx_queue[SERIAL_DATA_TX_QUEUE_SIZE];
+
+static Serial_data_tx_stats _tx_stats;
+
+#if (SERIAL_DATA_LZ)
+/* Compressed frame of the slot being sent (TX thread only) */
+static uint8_t *_lz_buf;
+#endif
+
+#if (SERIAL_DATA_LINK == SERIAL_DATA_LINK_FRAMED)
+/* Retransmit window (TX thread only): sent, unacked slots, oldest first */
+static int8_t _win_idx[SERIAL_DATA_TX_SLOTS];
+static uint16_t _win_seq[SERIAL_DATA_TX_SLOTS];
+static uint8_t _win_len;
+static uint16_t _next_seq;
+static uint8_t _retries;
+/* Payloads were given up, peer is told to skip them till it acks */
+static uint8_t _resync;
+/* ACK timeout, stale messages (timer re-armed meanwhile) are told apart by
+ * generation number */
+static xtimer_t _ack_timer;
+static msg_t _ack_timer_msg;
+static uint32_t _ack_timer_gen;
+
+static void _win_send(int8_t idx);
+static void _win_ack(uint16_t seq, int8_t inclusive);
+static void _win_pop(uint8_t n, int8_t is_sent);
+static void _win_retry(void);
+static void _win_resend(void);
+static void _win_skip(void);
+static void _win_arm(void);
+
+#ifdef MODULE_DATA_STORAGE
+/* Slot holds a payload drained from data storage */
+static uint8_t _slot_stored[SERIAL_DATA_TX_SLOTS];
+
+static void _drain(void);
+#endif
+#elif defined(MODULE_DATA_STORAGE)
+#error "data_storage requires SERIAL_DATA_LINK_FRAMED (delivery is acked)"
+#endif
+
+#if (SERIAL_DATA_ENCODING != SERIAL_DATA_ENCODING_JSON)
+/* Short device id, sent instead of hash */
+static uint16_t _device_id;
+/* Periods till next hello frame */
+static uint16_t _hello_countdown;
+/* Hello frame (sent from TX thread) */
+static uint8_t _hello_buf[PAYLOAD_FRAME_HEADER_LEN + 3 + UINT8_MAX];
+static size_t _hello_len;
+
+static void _render_hello(void);
+static void _hello_tick(void);
+#else
+_Static_assert(SERIAL_DATA_JSON_OVERHEAD_LEN <= SERIAL_DATA_BALAST_LEN,
+		"JSON payload head and tail don't fit into balast");
+#endif
+
+_Static_assert((SERIAL_DATA_TX_QUEUE_SIZE &
+		(SERIAL_DATA_TX_QUEUE_SIZE - 1)) == 0,
+		"TX queue size must be a power of 2");
+_Static_assert(SERIAL_DATA_TX_QUEUE_SIZE > SERIAL_DATA_TX_SLOTS,
+		"TX queue must hold all slots and hello");
+
+#if (SERIAL_DATA_BATCH_PERIODS > 1)
+/* Batch being filled (serial thread only) */
+static uint8_t _batch_count;			/* Periods in fill slot */
+static size_t _fill_len;				/* Bytes used in fill slot */
+static size_t _period_offset;			/* Module data of current period */
+static size_t _period_len_max;			/* Longest period incl. overhead */
+static size_t _batch_len_max;
+
+#define _PERIOD_HEAD_LEN	SERIAL_DATA_PERIOD_HEAD_LEN
+#define _PERIOD_TAIL_LEN	SERIAL_DATA_PERIOD_TAIL_LEN
+
+#if (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_BIN)
+#define _BATCH_TAIL_LEN		0
+#define _BATCH_FRAME		PAYLOAD_FRAME_BATCH
+#elif (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_DELTA)
+#define _BATCH_TAIL_LEN		0
+#define _BATCH_FRAME		PAYLOAD_FRAME_DELTA
+/* Previous period of the batch and differences to the one before (index,
+ * error, epoch, start, length), period fields are coded as their change */
+static Sample_period _prev_period;
+static uint16_t _prev_error;
+static int32_t _prev_delta[5];
+#else
+#define _BATCH_TAIL_LEN		SERIAL_DATA_JSON_BATCH_TAIL_MAX_LEN
+_Static_assert(SERIAL_DATA_JSON_BATCH_HEAD_FORMAT_LEN + _BATCH_TAIL_LEN <=
+		SERIAL_DATA_BALAST_LEN,
+		"JSON batch head and tail don't fit into balast");
+#endif
+
+static int8_t _flush_batch(uint16_t config);
+#endif
 
+static void *_tx_handler(void *arg);
+#if (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_JSON)
+static void _render_head(char *slot);
+#endif
+static int8_t _queue(uint16_t type, uint32_t value);
+static void _count_queued(void);
+static const uint8_t *_tx_payload(int8_t idx, size_t *len);
+static int8_t _take_slot(void);
+static void _free_slot(int8_t idx, int8_t is_sent);
+static char *_slot(int8_t idx);
+
+
+/* Receive time reference ("T<Unix time [s]>\n") and set the wall clock. */
 static void _rx_cb(void *arg, uint8_t data)
 {
+	static uint32_t unix_s;
+	static int8_t is_receiving = 0;
+
+#if (SERIAL_DATA_LINK == SERIAL_DATA_LINK_FRAMED)
+	/* ACK/NAK frames */
+	if (serial_link_rx(data)) {
+		return;
+	}
+#endif
+
+#ifdef MODULE_SYS_CONFIG
+	/* Configuration commands ("C...\n") */
+	if (sys_config_rx(data)) {
+		return;
+	}
+#endif
+
+	if (data == SERIAL_DATA_TIME_SYNC_CMD) {
+		unix_s = 0;
+		is_receiving = 1;
+	} else if (is_receiving && data >= '0' && data <= '9') {
+		unix_s = unix_s * 10 + (data - '0');
+	} else {
+		if (is_receiving && data == '\n' && unix_s != 0) {
+			wall_clock_set(unix_s);
+		}
+		is_receiving = 0;
+	}
 }
 
-int8_t init_serial_data (size_t data_buf_len, char *hash, size_t hash_len) {
+int8_t init_serial_data (char *buf, size_t buf_len, size_t data_buf_len,
+		char *hash, size_t hash_len) {
 
-	/* Write hash to local buffer */
-	_hash_buf = malloc(hash_len);
-	snprintf(_hash_buf, hash_len, "%s", hash);
+	_hash = hash;
+	_tx_stats.digest = PAYLOAD_FNV1A_INIT;
 
-	/* Estimate payload buffer length */
-	_payload_buf_len = data_buf_len + hash_len + SERIAL_DATA_BALAST_LEN;
-	/* Allocate and clear memory for payload buffer */
-	_payload_buf = malloc(_payload_buf_len);
-	memset(_payload_buf, 0, _payload_buf_len);
+	/* Buffer is sized by the caller at compile time */
+	if (hash_len > SERIAL_DATA_HASH_MAX_LEN ||
+			buf_len < SERIAL_DATA_BUF_LEN(data_buf_len)) {
+		LOG_ERROR("Failed: payload buffer too short\n");
+		return -1;
+	}
+
+	/* Payload buffer (slot) length */
+	_payload_buf_len = SERIAL_DATA_SLOT_LEN(data_buf_len);
+#if (SERIAL_DATA_BATCH_PERIODS > 1)
+	_period_len_max = _PERIOD_HEAD_LEN + data_buf_len + _PERIOD_TAIL_LEN;
+	_batch_len_max = _payload_buf_len;
+	if (SERIAL_DATA_BATCH_MAX_LEN &&
+			SERIAL_DATA_BATCH_MAX_LEN < _batch_len_max) {
+		_batch_len_max = SERIAL_DATA_BATCH_MAX_LEN;
+	}
+#endif
+	_payload_buf = buf;
+	memset(_payload_buf, 0, SERIAL_DATA_TX_SLOTS * _payload_buf_len);
+
+#if (SERIAL_DATA_LZ)
+	/* Frames longer than the slot itself are not worth sending */
+	_lz_buf = (uint8_t *)buf + SERIAL_DATA_TX_SLOTS * _payload_buf_len;
+#endif
 
-	/* Check if memory allocation was OK (else NULL) */
-	if (!_hash_buf || !_payload_buf) {
-		LOG_ERROR("Failed: malloc\n");
+#if (SERIAL_DATA_ENCODING != SERIAL_DATA_ENCODING_JSON)
+	_device_id = payload_device_id(_hash);
+	_hello_countdown = 0;
+	_render_hello();
+
+	/* Frame header and body header are filled in on send */
+#if (SERIAL_DATA_BATCH_PERIODS > 1)
+	_data_offset = PAYLOAD_FRAME_HEADER_LEN + SERIAL_DATA_BIN_BATCH_HEADER_LEN;
+#else
+	_data_offset = PAYLOAD_FRAME_HEADER_LEN + SERIAL_DATA_BIN_HEADER_LEN;
+#endif
+	_data_len_max = _payload_buf_len - _data_offset;
+#else
+	/* Pre-render constant head of every slot */
+	for (int8_t i = 0; i < SERIAL_DATA_TX_SLOTS; i++) {
+		_render_head(_slot(i));
+	}
+	_data_len_max = _payload_buf_len - _data_offset -
+			SERIAL_DATA_JSON_TAIL_MAX_LEN;
+#endif
+
+#if (SERIAL_DATA_BATCH_PERIODS > 1)
+	if (_data_offset + _period_len_max + _BATCH_TAIL_LEN > _batch_len_max) {
+		LOG_ERROR("Failed: SERIAL_DATA_BATCH_MAX_LEN too short\n");
 		return -1;
 	}
+#endif
 
 	/* Init UART device */
-	int return_uart_init = uart_init(UART_DEV(1), 115200, _rx_cb, (void *)1);
+	int return_uart_init = uart_init(SERIAL_DATA_UART_DEV,
+			SERIAL_DATA_BAUDRATE, _rx_cb, (void *)1);
 	if (return_uart_init != 0) {
 		LOG_ERROR("Failed: uart_init\n");
 		return return_uart_init;
 	}
 
+	/* Start TX thread, below all measuring and serial threads */
+	_tx_pid = thread_create(
+			_tx_stack,
+			sizeof(_tx_stack),
+			SERIAL_DATA_TX_PRIO,
+			0,
+			_tx_handler, NULL,
+			"th_serial_tx");
+	if (_tx_pid <= KERNEL_PID_UNDEF) {
+		LOG_ERROR("Failed: thread_create\n");
+		return -1;
+	}
+
+#if (SERIAL_DATA_LINK == SERIAL_DATA_LINK_FRAMED)
+	serial_link_init(SERIAL_DATA_UART_DEV, _tx_pid);
+#endif
+#ifdef MODULE_SYS_CONFIG
+	sys_config_listen(_tx_pid);
+#endif
+
 	return 0;
 }
 
-int8_t send_serial_data (char *data_buf, uint16_t config, uint16_t error) {
+#if (SERIAL_DATA_BATCH_PERIODS > 1)
+/* Open a period in the batch being filled, start a new batch if none is. */
+char *get_serial_data_buf (size_t *len) {
 
-	snprintf(_payload_buf, _payload_buf_len,
-			SERIAL_DATA_JSON_FORMAT,
-			_hash_buf, (unsigned int)config, (unsigned int)error, data_buf);
+	if (_fill_slot < 0) {
+		/* Take a free slot, if any */
+		_fill_slot = _take_slot();
+		if (_fill_slot < 0) {
+			/* All slots queued or sending, this period is lost */
+			_tx_stats.dropped++;
+			return NULL;
+		}
+		_batch_count = 0;
+		_fill_len = _data_offset;
+	}
 
-	//uart_write(UART_DEV(1), (uint8_t*)_payload_buf, _payload_buf_len);
+	char *buf = _slot(_fill_slot);
+	size_t n = _fill_len;
+#if (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_BIN)
+	/* Period header is filled in on send */
+	n += SERIAL_DATA_BIN_PERIOD_HEADER_LEN;
+#elif (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_DELTA)
+	/* Period header follows module data (its length varies) */
+#else
+	if (_batch_count) {
+		buf[n++] = ',';
+	}
+	buf[n++] = '{';
+	n += payload_json_key(buf + n, "", "data");
+#endif
+	_period_offset = n;
+
+	*len = _batch_len_max - n - _PERIOD_TAIL_LEN - _BATCH_TAIL_LEN;
+	return buf + n;
+}
+#else
+char *get_serial_data_buf (size_t *len) {
+
+	/* Take a free slot, if any */
+	_fill_slot = _take_slot();
+
+	if (_fill_slot < 0) {
+		/* All slots queued or sending, this period is lost */
+		_tx_stats.dropped++;
+		return NULL;
+	}
+
+	*len = _data_len_max;
+	return _slot(_fill_slot) + _data_offset;
+}
+#endif
+
+uint8_t get_serial_data_batch_periods (void) {
+#if (SERIAL_DATA_BATCH_PERIODS > 1)
+	return (_fill_slot < 0) ? 0 : _batch_count;
+#else
+	return 0;
+#endif
+}
+
+void get_serial_data_tx_stats (Serial_data_tx_stats *stats) {
+	unsigned state = irq_disable();
+	*stats = _tx_stats;
+	irq_restore(state);
+}
+
+#if (SERIAL_DATA_BATCH_PERIODS > 1)
+/* Complete period behind its module data, send batch once complete. */
+int8_t send_serial_data (size_t data_len, uint16_t config, uint16_t error,
+		const Sample_period *period) {
+
+	if (_fill_slot < 0) {
+		return -1;
+	}
+	if (_period_offset + data_len + _PERIOD_TAIL_LEN + _BATCH_TAIL_LEN >
+			_batch_len_max) {
+		LOG_ERROR("Failed: payload too long\n");
+		/* Leave period out, keep the batch */
+		_tx_stats.dropped++;
+		if (_batch_count == 0) {
+			_slot_busy[_fill_slot] = 0;
+			_fill_slot = -1;
+		}
+		return -1;
+	}
+
+	char *buf = _slot(_fill_slot);
+	size_t n = _period_offset + data_len;
+
+#if (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_BIN)
+	_hello_tick();
+
+	uint8_t *head = (uint8_t *)buf + _period_offset -
+			SERIAL_DATA_BIN_PERIOD_HEADER_LEN;
+	size_t h = payload_put_u32(head, period->index);
+	h += payload_put_u16(head + h, error);
+	h += payload_put_u32(head + h, period->epoch);
+	h += payload_put_u32(head + h, period->start_s);
+	h += payload_put_u16(head + h, period->length_s);
+	h += payload_put_u8(head + h, period->partial);
+	h += payload_put_u16(head + h, (uint16_t)data_len);
+#elif (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_DELTA)
+	_hello_tick();
+
+	if (_batch_count == 0) {
+		memset(&_prev_period, 0, sizeof(_prev_period));
+		memset(_prev_delta, 0, sizeof(_prev_delta));
+		_prev_error = 0;
+	}
+	int32_t delta[5] = {
+		(int32_t)(period->index - _prev_period.index),
+		(int16_t)(error - _prev_error),
+		(int32_t)(period->epoch - _prev_period.epoch),
+		(int32_t)(period->start_s - _prev_period.start_s),
+		(int16_t)(period->length_s - _prev_period.length_s),
+	};
+	uint8_t *tail = (uint8_t *)buf + n;
+	size_t bit = 0;
+	for (uint8_t i = 0; i < 5; i++) {
+		/* Steady periods: difference doesn't change */
+		bit = payload_put_packed(tail, bit,
+				(int32_t)((uint32_t)delta[i] - (uint32_t)_prev_delta[i]));
+		/* First period's difference is its value, the second's is sent */
+		_prev_delta[i] = _batch_count ? delta[i] : 0;
+	}
+	bit = payload_put_packed(tail, bit, period->partial);
+	n += (bit + 7) / 8;
+	_prev_period = *period;
+	_prev_error = error;
+#else
+	buf[n++] = ',';
+	n += payload_json_key(buf + n, "", "error");
+	n += payload_utoa(buf + n, error);
+	buf[n++] = ',';
+	n += payload_json_key(buf + n, "", "epoch");
+	n += payload_utoa(buf + n, period->epoch);
+	buf[n++] = ',';
+	n += payload_json_key(buf + n, "", "period");
+	n += payload_utoa(buf + n, period->index);
+	buf[n++] = ',';
+	n += payload_json_key(buf + n, "", "period_start");
+	n += payload_utoa(buf + n, period->start_s);
+	buf[n++] = ',';
+	n += payload_json_key(buf + n, "", "period_len");
+	n += payload_utoa(buf + n, period->length_s);
+	buf[n++] = ',';
+	n += payload_json_key(buf + n, "", "partial");
+	n += payload_utoa(buf + n, period->partial);
+	buf[n++] = '}';
+#endif
 
-	/* Avoid '\n', because it triggers an interrupt on the receiving RPi */
-	//printf("%s\n", (uint8_t*)_payload_buf);
-	printf("%s", (uint8_t*)_payload_buf);
+	_fill_len = n;
+	_batch_count++;
+
+	/* Send, if complete or if the next period might not fit */
+	if (_batch_count >= SERIAL_DATA_BATCH_PERIODS ||
+			_fill_len + _period_len_max + _BATCH_TAIL_LEN > _batch_len_max) {
+		return _flush_batch(config);
+	}
 
 	return 0;
 }
+
+/* Complete batch (shared fields) and queue it. */
+static int8_t _flush_batch(uint16_t config) {
+	char *buf = _slot(_fill_slot);
+	size_t n = _fill_len;
+
+#if (SERIAL_DATA_ENCODING != SERIAL_DATA_ENCODING_JSON)
+	uint8_t *head = (uint8_t *)buf;
+	size_t h = payload_bin_frame_header(head, _BATCH_FRAME,
+			(uint16_t)(n - PAYLOAD_FRAME_HEADER_LEN));
+	h += payload_put_u16(head + h, _device_id);
+	h += payload_put_u16(head + h, config);
+	h += payload_put_u8(head + h, _batch_count);
+#else
+	buf[n++] = ']';
+	buf[n++] = ',';
+	n += payload_json_key(buf + n, "", "status");
+	n += payload_utoa(buf + n, config);
+	buf[n++] = '}';
+	buf[n++] = '\n';
+#endif
+
+	int8_t idx = _fill_slot;
+	_fill_slot = -1;
+	_slot_len[idx] = n;
+	return _queue(SERIAL_DATA_TX_MSG_SLOT, idx);
+}
+#elif (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_BIN)
+int8_t send_serial_data (size_t data_len, uint16_t config, uint16_t error,
+		const Sample_period *period) {
+
+	if (_fill_slot < 0) {
+		return -1;
+	}
+	if (data_len > _data_len_max) {
+		LOG_ERROR("Failed: payload too long\n");
+		/* Period is lost, as if no slot was free */
+		_tx_stats.dropped++;
+		_slot_busy[_fill_slot] = 0;
+		_fill_slot = -1;
+		return -1;
+	}
+
+	_hello_tick();
+
+	/* Fill in headers ahead of module data */
+	uint8_t *buf = (uint8_t *)_slot(_fill_slot);
+	size_t n = payload_bin_frame_header(buf, PAYLOAD_FRAME_DATA,
+			(uint16_t)(SERIAL_DATA_BIN_HEADER_LEN + data_len));
+	n += payload_put_u16(buf + n, _device_id);
+	n += payload_put_u16(buf + n, config);
+	n += payload_put_u16(buf + n, error);
+	n += payload_put_u32(buf + n, period->epoch);
+	n += payload_put_u32(buf + n, period->start_s);
+	n += payload_put_u16(buf + n, period->length_s);
+	n += payload_put_u8(buf + n, period->partial);
+	n += data_len;
+
+	int8_t idx = _fill_slot;
+	_fill_slot = -1;
+	_slot_len[idx] = n;
+	return _queue(SERIAL_DATA_TX_MSG_SLOT, idx);
+}
+#else
+/* Append tail behind module data. */
+int8_t send_serial_data (size_t data_len, uint16_t config, uint16_t error,
+		const Sample_period *period) {
+
+	if (_fill_slot < 0) {
+		return -1;
+	}
+	if (data_len > _data_len_max) {
+		LOG_ERROR("Failed: payload too long\n");
+		/* Period is lost, as if no slot was free */
+		_tx_stats.dropped++;
+		_slot_busy[_fill_slot] = 0;
+		_fill_slot = -1;
+		return -1;
+	}
+
+	char *buf = _slot(_fill_slot);
+	size_t n = _data_offset + data_len;
+	buf[n++] = ',';
+	n += payload_json_key(buf + n, "", "status");
+	n += payload_utoa(buf + n, config);
+	buf[n++] = ',';
+	n += payload_json_key(buf + n, "", "error");
+	n += payload_utoa(buf + n, error);
+	buf[n++] = ',';
+	n += payload_json_key(buf + n, "", "epoch");
+	n += payload_utoa(buf + n, period->epoch);
+	buf[n++] = ',';
+	n += payload_json_key(buf + n, "", "period_start");
+	n += payload_utoa(buf + n, period->start_s);
+	buf[n++] = ',';
+	n += payload_json_key(buf + n, "", "period_len");
+	n += payload_utoa(buf + n, period->length_s);
+	buf[n++] = ',';
+	n += payload_json_key(buf + n, "", "partial");
+	n += payload_utoa(buf + n, period->partial);
+	buf[n++] = '}';
+	buf[n++] = '\n';
+
+	int8_t idx = _fill_slot;
+	_fill_slot = -1;
+	_slot_len[idx] = n;
+	return _queue(SERIAL_DATA_TX_MSG_SLOT, idx);
+}
+#endif
+
+#if (SERIAL_DATA_ENCODING != SERIAL_DATA_ENCODING_JSON)
+/* Count periods, queue hello frame every SERIAL_DATA_HELLO_PERIODS. */
+static void _hello_tick(void) {
+	if (_hello_countdown == 0) {
+		if (_queue(SERIAL_DATA_TX_MSG_HELLO, 0) == 0) {
+			_hello_countdown = SERIAL_DATA_HELLO_PERIODS;
+		}
+	}
+	if (_hello_countdown) {
+		_hello_countdown--;
+	}
+}
+
+/* Render device id to hash mapping (hello frame). */
+static void _render_hello(void) {
+	size_t hash_len = strlen(_hash);
+	if (hash_len > UINT8_MAX) {
+		hash_len = UINT8_MAX;
+	}
+
+	size_t n = payload_bin_frame_header(_hello_buf, PAYLOAD_FRAME_HELLO,
+			(uint16_t)(3 + hash_len));
+	n += payload_put_u16(_hello_buf + n, _device_id);
+	n += payload_put_u8(_hello_buf + n, (uint8_t)hash_len);
+	memcpy(_hello_buf + n, _hash, hash_len);
+	_hello_len = n + hash_len;
+}
+#endif
+
+
+/* Helpers ********************************************************************/
+
+/* TX thread: write queued slots to UART, in order, and free them (framed
+ * link: once acknowledged). */
+static void *_tx_handler(void *arg) {
+	(void)arg;
+	msg_t msg;
+
+	msg_init_queue(_tx_queue, SERIAL_DATA_TX_QUEUE_SIZE);
+
+	while (1) {
+		msg_receive(&msg);
+
+#ifdef MODULE_SYS_CONFIG
+		if (msg.type == SYS_CONFIG_MSG_LINE) {
+			sys_config_parse(msg.content.value);
+			continue;
+		}
+#endif
+
+#if (SERIAL_DATA_LINK == SERIAL_DATA_LINK_FRAMED)
+		switch (msg.type) {
+		case SERIAL_LINK_MSG_ACK:
+			_win_ack((uint16_t)msg.content.value, 1);
+			continue;
+		case SERIAL_LINK_MSG_NAK:
+			_win_ack((uint16_t)msg.content.value, 0);
+			_win_retry();
+			continue;
+		case SERIAL_DATA_TX_MSG_TIMEOUT:
+			if (msg.content.value != _ack_timer_gen || _win_len == 0) {
+				continue;
+			}
+			_win_retry();
+			continue;
+		default:
+			break;
+		}
+#endif
+
+#if (SERIAL_DATA_ENCODING != SERIAL_DATA_ENCODING_JSON)
+		if (msg.type == SERIAL_DATA_TX_MSG_HELLO) {
+#if (SERIAL_DATA_LINK == SERIAL_DATA_LINK_FRAMED)
+			_tx_stats.bytes += serial_link_send(SERIAL_LINK_TYPE_UNSEQ, 0,
+					_hello_buf, _hello_len);
+#else
+			uart_write(SERIAL_DATA_UART_DEV, _hello_buf, _hello_len);
+			_tx_stats.bytes += _hello_len;
+#endif
+			continue;
+		}
+#endif
+
+		int8_t idx = (int8_t)msg.content.value;
+#if (SERIAL_DATA_LINK == SERIAL_DATA_LINK_FRAMED)
+		_win_send(idx);
+#else
+		size_t len;
+		const uint8_t *payload = _tx_payload(idx, &len);
+		uart_write(SERIAL_DATA_UART_DEV, payload, len);
+		_tx_stats.bytes += len;
+		_free_slot(idx, 1);
+#endif
+
+		DEBUG("tx: sent %lu, dropped %lu, bytes %lu\n",
+				(unsigned long)_tx_stats.sent,
+				(unsigned long)_tx_stats.dropped,
+				(unsigned long)_tx_stats.bytes);
+	}
+
+	return NULL;
+}
+
+#if (SERIAL_DATA_LINK == SERIAL_DATA_LINK_FRAMED)
+/* Send slot with the next sequence number, and keep it in the window. */
+static void _win_send(int8_t idx) {
+	if (_win_len == 0) {
+		/* Skip frame isn't resent with an empty window */
+		_win_skip();
+	}
+
+	/* Window holds all slots, so it can't be full here */
+	_win_idx[_win_len] = idx;
+	_win_seq[_win_len] = _next_seq++;
+	_win_len++;
+
+	size_t len;
+	const uint8_t *payload = _tx_payload(idx, &len);
+	_tx_stats.bytes += serial_link_send(SERIAL_LINK_TYPE_DATA,
+			_win_seq[_win_len - 1], payload, len);
+
+	if (_win_len == 1) {
+		_retries = 0;
+		_win_arm();
+	}
+}
+
+/* Free slots acknowledged by peer (cumulative).
+ *  p1: sequence number
+ *  p2: 1 to free slot of seq. too (ACK), 0 for only preceding ones (NAK)
+ */
+static void _win_ack(uint16_t seq, int8_t inclusive) {
+	/* Peer expects the oldest payload not given up, or a later one */
+	uint16_t base = _win_len ? _win_seq[0] : _next_seq;
+	if (_resync && (int16_t)(seq + (inclusive ? 1 : 0) - base) >= 0) {
+		_resync = 0;
+	}
+
+	uint8_t n = 0;
+	/* Serial arithmetic, seq. numbers wrap around */
+	while (n < _win_len &&
+			(int16_t)(seq - _win_seq[n]) >= (inclusive ? 0 : 1)) {
+		n++;
+	}
+	if (n == 0) {
+		/* Duplicate or stale */
+		return;
+	}
+
+	_win_pop(n, 1);
+}
+
+/* Remove oldest slots from window and free them.
+ *  p1: number of slots
+ *  p2: 1 if delivered, 0 if lost
+ */
+static void _win_pop(uint8_t n, int8_t is_sent) {
+	for (uint8_t i = 0; i < n; i++) {
+#ifdef MODULE_DATA_STORAGE
+		if (_slot_stored[_win_idx[i]]) {
+			/* Drained payloads are sent one at a time, in order */
+			if (is_sent) {
+				data_storage_pop();
+			}
+			_slot_stored[_win_idx[i]] = 0;
+		}
+#endif
+		_free_slot(_win_idx[i], is_sent);
+	}
+
+	_win_len -= n;
+	memmove(_win_idx, _win_idx + n, _win_len * sizeof(_win_idx[0]));
+	memmove(_win_seq, _win_seq + n, _win_len * sizeof(_win_seq[0]));
+
+	_retries = 0;
+	if (_win_len) {
+		_win_arm();
+	} else {
+		xtimer_remove(&_ack_timer);
+		_ack_timer_gen++;
+#ifdef MODULE_DATA_STORAGE
+		/* Link is up (window acked), forward a stored payload */
+		if (is_sent) {
+			_drain();
+		}
+#endif
+	}
+}
+
+/* Retransmission round (NAK or ACK timeout): after
+ * SERIAL_DATA_MAX_RETRIES rounds give up on the oldest payload, and send the
+ * window again.
+ */
+static void _win_retry(void) {
+	if (_win_len && ++_retries > SERIAL_DATA_MAX_RETRIES) {
+#ifdef MODULE_DATA_STORAGE
+		/* Keep it in flash till the link is back (drained payloads are
+		 * still there) */
+		int8_t idx = _win_idx[0];
+		if (!_slot_stored[idx]) {
+			data_storage_push((uint8_t *)_slot(idx), _slot_len[idx]);
+		}
+#endif
+		_tx_stats.lost++;
+		_win_pop(1, 0);
+		/* Its sequence number is never sent again */
+		_resync = 1;
+		LOG_WARNING("serial_data: payload lost\n");
+	}
+	_win_resend();
+}
+
+/* Send all unacknowledged slots again, oldest first (go-back-N). */
+static void _win_resend(void) {
+	_win_skip();
+	for (uint8_t i = 0; i < _win_len; i++) {
+		/* Compressed again, only one frame is kept */
+		size_t len;
+		const uint8_t *payload = _tx_payload(_win_idx[i], &len);
+		_tx_stats.bytes += serial_link_send(SERIAL_LINK_TYPE_DATA,
+				_win_seq[i], payload, len);
+		_tx_stats.retransmits++;
+	}
+	if (_win_len) {
+		_win_arm();
+	}
+}
+
+/* After payloads were given up, tell peer the oldest sequence number still
+ * to come, so it doesn't wait for the missing ones (SERIAL_LINK_TYPE_SKIP).
+ * Sent ahead of every (re)transmission, till peer acks it.
+ */
+static void _win_skip(void) {
+	if (!_resync) {
+		return;
+	}
+	uint16_t seq = _win_len ? _win_seq[0] : _next_seq;
+	_tx_stats.bytes += serial_link_send(SERIAL_LINK_TYPE_SKIP, seq, NULL, 0);
+}
+
+#ifdef MODULE_DATA_STORAGE
+/* Load the oldest stored payload into a free slot and send it. */
+static void _drain(void) {
+	if (!data_storage_pending()) {
+		return;
+	}
+
+	int8_t idx = _take_slot();
+	if (idx < 0) {
+		return;
+	}
+
+	int len = data_storage_peek((uint8_t *)_slot(idx), _payload_buf_len);
+	if (len <= 0) {
+		_slot_busy[idx] = 0;
+		return;
+	}
+
+	_count_queued();
+
+	_slot_len[idx] = len;
+	_slot_stored[idx] = 1;
+	_win_send(idx);
+}
+#endif
+
+/* (re)Start ACK timeout. */
+static void _win_arm(void) {
+	xtimer_remove(&_ack_timer);
+	_ack_timer_msg.type = SERIAL_DATA_TX_MSG_TIMEOUT;
+	_ack_timer_msg.content.value = ++_ack_timer_gen;
+	xtimer_set_msg(&_ack_timer, SERIAL_DATA_ACK_TIMEOUT_US, &_ack_timer_msg,
+			_tx_pid);
+}
+#endif
+
+/* Queue a slot (or hello) to TX thread, without blocking. */
+static int8_t _queue(uint16_t type, uint32_t value) {
+	msg_t msg;
+	msg.type = type;
+	msg.content.value = value;
+
+	if (msg_try_send(&msg, _tx_pid) != 1) {
+		/* Can't happen with queue > slots, but keep the slot usable */
+		if (type == SERIAL_DATA_TX_MSG_SLOT) {
+			_slot_busy[value] = 0;
+			_tx_stats.dropped++;
+		}
+		return -1;
+	}
+
+	if (type == SERIAL_DATA_TX_MSG_SLOT) {
+		_count_queued();
+	}
+
+	return 0;
+}
+
+/* Count a payload handed to TX (queued, or drained from storage). Every one
+ * leaves as sent or lost (_free_slot), so queued = sent + lost + depth. */
+static void _count_queued(void) {
+	unsigned state = irq_disable();
+	_tx_stats.queued++;
+	_tx_stats.depth++;
+	if (_tx_stats.depth > _tx_stats.max_depth) {
+		_tx_stats.max_depth = _tx_stats.depth;
+	}
+	irq_restore(state);
+}
+
+#if (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_JSON)
+/* Render constant head ({"hash":"<hash>","data":, batch:
+ * {"hash":"<hash>","periods":[) and set data offset. */
+static void _render_head(char *slot) {
+	size_t n = 0;
+	slot[n++] = '{';
+	n += payload_json_key(slot + n, "", "hash");
+	n += payload_json_str(slot + n, _hash);
+	slot[n++] = ',';
+#if (SERIAL_DATA_BATCH_PERIODS > 1)
+	n += payload_json_key(slot + n, "", "periods");
+	slot[n++] = '[';
+#else
+	n += payload_json_key(slot + n, "", "data");
+#endif
+	_data_offset = n;
+}
+#endif
+
+/* Get payload of slot as it goes on the link: compressed frame (if enabled
+ * and shorter), or slot itself.
+ *  p1: slot index
+ *  p2: pointer to where length will be written
+ * return:
+ *  payload start address
+ */
+static const uint8_t *_tx_payload(int8_t idx, size_t *len) {
+	const uint8_t *slot = (const uint8_t *)_slot(idx);
+	*len = _slot_len[idx];
+
+#if (SERIAL_DATA_LZ)
+	size_t head = PAYLOAD_FRAME_HEADER_LEN + 2;
+	if (_slot_len[idx] <= head || _slot_len[idx] > UINT16_MAX) {
+		return slot;
+	}
+	size_t lz_len = lzss_compress(slot, _slot_len[idx], _lz_buf + head,
+			_slot_len[idx] - head, SERIAL_DATA_LZ_WINDOW);
+	if (lz_len == 0) {
+		/* Incompressible, send as is */
+		return slot;
+	}
+
+	size_t n = payload_bin_frame_header(_lz_buf, PAYLOAD_FRAME_LZ,
+			(uint16_t)(2 + lz_len));
+	n += payload_put_u16(_lz_buf + n, (uint16_t)_slot_len[idx]);
+	*len = n + lz_len;
+	_tx_stats.lz_saved += _slot_len[idx] - *len;
+	return _lz_buf;
+#else
+	return slot;
+#endif
+}
+
+/* Take a free slot.
+ * return:
+ *  slot index, -1 if all are busy
+ */
+static int8_t _take_slot(void) {
+	int8_t idx = -1;
+
+	unsigned state = irq_disable();
+	for (int8_t i = 0; i < SERIAL_DATA_TX_SLOTS; i++) {
+		if (!_slot_busy[i]) {
+			_slot_busy[i] = 1;
+			idx = i;
+			break;
+		}
+	}
+	irq_restore(state);
+
+	return idx;
+}
+
+/* Release slot for filling, and update statistics.
+ *  p1: slot index
+ *  p2: 1 if payload was delivered
+ */
+static void _free_slot(int8_t idx, int8_t is_sent) {
+#if SERIAL_DATA_DIGEST
+	/* Only the TX thread writes it, hash outside of critical section */
+	if (is_sent) {
+		_tx_stats.digest = payload_fnv1a(_tx_stats.digest,
+				(const uint8_t *)_slot(idx), _slot_len[idx]);
+	}
+#endif
+	unsigned state = irq_disable();
+	_slot_busy[idx] = 0;
+	if (is_sent) {
+		_tx_stats.sent++;
+	}
+	_tx_stats.depth--;
+	irq_restore(state);
+}
+
+/* Get slot's start address. */
+static char *_slot(int8_t idx) {
+	return _payload_buf + idx * _payload_buf_len;
+}
@@ -1,34 +1,294 @@
 #ifndef SERIAL_SEND_DATA_H
 #define SERIAL_SEND_DATA_H
 
+#include "../sample_epoch/sample_epoch.h"
+#include "../payload/payload.h"
+
+#include "thread.h"
+
 #include <stdint.h>
 #include <stddef.h>		// size_t
 
-/* Determine payload length based on which modules you use */
-#define SERIAL_DATA_PAYLOAD_LEN		512
-#define SERIAL_DATA_OTHER_LEN		64
-#define SERIAL_DATA_BUF_LEN			\
-	SERIAL_DATA_PAYLOAD_LEN + SERIAL_DATA_OTHER_LEN
+#define SERIAL_DATA_BALAST_LEN		128
+
+/* Data link (dedicated UART to the gateway) */
+#define SERIAL_DATA_UART_DEV		UART_DEV(1)
+#define SERIAL_DATA_BAUDRATE		115200
+
+/* Background transmission: filled payload slots are queued to a low priority
+ * TX thread, so the serial thread returns right after assembling a payload.
+ *  With 2 slots, one can be transmitted while the next one is filled. When
+ * transmission falls behind, and no slot is free, period is dropped.
+ */
+#define SERIAL_DATA_TX_SLOTS		2
+#define SERIAL_DATA_TX_QUEUE_SIZE	8		/* Power of 2, > slots (+hello,
+											 * ACK/NAK, timeout, config) */
+#define SERIAL_DATA_TX_STACKSIZE	THREAD_STACKSIZE_DEFAULT
+#define SERIAL_DATA_TX_PRIO			(THREAD_PRIORITY_MAIN + 1)
+
+/* TX thread message types */
+#define SERIAL_DATA_TX_MSG_SLOT		0
+#define SERIAL_DATA_TX_MSG_HELLO	1
+#define SERIAL_DATA_TX_MSG_TIMEOUT	2
+
+/* Data link framing, selectable at build time
+ * (e.g. CFLAGS += -DSERIAL_DATA_LINK=SERIAL_DATA_LINK_FRAMED):
+ *  RAW: payloads written as they are
+ *  FRAMED: payloads in SLIP frames with sequence number and CRC
+ *   (serial_link/serial_link.h), acknowledged by the gateway. Unacknowledged
+ *   payloads stay in their slots (retransmit window), and are sent again
+ *   from the oldest one (go-back-N) on NAK or ACK timeout.
+ */
+#define SERIAL_DATA_LINK_RAW		0
+#define SERIAL_DATA_LINK_FRAMED		1
+
+#ifndef SERIAL_DATA_LINK
+#define SERIAL_DATA_LINK			SERIAL_DATA_LINK_RAW
+#endif
+
+/* Resend window after no ACK for n us, drop its oldest payload after n
+ * unsuccessful retransmissions, on NAK or timeout (keeps the link moving
+ * with a dead gateway). The gateway is then told to skip the dropped
+ * sequence numbers (SERIAL_LINK_TYPE_SKIP).
+ */
+#ifndef SERIAL_DATA_ACK_TIMEOUT_US
+#define SERIAL_DATA_ACK_TIMEOUT_US	(500U * 1000U)
+#endif
+#ifndef SERIAL_DATA_MAX_RETRIES
+#define SERIAL_DATA_MAX_RETRIES		3
+#endif
+
+/* Payload encoding, selectable at build time
+ * (e.g. CFLAGS += -DSERIAL_DATA_ENCODING=SERIAL_DATA_ENCODING_BIN):
+ *  JSON: human readable
+ *  BIN: fixed TLV schema (payload/payload.h)
+ *  DELTA: binary batches, values coded as differences to the previous
+ *   period (bit-packed), needs SERIAL_DATA_BATCH_PERIODS > 1
+ */
+#define SERIAL_DATA_ENCODING_JSON	0
+#define SERIAL_DATA_ENCODING_BIN	1
+#define SERIAL_DATA_ENCODING_DELTA	2
+
+#ifndef SERIAL_DATA_ENCODING
+#define SERIAL_DATA_ENCODING		SERIAL_DATA_ENCODING_JSON
+#endif
+
+/* Binary encoding sends the full hash only in a hello frame, data frames
+ * carry short device id. Repeat hello every n periods, so a restarted
+ * gateway learns the mapping.
+ */
+#define SERIAL_DATA_HELLO_PERIODS	60
 
-#define SERIAL_DATA_BALAST_LEN		64
+/* Binary data frame body, ahead of module records:
+ *  device id (u16), status (u16), error (u16), epoch (u32),
+ *  period start (u32), period length (u16), partial (u8)
+ */
+#define SERIAL_DATA_BIN_HEADER_LEN	17
 
-#define SERIAL_DATA_JSON_FORMAT		""\
-	"{"\
-		"\"hash\":\"%s\","\
-		"\"status\":%u,"\
-		"\"error\":%u,"\
-		"\"data\":%s"\
-	"}"\
-	"\n"
+/* Batching: collect n periods in one payload, with shared fields (hash,
+ * status) sent once, so the gateway is woken only once every n periods. A
+ * batch is sent early, if another period might not fit into
+ * SERIAL_DATA_BATCH_MAX_LEN bytes (0: no limit besides RAM). 1 disables
+ * batching (one payload per period, layouts above and below).
+ */
+#ifndef SERIAL_DATA_BATCH_PERIODS
+#define SERIAL_DATA_BATCH_PERIODS	1
+#endif
+#ifndef SERIAL_DATA_BATCH_MAX_LEN
+#define SERIAL_DATA_BATCH_MAX_LEN	0
+#endif
+
+/* Binary batch frame (PAYLOAD_FRAME_BATCH) body: device id (u16),
+ * status (u16), number of periods (u8), and for every period: index (u32),
+ * error (u16), epoch (u32), period start (u32), period length (u16),
+ * partial (u8), length of module records (u16), module records.
+ */
+#define SERIAL_DATA_BIN_BATCH_HEADER_LEN	5
+#define SERIAL_DATA_BIN_PERIOD_HEADER_LEN	19
+
+/* Delta batch frame (PAYLOAD_FRAME_DELTA) body: same header as binary batch,
+ * and for every period: module records (payload_delta_record(), the first
+ * period's with headers and terminated by module id 0), then index, error,
+ * epoch, period start and period length, as the change of their difference
+ * to the previous period (first period: value, second: difference), and
+ * partial, all packed (payload_put_packed()) and padded to a byte.
+ */
+#define SERIAL_DATA_DELTA_PERIOD_MAX_LEN	PAYLOAD_PACKED_MAX_LEN(6)
+
+#if (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_DELTA) && \
+		(SERIAL_DATA_BATCH_PERIODS < 2)
+#error "SERIAL_DATA_ENCODING_DELTA needs SERIAL_DATA_BATCH_PERIODS > 1"
+#endif
+
+/* Report-by-exception: a module field is only sent, if it moved past its
+ * dead-band (Payload_field) since it was last sent, or all of them every
+ * SERIAL_DATA_RBE_HEARTBEAT periods. Binary records carry a bitmap of
+ * present fields (PAYLOAD_RECORD_RBE), JSON records leave keys out. Records
+ * without a field to report are left out.
+ */
+#ifndef SERIAL_DATA_RBE
+#define SERIAL_DATA_RBE				0
+#endif
+#define SERIAL_DATA_RBE_HEARTBEAT	10
+
+#if SERIAL_DATA_RBE && (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_DELTA)
+#error "SERIAL_DATA_RBE needs a fixed record layout, not delta encoding"
+#endif
+
+/* LZ compression of payloads (lzss/lzss.h), done by the TX thread right
+ * before writing. Compressed payload goes in a frame of its own
+ * (PAYLOAD_FRAME_LZ), body: uncompressed length (u16), LZSS data. Payloads,
+ * which don't get shorter, are sent as they are. Window bounds CPU time.
+ */
+#ifndef SERIAL_DATA_LZ
+#define SERIAL_DATA_LZ				0
+#endif
+#define SERIAL_DATA_LZ_WINDOW		512
+
+/* Hash delivered payloads (FNV-1a, before compression and framing) into
+ * the TX statistics, to compare the output of runs (native replay).
+ */
+#ifndef SERIAL_DATA_DIGEST
+#define SERIAL_DATA_DIGEST			0
+#endif
+
+/* Time reference command, received as "T<Unix time [s]>\n" */
+#define SERIAL_DATA_TIME_SYNC_CMD	'T'
+
+/* JSON payload (data first, so that constant head is rendered only once and
+ * module data is written in place, right behind it):
+ *  {"hash":"<hash>","data":<module data>,"status":<u16>,"error":<u16>,
+ *   "epoch":<u32>,"period_start":<u32>,"period_len":<u16>,"partial":<u8>}\n
+ */
+#define SERIAL_DATA_JSON_HEAD_FORMAT_LEN	\
+	(sizeof("{\"hash\":\"\",\"data\":") - 1)
+#define SERIAL_DATA_JSON_TAIL_MAX_LEN	(									\
+	sizeof(",\"status\":,\"error\":,\"epoch\":,\"period_start\":,"		\
+		"\"period_len\":,\"partial\":}\n") - 1 +								\
+	5 + 5 + PAYLOAD_DIGITS_U32 + PAYLOAD_DIGITS_U32 + 5 + 3)
+/* Max. length w/o hash and module data, checked against
+ * SERIAL_DATA_BALAST_LEN at compile time.
+ */
+#define SERIAL_DATA_JSON_OVERHEAD_LEN	\
+	(SERIAL_DATA_JSON_HEAD_FORMAT_LEN + SERIAL_DATA_JSON_TAIL_MAX_LEN)
+
+/* JSON batch:
+ *  {"hash":"<hash>","periods":[{"data":<module data>,"error":<u16>,
+ *   "epoch":<u32>,"period":<u32>,"period_start":<u32>,"period_len":<u16>,
+ *   "partial":<u8>},...],
+ *   "status":<u16>}\n
+ */
+#define SERIAL_DATA_JSON_BATCH_HEAD_FORMAT_LEN	\
+	(sizeof("{\"hash\":\"\",\"periods\":[") - 1)
+#define SERIAL_DATA_JSON_PERIOD_HEAD_MAX_LEN	\
+	(sizeof(",{\"data\":") - 1)
+#define SERIAL_DATA_JSON_PERIOD_TAIL_MAX_LEN	(							\
+	sizeof(",\"error\":,\"epoch\":,\"period\":,\"period_start\":,"		\
+		"\"period_len\":,\"partial\":}") - 1 +								\
+	5 + PAYLOAD_DIGITS_U32 + PAYLOAD_DIGITS_U32 + PAYLOAD_DIGITS_U32 + 5 + 3)
+#define SERIAL_DATA_JSON_BATCH_TAIL_MAX_LEN	\
+	(sizeof("],\"status\":}\n") - 1 + 5)
 
 //#define DEVICE_HASH_LEN				32+1
 //#define DEVICE_HASH_BUF_LEN			32 + DEVICE_HASH_LEN
 //#define DEVICE_HASH_JSON_FORMAT     "\"hash\":\"%s\""
 
+/* Longest device hash buffer (e.g. DEVICE_HASH_LEN, incl. '\0') */
+#define SERIAL_DATA_HASH_MAX_LEN	(32 + 1)
+
+/* Per period overhead within a batch */
+#if (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_BIN)
+#define SERIAL_DATA_PERIOD_HEAD_LEN	SERIAL_DATA_BIN_PERIOD_HEADER_LEN
+#define SERIAL_DATA_PERIOD_TAIL_LEN	0
+#elif (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_DELTA)
+#define SERIAL_DATA_PERIOD_HEAD_LEN	0
+#define SERIAL_DATA_PERIOD_TAIL_LEN	SERIAL_DATA_DELTA_PERIOD_MAX_LEN
+#else
+#define SERIAL_DATA_PERIOD_HEAD_LEN	SERIAL_DATA_JSON_PERIOD_HEAD_MAX_LEN
+#define SERIAL_DATA_PERIOD_TAIL_LEN	SERIAL_DATA_JSON_PERIOD_TAIL_MAX_LEN
+#endif
+
+/* Payload slot length, for module data of given max. length */
+#if (SERIAL_DATA_BATCH_PERIODS > 1)
+#define SERIAL_DATA_SLOT_LEN(data_len)	(SERIAL_DATA_BATCH_PERIODS *	\
+	(SERIAL_DATA_PERIOD_HEAD_LEN + (data_len) +							\
+	SERIAL_DATA_PERIOD_TAIL_LEN) +										\
+	SERIAL_DATA_HASH_MAX_LEN + SERIAL_DATA_BALAST_LEN)
+#else
+#define SERIAL_DATA_SLOT_LEN(data_len)	\
+	((data_len) + SERIAL_DATA_HASH_MAX_LEN + SERIAL_DATA_BALAST_LEN)
+#endif
+
+/* Length of payload buffer, passed to init_serial_data(): all slots, and
+ * with LZ compression one more for the compressed frame. Sized at compile
+ * time (static), there is no heap.
+ */
+#define SERIAL_DATA_BUF_LEN(data_len)	\
+	((SERIAL_DATA_TX_SLOTS + (SERIAL_DATA_LZ ? 1 : 0)) *	\
+	SERIAL_DATA_SLOT_LEN(data_len))
+
+
+/* Transmission statistics. Each queued payload is sent, lost or still
+ * queued: queued = sent + lost + depth. */
+typedef struct {
+	uint32_t queued;				/* Payloads queued for TX (stored ones
+									 * drained included) */
+	uint32_t sent;					/* Payloads written to UART (acked) */
+	uint32_t dropped;				/* Periods lost: no free slot, or module
+									 * data too long */
+	uint32_t retransmits;			/* Frames sent again (framed link) */
+	uint32_t lost;					/* Never acked, retries exhausted */
+	uint32_t lz_saved;				/* Bytes saved by LZ compression */
+	uint32_t bytes;					/* Bytes written to UART (compressed,
+									 * framed, hello and resent included) */
+	uint32_t digest;				/* Hash of delivered payloads */
+	uint8_t depth;					/* Payloads currently queued */
+	uint8_t max_depth;				/* Max. queued payloads */
+} Serial_data_tx_stats;
+
+
+/* Init payload slots (with pre-rendered head), data link and TX thread.
+ *  p1: payload buffer, SERIAL_DATA_BUF_LEN(p3) long (must outlive module)
+ *  p2: payload buffer length
+ *  p3: max. length of module data
+ *  p4: device hash (must outlive the module, e.g. DEVICE_HASH)
+ *  p5: device hash buffer length, at most SERIAL_DATA_HASH_MAX_LEN
+ * return:
+ *  0 on success, -1 on error
+ */
+int8_t init_serial_data (char *buf, size_t buf_len, size_t data_buf_len,
+		char *hash, size_t hash_len);
+
+/* Take a free payload slot (batching: keep filling the current one), and get
+ * its slice for module data (written in place).
+ *  p1: pointer to where the slice length will be written
+ * return:
+ *  slice start address, NULL if all slots are queued (period is dropped)
+ */
+char *get_serial_data_buf (size_t *len);
+
+/* Get number of periods already in the batch being filled (0 when the next
+ * period starts a new batch, always 0 w/o batching).
+ */
+uint8_t get_serial_data_batch_periods (void);
 
-int8_t init_serial_data (size_t data_buf_len, char *hash, size_t hash_len);
+/* Copy transmission statistics.
+ *  p1: pointer to where statistics will be written
+ */
+void get_serial_data_tx_stats (Serial_data_tx_stats *stats);
 
-int8_t send_serial_data (char *data_buff, uint16_t config, uint16_t error);
+/* Complete payload around module data (already in its slice) and queue it
+ * for transmission on data link (batching: once the batch is complete).
+ * Returns without waiting for UART.
+ *  p1: module data length, encoded as selected by SERIAL_DATA_ENCODING
+ *  p2: system configuration
+ *  p3: system errors
+ *  p4: period the data belongs to
+ * return:
+ *  0 on success, -1 on error
+ */
+int8_t send_serial_data (size_t data_len, uint16_t config, uint16_t error,
+		const Sample_period *period);
 
 
 
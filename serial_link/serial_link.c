@@ -0,0 +1,179 @@
+#include "serial_link.h"
+
+#include "msg.h"
+#include "checksum/crc16_ccitt.h"
+
+#include <stdint.h>
+#include <stddef.h>		// size_t
+
+#ifndef ENABLE_DEBUG
+#define ENABLE_DEBUG (0)
+#endif
+#include "debug.h"
+
+
+static uart_t _dev;
+static kernel_pid_t _pid = KERNEL_PID_UNDEF;
+
+/* RX state (ISR only) */
+static uint8_t _rx_buf[SERIAL_LINK_RX_BUF_LEN];
+static uint8_t _rx_len;
+static int8_t _rx_in_frame;
+static int8_t _rx_esc;
+
+/* TX encoding chunk (caller's context) */
+typedef struct {
+	uint8_t buf[SERIAL_LINK_TX_CHUNK_LEN];
+	size_t len;
+	size_t written;					/* Bytes written to UART so far */
+} Tx_chunk;
+
+static void _put_escaped (Tx_chunk *chunk, const uint8_t *data, size_t len);
+static void _put_raw (Tx_chunk *chunk, uint8_t byte);
+static void _flush (Tx_chunk *chunk);
+static void _rx_frame (void);
+
+
+/* Functions ******************************************************************/
+
+void serial_link_init (uart_t dev, kernel_pid_t pid) {
+	_dev = dev;
+	_pid = pid;
+	_rx_len = 0;
+	_rx_in_frame = 0;
+	_rx_esc = 0;
+}
+
+size_t serial_link_send (uint8_t type, uint16_t seq, const uint8_t *buf,
+		size_t len) {
+
+	Tx_chunk chunk;
+	chunk.len = 0;
+	chunk.written = 0;
+
+	uint8_t head[3] = { type, (uint8_t)seq, (uint8_t)(seq >> 8) };
+	uint16_t crc = crc16_ccitt_calc(head, sizeof(head));
+	crc = crc16_ccitt_update(crc, buf, len);
+	uint8_t tail[2] = { (uint8_t)crc, (uint8_t)(crc >> 8) };
+
+	/* Leading END flushes any line noise on the peer's side */
+	_put_raw(&chunk, SERIAL_LINK_SLIP_END);
+	_put_escaped(&chunk, head, sizeof(head));
+	_put_escaped(&chunk, buf, len);
+	_put_escaped(&chunk, tail, sizeof(tail));
+	_put_raw(&chunk, SERIAL_LINK_SLIP_END);
+	_flush(&chunk);
+	return chunk.written;
+}
+
+int8_t serial_link_rx (uint8_t data) {
+
+	if (data == SERIAL_LINK_SLIP_END) {
+		/* Closes a frame, and opens the next one. Empty frames (END END)
+		 * are ignored, so peer may send END on either end or both. */
+		if (_rx_in_frame && _rx_len > 0) {
+			_rx_frame();
+		}
+		_rx_in_frame = 1;
+		_rx_len = 0;
+		_rx_esc = 0;
+		return 1;
+	}
+
+	if (!_rx_in_frame) {
+		return 0;
+	}
+	if (_rx_len == 0 && data != SERIAL_LINK_TYPE_ACK &&
+			data != SERIAL_LINK_TYPE_NAK) {
+		/* Not a frame from peer, but e.g. a text line (time reference)
+		 * between frames: leave it to other parsers till the next END */
+		_rx_in_frame = 0;
+		return 0;
+	}
+
+	if (data == SERIAL_LINK_SLIP_ESC) {
+		_rx_esc = 1;
+		return 1;
+	}
+	if (_rx_esc) {
+		data = (data == SERIAL_LINK_SLIP_ESC_END) ?
+				SERIAL_LINK_SLIP_END : SERIAL_LINK_SLIP_ESC;
+		_rx_esc = 0;
+	}
+
+	if (_rx_len < SERIAL_LINK_RX_BUF_LEN) {
+		_rx_buf[_rx_len++] = data;
+	} else {
+		/* Too long for ACK/NAK, drop frame */
+		_rx_in_frame = 0;
+		_rx_len = 0;
+	}
+
+	return 1;
+}
+
+
+/* Helpers ********************************************************************/
+
+/* Validate received frame and pass ACK/NAK to the registered thread. */
+static void _rx_frame (void) {
+	if (_rx_len != SERIAL_LINK_OVERHEAD_LEN || _pid == KERNEL_PID_UNDEF) {
+		return;
+	}
+
+	uint16_t crc = crc16_ccitt_calc(_rx_buf, _rx_len - 2);
+	if (crc != (uint16_t)(_rx_buf[_rx_len - 2] | _rx_buf[_rx_len - 1] << 8)) {
+		DEBUG("serial_link: CRC mismatch\n");
+		return;
+	}
+
+	msg_t msg;
+	msg.content.value = (uint16_t)(_rx_buf[1] | _rx_buf[2] << 8);
+	switch (_rx_buf[0]) {
+	case SERIAL_LINK_TYPE_ACK:
+		msg.type = SERIAL_LINK_MSG_ACK;
+		break;
+	case SERIAL_LINK_TYPE_NAK:
+		msg.type = SERIAL_LINK_MSG_NAK;
+		break;
+	default:
+		return;
+	}
+
+	/* Non-blocking in ISR, message is lost if the queue is full (the peer
+	 * resends ACK/NAK, or TX times out and retransmits) */
+	msg_send(&msg, _pid);
+}
+
+static void _put_escaped (Tx_chunk *chunk, const uint8_t *data, size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		switch (data[i]) {
+		case SERIAL_LINK_SLIP_END:
+			_put_raw(chunk, SERIAL_LINK_SLIP_ESC);
+			_put_raw(chunk, SERIAL_LINK_SLIP_ESC_END);
+			break;
+		case SERIAL_LINK_SLIP_ESC:
+			_put_raw(chunk, SERIAL_LINK_SLIP_ESC);
+			_put_raw(chunk, SERIAL_LINK_SLIP_ESC_ESC);
+			break;
+		default:
+			_put_raw(chunk, data[i]);
+			break;
+		}
+	}
+}
+
+static void _put_raw (Tx_chunk *chunk, uint8_t byte) {
+	chunk->buf[chunk->len++] = byte;
+	if (chunk->len == sizeof(chunk->buf)) {
+		_flush(chunk);
+	}
+}
+
+static void _flush (Tx_chunk *chunk) {
+	if (chunk->len) {
+		uart_write(_dev, chunk->buf, chunk->len);
+		chunk->written += chunk->len;
+		chunk->len = 0;
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef SERIAL_LINK_H
+#define SERIAL_LINK_H
+
+#include "thread.h"
+#include "periph/uart.h"
+
+#include <stdint.h>
+#include <stddef.h>		// size_t
+
+
+/* Framed serial link.
+ *  Frame: SLIP (RFC 1055) encoded type (u8), sequence number (u16), payload
+ * and CRC-16-CCITT (u16) of all preceding bytes. Multi-byte values are
+ * little-endian. Frames start and end with SLIP END.
+ *  Data frames carry an increasing sequence number. The peer answers with
+ * ACK (cumulative, all up to seq. received) or NAK (resend from seq.).
+ *  Peer keeps the next expected seq. A data frame with it is delivered and
+ * acked, an older one is a duplicate (acked again, not delivered), a newer
+ * one means frames went missing (NAK of the expected seq.). After giving up
+ * on frames, the sender sends SKIP with the oldest seq. still to come: if
+ * it is ahead of the expected one, peer counts the frames in between as
+ * lost, expects it, and acks the one before. SKIP is repeated ahead of
+ * every (re)transmission till then.
+ */
+
+/* SLIP special characters */
+#define SERIAL_LINK_SLIP_END			0xC0
+#define SERIAL_LINK_SLIP_ESC			0xDB
+#define SERIAL_LINK_SLIP_ESC_END		0xDC
+#define SERIAL_LINK_SLIP_ESC_ESC		0xDD
+
+/* Frame types */
+#define SERIAL_LINK_TYPE_DATA			'D'		/* Sequenced, acknowledged */
+#define SERIAL_LINK_TYPE_UNSEQ			'U'		/* Not acknowledged */
+#define SERIAL_LINK_TYPE_SKIP			'S'		/* Continue from seq., no payload */
+#define SERIAL_LINK_TYPE_ACK			'A'		/* From peer */
+#define SERIAL_LINK_TYPE_NAK			'N'		/* From peer */
+
+/* Type, sequence number and CRC */
+#define SERIAL_LINK_OVERHEAD_LEN		5
+
+/* Longest frame received from peer (ACK/NAK w/o payload) */
+#define SERIAL_LINK_RX_BUF_LEN			8
+
+/* Messages posted to the registered thread on ACK/NAK (content: seq.) */
+#define SERIAL_LINK_MSG_ACK				(0x5301)
+#define SERIAL_LINK_MSG_NAK				(0x5302)
+
+/* Encoding chunk, written to UART at once (on stack of sending thread) */
+#define SERIAL_LINK_TX_CHUNK_LEN		32
+
+
+/* Init link.
+ *  p1: UART device (already initiated)
+ *  p2: thread, which receives ACK/NAK messages
+ */
+void serial_link_init (uart_t dev, kernel_pid_t pid);
+
+/* Encode and write a frame (blocks the calling thread till written).
+ *  p1: frame type (SERIAL_LINK_TYPE_*)
+ *  p2: sequence number
+ *  p3: payload
+ *  p4: payload length
+ * return:
+ *  bytes written to UART (SLIP encoded frame)
+ */
+size_t serial_link_send (uint8_t type, uint16_t seq, const uint8_t *buf,
+		size_t len);
+
+/* Feed a received byte (call from UART RX callback).
+ * return:
+ *  1 if byte belongs to a frame, 0 otherwise (free for other parsers)
+ */
+int8_t serial_link_rx (uint8_t data);
+
+
+#endif
@@ -0,0 +1,251 @@
+#include "sim_clock.h"
+
+#include "thread.h"
+#include "irq.h"
+#include "timex.h"
+#include "sched.h"
+#include "periph/timer.h"
+#include "periph/pm.h"
+#include "native_internal.h"
+
+#include <log.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>			// getenv, EXIT_*
+#include <string.h>
+#include <time.h>			// clock_gettime
+
+#ifndef ENABLE_DEBUG
+#define ENABLE_DEBUG (0)
+#endif
+#include "debug.h"
+
+
+static char _stack[THREAD_STACKSIZE_DEFAULT];
+static kernel_pid_t _pid = KERNEL_PID_UNDEF;
+static Sim_clock_stop_cb _stop_cb;
+
+/* Virtual time, and the timer's (single) channel */
+static uint64_t _now_us;
+static uint64_t _target_us;
+static uint8_t _armed;
+static uint8_t _running = 1;
+static timer_cb_t _cb;
+static void *_cb_arg;
+
+/* Real time at start, virtual time of the next report */
+static uint64_t _real_start_us;
+static uint64_t _report_us;
+
+
+/* Prototypes *****************************************************************/
+static void *_clock_thread (void *arg);
+static void _arm (uint64_t target_us);
+static void _report (void);
+static uint64_t _real_us (void);
+static void _stop (void);
+
+
+/* Functions ******************************************************************/
+
+/* Start the clock thread. */
+int8_t init_sim_clock (Sim_clock_stop_cb stop_cb) {
+	_stop_cb = stop_cb;
+	_real_start_us = _real_us();
+	_report_us = (uint64_t)SIM_CLOCK_REPORT_S * US_PER_SEC;
+
+	_pid = thread_create(
+			_stack,
+			sizeof(_stack),
+			THREAD_PRIORITY_IDLE - 1,
+			0,
+			_clock_thread, NULL,
+			"th_sim_clock");
+	if (_pid <= KERNEL_PID_UNDEF) {
+		LOG_ERROR("Failed: thread_create\n");
+		return -1;
+	}
+	return 0;
+}
+
+/* Get virtual time since start. */
+uint64_t sim_clock_now_us (void) {
+	return _now_us;
+}
+
+/* Get real (host) monotonic time. */
+uint64_t sim_clock_real_ns (void) {
+	struct timespec ts;
+	_native_syscall_enter();
+	real_clock_gettime(CLOCK_MONOTONIC, &ts);
+	_native_syscall_leave();
+	return (uint64_t)ts.tv_sec * US_PER_SEC * NS_PER_US + ts.tv_nsec;
+}
+
+/* Compare run summary against the golden file, or record it. */
+int8_t sim_clock_check_golden (const char *summary) {
+	const char *path = getenv("SIM_GOLDEN");
+	if (path == NULL || *path == '\0') {
+		return 0;
+	}
+
+	char golden[SIM_CLOCK_GOLDEN_MAX_LEN + 1];
+	size_t len = 0;
+	size_t summary_len = strlen(summary);
+
+	_native_syscall_enter();
+	FILE *f = real_fopen(path, "r");
+	if (f != NULL) {
+		len = real_fread(golden, 1, SIM_CLOCK_GOLDEN_MAX_LEN, f);
+		real_fclose(f);
+	}
+	else if ((f = real_fopen(path, "w")) != NULL) {
+		len = real_fwrite(summary, 1, summary_len, f);
+		real_fclose(f);
+		_native_syscall_leave();
+		printf("golden: recorded %s\n", path);
+		return (len == summary_len) ? 0 : -1;
+	}
+	_native_syscall_leave();
+
+	if (f == NULL) {
+		LOG_ERROR("Failed: open golden file\n");
+		return -1;
+	}
+	if (len != summary_len || memcmp(golden, summary, len) != 0) {
+		golden[len] = '\0';
+		printf("golden: MISMATCH, expected:\n%s", golden);
+		return -1;
+	}
+	printf("golden: match\n");
+	return 0;
+}
+
+
+/* Timer (periph/timer.h), one 32 bit channel at SIM_CLOCK_FREQ ***************/
+
+int timer_init (tim_t dev, unsigned long freq, timer_cb_t cb, void *arg) {
+	if (dev != TIMER_DEV(0) || freq != SIM_CLOCK_FREQ) {
+		return -1;
+	}
+	_cb = cb;
+	_cb_arg = arg;
+	_armed = 0;
+	_running = 1;
+	return 0;
+}
+
+int timer_set (tim_t dev, int channel, unsigned int timeout) {
+	if (dev != TIMER_DEV(0) || channel != 0) {
+		return -1;
+	}
+	_arm(_now_us + timeout);
+	return 0;
+}
+
+int timer_set_absolute (tim_t dev, int channel, unsigned int value) {
+	if (dev != TIMER_DEV(0) || channel != 0) {
+		return -1;
+	}
+	/* Next time the 32 bit counter reaches value */
+	_arm(_now_us + (uint32_t)(value - (uint32_t)_now_us));
+	return 0;
+}
+
+int timer_clear (tim_t dev, int channel) {
+	if (dev != TIMER_DEV(0) || channel != 0) {
+		return -1;
+	}
+	_armed = 0;
+	return 0;
+}
+
+unsigned int timer_read (tim_t dev) {
+	(void)dev;
+	_now_us += SIM_CLOCK_READ_US;
+	return (unsigned int)_now_us;
+}
+
+void timer_start (tim_t dev) {
+	(void)dev;
+	_running = 1;
+	thread_wakeup(_pid);
+}
+
+void timer_stop (tim_t dev) {
+	(void)dev;
+	_running = 0;
+}
+
+
+/* Helpers ********************************************************************/
+
+/* Runs only when all other threads are blocked. */
+static void *_clock_thread (void *arg) {
+	(void)arg;
+
+	while (1) {
+		unsigned state = irq_disable();
+		if (!_armed || !_running) {
+			irq_restore(state);
+			thread_sleep();
+			continue;
+		}
+
+		if (_target_us > _now_us) {
+			_now_us = _target_us;
+		}
+		_armed = 0;
+
+		/* Call back as from the timer ISR */
+		_native_in_isr = 1;
+		_cb(_cb_arg, 0);
+		_native_in_isr = 0;
+		irq_restore(state);
+
+		if (_now_us >= _report_us) {
+			_report();
+			_report_us = (_now_us / (SIM_CLOCK_REPORT_S * US_PER_SEC) + 1)
+					* SIM_CLOCK_REPORT_S * US_PER_SEC;
+		}
+		if (SIM_CLOCK_STOP_S &&
+				_now_us >= (uint64_t)SIM_CLOCK_STOP_S * US_PER_SEC) {
+			_stop();
+		}
+
+		if (sched_context_switch_request) {
+			thread_yield_higher();
+		}
+	}
+
+	return NULL;
+}
+
+static void _arm (uint64_t target_us) {
+	_target_us = target_us;
+	_armed = 1;
+	thread_wakeup(_pid);
+}
+
+static void _report (void) {
+	uint64_t real_us = _real_us() - _real_start_us;
+	uint32_t speedup = real_us ? (uint32_t)(_now_us / real_us) : 0;
+	printf("sim_clock: %lu s in %lu ms, speed-up %lux\n",
+			(unsigned long)(_now_us / US_PER_SEC),
+			(unsigned long)(real_us / 1000),
+			(unsigned long)speedup);
+}
+
+static uint64_t _real_us (void) {
+	return sim_clock_real_ns() / NS_PER_US;
+}
+
+/* Report and exit, with status of the stop callback. */
+static void _stop (void) {
+	int8_t res = (_stop_cb != NULL) ? _stop_cb() : 0;
+	_report();
+	if (res != 0) {
+		real_exit(EXIT_FAILURE);
+	}
+	pm_off();
+}
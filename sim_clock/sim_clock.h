@@ -0,0 +1,66 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+#include <stdint.h>
+
+
+/* Virtual clock for the native board (replaces periph_timer, which xtimer
+ * runs on).
+ *  Time only advances while all other threads are blocked: a thread at the
+ * lowest priority (above idle) jumps to the next timer target and calls the
+ * timer callback, as the timer ISR would. Computation takes no virtual time,
+ * besides SIM_CLOCK_READ_US per timer read (so busy waits end). Scheduling
+ * depends on virtual time only, so runs are reproducible.
+ */
+
+/* Stop after this much virtual time [s], 0 to run forever */
+#ifndef SIM_CLOCK_STOP_S
+#define SIM_CLOCK_STOP_S				(24UL * 3600)
+#endif
+/* Print speed-up every this much virtual time [s] */
+#ifndef SIM_CLOCK_REPORT_S
+#define SIM_CLOCK_REPORT_S				3600
+#endif
+/* Virtual time a timer read takes [us] */
+#ifndef SIM_CLOCK_READ_US
+#define SIM_CLOCK_READ_US				1
+#endif
+
+#define SIM_CLOCK_FREQ					1000000UL
+
+
+/* Max. length of a golden summary */
+#define SIM_CLOCK_GOLDEN_MAX_LEN		256
+
+
+/* Called once, when virtual time reaches SIM_CLOCK_STOP_S, before exit.
+ * return:
+ *  0 on success, -1 on failure (exit status 1)
+ */
+typedef int8_t (*Sim_clock_stop_cb)(void);
+
+
+/* Start the clock thread.
+ *  p1: callback run before exit (e.g. print summary), or NULL
+ * return:
+ *  0 on success, -1 on error
+ */
+int8_t init_sim_clock (Sim_clock_stop_cb stop_cb);
+
+/* Get virtual time since start [us]. */
+uint64_t sim_clock_now_us (void);
+
+/* Get real (host) monotonic time [ns]. */
+uint64_t sim_clock_real_ns (void);
+
+/* Compare run summary against the golden file named by the SIM_GOLDEN
+ * environment variable. If the file doesn't exist yet, summary is written
+ * to it instead (recording a golden run).
+ *  p1: summary (deterministic results only, no real time)
+ * return:
+ *  0 on match (or recorded, or SIM_GOLDEN not set), -1 on mismatch or error
+ */
+int8_t sim_clock_check_golden (const char *summary);
+
+
+#endif
@@ -0,0 +1,297 @@
+#include "sys_config.h"
+#include "../sys_control.h"
+#include "../payload/payload.h"
+
+#include "log.h"
+#include "irq.h"
+#include "msg.h"
+
+#include <stdint.h>
+#include <stddef.h>			// offsetof
+#include <stdlib.h>			// strtoul
+#include <string.h>
+
+#ifndef ENABLE_DEBUG
+#define ENABLE_DEBUG (0)
+#endif
+#include "debug.h"
+
+
+_Static_assert((SYS_CONFIG_LINES & (SYS_CONFIG_LINES - 1)) == 0,
+		"Number of config lines must be a power of 2");
+
+/* Configuration in effect, and the one to take over at period boundary */
+static Sys_config _active;
+static Sys_config _pending;
+static int8_t _is_pending;
+
+/* Line ring: the ISR fills line _head, the thread parses from _tail */
+static char _lines[SYS_CONFIG_LINES][SYS_CONFIG_LINE_LEN];
+static uint8_t _head;
+static volatile uint8_t _tail;
+static int8_t _rx_pos = -1;				/* -1: not in a command */
+static kernel_pid_t _pid = KERNEL_PID_UNDEF;
+
+#ifdef MODULE_PERIPH_FLASHPAGE
+_Static_assert(sizeof(Sys_config) <= FLASHPAGE_SIZE,
+		"Config doesn't fit into a flash page");
+
+/* Page image, written as a whole */
+static uint32_t _page[FLASHPAGE_SIZE / sizeof(uint32_t)];
+#endif
+
+
+/* Prototypes *****************************************************************/
+static void _defaults (Sys_config *config);
+#ifdef MODULE_PERIPH_FLASHPAGE
+static uint32_t _check (const Sys_config *config);
+static int8_t _is_valid (const Sys_config *config);
+#endif
+static int8_t _save (const Sys_config *config);
+static int8_t _parse_values (const char *pos, uint32_t *values, uint8_t numof);
+static int8_t _id_bit (uint32_t id);
+
+
+/* Functions ******************************************************************/
+
+/* Load persisted configuration. */
+int8_t init_sys_config(void) {
+	int8_t res = -1;
+
+#ifdef MODULE_PERIPH_FLASHPAGE
+	const Sys_config *stored = flashpage_addr(SYS_CONFIG_FLASHPAGE);
+	if (_is_valid(stored)) {
+		_active = *stored;
+		res = 0;
+	}
+#endif
+	if (res != 0) {
+		_defaults(&_active);
+	}
+
+	_pending = _active;
+	_is_pending = 0;
+	return res;
+}
+
+void sys_config_listen(kernel_pid_t pid) {
+	_pid = pid;
+}
+
+/* Collect command line in the line ring, post it once complete. */
+int8_t sys_config_rx(uint8_t data) {
+	char *line = _lines[_head % SYS_CONFIG_LINES];
+
+	if (_rx_pos < 0) {
+		if (data != SYS_CONFIG_CMD) {
+			return 0;
+		}
+		/* No free line: command is dropped */
+		_rx_pos = ((uint8_t)(_head - _tail) < SYS_CONFIG_LINES) ? 0 :
+				SYS_CONFIG_LINE_LEN;
+		return 1;
+	}
+
+	if (data == '\n') {
+		if (_rx_pos < SYS_CONFIG_LINE_LEN && _pid != KERNEL_PID_UNDEF) {
+			line[_rx_pos] = '\0';
+			msg_t msg;
+			msg.type = SYS_CONFIG_MSG_LINE;
+			msg.content.value = _head;
+			if (msg_try_send(&msg, _pid) == 1) {
+				_head++;
+			}
+		}
+		_rx_pos = -1;
+		return 1;
+	}
+
+	/* Keep space for '\0', overlong lines are dropped */
+	if (_rx_pos < SYS_CONFIG_LINE_LEN - 1) {
+		line[_rx_pos++] = (char)data;
+	} else {
+		_rx_pos = SYS_CONFIG_LINE_LEN;
+	}
+	return 1;
+}
+
+/* Parse line where it was received, update pending configuration. */
+void sys_config_parse(uint32_t line) {
+	const char *pos = _lines[line % SYS_CONFIG_LINES];
+	uint32_t val[2];
+	int8_t numof = _parse_values(pos + 1, val, 2);
+
+	unsigned state = irq_disable();
+	Sys_config config = _pending;
+	irq_restore(state);
+
+	int8_t is_valid = 0;
+	switch (*pos) {
+	case SYS_CONFIG_KEY_PERIOD:
+		if (numof == 1 && val[0] >= 1 && val[0] <= SYS_CONFIG_PERIOD_MIN_MAX) {
+			config.period_min = (uint16_t)val[0];
+			is_valid = 1;
+		}
+		break;
+	case SYS_CONFIG_KEY_RATE:
+		if (numof == 2 && _id_bit(val[0]) >= 0 && val[1] <= UINT8_MAX) {
+			config.ticks_per_sample[_id_bit(val[0])] = (uint8_t)val[1];
+			is_valid = 1;
+		}
+		break;
+	case SYS_CONFIG_KEY_NORTH:
+		if (numof == 2 && val[0] < SYS_CONFIG_INSTANCES_MAX &&
+				(val[1] < 3600 || val[1] == SYS_CONFIG_UNSET)) {
+			config.north_offset_10e1[val[0]] = (uint16_t)val[1];
+			is_valid = 1;
+		}
+		break;
+	case SYS_CONFIG_KEY_ENABLE:
+		if (numof == 1 && val[0] <= UINT8_MAX) {
+			config.enabled = (uint8_t)val[0];
+			is_valid = 1;
+		}
+		break;
+	case SYS_CONFIG_KEY_DEFAULTS:
+		if (numof == 0) {
+			_defaults(&config);
+			is_valid = 1;
+		}
+		break;
+	default:
+		break;
+	}
+
+	/* Line is free again */
+	_tail++;
+
+	if (!is_valid) {
+		LOG_WARNING("sys_config: invalid command\n");
+		return;
+	}
+
+	state = irq_disable();
+	_pending = config;
+	_is_pending = 1;
+	irq_restore(state);
+
+	if (_save(&config) != 0) {
+		LOG_ERROR("Failed: _save\n");
+	}
+	LOG_INFO("sys_config: set, from next period\n");
+}
+
+/* Take over pending configuration. */
+int8_t sys_config_apply(void) {
+	int8_t is_changed = 0;
+
+	unsigned state = irq_disable();
+	if (_is_pending) {
+		_active = _pending;
+		_is_pending = 0;
+		is_changed = 1;
+	}
+	irq_restore(state);
+
+	return is_changed;
+}
+
+const Sys_config *sys_config_get(void) {
+	return &_active;
+}
+
+int8_t sys_config_is_enabled(uint16_t mask) {
+	return (_active.enabled & (uint8_t)(mask >> 8)) != 0;
+}
+
+uint8_t sys_config_ticks_per_sample(uint16_t mask, uint8_t ticks_default) {
+	int8_t bit = _id_bit(mask >> 8);
+	if (bit < 0 || _active.ticks_per_sample[bit] == 0) {
+		return ticks_default;
+	}
+	return _active.ticks_per_sample[bit];
+}
+
+
+/* Helpers ********************************************************************/
+
+/* Settings of sys_control.h and the module table. */
+static void _defaults (Sys_config *config) {
+	memset(config, 0, sizeof(*config));
+	config->magic = SYS_CONFIG_MAGIC;
+	config->version = SYS_CONFIG_VERSION;
+	config->period_min = DATA_SEND_PERIOD_MIN;
+	config->enabled = UINT8_MAX;
+	for (uint8_t i = 0; i < SYS_CONFIG_INSTANCES_MAX; i++) {
+		config->north_offset_10e1[i] = SYS_CONFIG_UNSET;
+	}
+}
+
+#ifdef MODULE_PERIPH_FLASHPAGE
+/* Stored configurations only */
+static uint32_t _check (const Sys_config *config) {
+	return payload_fnv1a(PAYLOAD_FNV1A_INIT, (const uint8_t *)config,
+			offsetof(Sys_config, check));
+}
+
+static int8_t _is_valid (const Sys_config *config) {
+	return config->magic == SYS_CONFIG_MAGIC &&
+			config->version == SYS_CONFIG_VERSION &&
+			config->check == _check(config) &&
+			config->period_min >= 1 &&
+			config->period_min <= SYS_CONFIG_PERIOD_MIN_MAX;
+}
+#endif
+
+/* Write configuration to its flash page (only if it changed). */
+static int8_t _save (const Sys_config *config) {
+#ifdef MODULE_PERIPH_FLASHPAGE
+	Sys_config stored = *config;
+	stored.check = _check(&stored);
+
+	if (memcmp(flashpage_addr(SYS_CONFIG_FLASHPAGE), &stored,
+			sizeof(stored)) == 0) {
+		return 0;
+	}
+
+	memset(_page, 0xFF, sizeof(_page));
+	memcpy(_page, &stored, sizeof(stored));
+	if (flashpage_write_and_verify(SYS_CONFIG_FLASHPAGE, _page) !=
+			FLASHPAGE_OK) {
+		return -1;
+	}
+#else
+	(void)config;
+#endif
+	return 0;
+}
+
+/* Parse comma separated decimal values.
+ * return:
+ *  number of values, -1 on anything else in the line
+ */
+static int8_t _parse_values (const char *pos, uint32_t *values,
+		uint8_t numof) {
+	int8_t n = 0;
+
+	while (*pos != '\0' && *pos != '\r') {
+		if (n == numof || *pos < '0' || *pos > '9') {
+			return -1;
+		}
+		char *end;
+		values[n++] = strtoul(pos, &end, 10);
+		pos = (*end == ',') ? end + 1 : end;
+	}
+
+	return n;
+}
+
+/* Bit of a module's record id, -1 if id isn't a single bit. */
+static int8_t _id_bit (uint32_t id) {
+	for (int8_t bit = 0; bit < SYS_CONFIG_MODULES_MAX; bit++) {
+		if (id == (1UL << bit)) {
+			return bit;
+		}
+	}
+	return -1;
+}
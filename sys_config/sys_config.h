@@ -0,0 +1,125 @@
+#ifndef SYS_CONFIG_H
+#define SYS_CONFIG_H
+
+#include "thread.h"
+#ifdef MODULE_PERIPH_FLASHPAGE
+#include "periph/flashpage.h"
+#endif
+
+#include <stdint.h>
+
+
+/* Runtime configuration.
+ *  Settings of sys_control.h and the module table can be changed over the
+ * data link's RX line, without reflashing. A change is persisted to the
+ * last flash page right away (boards with periph_flashpage, RAM only
+ * otherwise), and taken over at the next period boundary (batching: batch
+ * boundary). On boot, the persisted configuration is used, if it is valid.
+ *
+ * Commands, one per line, 'C', key and decimal values ('\n' terminated):
+ *  Cp<min>			MTP length [min], 1..SYS_CONFIG_PERIOD_MIN_MAX
+ *  Cr<id>,<n>		sample module every n-th tick (0: module's default)
+ *  Cn<i>,<deg*10>	north offset of wind instance i (0xFFFF: params)
+ *  Ce<ids>			enabled measuring modules
+ *  Cd				restore defaults
+ * Modules are identified by their binary record id (SYS_*_DATA_MASK >> 8),
+ * enabled modules by the sum of ids.
+ */
+#define SYS_CONFIG_CMD					'C'
+#define SYS_CONFIG_KEY_PERIOD			'p'
+#define SYS_CONFIG_KEY_RATE				'r'
+#define SYS_CONFIG_KEY_NORTH			'n'
+#define SYS_CONFIG_KEY_ENABLE			'e'
+#define SYS_CONFIG_KEY_DEFAULTS			'd'
+
+#define SYS_CONFIG_PERIOD_MIN_MAX		60
+
+/* Record ids are bits of a byte, instances bits of instance masks */
+#define SYS_CONFIG_MODULES_MAX			8
+#define SYS_CONFIG_INSTANCES_MAX		8
+
+/* Flash page the configuration is persisted to (the last one, other users
+ * of the internal flash, e.g. data_storage, keep clear of it) */
+#ifdef MODULE_PERIPH_FLASHPAGE
+#define SYS_CONFIG_FLASHPAGE			(FLASHPAGE_NUMOF - 1)
+#endif
+
+/* Value left as defined at compile time */
+#define SYS_CONFIG_UNSET				0xFFFFU
+
+/* Received lines: ring of line buffers, filled by the UART ISR and parsed
+ * in place by the registered thread (power of 2).
+ */
+#define SYS_CONFIG_LINES				2
+#define SYS_CONFIG_LINE_LEN				24
+
+/* Message posted to the registered thread on a complete line (content: line
+ * number, pass to sys_config_parse())
+ */
+#define SYS_CONFIG_MSG_LINE				(0x5303)
+
+/* Persisted configuration: ASCII "ANCF", layout version */
+#define SYS_CONFIG_MAGIC				0x46434E41UL
+#define SYS_CONFIG_VERSION				1
+
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t period_min;			/* MTP length [min] */
+	uint8_t enabled;				/* Record ids of enabled modules */
+	/* Ticks per sample, by bit of record id (0: module's default) */
+	uint8_t ticks_per_sample[SYS_CONFIG_MODULES_MAX];
+	/* North offset of wind instances [deg * 10] (SYS_CONFIG_UNSET: params) */
+	uint16_t north_offset_10e1[SYS_CONFIG_INSTANCES_MAX];
+	uint32_t check;					/* FNV-1a of all the above */
+} Sys_config;
+
+
+/* Load persisted configuration, or defaults if there is none (or invalid).
+ * return:
+ *  0 on success, -1 if defaults are used
+ */
+int8_t init_sys_config(void);
+
+/* Post received command lines to a thread (SYS_CONFIG_MSG_LINE).
+ *  p1: thread, which calls sys_config_parse()
+ */
+void sys_config_listen(kernel_pid_t pid);
+
+/* Feed a received byte (call from UART RX callback).
+ * return:
+ *  1 if byte belongs to a command, 0 otherwise (free for other parsers)
+ */
+int8_t sys_config_rx(uint8_t data);
+
+/* Parse a received line and persist the changed configuration. Call from
+ * thread context (writes flash), on SYS_CONFIG_MSG_LINE.
+ *  p1: line number (message content)
+ */
+void sys_config_parse(uint32_t line);
+
+/* Take over changes received since the last call (at a period boundary).
+ * return:
+ *  1 if configuration changed, 0 otherwise
+ */
+int8_t sys_config_apply(void);
+
+/* Get configuration in effect. */
+const Sys_config *sys_config_get(void);
+
+/* Check if a module is enabled.
+ *  p1: module's SYS_*_DATA_MASK
+ */
+int8_t sys_config_is_enabled(uint16_t mask);
+
+/* Get sampling rate of a module.
+ *  p1: module's SYS_*_DATA_MASK
+ *  p2: default ticks per sample (module table)
+ * return:
+ *  sample on every n-th tick
+ */
+uint8_t sys_config_ticks_per_sample(uint16_t mask, uint8_t ticks_default);
+
+
+#endif
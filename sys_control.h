@@ -2,33 +2,66 @@
 #define SYS_CONTROL_H
 
 
-/* Configure system and set data formater based on the modules in use */
-/*#define SYS_CONFING (						\
-		SYS_SERIAL_DATA_MASK | \
-		SYS_WIND_DATA_MASK | \
-		SYS_ENV_DATA_MASK | \
-		SYS_EL_DATA_MASK \
-		)*/
+/* System configuration, derived from the modules in use (Makefile USEMODULE).
+ * Measuring modules are listed in the module table (tasks/tasks.c).
+ */
+#ifdef MODULE_SERIAL_DATA
+#define SYS_SERIAL_DATA_CONF		SYS_SERIAL_DATA_MASK
+#else
+#define SYS_SERIAL_DATA_CONF		0
+#endif
+#ifdef MODULE_DATA_STORAGE
+#define SYS_DATA_STORAGE_CONF		SYS_DATA_STORAGE_MASK
+#else
+#define SYS_DATA_STORAGE_CONF		0
+#endif
+#ifdef MODULE_WIND_DATA
+#define SYS_WIND_DATA_CONF			SYS_WIND_DATA_MASK
+#else
+#define SYS_WIND_DATA_CONF			0
+#endif
+#ifdef MODULE_ENV_DATA
+#define SYS_ENV_DATA_CONF			SYS_ENV_DATA_MASK
+#else
+#define SYS_ENV_DATA_CONF			0
+#endif
+#ifdef MODULE_EL_DATA
+#define SYS_EL_DATA_CONF			SYS_EL_DATA_MASK
+#else
+#define SYS_EL_DATA_CONF			0
+#endif
+#ifdef MODULE_DV_DATA
+#define SYS_DV_DATA_CONF			SYS_DV_DATA_MASK
+#else
+#define SYS_DV_DATA_CONF			0
+#endif
+
 #define SYS_CONFING	(					\
-		SYS_SERIAL_DATA_MASK | \
-		SYS_WIND_DATA_MASK | \
-		SYS_ENV_DATA_MASK | \
-		SYS_EL_DATA_MASK \
+		SYS_SERIAL_DATA_CONF | \
+		SYS_DATA_STORAGE_CONF | \
+		SYS_WIND_DATA_CONF | \
+		SYS_ENV_DATA_CONF | \
+		SYS_EL_DATA_CONF | \
+		SYS_DV_DATA_CONF \
 		)
 
-
-/* Dont forget to change formater (no spaces)! */
-//#define DATA_FORMATER "{%s}"			// wind
-//#define DATA_FORMATER "{%s,%s}"		// wind, env
-#define DATA_FORMATER "{%s,%s,%s}"	// wind, env, el
-//#define DATA_FORMATER "{%s,%s,%s,%s}"	// wind, env, el, dv
-
 /* Direction offset from north in degrees * 10e1 */
 #define NORTH_OFFSET_10E1			1575U
 
 /* Set up timer */
 #define DATA_SEND_PERIOD_MIN		1U
 
+/* Adaptive period: doubled after DATA_SEND_PERIOD_ADAPT_STABLE periods in a
+ * row, in which no module's signal variance exceeded its threshold (module
+ * table), up to DATA_SEND_PERIOD_ADAPT_MAX_MIN. Back to DATA_SEND_PERIOD_MIN
+ * (or its runtime setting) after the first variable period.
+ */
+#ifndef DATA_SEND_PERIOD_ADAPT
+#define DATA_SEND_PERIOD_ADAPT		0
+#endif
+#define DATA_SEND_PERIOD_ADAPT_MAX_MIN	16U
+#define DATA_SEND_PERIOD_ADAPT_STABLE	3
+
 
 /******************************************************************************/
 
@@ -63,5 +96,8 @@
 #define TICKS_PER_PERIOD			\
 		DATA_SEND_PERIOD_MIN * SEC_PER_MIN / TIMER_PERIOD_S
 
+/* Period length in seconds, used to align periods to wall-clock time */
+#define DATA_SEND_PERIOD_S			(DATA_SEND_PERIOD_MIN * SEC_PER_MIN)
+
 
 #endif
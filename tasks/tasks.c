@@ -1,166 +1,775 @@
 #include "tasks.h"
 #include "../sys_control.h"
-#include "../wind_data/wind_data.h"
-#include "../el_data/el_data.h"
-#include "../env_data/env_data.h"
 #include "../serial_data/serial_data.h"
+#include "../sample_epoch/sample_epoch.h"
+#ifdef MODULE_SIM_CLOCK
+#include "../sim_clock/sim_clock.h"
+#endif
+#ifdef MODULE_BENCH
+#include "../bench/bench.h"
+#endif
+#ifdef MODULE_SYS_CONFIG
+#include "../sys_config/sys_config.h"
+#endif
 
 #include "thread.h"
+#include "xtimer.h"
 #include "log.h"
 
 #include <stdio.h>		// printf, ...
-#include <stdlib.h>		// malloc, ...
+#include <string.h>		// strlen
 #include <stddef.h>		// size_t, NULL, ...
 
 
 extern uint16_t sys_error;
-extern size_t data_buffer_len;
 
 
-/* DEFINE PROCESS AND STACK ***************************************************/
+/* MODULE DESCRIPTORS *********************************************************/
+
+/* One descriptor per measuring module, everything else in the module table
+ * is generated from it:
+ *  X(name, NAME, Dev, priority, stacksize, var, bench, north_offset)
+ *   name, NAME: module name, the module follows the naming of the others
+ *    (NAME_NUMOF instances of Dev with name_params[], init_name(),
+ *    read_intermediate_name(), get_avg_name(), name_fields[],
+ *    NAME_FIELDS_NUMOF, NAME_JSON_MAX_LEN, NAME_WCET_STEP_US,
+ *    NAME_WCET_PASS_US, SYS_NAME_MASK)
+ *   priority: priority of module's task
+ *   stacksize: stack size of module's task [B]
+ *   var: HAS_VAR, if a signal variance adapts the period (get_var_name(),
+ *    NAME_VAR_MAX), NO_VAR otherwise
+ *   bench: HAS_BENCH, if it times its own steps (name_bench()), NO_BENCH
+ *    otherwise
+ *   north_offset: HAS_NORTH_OFFSET, if it takes the runtime offset from north
+ *    (name_set_north_offset(), parameter north_offset_10e1),
+ *    NO_NORTH_OFFSET otherwise
+ */
+
+#ifdef MODULE_WIND_DATA
+#include "../wind_data/wind_data_params.h"
+#define SYS_MODULE_WIND_DATA(X)		X(wind_data, WIND_DATA, Wind_data_dev, \
+		THREAD_PRIORITY_MAIN - 4, THREAD_STACKSIZE_DEFAULT, \
+		HAS_VAR, HAS_BENCH, HAS_NORTH_OFFSET)
+#else
+#define SYS_MODULE_WIND_DATA(X)
+#endif
+
+#ifdef MODULE_ENV_DATA
+#include "../env_data/env_data_params.h"
+#define SYS_MODULE_ENV_DATA(X)		X(env_data, ENV_DATA, Env_data_dev, \
+		THREAD_PRIORITY_MAIN - 5, THREAD_STACKSIZE_DEFAULT, \
+		NO_VAR, NO_BENCH, NO_NORTH_OFFSET)
+#else
+#define SYS_MODULE_ENV_DATA(X)
+#endif
+
+#ifdef MODULE_EL_DATA
+#include "../el_data/el_data_params.h"
+#define SYS_MODULE_EL_DATA(X)		X(el_data, EL_DATA, El_data_dev, \
+		THREAD_PRIORITY_MAIN - 3, THREAD_STACKSIZE_DEFAULT, \
+		HAS_VAR, NO_BENCH, NO_NORTH_OFFSET)
+#else
+#define SYS_MODULE_EL_DATA(X)
+#endif
+
+#ifdef MODULE_DV_DATA
+#include "../dv_data/dv_data_params.h"
+#define SYS_MODULE_DV_DATA(X)		X(dv_data, DV_DATA, Dv_data_dev, \
+		THREAD_PRIORITY_MAIN - 4, THREAD_STACKSIZE_DEFAULT, \
+		NO_VAR, NO_BENCH, NO_NORTH_OFFSET)
+#else
+#define SYS_MODULE_DV_DATA(X)
+#endif
+
+/* Modules in use. Order determines order of data in payload. */
+#define SYS_MODULES(X)		SYS_MODULE_WIND_DATA(X) SYS_MODULE_ENV_DATA(X) \
+		SYS_MODULE_EL_DATA(X) SYS_MODULE_DV_DATA(X)
+
+
+/* MODULE TABLE ***************************************************************/
+
+/* Generator of an optional part, chosen by descriptor's flag (e.g.
+ * _SYS_HOOK(_SYS_VAR, NO_VAR) is _SYS_VAR_NO_VAR).
+ */
+#define _SYS_HOOK(part, flag)			_SYS_HOOK_(part, flag)
+#define _SYS_HOOK_(part, flag)			part##_##flag
+
+/* Last values of delta encoding, and last reported of report-by-exception */
+#if (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_DELTA)
+#define _SYS_DELTA_PREV_DEF(mod, MOD)										\
+	static int32_t mod##_prev[MOD##_NUMOF * MOD##_FIELDS_NUMOF];
+#define _SYS_DELTA_PREV(mod)			mod##_prev
+#else
+#define _SYS_DELTA_PREV_DEF(mod, MOD)
+#define _SYS_DELTA_PREV(mod)			NULL
+#endif
+#if SERIAL_DATA_RBE
+#define _SYS_RBE_LAST_DEF(mod, MOD)											\
+	static int32_t mod##_last[MOD##_NUMOF * MOD##_FIELDS_NUMOF];			\
+	_Static_assert(MOD##_FIELDS_NUMOF <= PAYLOAD_RBE_FIELDS_MAX,			\
+			"Too many " #mod " fields for presence bitmap");
+#define _SYS_RBE_LAST(mod)				mod##_last
+#else
+#define _SYS_RBE_LAST_DEF(mod, MOD)
+#define _SYS_RBE_LAST(mod)				NULL
+#endif
+
+/* Signal variance (adaptive period) */
+#define _SYS_VAR_DEF_HAS_VAR(mod, Dev)										\
+	static uint32_t _get_var_##mod(void *dev) {								\
+		return get_var_##mod(dev);											\
+	}
+#define _SYS_VAR_DEF_NO_VAR(mod, Dev)
+#define _SYS_VAR_HAS_VAR(mod)			_get_var_##mod
+#define _SYS_VAR_NO_VAR(mod)			NULL
+#define _SYS_VAR_MAX_HAS_VAR(MOD)		MOD##_VAR_MAX
+#define _SYS_VAR_MAX_NO_VAR(MOD)		0
+
+/* Module's own benchmarks */
+#ifdef MODULE_BENCH
+#define _SYS_BENCH_DEF_HAS_BENCH(mod, Dev)									\
+	static void _bench_##mod(void *dev) {									\
+		mod##_bench(dev);													\
+	}
+#define _SYS_BENCH_HAS_BENCH(mod)		_bench_##mod
+#else
+#define _SYS_BENCH_DEF_HAS_BENCH(mod, Dev)
+#define _SYS_BENCH_HAS_BENCH(mod)		NULL
+#endif
+#define _SYS_BENCH_DEF_NO_BENCH(mod, Dev)
+#define _SYS_BENCH_NO_BENCH(mod)		NULL
+
+/* Runtime offset from north, the instance parameter while unset */
+#ifdef MODULE_SYS_CONFIG
+#define _SYS_NORTH_OFFSET_DEF_HAS_NORTH_OFFSET(mod, Dev)					\
+	static void _set_north_offset_##mod(void *dev,							\
+			uint16_t north_offset_10e1) {									\
+		if (north_offset_10e1 == SYS_CONFIG_UNSET) {						\
+			north_offset_10e1 = ((Dev *)dev)->params->north_offset_10e1;	\
+		}																	\
+		mod##_set_north_offset(dev, north_offset_10e1);						\
+	}
+#define _SYS_NORTH_OFFSET_HAS_NORTH_OFFSET(mod)	_set_north_offset_##mod
+#else
+#define _SYS_NORTH_OFFSET_DEF_HAS_NORTH_OFFSET(mod, Dev)
+#define _SYS_NORTH_OFFSET_HAS_NORTH_OFFSET(mod)	NULL
+#endif
+#define _SYS_NORTH_OFFSET_DEF_NO_NORTH_OFFSET(mod, Dev)
+#define _SYS_NORTH_OFFSET_NO_NORTH_OFFSET(mod)		NULL
+
+/* State, checks and adapters from generic (void *) table signatures to
+ * module's typed API.
+ */
+#define _SYS_MODULE_DEF(mod, MOD, Dev, prio, stacksize, has_var,			\
+		has_bench, has_north)												\
+	static char stack_th_##mod[stacksize];									\
+	static Dev mod##_devs[MOD##_NUMOF];										\
+	_SYS_DELTA_PREV_DEF(mod, MOD)											\
+	_SYS_RBE_LAST_DEF(mod, MOD)												\
+	_Static_assert(MOD##_NUMOF <= SYS_MODULE_INSTANCES_MAX,					\
+			"Too many " #mod " instances");									\
+	_Static_assert(MOD##_FIELDS_NUMOF * 4 <= UINT8_MAX,						\
+			#mod " binary record too long");								\
+	_Static_assert((prio) < SERIAL_DATA_TASK_PRIORITY,						\
+			#mod " task must preempt the serial task");						\
+	static int8_t _init_##mod(void *dev, const void *params) {				\
+		return init_##mod(dev, params);										\
+	}																		\
+	static int8_t _sample_##mod(void *dev) {								\
+		return read_intermediate_##mod(dev);								\
+	}																		\
+	static const char *_get_prefix_##mod(void *dev) {						\
+		return ((Dev *)dev)->params->prefix;								\
+	}																		\
+	static const void *_get_avg_##mod(void *dev) {							\
+		return get_avg_##mod(dev);											\
+	}																		\
+	_SYS_HOOK(_SYS_VAR_DEF, has_var)(mod, Dev)								\
+	_SYS_HOOK(_SYS_BENCH_DEF, has_bench)(mod, Dev)							\
+	_SYS_HOOK(_SYS_NORTH_OFFSET_DEF, has_north)(mod, Dev)
+
+#define _SYS_MODULE_ENTRY(mod, MOD, Dev, prio, stacksize, has_var,			\
+		has_bench, has_north) {												\
+		.name = #mod,														\
+		.mask = SYS_##MOD##_MASK,											\
+		.init = _init_##mod,												\
+		.sample = _sample_##mod,											\
+		.get_prefix = _get_prefix_##mod,									\
+		.get_avg = _get_avg_##mod,											\
+		.fields = mod##_fields,												\
+		.fields_numof = MOD##_FIELDS_NUMOF,									\
+		.delta_prev = _SYS_DELTA_PREV(mod),									\
+		.rbe_last = _SYS_RBE_LAST(mod),										\
+		.bench = _SYS_HOOK(_SYS_BENCH, has_bench)(mod),						\
+		.set_north_offset =													\
+				_SYS_HOOK(_SYS_NORTH_OFFSET, has_north)(mod),				\
+		.get_var = _SYS_HOOK(_SYS_VAR, has_var)(mod),						\
+		.var_max = _SYS_HOOK(_SYS_VAR_MAX, has_var)(MOD),					\
+		.wcet_step_us = MOD##_WCET_STEP_US,									\
+		.wcet_pass_us = MOD##_WCET_PASS_US,									\
+		.devs = mod##_devs,													\
+		.dev_size = sizeof(mod##_devs[0]),									\
+		.params = mod##_params,												\
+		.params_size = sizeof(mod##_params[0]),								\
+		.numof = MOD##_NUMOF,												\
+		.ticks_per_sample = 1,												\
+		.priority = prio,													\
+		.stack = stack_th_##mod,											\
+		.stack_size = sizeof(stack_th_##mod),								\
+	},
+
+/* Budgets summed over modules in use */
+#define _SYS_MODULE_WCET_US(mod, MOD, ...)	+ MOD##_WCET_PASS_US
+#define _SYS_MODULE_LEN(mod, MOD, ...)										\
+	+ MOD##_NUMOF * (MOD##_JSON_MAX_LEN + 1)
+
+SYS_MODULES(_SYS_MODULE_DEF)
+
+const Sys_module sys_modules[] = {
+	SYS_MODULES(_SYS_MODULE_ENTRY)
+};
+
+const size_t sys_modules_numof = sizeof(sys_modules) / sizeof(sys_modules[0]);
+
+/* All tasks are woken by the same tick, so their passes together must fit
+ * into one (serial task included, it must finish before the next tick).
+ */
+#define TASKS_WCET_US			(0 SYS_MODULES(_SYS_MODULE_WCET_US))
+_Static_assert(TASKS_WCET_US + SERIAL_DATA_TASK_WCET_US <
+		ATIMER_PERIOD_S * US_PER_SEC,
+		"WCET budgets of tasks don't fit into a tick");
+
+/* Longest module data of a period: JSON records of all instances (failed
+ * ones report zeros), each with a separator, and braces. Binary records
+ * are shorter, so this covers every encoding.
+ */
+#define TASKS_DATA_LEN			(0 SYS_MODULES(_SYS_MODULE_LEN) + 2)
+
+const size_t sys_data_len = TASKS_DATA_LEN;
+
+#if (SYS_CONFING & SYS_SERIAL_DATA_MASK)
+/* Payload slots of serial_data, sized for the modules in use */
+char sys_payload_buf[SERIAL_DATA_BUF_LEN(TASKS_DATA_LEN)];
+const size_t sys_payload_buf_len = sizeof(sys_payload_buf);
+#endif
+
+/* Process IDs of module tasks (same order as table). */
+static kernel_pid_t _pids[sizeof(sys_modules) / sizeof(sys_modules[0])];
+
+/* Failed instances of modules, bit per instance (same order as table). */
+static uint8_t _failed[sizeof(sys_modules) / sizeof(sys_modules[0])];
+
+#ifdef MODULE_SIM_CLOCK
+/* Samples and real time spent per module, and in the serial task */
+static Sys_task_stats _task_stats[sizeof(sys_modules) / sizeof(sys_modules[0])];
+#if (SYS_CONFING & SYS_SERIAL_DATA_MASK)
+static Sys_task_stats _serial_task_stats;
+#endif
+#endif
+
+#if TASKS_WCET
+/* Worst observed execution times per module, and of the serial task */
+static Sys_task_wcet _wcet[sizeof(sys_modules) / sizeof(sys_modules[0])];
+#if (SYS_CONFING & SYS_SERIAL_DATA_MASK)
+static Sys_task_wcet _serial_wcet;
+#endif
+
+/* Keep the worst execution time since start, log when over budget.
+ *  p1: pointer to worst time so far
+ *  p2: start time
+ *  p3: budget
+ *  p4: task name
+ */
+static void _update_wcet(uint32_t *wcet_us, uint64_t start_us,
+		uint32_t budget_us, const char *name) {
+	uint32_t elapsed_us = (uint32_t)(xtimer_now_usec64() - start_us);
+	if (elapsed_us <= *wcet_us) {
+		return;
+	}
+	*wcet_us = elapsed_us;
+	if (elapsed_us > budget_us) {
+		LOG_ERROR("Failed: wcet %s %lu us (budget %lu us)\n", name,
+				(unsigned long)elapsed_us, (unsigned long)budget_us);
+	}
+}
+#endif
+
+/* Get state of module's n-th instance. */
+static void *_dev(const Sys_module *module, uint8_t n) {
+	return (char *)module->devs + n * module->dev_size;
+}
+
+/* Get parameters of module's n-th instance. */
+static const void *_params(const Sys_module *module, uint8_t n) {
+	return (const char *)module->params + n * module->params_size;
+}
+
+/* Mask of all module's instances. */
+static uint8_t _all_instances(const Sys_module *module) {
+	return (uint8_t)((1U << module->numof) - 1);
+}
 
-#if (SYS_CONFING & SYS_WIND_DATA_MASK)
-char stack_th_wind_data[THREAD_STACKSIZE_DEFAULT];
-kernel_pid_t pid_th_wind_data;
+/* Module is enabled (runtime configuration, all are by default). */
+static int8_t _is_enabled(const Sys_module *module) {
+#ifdef MODULE_SYS_CONFIG
+	return sys_config_is_enabled(module->mask);
+#else
+	(void)module;
+	return 1;
 #endif
+}
 
-#if (SYS_CONFING & SYS_ENV_DATA_MASK)
-char stack_th_env_data[THREAD_STACKSIZE_DEFAULT];
-kernel_pid_t pid_th_env_data;
+/* Sampling rate of module, in timer ticks. */
+static uint8_t _ticks_per_sample(const Sys_module *module) {
+#ifdef MODULE_SYS_CONFIG
+	return sys_config_ticks_per_sample(module->mask,
+			module->ticks_per_sample);
+#else
+	return module->ticks_per_sample;
 #endif
+}
 
-#if (SYS_CONFING & SYS_EL_DATA_MASK)
-char stack_th_el_data[THREAD_STACKSIZE_DEFAULT];
-kernel_pid_t pid_th_el_data;
+#ifdef MODULE_SYS_CONFIG
+/* Apply runtime configuration to module instances. */
+static void _apply_sys_config(void) {
+	const Sys_config *config = sys_config_get();
+
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		const Sys_module *module = &sys_modules[i];
+		if (module->set_north_offset == NULL) {
+			continue;
+		}
+		for (uint8_t n = 0; n < module->numof &&
+				n < SYS_CONFIG_INSTANCES_MAX; n++) {
+			module->set_north_offset(_dev(module, n),
+					config->north_offset_10e1[n]);
+		}
+	}
+}
 #endif
 
-#if (SYS_CONFING & SYS_DV_DATA_MASK)
-char stack_th_dv_data[THREAD_STACKSIZE_DEFAULT];
-kernel_pid_t pid_th_dv_data;
+
+/* PERIOD LENGTH **************************************************************/
+
+#if DATA_SEND_PERIOD_ADAPT
+_Static_assert(DATA_SEND_PERIOD_ADAPT_MAX_MIN * SEC_PER_MIN <= UINT16_MAX,
+		"Adaptive period too long for payload");
+
+/* Period is nominal length << shift (written by serial task, read by ISR) */
+static volatile uint8_t _period_shift;
+/* Periods in a row without variable signals */
+static uint8_t _stable_periods;
 #endif
 
+/* Nominal period length [s]. */
+static uint32_t _nominal_period_s(void) {
+#ifdef MODULE_SYS_CONFIG
+	return (uint32_t)sys_config_get()->period_min * SEC_PER_MIN;
+#else
+	return DATA_SEND_PERIOD_S;
+#endif
+}
+
+uint32_t get_sys_period_s(void) {
+	uint32_t period_s = _nominal_period_s();
+#if DATA_SEND_PERIOD_ADAPT
+	/* Nominal length may have changed since (runtime configuration) */
+	for (uint8_t shift = _period_shift; shift > 0; shift--) {
+		if ((period_s << shift) <=
+				DATA_SEND_PERIOD_ADAPT_MAX_MIN * SEC_PER_MIN) {
+			return period_s << shift;
+		}
+	}
+#endif
+	return period_s;
+}
+
+#if DATA_SEND_PERIOD_ADAPT
+/* Shorten period to nominal length, if a signal varied within the period
+ * just finalized, or lengthen it after enough stable ones. Call after all
+ * module instances are finalized.
+ */
+static void _adapt_period(void) {
+	int8_t is_variable = 0;
+
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		const Sys_module *module = &sys_modules[i];
+		if (module->get_var == NULL || !_is_enabled(module)) {
+			continue;
+		}
+		for (uint8_t n = 0; n < module->numof; n++) {
+			if (!(_failed[i] & (1U << n)) &&
+					module->get_var(_dev(module, n)) > module->var_max) {
+				is_variable = 1;
+			}
+		}
+	}
+
+	if (is_variable) {
+		_period_shift = 0;
+		_stable_periods = 0;
+	} else if (++_stable_periods >= DATA_SEND_PERIOD_ADAPT_STABLE) {
+		_stable_periods = 0;
+		if ((_nominal_period_s() << (_period_shift + 1)) <=
+				DATA_SEND_PERIOD_ADAPT_MAX_MIN * SEC_PER_MIN) {
+			_period_shift++;
+		}
+	}
+}
+#endif
+
+
+/* DEFINE PROCESS AND STACK ***************************************************/
+
 char stack_th_serial_data[THREAD_STACKSIZE_DEFAULT];
 kernel_pid_t pid_th_serial_data;
 
 
 /* TASK HANDLERS **************************************************************/
 
-/* Wind data handler */
-#if (SYS_CONFING & SYS_WIND_DATA_MASK)
-void *th_wind_data_handler (void *arg)
+/* Module task handler.
+ * All module's instances are sampled in one pass, interleaving the busy ones
+ * (e.g. waiting for relays), until each finishes (status 0) or fails. The
+ * task then sleeps till the next tick.
+ *  A failed instance reports zeros and sets module's error bit; the module
+ * is woken, until all its instances failed.
+ */
+void *th_sys_module_handler (void *arg)
 {
-    (void) arg;
+	const Sys_module *module = arg;
+	size_t idx = module - sys_modules;
 
-    while (1) {
-    	if (read_intermediate_wind_data() != 0) {
-    		LOG_ERROR("Failed: read_intermediate_wind_data\n");
-    		sys_error |= SYS_WIND_DATA_MASK;
-    	}
-    	thread_sleep();
-    }
+	while (1) {
+		uint8_t pending = _all_instances(module) & ~_failed[idx];
+#ifdef MODULE_SIM_CLOCK
+		uint64_t start_ns = sim_clock_real_ns();
+#endif
+#if TASKS_WCET
+		uint64_t pass_start_us = xtimer_now_usec64();
+#endif
 
-    return NULL;
+		while (pending) {
+			for (uint8_t n = 0; n < module->numof; n++) {
+				if (!(pending & (1U << n))) {
+					continue;
+				}
+#if TASKS_WCET
+				uint64_t step_start_us = xtimer_now_usec64();
+#endif
+				int8_t res = module->sample(_dev(module, n));
+#if TASKS_WCET
+				_update_wcet(&_wcet[idx].step_us, step_start_us,
+						module->wcet_step_us, module->name);
+#endif
+				switch (res) {
+				case 0:
+					pending &= ~(1U << n);
+#ifdef MODULE_SIM_CLOCK
+					_task_stats[idx].samples++;
+#endif
+					break;
+				case 1:
+					// Busy
+					break;
+				default:
+					LOG_ERROR("Failed: sample %s[%u]\n", module->name, n);
+					_failed[idx] |= (1U << n);
+					sys_error |= module->mask;
+					pending &= ~(1U << n);
+					break;
+				}
+			}
+		}
+
+#ifdef MODULE_SIM_CLOCK
+		_task_stats[idx].busy_ns += sim_clock_real_ns() - start_ns;
+#endif
+#if TASKS_WCET
+		_update_wcet(&_wcet[idx].pass_us, pass_start_us,
+				module->wcet_pass_us, module->name);
+#endif
+		thread_sleep();
+	}
+
+	return NULL;
+}
+
+
+/* Serial data handler */
+#if (SYS_CONFING & SYS_SERIAL_DATA_MASK)
+
+/* Finalize period of all module's instances, without serializing. */
+static void _discard_module(const Sys_module *module) {
+	for (uint8_t n = 0; n < module->numof; n++) {
+		module->get_avg(_dev(module, n));
+	}
+}
+
+#if SERIAL_DATA_RBE
+/* Periods till all fields are sent again (0: the next one) */
+static uint8_t _rbe_countdown;
+
+/* Count periods.
+ * return:
+ *  1 on heartbeat (send all fields), 0 otherwise
+ */
+static int8_t _rbe_heartbeat(void) {
+	if (_rbe_countdown == 0) {
+		_rbe_countdown = SERIAL_DATA_RBE_HEARTBEAT - 1;
+		return 1;
+	}
+	_rbe_countdown--;
+	return 0;
 }
 #endif
 
+#if (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_DELTA)
+/* Add delta records of module instances in use. The first period of a batch
+ * carries record headers (layout of the following ones), terminated by 0.
+ * Buffer is sized for JSON, so records always fit (a missing one would
+ * break the layout).
+ */
+static size_t _build_data(char *data_buf, size_t data_buf_len) {
+	uint8_t *buf = (uint8_t *)data_buf;
+	size_t len = 0;
+	int8_t is_first = (get_serial_data_batch_periods() == 0);
+
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		const Sys_module *module = &sys_modules[i];
+		if (!_is_enabled(module)) {
+			_discard_module(module);
+			continue;
+		}
+		for (uint8_t n = 0; n < module->numof; n++) {
+			len += payload_delta_record(buf + len, data_buf_len - len,
+					(uint8_t)(module->mask >> 8), n, is_first,
+					module->fields, module->fields_numof,
+					module->get_avg(_dev(module, n)),
+					module->delta_prev + n * module->fields_numof);
+		}
+	}
+	if (is_first) {
+		len += payload_put_u8(buf + len, 0);
+	}
+
+	return len;
+}
+#elif (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_BIN)
+/* Set module's error bit, if a field to be sent is out of range of its wire
+ * type (sent saturated).
+ *  p1: module
+ *  p2: instance
+ *  p3: instance's averaged data
+ *  p4: bitmap of fields to be sent
+ */
+static void _check_range(const Sys_module *module, uint8_t n,
+		const void *avg, uint32_t present) {
+	uint32_t out = payload_out_of_range(module->fields, module->fields_numof,
+			avg) & present;
+	if (out) {
+		LOG_ERROR("Failed: %s[%u] out of range (fields 0x%lx)\n",
+				module->name, n, (unsigned long)out);
+		sys_error |= module->mask;
+	}
+}
 
-/* Environmental data handler */
-#if (SYS_CONFING & SYS_ENV_DATA_MASK)
-void *th_env_data_handler (void *arg)
-{
-	(void) arg;
+/* Add records of module instances in use (module id is mask's high byte).
+ * With report-by-exception, only changed fields, records without any are
+ * left out. A value sent saturated (out of range of its wire type) sets
+ * module's error bit.
+ */
+static size_t _build_data(char *data_buf, size_t data_buf_len) {
+	uint8_t *buf = (uint8_t *)data_buf;
+	size_t len = 0;
+#if SERIAL_DATA_RBE
+	int8_t is_heartbeat = _rbe_heartbeat();
+#endif
 
-	    while (1) {
-	    	if (read_intermediate_env_data() != 0) {
-	    		LOG_ERROR("Failed: read_intermediate_env_data\n");
-	    		sys_error |= SYS_ENV_DATA_MASK;
-	    	}
-	    	thread_sleep();
-	    }
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		const Sys_module *module = &sys_modules[i];
+		if (!_is_enabled(module)) {
+			_discard_module(module);
+			continue;
+		}
+		for (uint8_t n = 0; n < module->numof; n++) {
+			const void *avg = module->get_avg(_dev(module, n));
+#if SERIAL_DATA_RBE
+			int32_t *last = module->rbe_last + n * module->fields_numof;
+			uint8_t present = payload_rbe_select(module->fields,
+					module->fields_numof, avg, last, is_heartbeat);
+			if (present == 0) {
+				continue;
+			}
+			_check_range(module, n, avg, present);
+			size_t record_len = payload_bin_record_rbe(buf + len,
+					data_buf_len - len, (uint8_t)(module->mask >> 8), n,
+					module->fields, module->fields_numof, avg, present);
+			if (record_len == 0) {
+				LOG_ERROR("Failed: payload_bin_record_rbe %s[%u]\n",
+						module->name, n);
+				continue;
+			}
+			/* Only what is written counts as reported */
+			payload_rbe_commit(module->fields, module->fields_numof, avg,
+					last, present);
+			len += record_len;
+#else
+			_check_range(module, n, avg, UINT32_MAX);
+			len += payload_bin_record(buf + len, data_buf_len - len,
+					(uint8_t)(module->mask >> 8), n,
+					module->fields, module->fields_numof, avg);
+#endif
+		}
+	}
 
-	    return NULL;
+	return len;
 }
+#else
+/* Add data from module instances in use ("{m1,m2,...}"). Buffer length is
+ * the sum of instances' max. JSON lengths (+ separators and balast), so
+ * a record only doesn't fit on a too long prefix, and is then left out.
+ * With report-by-exception, only changed fields' keys are present.
+ */
+static size_t _build_data(char *data_buf, size_t data_buf_len) {
+	size_t len = 0;
+	data_buf[len++] = '{';
+#if SERIAL_DATA_RBE
+	int8_t is_heartbeat = _rbe_heartbeat();
 #endif
 
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		const Sys_module *module = &sys_modules[i];
+		if (!_is_enabled(module)) {
+			_discard_module(module);
+			continue;
+		}
+		for (uint8_t n = 0; n < module->numof; n++) {
+			void *dev = _dev(module, n);
+			const void *avg = module->get_avg(dev);
+			size_t sep = (len == 1) ? 0 : 1;
+			/* Keep space for separator, '}' and '\0' */
+			size_t reserved = len + sep + 2;
+#if SERIAL_DATA_RBE
+			int32_t *last = module->rbe_last + n * module->fields_numof;
+			uint8_t present = payload_rbe_select(module->fields,
+					module->fields_numof, avg, last, is_heartbeat);
+			if (present == 0) {
+				continue;
+			}
+			size_t record_len = payload_json_record_rbe(
+					data_buf + len + sep,
+					(reserved < data_buf_len) ? data_buf_len - reserved : 0,
+					module->get_prefix(dev),
+					module->fields, module->fields_numof, avg, present);
+#else
+			size_t record_len = payload_json_record(
+					data_buf + len + sep,
+					(reserved < data_buf_len) ? data_buf_len - reserved : 0,
+					module->get_prefix(dev),
+					module->fields, module->fields_numof, avg);
+#endif
+			if (record_len == 0) {
+				LOG_ERROR("Failed: payload_json_record %s[%u]\n",
+						module->name, n);
+				continue;
+			}
+#if SERIAL_DATA_RBE
+			payload_rbe_commit(module->fields, module->fields_numof, avg,
+					last, present);
+#endif
+			if (sep) {
+				data_buf[len] = ',';
+			}
+			len += sep + record_len;
+		}
+	}
 
-/* Electrical data handler */
-#if (SYS_CONFING & SYS_EL_DATA_MASK)
-void *th_el_data_handler (void *arg)
-{
-	(void) arg;
-	int8_t intermediate_data_status;
-
-	    while (1) {
-	    	intermediate_data_status = read_intermediate_el_data();
-	    	switch (intermediate_data_status) {
-	    	case 0:
-	    		thread_sleep();
-	    		break;
-	    	case 1:
-	    		// Busy
-	    		break;
-	    	case -1:
-	    		LOG_ERROR("Failed: read_intermediate_el_data\n");
-	    		sys_error |= SYS_EL_DATA_MASK;
-	    		thread_sleep();
-	    		break;
-	    	default:
-	    		break;
-	    	}
-	    }
-
-	    return NULL;
-}
-#endif
-
-
-/* Wind gradient data handler */
-#if (SYS_CONFING & SYS_DV_DATA_MASK)
-void *th_dv_data_handler (void *arg)
-{
-	(void) arg;
-	    while (1) {
-	    	thread_sleep();
-	    }
-	    return NULL;
+	data_buf[len++] = '}';
+	data_buf[len] = '\0';
+
+	return len;
 }
 #endif
 
+/* Finalize period of all module instances, without serializing. */
+static void _discard_data(void) {
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		_discard_module(&sys_modules[i]);
+	}
+}
+
+/* Modules in payload: those in use, less the disabled ones. */
+static uint16_t _status(void) {
+	uint16_t status = (uint16_t)SYS_CONFING;
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		if (!_is_enabled(&sys_modules[i])) {
+			status &= ~sys_modules[i].mask;
+		}
+	}
+	return status;
+}
 
-/* Serial data handler */
-#if (SYS_CONFING & SYS_SERIAL_DATA_MASK)
 void *th_serial_data_handler (void *arg)
 {
     (void) arg;
 
+    /* Module data is written straight into a payload slot */
+    size_t data_buf_len;
     char *data_buf;
-    data_buf = malloc(data_buffer_len);
+
+    /* Measurement period, closed by the timer ISR */
+    Sample_period period;
 
     while (1) {
 
-    	/* Add data from modules that are in use */
-    	snprintf (data_buf, data_buffer_len, DATA_FORMATER
-#if (SYS_CONFING & SYS_WIND_DATA_MASK)
-    			,get_avg_json_wind_data()
+#ifdef MODULE_SIM_CLOCK
+    	uint64_t start_ns = sim_clock_real_ns();
 #endif
-#if (SYS_CONFING & SYS_ENV_DATA_MASK)
-    			,get_avg_json_env_data()
+#if TASKS_WCET
+    	uint64_t start_us = xtimer_now_usec64();
 #endif
-#if (SYS_CONFING & SYS_EL_DATA_MASK)
-    			,get_avg_json_el_data()
+    	sample_epoch_get_period(&period);
+
+    	data_buf = get_serial_data_buf(&data_buf_len);
+    	if (data_buf == NULL) {
+    		/* TX is behind, finalize period anyway (its data is lost) */
+    		LOG_ERROR("Failed: get_serial_data_buf\n");
+    		_discard_data();
+#if DATA_SEND_PERIOD_ADAPT
+    		_adapt_period();
 #endif
-#if (SYS_CONFING & SYS_DV_DATA_MASK)
-    			//,get_avg_json_dv_data()
-#endif
-    	);
+    		thread_sleep();
+    		continue;
+    	}
 
-    	//printf("%s\n", data_buf);
+    	size_t len = _build_data(data_buf, data_buf_len);
+#if DATA_SEND_PERIOD_ADAPT
+    	_adapt_period();
+#endif
 
-    	if(send_serial_data(data_buf, (uint16_t)SYS_CONFING, sys_error) != 0) {
+    	/* Queue for transmission, returns immediately */
+    	if(send_serial_data(len, _status(), sys_error, &period) != 0) {
     		// GLOW RED
-    	    return NULL;
+    		LOG_ERROR("Failed: send_serial_data\n");
+    	}
+
+#ifdef MODULE_SYS_CONFIG
+    	/* Take over received configuration between batches, so a payload
+    	 * (and delta record layout) is built with a single one.
+    	 */
+    	if (get_serial_data_batch_periods() == 0 && sys_config_apply()) {
+    		_apply_sys_config();
     	}
+#endif
 
+#ifdef MODULE_SIM_CLOCK
+    	_serial_task_stats.samples++;
+    	_serial_task_stats.busy_ns += sim_clock_real_ns() - start_ns;
+#endif
+#if TASKS_WCET
+    	_update_wcet(&_serial_wcet.pass_us, start_us,
+    			SERIAL_DATA_TASK_WCET_US, "serial_data");
+#endif
     	thread_sleep();
     }
 
@@ -169,58 +778,149 @@ void *th_serial_data_handler (void *arg)
 #endif
 
 
-/* CREATE TASKS (THREADS) **************************************************/
+#ifdef MODULE_BENCH
+/* BENCHMARKS *****************************************************************/
+
+/* Longest time to wait for TX to empty the queue between sends */
+#define BENCH_TX_WAIT_MS			2000
+/* Scratch buffer for a single module record */
+#define BENCH_RECORD_BUF_LEN		512
+
+static char _bench_buf[BENCH_RECORD_BUF_LEN];
+
+/* Average and serialize first instance (encoding as configured). */
+static void _bench_get_avg(void *arg) {
+	const Sys_module *module = arg;
+	void *dev = _dev(module, 0);
+#if (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_JSON)
+	payload_json_record(_bench_buf, sizeof(_bench_buf),
+			module->get_prefix(dev), module->fields, module->fields_numof,
+			module->get_avg(dev));
+#else
+	payload_bin_record((uint8_t *)_bench_buf, sizeof(_bench_buf),
+			(uint8_t)(module->mask >> 8), 0, module->fields,
+			module->fields_numof, module->get_avg(dev));
+#endif
+}
 
-#if (SYS_CONFING & SYS_WIND_DATA_MASK)
-void create_wind_data_task(void) {
-	pid_th_wind_data = thread_create(
-		stack_th_wind_data,
-		sizeof(stack_th_wind_data),
-		THREAD_PRIORITY_MAIN - 4,
-		THREAD_CREATE_SLEEPING,
-		th_wind_data_handler, NULL,
-		"th_wind_data_handler");
+#if (SYS_CONFING & SYS_SERIAL_DATA_MASK)
+/* Payload built by setup, queued by send */
+static size_t _bench_data_len;
+static int8_t _bench_has_buf;
+
+/* Wait for TX to drain, then fill a slot with module data. */
+static void _bench_send_setup(void *arg) {
+	(void)arg;
+	Serial_data_tx_stats stats;
+	for (uint16_t ms = 0; ms < BENCH_TX_WAIT_MS; ms++) {
+		get_serial_data_tx_stats(&stats);
+		if (stats.depth == 0) {
+			break;
+		}
+		xtimer_usleep(1000);
+	}
+
+	size_t data_buf_len;
+	char *data_buf = get_serial_data_buf(&data_buf_len);
+	_bench_has_buf = (data_buf != NULL);
+	if (_bench_has_buf) {
+		_bench_data_len = _build_data(data_buf, data_buf_len);
+	}
+}
+
+static void _bench_send(void *arg) {
+	(void)arg;
+	Sample_period period;
+	sample_epoch_get_period(&period);
+	if (_bench_has_buf) {
+		send_serial_data(_bench_data_len, _status(), sys_error, &period);
+	}
 }
 #endif
 
+void bench_sys_modules(void) {
+	char name[32];
+
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		const Sys_module *module = &sys_modules[i];
+		if (module->bench != NULL) {
+			module->bench(_dev(module, 0));
+		}
+	}
+
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		const Sys_module *module = &sys_modules[i];
+#if (SERIAL_DATA_ENCODING == SERIAL_DATA_ENCODING_JSON)
+		snprintf(name, sizeof(name), "get_avg_json_%s", module->name);
+#else
+		snprintf(name, sizeof(name), "get_avg_bin_%s", module->name);
+#endif
+		bench_run(name, NULL, _bench_get_avg, (void *)module);
+	}
 
-#if (SYS_CONFING & SYS_ENV_DATA_MASK)
-void create_env_data_task(void) {
-		pid_th_env_data = thread_create(
-			stack_th_env_data,
-			sizeof(stack_th_env_data),
-			THREAD_PRIORITY_MAIN - 5,
-			THREAD_CREATE_SLEEPING,
-			th_env_data_handler, NULL,
-			"th_env_data_handler");
+#if (SYS_CONFING & SYS_SERIAL_DATA_MASK)
+	bench_run("send_serial_data", _bench_send_setup, _bench_send, NULL);
+#endif
 }
 #endif
 
 
-#if (SYS_CONFING & SYS_EL_DATA_MASK)
-void create_el_data_task(void) {
-	pid_th_el_data = thread_create(
-		stack_th_el_data,
-		sizeof(stack_th_el_data),
-		THREAD_PRIORITY_MAIN - 3,
-		THREAD_CREATE_SLEEPING,
-		th_el_data_handler, NULL,
-		"th_el_data_handler");
-}
+/* INIT MODULES ***************************************************************/
+
+void init_sys_modules(void) {
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		const Sys_module *module = &sys_modules[i];
+
+		for (uint8_t n = 0; n < module->numof; n++) {
+			if (module->init(_dev(module, n), _params(module, n)) != 0) {
+				LOG_ERROR("Failed: init %s[%u]\n", module->name, n);
+				sys_error |= module->mask;
+				_failed[i] |= (1U << n);
+			}
+			/* Longer prefix wouldn't fit into data buffer */
+			if (strlen(module->get_prefix(_dev(module, n))) >
+					PAYLOAD_PREFIX_MAX_LEN) {
+				LOG_ERROR("Failed: prefix %s[%u]\n", module->name, n);
+				sys_error |= module->mask;
+			}
+		}
+	}
+
+#ifdef MODULE_SYS_CONFIG
+	/* Persisted configuration (init_sys_config) */
+	_apply_sys_config();
 #endif
+}
 
 
-#if (SYS_CONFING & SYS_DV_DATA_MASK)
-void create_dv_data_task(void) {
-	pid_th_dv_data = thread_create(
-		stack_th_dv_data,
-		sizeof(stack_th_dv_data),
-		THREAD_PRIORITY_MAIN - 2,
-		THREAD_CREATE_SLEEPING,
-		th_dv_data_handler, NULL,
-		"th_dv_data_handler");
+/* CREATE TASKS (THREADS) **************************************************/
+
+void create_sys_module_tasks(void) {
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		const Sys_module *module = &sys_modules[i];
+		if (_failed[i] == _all_instances(module)) {
+			continue;
+		}
+		_pids[i] = thread_create(
+			module->stack,
+			module->stack_size,
+			module->priority,
+			THREAD_CREATE_SLEEPING,
+			th_sys_module_handler, (void *)module,
+			module->name);
+	}
+}
+
+
+void wakeup_sys_module_tasks(uint32_t tick) {
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		const Sys_module *module = &sys_modules[i];
+		if (_failed[i] != _all_instances(module) && _is_enabled(module) &&
+				(tick % _ticks_per_sample(module)) == 0) {
+			thread_wakeup(_pids[i]);
+		}
+	}
 }
-#endif
 
 
 #if (SYS_CONFING & SYS_SERIAL_DATA_MASK)
@@ -228,12 +928,67 @@ void create_serial_data_task(void) {
 	pid_th_serial_data = thread_create(
 		stack_th_serial_data,
 		sizeof(stack_th_serial_data),
-		THREAD_PRIORITY_MAIN - 1,
+		SERIAL_DATA_TASK_PRIORITY,
 		THREAD_CREATE_SLEEPING,
 		th_serial_data_handler, NULL,
 		"th_serial_data");
 }
+
+
+void wakeup_serial_data_task(void) {
+	if (!(sys_error & SYS_SERIAL_DATA_MASK)) {
+		thread_wakeup(pid_th_serial_data);
+	}
+}
+#endif
+
+
+#ifdef MODULE_SIM_CLOCK
+/* TASK STATISTICS ************************************************************/
+
+void get_sys_module_task_stats(size_t idx, Sys_task_stats *stats) {
+	*stats = _task_stats[idx];
+}
+
+#if (SYS_CONFING & SYS_SERIAL_DATA_MASK)
+void get_serial_data_task_stats(Sys_task_stats *stats) {
+	*stats = _serial_task_stats;
+}
+#endif
 #endif
 
 
+#if TASKS_WCET
+/* EXECUTION TIME BUDGETS *****************************************************/
+
+int8_t check_sys_task_wcet(void) {
+	int8_t res = 0;
 
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		const Sys_module *module = &sys_modules[i];
+		printf("wcet: %s: step %lu/%lu us, pass %lu/%lu us\n", module->name,
+				(unsigned long)_wcet[i].step_us,
+				(unsigned long)module->wcet_step_us,
+				(unsigned long)_wcet[i].pass_us,
+				(unsigned long)module->wcet_pass_us);
+		if (_wcet[i].step_us > module->wcet_step_us ||
+				_wcet[i].pass_us > module->wcet_pass_us) {
+			res = -1;
+		}
+	}
+
+#if (SYS_CONFING & SYS_SERIAL_DATA_MASK)
+	printf("wcet: serial_data: pass %lu/%lu us\n",
+			(unsigned long)_serial_wcet.pass_us,
+			(unsigned long)SERIAL_DATA_TASK_WCET_US);
+	if (_serial_wcet.pass_us > SERIAL_DATA_TASK_WCET_US) {
+		res = -1;
+	}
+#endif
+
+	if (res != 0) {
+		LOG_ERROR("Failed: wcet budget exceeded\n");
+	}
+	return res;
+}
+#endif
@@ -1,24 +1,153 @@
 #ifndef TASKS_H
 #define TASKS_H
 
-/* Wind data handler */
-void *th_wind_data_handler (void *arg);
-void create_wind_data_task(void);
+#include "thread.h"
+#include "../payload/payload.h"
 
-/* Environmental data handler */
-void *th_env_data_handler (void *arg);
-void create_env_data_task(void);
+#include <stdint.h>
+#include <stddef.h>		// size_t
 
-/* Electrical data handler */
-void *th_el_data_handler (void *arg);
-void create_el_data_task(void);
 
-/* Wind gradient data handler */
-void *th_dv_data_handler (void *arg);
-void create_dv_data_task(void);
+/* Max. number of instances of a single module (bits in instance masks). */
+#define SYS_MODULE_INSTANCES_MAX	8
+
+/* Priority of the serial task. It finalizes the closed bank of every module
+ * (see sample_epoch.h), which a sampling pass woken before the boundary may
+ * still write to, e.g. an electrical cycle over several ticks. Module tasks
+ * preempt the serial task, so it only runs once they have finished.
+ */
+#define SERIAL_DATA_TASK_PRIORITY	(THREAD_PRIORITY_MAIN - 1)
+
+/* WCET budget of the serial task: build and queue a payload [us] */
+#define SERIAL_DATA_TASK_WCET_US	(100U * 1000U)
+
+/* Measure worst execution times of sample steps and task passes, and check
+ * them against their budgets (module's *_WCET_*_US). Time between wakeup
+ * and sleep includes preemption and busy waiting, so a pass is what has to
+ * fit into a tick. With sim_clock, times are virtual and a run exceeding a
+ * budget fails.
+ */
+#ifndef TASKS_WCET
+#define TASKS_WCET					0
+#endif
+
+/* Module descriptor.
+ *  Every measuring module in use (Makefile USEMODULE) has an entry in the
+ * module table, holding everything needed to init it, run its task and
+ * serialize its data. The scheduler, payload builder and error handling
+ * iterate the table. Entries are generated from a descriptor per module
+ * (SYS_MODULE_<NAME> in tasks.c), so adding a sensor only means adding it.
+ *  A module may run several instances (e.g. anemometers at different
+ * heights), each with its own state and parameters (see *_params.h). All
+ * instances of a module share one task, sampled in the same pass.
+ */
+typedef struct {
+	const char *name;				/* Module (and thread) name */
+	uint16_t mask;					/* SYS_*_DATA_MASK, used for errors */
+	/* Init instance. 0 on success, -1 on error */
+	int8_t (*init)(void *dev, const void *params);
+	/* Take intermediate sample. 0: finished, 1: busy, -1: error */
+	int8_t (*sample)(void *dev);
+	/* Get instance's JSON key prefix */
+	const char *(*get_prefix)(void *dev);
+	/* Finalize period and get averaged data (described by fields) */
+	const void *(*get_avg)(void *dev);
+	const Payload_field *fields;	/* Descriptors of averaged data */
+	uint8_t fields_numof;
+	int32_t *delta_prev;			/* Previous values (delta encoding) */
+	int32_t *rbe_last;				/* Last sent values (report-by-exception) */
+	/* Time module's hot functions on an instance (bench), or NULL */
+	void (*bench)(void *dev);
+	/* Set offset from north (runtime configuration), or NULL */
+	void (*set_north_offset)(void *dev, uint16_t north_offset_10e1);
+	/* Get signal variance of the last finalized period (adaptive period),
+	 * or NULL. Variable above var_max. */
+	uint32_t (*get_var)(void *dev);
+	uint32_t var_max;
+	uint32_t wcet_step_us;			/* WCET budget of a sample call */
+	uint32_t wcet_pass_us;			/* WCET budget of sampling all instances */
+	void *devs;						/* Array of instance states */
+	size_t dev_size;				/* Size of a single instance state */
+	const void *params;				/* Array of instance parameters */
+	size_t params_size;				/* Size of a single instance's params */
+	uint8_t numof;					/* Number of instances */
+	uint8_t ticks_per_sample;		/* Sample on every n-th timer tick */
+	uint8_t priority;				/* Thread priority */
+	char *stack;					/* Thread stack */
+	int stack_size;
+} Sys_module;
+
+/* Task statistics (native, virtual clock): samples and real time spent.
+ * Samples are instance samples, for the serial task periods.
+ */
+typedef struct {
+	uint32_t samples;
+	uint64_t busy_ns;
+} Sys_task_stats;
+
+/* Worst observed execution times [us] (TASKS_WCET). */
+typedef struct {
+	uint32_t step_us;
+	uint32_t pass_us;
+} Sys_task_wcet;
+
+/* Table of modules in use (generated from USEMODULE at compile time). */
+extern const Sys_module sys_modules[];
+extern const size_t sys_modules_numof;
+
+/* Max. length of module data of a period, summed up at compile time over
+ * instances of modules in use (JSON, incl. separators).
+ */
+extern const size_t sys_data_len;
+/* Payload buffer for init_serial_data(), SERIAL_DATA_BUF_LEN(sys_data_len) */
+extern char sys_payload_buf[];
+extern const size_t sys_payload_buf_len;
+
+
+/* Init all instances of modules in table, and apply runtime configuration.
+ * Failed modules are flagged in sys_error.
+ */
+void init_sys_modules(void);
+
+/* Module task handler (common to all modules in table) */
+void *th_sys_module_handler (void *arg);
+/* Create tasks of all modules, which were successfully initiated */
+void create_sys_module_tasks(void);
+/* Wake tasks of enabled modules due to sample on given tick (call from ISR)
+ *  p1: tick sequence number
+ */
+void wakeup_sys_module_tasks(uint32_t tick);
+
+/* Copy task statistics of a module (only with sim_clock)
+ *  p1: index in module table
+ *  p2: pointer to where statistics will be written
+ */
+void get_sys_module_task_stats(size_t idx, Sys_task_stats *stats);
+
+/* Print worst observed execution times of module and serial tasks against
+ * their budgets (only with TASKS_WCET)
+ * return:
+ *  0 if all within budget, -1 otherwise
+ */
+int8_t check_sys_task_wcet(void);
+
+/* Time hot functions of modules in table, on their first instance, then
+ * averaging and serialization of each module, and send_serial_data (bench)
+ */
+void bench_sys_modules(void);
+
+/* Get period length in effect [s]: DATA_SEND_PERIOD_MIN (or its runtime
+ * setting), stretched by the adaptive period (DATA_SEND_PERIOD_ADAPT). Safe
+ * to call from ISR.
+ */
+uint32_t get_sys_period_s(void);
 
 /* Serial data handler */
 void *th_serial_data_handler (void *arg);
 void create_serial_data_task(void);
+/* Wake serial data task (call from ISR) */
+void wakeup_serial_data_task(void);
+/* Copy serial task statistics (only with sim_clock) */
+void get_serial_data_task_stats(Sys_task_stats *stats);
 
 #endif
@@ -0,0 +1,42 @@
+/* Host decompressor of LZSS data (see lzss_decode.h). */
+#include "lzss_decode.h"
+
+
+/* Functions ******************************************************************/
+
+size_t lzss_decompress (const uint8_t *in, size_t in_len, uint8_t *out,
+		size_t out_len) {
+
+	size_t pos = 0;
+	size_t n = 0;
+
+	while (pos < in_len) {
+		uint8_t flags = in[pos++];
+
+		for (uint8_t item = 0; item < 8 && pos < in_len; item++) {
+			if (flags & (1U << item)) {
+				if (n >= out_len) {
+					return 0;
+				}
+				out[n++] = in[pos++];
+				continue;
+			}
+
+			if (pos + 2 > in_len) {
+				return 0;
+			}
+			size_t dist = in[pos] | ((size_t)(in[pos + 1] >> 4) << 8);
+			size_t len = (in[pos + 1] & 0x0F) + LZSS_MIN_MATCH;
+			pos += 2;
+			if (dist == 0 || dist > n || n + len > out_len) {
+				return 0;
+			}
+			/* Byte by byte, a match may overlap its own output */
+			for (size_t i = 0; i < len; i++, n++) {
+				out[n] = out[n - dist];
+			}
+		}
+	}
+
+	return n;
+}
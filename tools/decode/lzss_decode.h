@@ -0,0 +1,28 @@
+#ifndef LZSS_DECODE_H
+#define LZSS_DECODE_H
+
+#include "lzss/lzss.h"
+
+#include <stdint.h>
+#include <stddef.h>		// size_t
+
+
+/* Host decompressor of LZSS data (lzss/lzss.h), as written by
+ * lzss_compress() (see README, Host tests).
+ */
+
+
+/* Decompress buffer.
+ *  p1: LZSS data
+ *  p2: data length
+ *  p3: output
+ *  p4: output length
+ * return:
+ *  decompressed length, 0 if data is malformed (match before the start)
+ *  or output is too short
+ */
+size_t lzss_decompress (const uint8_t *in, size_t in_len, uint8_t *out,
+		size_t out_len);
+
+
+#endif
@@ -0,0 +1,64 @@
+/* Decode a capture of the data link (binary encoding or LZ compression, raw
+ * link) to JSON payloads, one per line (see README, Host tests):
+ *	payload_decode [capture]
+ * Reads stdin without argument. Bytes between frames are skipped, and
+ * counted on stderr.
+ */
+#include "payload_decode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+int main (int argc, char **argv) {
+	FILE *in = stdin;
+	if (argc > 2) {
+		fprintf(stderr, "usage: %s [capture]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (argc == 2 && (in = fopen(argv[1], "rb")) == NULL) {
+		perror(argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	/* Whole capture, frames are decoded in place */
+	size_t size = 1 << 16;
+	size_t len = 0;
+	uint8_t *buf = malloc(size);
+	size_t n;
+	while (buf != NULL && (n = fread(buf + len, 1, size - len, in)) > 0) {
+		len += n;
+		if (len == size) {
+			size *= 2;
+			buf = realloc(buf, size);
+		}
+	}
+	if (buf == NULL) {
+		fprintf(stderr, "payload_decode: out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	Payload_decoder dec;
+	payload_decode_init(&dec);
+	size_t pos = 0;
+	size_t skipped = 0;
+	unsigned long frames = 0;
+	while (pos < len) {
+		int res = payload_decode_frame(&dec, buf + pos, len - pos, stdout);
+		if (res == 0) {
+			break;
+		}
+		if (res < 0) {
+			skipped++;
+			pos++;
+			continue;
+		}
+		frames++;
+		pos += res;
+	}
+
+	fprintf(stderr, "payload_decode: %lu frames, %lu bytes skipped, "
+			"%lu truncated\n", frames, (unsigned long)skipped,
+			(unsigned long)(len - pos));
+	return (skipped || pos != len) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,548 @@
+/* Host decoder of binary payloads (see payload_decode.h). */
+#include "payload_decode.h"
+#include "lzss_decode.h"
+#ifdef MODULE_WIND_DATA
+#include "wind_data/wind_data_params.h"
+#endif
+#ifdef MODULE_ENV_DATA
+#include "env_data/env_data_params.h"
+#endif
+#ifdef MODULE_EL_DATA
+#include "el_data/el_data_params.h"
+#endif
+#ifdef MODULE_DV_DATA
+#include "dv_data/dv_data_params.h"
+#endif
+#include "sys_control.h"
+
+#include <string.h>
+
+
+/* Longest JSON payload line of a frame (body is at most UINT16_MAX) */
+#define DECODE_JSON_MAX_LEN			(32 * UINT16_MAX)
+
+/* Schema of a module: descriptors from its field list, prefixes from its
+ * instance parameters.
+ */
+#define DECODE_MODULE(name, NAME)										\
+	static const Payload_field _fields_##name[] = {						\
+		NAME##_FIELDS(PAYLOAD_FIELD_DESC)								\
+	};																	\
+	static const char *_get_prefix_##name(uint8_t instance) {			\
+		return name##_params[instance].prefix;							\
+	}
+#define DECODE_MODULE_ENTRY(name, NAME)									\
+	{ SYS_##NAME##_MASK >> 8, #name, _fields_##name,					\
+	  NAME##_FIELDS_NUMOF, NAME##_NUMOF, _get_prefix_##name },
+
+#ifdef MODULE_WIND_DATA
+DECODE_MODULE(wind_data, WIND_DATA)
+_Static_assert(sizeof(Wind_data) <= PAYLOAD_DECODE_DATA_MAX_LEN, "wind_data");
+#endif
+#ifdef MODULE_ENV_DATA
+DECODE_MODULE(env_data, ENV_DATA)
+_Static_assert(sizeof(Env_data) <= PAYLOAD_DECODE_DATA_MAX_LEN, "env_data");
+#endif
+#ifdef MODULE_EL_DATA
+DECODE_MODULE(el_data, EL_DATA)
+_Static_assert(sizeof(El_data) <= PAYLOAD_DECODE_DATA_MAX_LEN, "el_data");
+#endif
+#ifdef MODULE_DV_DATA
+DECODE_MODULE(dv_data, DV_DATA)
+_Static_assert(sizeof(Dv_data) <= PAYLOAD_DECODE_DATA_MAX_LEN, "dv_data");
+#endif
+
+static const Payload_decode_module _modules[] = {
+#ifdef MODULE_WIND_DATA
+	DECODE_MODULE_ENTRY(wind_data, WIND_DATA)
+#endif
+#ifdef MODULE_ENV_DATA
+	DECODE_MODULE_ENTRY(env_data, ENV_DATA)
+#endif
+#ifdef MODULE_EL_DATA
+	DECODE_MODULE_ENTRY(el_data, EL_DATA)
+#endif
+#ifdef MODULE_DV_DATA
+	DECODE_MODULE_ENTRY(dv_data, DV_DATA)
+#endif
+};
+
+/* Wire width of field types (same order as PAYLOAD_TYPE_*) */
+static const uint8_t _type_len[] = { 1, 2, 4, 4 };
+
+/* Delta batch (PAYLOAD_FRAME_DELTA): record layout of the first period,
+ * records hold the values of the last decoded period. */
+typedef struct {
+	Payload_decode_record records[PAYLOAD_DECODE_DELTA_RECORDS_MAX];
+	uint8_t numof[PAYLOAD_DECODE_DELTA_RECORDS_MAX];	/* Fields sent */
+	uint8_t len;
+	/* Index, error, epoch, period start, period length, partial */
+	uint32_t period[6];
+	/* Differences of the last period (period[0..4]) */
+	uint32_t delta[5];
+} Delta_state;
+
+static char _json[DECODE_JSON_MAX_LEN];
+/* Decompressed payload of an LZ frame */
+static uint8_t _lz[UINT16_MAX];
+static Delta_state _delta;
+
+
+/* Prototypes *****************************************************************/
+static uint16_t _get_u16 (const uint8_t *buf);
+static uint32_t _get_u32 (const uint8_t *buf);
+static size_t _get_field (const uint8_t *buf, const Payload_field *field,
+		void *data);
+static int _get_bit (const uint8_t *buf, size_t len, size_t *bit);
+static int _delta_period (const uint8_t *buf, size_t len, Delta_state *st,
+		int8_t is_first);
+static size_t _json_records (char *out, const uint8_t *buf, size_t len);
+static size_t _json_record (char *out, const Payload_decode_record *rec);
+static size_t _json_hash (char *out, const Payload_decoder *dec,
+		uint16_t device_id);
+static size_t _json_u32 (char *out, const char *key, uint32_t val);
+
+
+/* Functions ******************************************************************/
+
+void payload_decode_init (Payload_decoder *dec) {
+	memset(dec, 0, sizeof(*dec));
+}
+
+const Payload_decode_module *payload_decode_module (uint8_t id) {
+	for (size_t i = 0; i < sizeof(_modules) / sizeof(_modules[0]); i++) {
+		if (_modules[i].id == id) {
+			return &_modules[i];
+		}
+	}
+	return NULL;
+}
+
+size_t payload_decode_record (const uint8_t *buf, size_t len,
+		Payload_decode_record *rec) {
+
+	if (len < PAYLOAD_RECORD_HEADER_LEN) {
+		return 0;
+	}
+	size_t record_len = PAYLOAD_RECORD_HEADER_LEN + buf[2];
+	rec->module = payload_decode_module(buf[0] & ~PAYLOAD_RECORD_RBE);
+	if (record_len > len || rec->module == NULL) {
+		return 0;
+	}
+	rec->instance = buf[1];
+	memset(&rec->data, 0, sizeof(rec->data));
+
+	size_t n = PAYLOAD_RECORD_HEADER_LEN;
+	if (buf[0] & PAYLOAD_RECORD_RBE) {
+		if (n >= record_len) {
+			return 0;
+		}
+		rec->present = buf[n++];
+	}
+	else {
+		rec->present = (uint8_t)((1U << rec->module->numof) - 1);
+	}
+
+	for (uint8_t i = 0; i < rec->module->numof; i++) {
+		if (!(rec->present & (1U << i))) {
+			continue;
+		}
+		if (n + _type_len[rec->module->fields[i].type] > record_len) {
+			return 0;
+		}
+		n += _get_field(buf + n, &rec->module->fields[i], &rec->data);
+	}
+
+	/* Fields of a newer schema are skipped */
+	return record_len;
+}
+
+int8_t payload_decode_packed (const uint8_t *buf, size_t len, size_t *bit,
+		uint32_t *val) {
+	/* Width by number of leading ones of the prefix */
+	static const uint8_t width[] = { 0, 4, 8, 16, 32 };
+	uint8_t ones = 0;
+	int b;
+
+	while (ones < 4 && (b = _get_bit(buf, len, bit)) == 1) {
+		ones++;
+	}
+	if (ones < 4 && b < 0) {
+		return -1;
+	}
+
+	uint32_t z = 0;
+	for (uint8_t i = 0; i < width[ones]; i++) {
+		if ((b = _get_bit(buf, len, bit)) < 0) {
+			return -1;
+		}
+		z |= (uint32_t)b << i;
+	}
+	*val = (z >> 1) ^ (0U - (z & 1));
+	return 0;
+}
+
+int payload_decode_frame (Payload_decoder *dec, const uint8_t *buf,
+		size_t len, FILE *out) {
+
+	/* JSON payload, e.g. one LZ compression didn't make shorter */
+	if (len && buf[0] == '{') {
+		const uint8_t *end = memchr(buf, '\n', len);
+		if (end == NULL) {
+			return 0;
+		}
+		fwrite(buf, 1, end + 1 - buf, out);
+		return (int)(end + 1 - buf);
+	}
+
+	if (len < PAYLOAD_FRAME_HEADER_LEN) {
+		return (len && buf[0] != PAYLOAD_SYNC) ? -1 : 0;
+	}
+	if (buf[0] != PAYLOAD_SYNC || buf[2] < PAYLOAD_DECODE_SCHEMA_MIN ||
+			buf[2] > PAYLOAD_SCHEMA_VERSION) {
+		return -1;
+	}
+	size_t body_len = _get_u16(buf + 3);
+	if (PAYLOAD_FRAME_HEADER_LEN + body_len > len) {
+		return 0;
+	}
+	const uint8_t *body = buf + PAYLOAD_FRAME_HEADER_LEN;
+	size_t frame_len = PAYLOAD_FRAME_HEADER_LEN + body_len;
+	char *json = _json;
+	size_t n = 0;
+
+	switch (buf[1]) {
+	case PAYLOAD_FRAME_HELLO: {
+		if (body_len < 3 || 3 + (size_t)body[2] > body_len) {
+			return -1;
+		}
+		dec->device_id = _get_u16(body);
+		memcpy(dec->hash, body + 3, body[2]);
+		dec->hash[body[2]] = '\0';
+		return (int)frame_len;
+	}
+
+	case PAYLOAD_FRAME_DATA: {
+		if (body_len < SERIAL_DATA_BIN_HEADER_LEN) {
+			return -1;
+		}
+		json[n++] = '{';
+		n += _json_hash(json + n, dec, _get_u16(body));
+		json[n++] = ',';
+		n += payload_json_key(json + n, "", "data");
+		n += _json_records(json + n, body + SERIAL_DATA_BIN_HEADER_LEN,
+				body_len - SERIAL_DATA_BIN_HEADER_LEN);
+		n += _json_u32(json + n, "status", _get_u16(body + 2));
+		n += _json_u32(json + n, "error", _get_u16(body + 4));
+		n += _json_u32(json + n, "epoch", _get_u32(body + 6));
+		n += _json_u32(json + n, "period_start", _get_u32(body + 10));
+		n += _json_u32(json + n, "period_len", _get_u16(body + 14));
+		n += _json_u32(json + n, "partial", body[16]);
+		json[n++] = '}';
+		break;
+	}
+
+	case PAYLOAD_FRAME_BATCH: {
+		if (body_len < SERIAL_DATA_BIN_BATCH_HEADER_LEN) {
+			return -1;
+		}
+		json[n++] = '{';
+		n += _json_hash(json + n, dec, _get_u16(body));
+		json[n++] = ',';
+		n += payload_json_key(json + n, "", "periods");
+		json[n++] = '[';
+
+		size_t b = SERIAL_DATA_BIN_BATCH_HEADER_LEN;
+		for (uint8_t p = 0; p < body[4]; p++) {
+			const uint8_t *head = body + b;
+			if (b + SERIAL_DATA_BIN_PERIOD_HEADER_LEN > body_len) {
+				return -1;
+			}
+			size_t data_len = _get_u16(head + 17);
+			b += SERIAL_DATA_BIN_PERIOD_HEADER_LEN;
+			if (b + data_len > body_len) {
+				return -1;
+			}
+			if (p) {
+				json[n++] = ',';
+			}
+			json[n++] = '{';
+			n += payload_json_key(json + n, "", "data");
+			n += _json_records(json + n, body + b, data_len);
+			n += _json_u32(json + n, "error", _get_u16(head + 4));
+			n += _json_u32(json + n, "epoch", _get_u32(head + 6));
+			n += _json_u32(json + n, "period", _get_u32(head));
+			n += _json_u32(json + n, "period_start", _get_u32(head + 10));
+			n += _json_u32(json + n, "period_len", _get_u16(head + 14));
+			n += _json_u32(json + n, "partial", head[16]);
+			json[n++] = '}';
+			b += data_len;
+		}
+
+		json[n++] = ']';
+		n += _json_u32(json + n, "status", _get_u16(body + 2));
+		json[n++] = '}';
+		break;
+	}
+
+	case PAYLOAD_FRAME_DELTA: {
+		if (body_len < SERIAL_DATA_BIN_BATCH_HEADER_LEN) {
+			return -1;
+		}
+		json[n++] = '{';
+		n += _json_hash(json + n, dec, _get_u16(body));
+		json[n++] = ',';
+		n += payload_json_key(json + n, "", "periods");
+		json[n++] = '[';
+
+		Delta_state *st = &_delta;
+		size_t b = SERIAL_DATA_BIN_BATCH_HEADER_LEN;
+		for (uint8_t p = 0; p < body[4]; p++) {
+			int res = _delta_period(body + b, body_len - b, st, p == 0);
+			if (res < 0) {
+				return -1;
+			}
+			b += res;
+
+			if (p) {
+				json[n++] = ',';
+			}
+			json[n++] = '{';
+			n += payload_json_key(json + n, "", "data");
+			json[n++] = '{';
+			for (uint8_t r = 0, k = 0; r < st->len; r++) {
+				if (st->records[r].module == NULL) {
+					continue;
+				}
+				if (k++) {
+					json[n++] = ',';
+				}
+				n += _json_record(json + n, &st->records[r]);
+			}
+			json[n++] = '}';
+			n += _json_u32(json + n, "error", (uint16_t)st->period[1]);
+			n += _json_u32(json + n, "epoch", st->period[2]);
+			n += _json_u32(json + n, "period", st->period[0]);
+			n += _json_u32(json + n, "period_start", st->period[3]);
+			n += _json_u32(json + n, "period_len", (uint16_t)st->period[4]);
+			n += _json_u32(json + n, "partial", st->period[5]);
+			json[n++] = '}';
+		}
+		if (b != body_len) {
+			return -1;
+		}
+
+		json[n++] = ']';
+		n += _json_u32(json + n, "status", _get_u16(body + 2));
+		json[n++] = '}';
+		break;
+	}
+
+	case PAYLOAD_FRAME_LZ: {
+		if (body_len < 2) {
+			return -1;
+		}
+		/* Payload as it was before compression, a JSON one or a frame */
+		size_t lz_len = _get_u16(body);
+		if (lzss_decompress(body + 2, body_len - 2, _lz, sizeof(_lz)) !=
+				lz_len || lz_len < 2 || _lz[1] == PAYLOAD_FRAME_LZ ||
+				payload_decode_frame(dec, _lz, lz_len, out) != (int)lz_len) {
+			return -1;
+		}
+		return (int)frame_len;
+	}
+
+	default:
+		return -1;
+	}
+
+	json[n++] = '\n';
+	fwrite(json, 1, n, out);
+	return (int)frame_len;
+}
+
+
+/* Helpers ********************************************************************/
+
+static uint16_t _get_u16 (const uint8_t *buf) {
+	return (uint16_t)(buf[0] | (buf[1] << 8));
+}
+
+static uint32_t _get_u32 (const uint8_t *buf) {
+	return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) |
+			((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+/* Read field at its natural width into module's data structure (inverse
+ * of payload.c's _put_field()).
+ */
+static size_t _get_field (const uint8_t *buf, const Payload_field *field,
+		void *data) {
+	uint8_t *dst = (uint8_t *)data + field->offset;
+	switch (field->type) {
+	case PAYLOAD_TYPE_I8:
+		*(int *)dst = (int8_t)buf[0];
+		return 1;
+	case PAYLOAD_TYPE_I16:
+		*(int *)dst = (int16_t)_get_u16(buf);
+		return 2;
+	case PAYLOAD_TYPE_I32:
+		*(int *)dst = (int32_t)_get_u32(buf);
+		return 4;
+	case PAYLOAD_TYPE_U32:
+		*(uint32_t *)dst = _get_u32(buf);
+		return 4;
+	}
+	return 0;
+}
+
+/* Read a bit (LSB first), and advance the offset.
+ * return:
+ *  bit, -1 behind the end
+ */
+static int _get_bit (const uint8_t *buf, size_t len, size_t *bit) {
+	if (*bit >= 8 * len) {
+		return -1;
+	}
+	int val = (buf[*bit >> 3] >> (*bit & 7)) & 1;
+	(*bit)++;
+	return val;
+}
+
+/* Decode a period of a delta batch (serial_data.h): differences of every
+ * field added to the previous period's values (zero on the first), and
+ * changes of the period fields' differences. The first period's records
+ * start with a header, the layout of the later ones, and are terminated by
+ * module id 0. Fields of unknown modules and of a newer schema are skipped.
+ *  p1: period
+ *  p2: bytes available
+ *  p3: state, updated
+ *  p4: 1 on first period of the batch
+ * return:
+ *  number of bytes read, -1 on error
+ */
+static int _delta_period (const uint8_t *buf, size_t len, Delta_state *st,
+		int8_t is_first) {
+	size_t b = 0;
+	size_t bit;
+	uint32_t val;
+
+	if (is_first) {
+		memset(st, 0, sizeof(*st));
+	}
+	for (uint8_t r = 0; is_first || r < st->len; r++) {
+		if (is_first) {
+			if (b < len && buf[b] == 0) {
+				b++;
+				break;
+			}
+			if (r >= PAYLOAD_DECODE_DELTA_RECORDS_MAX ||
+					b + PAYLOAD_DELTA_HEADER_LEN > len) {
+				return -1;
+			}
+			st->records[r].module = payload_decode_module(buf[b]);
+			st->records[r].instance = buf[b + 1];
+			st->numof[r] = buf[b + 2];
+			st->len++;
+			b += PAYLOAD_DELTA_HEADER_LEN;
+		}
+
+		Payload_decode_record *rec = &st->records[r];
+		bit = 0;
+		for (uint8_t i = 0; i < st->numof[r]; i++) {
+			if (payload_decode_packed(buf + b, len - b, &bit, &val) != 0) {
+				return -1;
+			}
+			if (rec->module == NULL || i >= rec->module->numof) {
+				continue;
+			}
+			/* Sum wraps at 32 bits as the encoder's difference */
+			uint8_t *dst = rec->data.bytes + rec->module->fields[i].offset;
+			if (rec->module->fields[i].type == PAYLOAD_TYPE_U32) {
+				*(uint32_t *)dst += val;
+			}
+			else {
+				*(int *)dst = (int32_t)((uint32_t)*(int *)dst + val);
+			}
+			rec->present |= 1U << i;
+		}
+		b += (bit + 7) / 8;
+	}
+
+	bit = 0;
+	for (uint8_t i = 0; i < 6; i++) {
+		if (payload_decode_packed(buf + b, len - b, &bit, &val) != 0) {
+			return -1;
+		}
+		if (i == 5) {
+			/* Partial is sent as it is */
+			st->period[i] = val;
+			break;
+		}
+		uint32_t delta = st->delta[i] + val;
+		st->period[i] += delta;
+		st->delta[i] = is_first ? 0 : delta;
+	}
+	b += (bit + 7) / 8;
+
+	return (int)b;
+}
+
+/* Render module records as JSON module data ({r1,r2,...}). Records of
+ * unknown modules are left out.
+ */
+static size_t _json_records (char *out, const uint8_t *buf, size_t len) {
+	Payload_decode_record rec;
+	size_t n = 0;
+	size_t b = 0;
+
+	out[n++] = '{';
+	while (b + PAYLOAD_RECORD_HEADER_LEN <= len) {
+		size_t record_len = payload_decode_record(buf + b, len - b, &rec);
+		if (record_len == 0) {
+			/* Skip by its length, if the module is unknown */
+			record_len = PAYLOAD_RECORD_HEADER_LEN + buf[b + 2];
+			b += record_len;
+			continue;
+		}
+		b += record_len;
+
+		if (n > 1) {
+			out[n++] = ',';
+		}
+		n += _json_record(out + n, &rec);
+	}
+	out[n++] = '}';
+	return n;
+}
+
+/* Render a decoded record, keys prefixed as its instance's. */
+static size_t _json_record (char *out, const Payload_decode_record *rec) {
+	const char *prefix = (rec->instance < rec->module->instances) ?
+			rec->module->get_prefix(rec->instance) : "";
+	return payload_json_record_rbe(out, DECODE_JSON_MAX_LEN, prefix,
+			rec->module->fields, rec->module->numof, &rec->data,
+			rec->present);
+}
+
+/* "hash":"<hash>", "#<device id>" till the hello frame is received */
+static size_t _json_hash (char *out, const Payload_decoder *dec,
+		uint16_t device_id) {
+	size_t n = payload_json_key(out, "", "hash");
+	if (dec->hash[0] != '\0' && dec->device_id == device_id) {
+		return n + payload_json_str(out + n, dec->hash);
+	}
+	char id[sizeof("#65535")];
+	id[0] = '#';
+	id[1 + payload_utoa(id + 1, device_id)] = '\0';
+	return n + payload_json_str(out + n, id);
+}
+
+/* ,"<key>":<value> */
+static size_t _json_u32 (char *out, const char *key, uint32_t val) {
+	size_t n = 0;
+	out[n++] = ',';
+	n += payload_json_key(out + n, "", key);
+	n += payload_utoa(out + n, val);
+	return n;
+}
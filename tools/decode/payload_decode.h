@@ -0,0 +1,113 @@
+#ifndef PAYLOAD_DECODE_H
+#define PAYLOAD_DECODE_H
+
+#include "payload/payload.h"
+#include "serial_data/serial_data.h"
+
+#include <stdint.h>
+#include <stddef.h>		// size_t
+#include <stdio.h>
+
+
+/* Host decoder of binary payloads (see README, Host tests).
+ *  Frames are rendered to the JSON payload the firmware sends with
+ * SERIAL_DATA_ENCODING_JSON, built with the firmware's own JSON writers
+ * (payload.c), so a decoded binary capture compares byte for byte with a
+ * JSON one. Module schemas (field descriptors, key prefixes of instances)
+ * are taken from module headers, for the modules the decoder is built with
+ * (MODULE_*, as the firmware).
+ *  Binary (PAYLOAD_FRAME_DATA), binary batch (PAYLOAD_FRAME_BATCH) and
+ * delta batch (PAYLOAD_FRAME_DELTA) frames are decoded. LZ frames
+ * (PAYLOAD_FRAME_LZ) are decompressed (lzss_decode.h), and their payload is
+ * decoded in turn. JSON payloads (lines) are passed on as they are. Frames
+ * are expected as written on a raw data link (SERIAL_DATA_LINK_RAW), one
+ * after another, with a schema from PAYLOAD_DECODE_SCHEMA_MIN to
+ * PAYLOAD_SCHEMA_VERSION.
+ */
+
+/* Oldest schema decoded: 3 only added report-by-exception records, which
+ * frames of schema 2 don't hold */
+#define PAYLOAD_DECODE_SCHEMA_MIN	2
+/* Longest module data structure */
+#define PAYLOAD_DECODE_DATA_MAX_LEN	64
+/* Most module records per period of a delta batch */
+#define PAYLOAD_DECODE_DELTA_RECORDS_MAX	32
+
+/* Module schema */
+typedef struct {
+	uint8_t id;						/* Module id (high byte of mask) */
+	const char *name;
+	const Payload_field *fields;
+	uint8_t numof;					/* Number of fields */
+	uint8_t instances;				/* Number of instances */
+	const char *(*get_prefix)(uint8_t instance);
+} Payload_decode_module;
+
+/* Decoded module record */
+typedef struct {
+	const Payload_decode_module *module;
+	uint8_t instance;
+	uint8_t present;				/* Fields present (bit n: n-th field) */
+	/* Module's data structure, fields not present are zero */
+	union {
+		uint8_t bytes[PAYLOAD_DECODE_DATA_MAX_LEN];
+		uint32_t align;
+	} data;
+} Payload_decode_record;
+
+/* Decoder state: device id to hash mapping (hello frame). */
+typedef struct {
+	uint16_t device_id;
+	char hash[UINT8_MAX + 1];		/* Empty till the first hello frame */
+} Payload_decoder;
+
+
+/* Init decoder state.
+ *  p1: decoder
+ */
+void payload_decode_init (Payload_decoder *dec);
+
+/* Get module schema.
+ *  p1: module id
+ * return:
+ *  schema, NULL if the decoder doesn't know the module
+ */
+const Payload_decode_module *payload_decode_module (uint8_t id);
+
+/* Decode a module record (payload_bin_record(), payload_bin_record_rbe()).
+ *  p1: record
+ *  p2: bytes available
+ *  p3: pointer to where the decoded record will be written
+ * return:
+ *  record length, 0 if truncated or of an unknown module
+ */
+size_t payload_decode_record (const uint8_t *buf, size_t len,
+		Payload_decode_record *rec);
+
+/* Read a packed value (payload_put_packed()), zig-zag mapped back.
+ *  p1: buffer
+ *  p2: buffer length [bytes]
+ *  p3: bit offset, advanced
+ *  p4: pointer to where the value (32 bit, two's complement) is written
+ * return:
+ *  0 on success, -1 if truncated
+ */
+int8_t payload_decode_packed (const uint8_t *buf, size_t len, size_t *bit,
+		uint32_t *val);
+
+/* Decode frame, and write it as JSON payload (line). Hello frames are
+ * taken into decoder state, without output. A JSON payload is written as
+ * it is.
+ *  p1: decoder
+ *  p2: frame
+ *  p3: bytes available
+ *  p4: output
+ * return:
+ *  frame length, 0 if more bytes are needed, -1 if no valid frame starts
+ *  at p2 (skip a byte)
+ */
+int payload_decode_frame (Payload_decoder *dec, const uint8_t *buf,
+		size_t len, FILE *out);
+
+
+#endif
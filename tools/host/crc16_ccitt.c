@@ -0,0 +1,19 @@
+/* Host stand-in for RIOT (see README, Host tests): CRC16-CCITT, bitwise. */
+#include "checksum/crc16_ccitt.h"
+
+
+uint16_t crc16_ccitt_update (uint16_t crc, const unsigned char *buf,
+		size_t len) {
+	while (len--) {
+		crc ^= (uint16_t)(*buf++) << 8;
+		for (int i = 0; i < 8; i++) {
+			crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) :
+					(uint16_t)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+uint16_t crc16_ccitt_calc (const unsigned char *buf, size_t len) {
+	return crc16_ccitt_update(0x1D0F, buf, len);
+}
@@ -0,0 +1,33 @@
+/* Host stand-in for RIOT (see README, Host tests): glue between its parts. */
+#ifndef HOST_H
+#define HOST_H
+
+#include "kernel_types.h"
+#include "periph/uart.h"
+
+#include <stddef.h>
+
+
+/* Application's main(), renamed at compile time (-Dmain=host_app_main) */
+int host_app_main (void);
+
+/* kernel.c */
+void host_kernel_init (void);
+void host_isr (void (*handler)(void *arg), void *arg);
+int host_irq_enabled (void);
+/* Block running thread until host_thread_unblock() */
+void host_thread_block (void);
+void host_thread_unblock (kernel_pid_t pid);
+
+/* xtimer.c: run timer ISR, if one is due and interrupts are enabled */
+void host_poll_irq (void);
+
+/* periph.c: wait for the timer or UART input, and run their ISRs (idle
+ * thread). Exits, if there is nothing to wait for.
+ */
+void host_idle (void);
+/* periph.c: hand bytes to a UART's RX callback, as its ISR would (tests) */
+void host_uart_rx (uart_t dev, const uint8_t *data, size_t len);
+
+
+#endif
@@ -0,0 +1,17 @@
+/* Host stand-in for RIOT (see README, Host tests): CRC16-CCITT, same as
+ * RIOT's (polynomial 0x1021, not reflected, crc16_ccitt_calc() starting from
+ * 0x1D0F, i.e. CRC-16/AUG-CCITT).
+ */
+#ifndef CHECKSUM_CRC16_CCITT_H
+#define CHECKSUM_CRC16_CCITT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+uint16_t crc16_ccitt_update(uint16_t crc, const unsigned char *buf,
+		size_t len);
+uint16_t crc16_ccitt_calc(const unsigned char *buf, size_t len);
+
+
+#endif
@@ -0,0 +1,11 @@
+/* Host stand-in for RIOT (see README, Host tests): debug output, include
+ * after defining ENABLE_DEBUG.
+ */
+#include <stdio.h>
+
+#undef DEBUG
+#if ENABLE_DEBUG
+#define DEBUG(...)					printf(__VA_ARGS__)
+#else
+#define DEBUG(...)
+#endif
@@ -0,0 +1,9 @@
+/* Device hash of host builds (see README, hash.h). */
+#ifndef HASH_H
+#define HASH_H
+
+#define DEVICE_HASH_LEN				16+1
+#define DEVICE_HASH					"0123456789abcdef"
+
+
+#endif
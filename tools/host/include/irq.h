@@ -0,0 +1,16 @@
+/* Host stand-in for RIOT (see README, Host tests): interrupts.
+ *  There are no asynchronous interrupts. Pending ISRs (timer, UART RX) run
+ * when the CPU would take them: when interrupts get enabled, when a thread
+ * reads the time, or when all threads are blocked.
+ */
+#ifndef IRQ_H
+#define IRQ_H
+
+
+unsigned irq_disable(void);
+unsigned irq_enable(void);
+void irq_restore(unsigned state);
+int irq_is_in(void);
+
+
+#endif
@@ -0,0 +1,19 @@
+/* Host stand-in for RIOT (see README, Host tests): kernel types. */
+#ifndef KERNEL_TYPES_H
+#define KERNEL_TYPES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+typedef int16_t kernel_pid_t;
+
+#define KERNEL_PID_UNDEF			0
+#define KERNEL_PID_FIRST			(KERNEL_PID_UNDEF + 1)
+#define MAXTHREADS					16
+#define KERNEL_PID_LAST				(KERNEL_PID_FIRST + MAXTHREADS - 1)
+
+#define STATUS_NOT_FOUND			(-1)
+
+
+#endif
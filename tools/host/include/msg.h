@@ -0,0 +1,32 @@
+/* Host stand-in for RIOT (see README, Host tests): messages.
+ *  Same semantics as RIOT: a message goes to a thread blocked in
+ * msg_receive(), or to its queue. From an ISR, sending never blocks.
+ */
+#ifndef MSG_H
+#define MSG_H
+
+#include "kernel_types.h"
+
+
+typedef struct {
+	kernel_pid_t sender_pid;
+	uint16_t type;
+	union {
+		void *ptr;
+		uint32_t value;
+	} content;
+} msg_t;
+
+
+/* 1 if delivered, 0 if receiver isn't waiting and its queue is full (ISR),
+ * -1 on invalid pid */
+int msg_send(msg_t *m, kernel_pid_t target_pid);
+/* 1 if delivered, 0 if it would block, -1 on invalid pid */
+int msg_try_send(msg_t *m, kernel_pid_t target_pid);
+int msg_receive(msg_t *m);
+/* 1 if a message was received, -1 otherwise */
+int msg_try_receive(msg_t *m);
+void msg_init_queue(msg_t *array, int num);
+
+
+#endif
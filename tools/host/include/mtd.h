@@ -0,0 +1,52 @@
+/* Host stand-in for RIOT (see README, Host tests): MTD.
+ *  MTD_0 is file-backed, with the geometry of RIOT native's (256 B pages,
+ * 4 kB sectors, 8 MB). Writes behave like NOR flash (bits only cleared, up
+ * to a page). The file is HOST_MTD_FILE (environment), or MEMORY.bin.
+ */
+#ifndef MTD_H
+#define MTD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+#define MTD_PAGE_SIZE				(256)
+#define MTD_SECTOR_SIZE				(4096)
+#define MTD_SECTOR_NUM				(2048)
+
+typedef struct mtd_desc mtd_desc_t;
+
+typedef struct {
+	const mtd_desc_t *driver;
+	uint32_t sector_count;
+	uint32_t pages_per_sector;
+	uint32_t page_size;
+} mtd_dev_t;
+
+/* Operation counts of MTD_0, for benchmarks */
+typedef struct {
+	uint32_t reads;
+	uint32_t writes;
+	uint32_t erases;				/* Sectors */
+	uint64_t read_bytes;
+	uint64_t write_bytes;
+} mtd_host_stats_t;
+
+extern mtd_dev_t *mtd0;
+#define MTD_0						mtd0
+
+
+/* 0 on success, <0 on error */
+int mtd_init(mtd_dev_t *mtd);
+/* Bytes read, <0 on error */
+int mtd_read(mtd_dev_t *mtd, void *dest, uint32_t addr, uint32_t count);
+/* Bytes written, <0 on error (e.g. -EOVERFLOW across a page boundary) */
+int mtd_write(mtd_dev_t *mtd, const void *src, uint32_t addr,
+		uint32_t count);
+/* 0 on success, <0 on error (address and count sector aligned) */
+int mtd_erase(mtd_dev_t *mtd, uint32_t addr, uint32_t count);
+
+void mtd_host_get_stats(mtd_host_stats_t *stats);
+
+
+#endif
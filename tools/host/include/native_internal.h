@@ -0,0 +1,25 @@
+/* Host stand-in for RIOT (see README, Host tests): native board's access
+ * to the host's libc. The application already runs on it.
+ */
+#ifndef NATIVE_INTERNAL_H
+#define NATIVE_INTERNAL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+extern volatile int _native_in_isr;
+
+#define _native_syscall_enter()
+#define _native_syscall_leave()
+
+#define real_fopen					fopen
+#define real_fread					fread
+#define real_fwrite					fwrite
+#define real_fclose					fclose
+#define real_exit					exit
+#define real_clock_gettime			clock_gettime
+
+
+#endif
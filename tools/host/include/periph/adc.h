@@ -0,0 +1,26 @@
+/* Host stand-in for RIOT (see README, Host tests): ADC API, provided by
+ * sensor_sim.
+ */
+#ifndef PERIPH_ADC_H
+#define PERIPH_ADC_H
+
+
+typedef unsigned int adc_t;
+
+#define ADC_LINE(x)					((adc_t)(x))
+
+typedef enum {
+	ADC_RES_6BIT = 0,
+	ADC_RES_8BIT,
+	ADC_RES_10BIT,
+	ADC_RES_12BIT,
+	ADC_RES_14BIT,
+	ADC_RES_16BIT
+} adc_res_t;
+
+
+int adc_init(adc_t line);
+int adc_sample(adc_t line, adc_res_t res);
+
+
+#endif
@@ -0,0 +1,24 @@
+/* Host stand-in for RIOT (see README, Host tests): flash pages.
+ *  Pages are kept in RAM, erased (0xFF) at start, with the geometry of the
+ * SAMD21G18A. Written pages last for the run, so a program can init its
+ * modules again to see what a reboot would load.
+ */
+#ifndef PERIPH_FLASHPAGE_H
+#define PERIPH_FLASHPAGE_H
+
+
+#define FLASHPAGE_SIZE				(256U)
+#define FLASHPAGE_NUMOF				(1024U)
+
+enum {
+	FLASHPAGE_OK = 0,
+	FLASHPAGE_NOMATCH = -1
+};
+
+
+void *flashpage_addr(int page);
+void flashpage_write(int page, const void *data);
+int flashpage_write_and_verify(int page, const void *data);
+
+
+#endif
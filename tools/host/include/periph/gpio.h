@@ -0,0 +1,33 @@
+/* Host stand-in for RIOT (see README, Host tests): GPIO API, provided by
+ * sensor_sim.
+ */
+#ifndef PERIPH_GPIO_H
+#define PERIPH_GPIO_H
+
+#include <stdint.h>
+
+
+typedef unsigned int gpio_t;
+
+#define GPIO_UNDEF					((gpio_t)UINT32_MAX)
+#define GPIO_PIN(port, pin)			((gpio_t)(((port) << 8) | (pin)))
+
+typedef enum {
+	GPIO_IN,
+	GPIO_IN_PD,
+	GPIO_IN_PU,
+	GPIO_OUT,
+	GPIO_OD,
+	GPIO_OD_PU
+} gpio_mode_t;
+
+
+int gpio_init(gpio_t pin, gpio_mode_t mode);
+int gpio_read(gpio_t pin);
+void gpio_set(gpio_t pin);
+void gpio_clear(gpio_t pin);
+void gpio_toggle(gpio_t pin);
+void gpio_write(gpio_t pin, int value);
+
+
+#endif
@@ -0,0 +1,13 @@
+/* Host stand-in for RIOT (see README, Host tests): I2C bus handle, for
+ * sensor_sim's drivers.
+ */
+#ifndef PERIPH_I2C_H
+#define PERIPH_I2C_H
+
+
+typedef unsigned int i2c_t;
+
+#define I2C_DEV(x)					((i2c_t)(x))
+
+
+#endif
@@ -0,0 +1,11 @@
+/* Host stand-in for RIOT (see README, Host tests): power management. */
+#ifndef PERIPH_PM_H
+#define PERIPH_PM_H
+
+
+/* Exit with status 0 */
+void pm_off(void);
+void pm_reboot(void);
+
+
+#endif
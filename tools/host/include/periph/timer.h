@@ -0,0 +1,26 @@
+/* Host stand-in for RIOT (see README, Host tests): timer.
+ *  TIMER_DEV(0) is a 32 bit, 1 MHz timer on the host's monotonic clock,
+ * with one channel. sim_clock replaces it with virtual time.
+ */
+#ifndef PERIPH_TIMER_H
+#define PERIPH_TIMER_H
+
+
+typedef unsigned int tim_t;
+
+#define TIMER_DEV(x)				((tim_t)(x))
+#define TIMER_NUMOF					1
+
+typedef void (*timer_cb_t)(void *arg, int channel);
+
+
+int timer_init(tim_t dev, unsigned long freq, timer_cb_t cb, void *arg);
+int timer_set(tim_t dev, int channel, unsigned int timeout);
+int timer_set_absolute(tim_t dev, int channel, unsigned int value);
+int timer_clear(tim_t dev, int channel);
+unsigned int timer_read(tim_t dev);
+void timer_start(tim_t dev);
+void timer_stop(tim_t dev);
+
+
+#endif
@@ -0,0 +1,36 @@
+/* Host stand-in for RIOT (see README, Host tests): UART.
+ *  UART_DEV(n) is the n-th "-c <path>" command line argument (like RIOT
+ * native's), e.g. a pty. Without one, UART_DEV(0) writes to stdout, and
+ * other UARTs drop what is written.
+ */
+#ifndef PERIPH_UART_H
+#define PERIPH_UART_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+#ifndef UART_NUMOF
+#define UART_NUMOF					2
+#endif
+
+typedef unsigned int uart_t;
+
+#define UART_DEV(x)					((uart_t)(x))
+
+enum {
+	UART_OK = 0,
+	UART_NODEV = -1,
+	UART_NOBAUD = -2,
+	UART_INTERR = -3,
+	UART_NOMODE = -4
+};
+
+typedef void (*uart_rx_cb_t)(void *arg, uint8_t data);
+
+
+int uart_init(uart_t uart, uint32_t baudrate, uart_rx_cb_t rx_cb, void *arg);
+void uart_write(uart_t uart, const uint8_t *data, size_t len);
+
+
+#endif
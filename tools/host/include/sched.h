@@ -0,0 +1,14 @@
+/* Host stand-in for RIOT (see README, Host tests): scheduler. */
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "kernel_types.h"
+
+
+#define SCHED_PRIO_LEVELS			16
+
+/* Set by ISRs waking a thread of higher priority than the running one */
+extern volatile unsigned int sched_context_switch_request;
+
+
+#endif
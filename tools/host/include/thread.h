@@ -0,0 +1,37 @@
+/* Host stand-in for RIOT (see README, Host tests): threads.
+ *  Threads are coroutines with RIOT's scheduling rules: the highest priority
+ * runnable thread runs until it blocks, yields, or wakes a higher priority
+ * one. Stacks are host sized, whatever the application asks for.
+ */
+#ifndef THREAD_H
+#define THREAD_H
+
+#include "kernel_types.h"
+#include "sched.h"
+
+
+#define THREAD_STACKSIZE_DEFAULT	(64 * 1024)
+#define THREAD_STACKSIZE_MAIN		THREAD_STACKSIZE_DEFAULT
+
+#define THREAD_PRIORITY_MIN			(SCHED_PRIO_LEVELS - 1)
+#define THREAD_PRIORITY_IDLE		THREAD_PRIORITY_MIN
+#define THREAD_PRIORITY_MAIN		(THREAD_PRIORITY_MIN - (SCHED_PRIO_LEVELS / 2))
+
+#define THREAD_CREATE_SLEEPING		(1)
+#define THREAD_CREATE_STACKTEST		(8)
+
+typedef void *(*thread_task_func_t)(void *arg);
+
+
+kernel_pid_t thread_create(char *stack, int stacksize, uint8_t priority,
+		int flags, thread_task_func_t task_func, void *arg, const char *name);
+kernel_pid_t thread_getpid(void);
+const char *thread_getname(kernel_pid_t pid);
+void thread_sleep(void);
+/* 1 on success, STATUS_NOT_FOUND if the thread isn't sleeping */
+int thread_wakeup(kernel_pid_t pid);
+void thread_yield(void);
+void thread_yield_higher(void);
+
+
+#endif
@@ -0,0 +1,15 @@
+/* Host stand-in for RIOT (see README, Host tests): time units. */
+#ifndef TIMEX_H
+#define TIMEX_H
+
+#ifndef US_PER_SEC
+#define US_PER_SEC					(1000000U)
+#endif
+#define SEC_PER_MIN					(60U)
+#define MIN_PER_HOUR				(60U)
+#define US_PER_MS					(1000U)
+#define MS_PER_SEC					(1000U)
+#define NS_PER_US					(1000U)
+
+
+#endif
@@ -0,0 +1,42 @@
+/* Host stand-in for RIOT (see README, Host tests): xtimer.
+ *  Runs on periph timer XTIMER_DEV at 1 MHz, extended to 64 bit, like
+ * RIOT's. Reading the time lets a due timer ISR preempt the caller.
+ */
+#ifndef XTIMER_H
+#define XTIMER_H
+
+#include "kernel_types.h"
+#include "msg.h"
+#include "timex.h"
+#include "periph/timer.h"
+
+#include <stdint.h>
+
+
+#define XTIMER_DEV					TIMER_DEV(0)
+#define XTIMER_HZ					(1000000UL)
+/* Sleeps shorter than this spin instead of setting a timer [us] */
+#define XTIMER_BACKOFF				30
+
+typedef void (*xtimer_callback_t)(void *arg);
+
+typedef struct xtimer {
+	struct xtimer *next;
+	uint64_t target_us;
+	xtimer_callback_t callback;
+	void *arg;
+} xtimer_t;
+
+
+void xtimer_init(void);
+uint64_t xtimer_now_usec64(void);
+uint32_t xtimer_now_usec(void);
+void xtimer_usleep(uint32_t us);
+void xtimer_sleep(uint32_t s);
+void xtimer_set(xtimer_t *timer, uint32_t offset_us);
+void xtimer_set_msg(xtimer_t *timer, uint32_t offset_us, msg_t *msg,
+		kernel_pid_t target_pid);
+void xtimer_remove(xtimer_t *timer);
+
+
+#endif
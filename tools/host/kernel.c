@@ -0,0 +1,433 @@
+/* Host stand-in for RIOT (see README, Host tests): threads, scheduler, messages and
+ * interrupt state.
+ *  Threads are ucontext coroutines. Like RIOT, the highest priority runnable
+ * thread runs, threads of equal priority in FIFO order. "ISRs" run on the
+ * interrupted thread's stack (host_isr()); a thread of higher priority they
+ * wake runs right after.
+ */
+#include "host.h"
+
+#include "thread.h"
+#include "sched.h"
+#include "msg.h"
+#include "irq.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+
+typedef enum {
+	_STOPPED = 0,
+	_SLEEPING,
+	_RECEIVE_BLOCKED,
+	_SEND_BLOCKED,
+	_TIMER_BLOCKED,
+	_PENDING,
+	_RUNNING
+} Thread_status;
+
+typedef struct {
+	ucontext_t ctx;
+	Thread_status status;
+	uint8_t priority;
+	unsigned irq_disabled;			/* Interrupt state, saved on switch */
+	uint64_t order;					/* FIFO order within priority */
+	const char *name;
+	thread_task_func_t func;
+	void *arg;
+	/* Messages */
+	msg_t *queue;
+	unsigned queue_size;
+	unsigned queue_head;
+	unsigned queue_count;
+	msg_t *msg;						/* Receive buffer, or message to send */
+	kernel_pid_t send_to;
+} Thread;
+
+volatile unsigned int sched_context_switch_request;
+volatile int _native_in_isr;
+
+static Thread _threads[MAXTHREADS + 1];
+static Thread *_current;
+static uint64_t _order;
+static unsigned _irq_disabled;
+
+static char _idle_stack[THREAD_STACKSIZE_DEFAULT];
+static char _main_stack[THREAD_STACKSIZE_MAIN];
+static ucontext_t _start_ctx;
+
+
+/* Prototypes *****************************************************************/
+static void _trampoline (void);
+static void _set_pending (Thread *t);
+static Thread *_next (void);
+static void _switch (void);
+static void _block (Thread_status status);
+static int _deliver (Thread *target, msg_t *m);
+static Thread *_get (kernel_pid_t pid);
+static void *_idle (void *arg);
+static void *_main (void *arg);
+
+
+/* Threads ********************************************************************/
+
+kernel_pid_t thread_create (char *stack, int stacksize, uint8_t priority,
+		int flags, thread_task_func_t task_func, void *arg, const char *name) {
+	if (priority >= SCHED_PRIO_LEVELS) {
+		return -1;
+	}
+
+	kernel_pid_t pid;
+	for (pid = KERNEL_PID_FIRST; pid <= KERNEL_PID_LAST; pid++) {
+		if (_threads[pid].status == _STOPPED && _threads[pid].func == NULL) {
+			break;
+		}
+	}
+	if (pid > KERNEL_PID_LAST) {
+		return -1;
+	}
+
+	Thread *t = &_threads[pid];
+	memset(t, 0, sizeof(*t));
+	t->priority = priority;
+	t->name = name;
+	t->func = task_func;
+	t->arg = arg;
+
+	getcontext(&t->ctx);
+	t->ctx.uc_stack.ss_sp = stack;
+	t->ctx.uc_stack.ss_size = stacksize;
+	t->ctx.uc_link = NULL;
+	makecontext(&t->ctx, _trampoline, 0);
+
+	if (flags & THREAD_CREATE_SLEEPING) {
+		t->status = _SLEEPING;
+	}
+	else {
+		_set_pending(t);
+		if (_current != NULL && !irq_is_in() &&
+				priority < _current->priority) {
+			_switch();
+		}
+	}
+	return pid;
+}
+
+kernel_pid_t thread_getpid (void) {
+	return (kernel_pid_t)(_current - _threads);
+}
+
+const char *thread_getname (kernel_pid_t pid) {
+	Thread *t = _get(pid);
+	return (t != NULL) ? t->name : NULL;
+}
+
+void thread_sleep (void) {
+	if (irq_is_in()) {
+		return;
+	}
+	_block(_SLEEPING);
+}
+
+int thread_wakeup (kernel_pid_t pid) {
+	Thread *t = _get(pid);
+	if (t == NULL || t->status != _SLEEPING) {
+		return STATUS_NOT_FOUND;
+	}
+	host_thread_unblock(pid);
+	return 1;
+}
+
+void thread_yield (void) {
+	_current->order = ++_order;
+	_switch();
+}
+
+void thread_yield_higher (void) {
+	if (irq_is_in()) {
+		sched_context_switch_request = 1;
+		return;
+	}
+	_switch();
+}
+
+
+/* Messages *******************************************************************/
+
+void msg_init_queue (msg_t *array, int num) {
+	_current->queue = array;
+	_current->queue_size = num;
+	_current->queue_head = 0;
+	_current->queue_count = 0;
+}
+
+int msg_send (msg_t *m, kernel_pid_t target_pid) {
+	Thread *target = _get(target_pid);
+	if (target == NULL) {
+		return -1;
+	}
+	m->sender_pid = irq_is_in() ? KERNEL_PID_UNDEF : thread_getpid();
+	if (_deliver(target, m)) {
+		return 1;
+	}
+	if (irq_is_in()) {
+		return 0;
+	}
+
+	/* Block until the receiver takes it */
+	_current->msg = m;
+	_current->send_to = target_pid;
+	_block(_SEND_BLOCKED);
+	return 1;
+}
+
+int msg_try_send (msg_t *m, kernel_pid_t target_pid) {
+	Thread *target = _get(target_pid);
+	if (target == NULL) {
+		return -1;
+	}
+	m->sender_pid = irq_is_in() ? KERNEL_PID_UNDEF : thread_getpid();
+	return _deliver(target, m);
+}
+
+int msg_receive (msg_t *m) {
+	while (msg_try_receive(m) != 1) {
+		_current->msg = m;
+		_block(_RECEIVE_BLOCKED);
+		if (_current->msg == NULL) {
+			/* Sender copied the message in */
+			return 1;
+		}
+	}
+	return 1;
+}
+
+int msg_try_receive (msg_t *m) {
+	Thread *self = _current;
+
+	if (self->queue_count) {
+		*m = self->queue[self->queue_head];
+		self->queue_head = (self->queue_head + 1) % self->queue_size;
+		self->queue_count--;
+	}
+	else {
+		/* Take a message from a blocked sender */
+		Thread *sender = NULL;
+		for (kernel_pid_t pid = KERNEL_PID_FIRST; pid <= KERNEL_PID_LAST;
+				pid++) {
+			Thread *t = &_threads[pid];
+			if (t->status == _SEND_BLOCKED &&
+					t->send_to == thread_getpid() &&
+					(sender == NULL || t->order < sender->order)) {
+				sender = t;
+			}
+		}
+		if (sender == NULL) {
+			return -1;
+		}
+		*m = *sender->msg;
+		host_thread_unblock((kernel_pid_t)(sender - _threads));
+		return 1;
+	}
+
+	/* Room in queue: move a blocked sender's message in */
+	for (kernel_pid_t pid = KERNEL_PID_FIRST; pid <= KERNEL_PID_LAST; pid++) {
+		Thread *t = &_threads[pid];
+		if (t->status == _SEND_BLOCKED && t->send_to == thread_getpid()) {
+			_deliver(self, t->msg);
+			host_thread_unblock(pid);
+			break;
+		}
+	}
+	return 1;
+}
+
+
+/* Interrupts *****************************************************************/
+
+unsigned irq_disable (void) {
+	unsigned state = _irq_disabled;
+	_irq_disabled = 1;
+	return state;
+}
+
+unsigned irq_enable (void) {
+	unsigned state = _irq_disabled;
+	_irq_disabled = 0;
+	host_poll_irq();
+	return state;
+}
+
+void irq_restore (unsigned state) {
+	_irq_disabled = state;
+	if (!state) {
+		host_poll_irq();
+	}
+}
+
+int irq_is_in (void) {
+	return _native_in_isr;
+}
+
+
+/* Host ***********************************************************************/
+
+/* Run an ISR on the current stack, then switch if it woke a thread of
+ * higher priority.
+ */
+void host_isr (void (*handler)(void *arg), void *arg) {
+	unsigned state = _irq_disabled;
+	_irq_disabled = 1;
+	_native_in_isr = 1;
+	handler(arg);
+	_native_in_isr = 0;
+	_irq_disabled = state;
+
+	if (sched_context_switch_request) {
+		_switch();
+	}
+}
+
+/* Interrupts enabled and not in an ISR, i.e. an ISR could run now. */
+int host_irq_enabled (void) {
+	return !_irq_disabled && !_native_in_isr;
+}
+
+void host_thread_block (void) {
+	_block(_TIMER_BLOCKED);
+}
+
+void host_thread_unblock (kernel_pid_t pid) {
+	Thread *t = _get(pid);
+	if (t == NULL || t->status == _PENDING || t->status == _RUNNING) {
+		return;
+	}
+	_set_pending(t);
+	if (t->priority < _current->priority) {
+		if (irq_is_in()) {
+			sched_context_switch_request = 1;
+		}
+		else {
+			_switch();
+		}
+	}
+}
+
+/* Start idle and main threads, like RIOT's kernel_init(). Called from
+ * main() (periph.c) after parsing the command line, never returns.
+ */
+void host_kernel_init (void) {
+	thread_create(_idle_stack, sizeof(_idle_stack), THREAD_PRIORITY_IDLE, 0,
+			_idle, NULL, "idle");
+	thread_create(_main_stack, sizeof(_main_stack), THREAD_PRIORITY_MAIN, 0,
+			_main, NULL, "main");
+
+	_current = _next();
+	_current->status = _RUNNING;
+	swapcontext(&_start_ctx, &_current->ctx);
+	abort();
+}
+
+
+/* Helpers ********************************************************************/
+
+static void _trampoline (void) {
+	_current->func(_current->arg);
+
+	/* Thread exited, its slot is not reused */
+	_current->status = _STOPPED;
+	_switch();
+}
+
+static void _set_pending (Thread *t) {
+	t->status = _PENDING;
+	t->order = ++_order;
+}
+
+/* Highest priority runnable thread, the running one first among equals. */
+static Thread *_next (void) {
+	Thread *next = NULL;
+	for (kernel_pid_t pid = KERNEL_PID_FIRST; pid <= KERNEL_PID_LAST; pid++) {
+		Thread *t = &_threads[pid];
+		if (t->status != _PENDING && t->status != _RUNNING) {
+			continue;
+		}
+		if (next == NULL || t->priority < next->priority ||
+				(t->priority == next->priority && t->order < next->order)) {
+			next = t;
+		}
+	}
+	return next;
+}
+
+static void _switch (void) {
+	sched_context_switch_request = 0;
+
+	Thread *prev = _current;
+	Thread *next = _next();
+	if (next == NULL) {
+		fprintf(stderr, "host: no runnable thread\n");
+		exit(EXIT_FAILURE);
+	}
+	if (next == prev) {
+		return;
+	}
+
+	if (prev->status == _RUNNING) {
+		prev->status = _PENDING;
+	}
+	prev->irq_disabled = _irq_disabled;
+	next->status = _RUNNING;
+	_irq_disabled = next->irq_disabled;
+	_current = next;
+	swapcontext(&prev->ctx, &next->ctx);
+}
+
+static void _block (Thread_status status) {
+	_current->status = status;
+	_switch();
+}
+
+/* Hand message to a waiting receiver, or queue it.
+ * return:
+ *  1 if delivered, 0 if queue is full
+ */
+static int _deliver (Thread *target, msg_t *m) {
+	if (target->status == _RECEIVE_BLOCKED) {
+		*target->msg = *m;
+		target->msg = NULL;
+		host_thread_unblock((kernel_pid_t)(target - _threads));
+		return 1;
+	}
+	if (target->queue_count < target->queue_size) {
+		target->queue[(target->queue_head + target->queue_count) %
+				target->queue_size] = *m;
+		target->queue_count++;
+		return 1;
+	}
+	return 0;
+}
+
+static Thread *_get (kernel_pid_t pid) {
+	if (pid < KERNEL_PID_FIRST || pid > KERNEL_PID_LAST ||
+			_threads[pid].func == NULL) {
+		return NULL;
+	}
+	return &_threads[pid];
+}
+
+static void *_idle (void *arg) {
+	(void)arg;
+	while (1) {
+		host_idle();
+	}
+	return NULL;
+}
+
+static void *_main (void *arg) {
+	(void)arg;
+	host_app_main();
+	return NULL;
+}
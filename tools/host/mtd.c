@@ -0,0 +1,142 @@
+/* Host stand-in for RIOT (see README, Host tests): file-backed MTD_0.
+ *  Same geometry and checks as RIOT native's mtd_native: writes must not
+ * cross a page, erases are whole sectors. Like NOR flash, writing only
+ * clears bits (new = old & data).
+ */
+#include "mtd.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define HOST_MTD_FILE_DEFAULT		"MEMORY.bin"
+
+static mtd_dev_t _mtd0 = {
+	.driver = NULL,
+	.sector_count = MTD_SECTOR_NUM,
+	.pages_per_sector = MTD_SECTOR_SIZE / MTD_PAGE_SIZE,
+	.page_size = MTD_PAGE_SIZE,
+};
+mtd_dev_t *mtd0 = &_mtd0;
+
+static FILE *_file;
+static mtd_host_stats_t _stats;
+
+
+/* Prototypes *****************************************************************/
+static uint32_t _size (const mtd_dev_t *mtd);
+
+
+/* Functions ******************************************************************/
+
+/* Open the file, or create it erased. */
+int mtd_init (mtd_dev_t *mtd) {
+	if (mtd != mtd0) {
+		return -ENODEV;
+	}
+	if (_file != NULL) {
+		return 0;
+	}
+
+	const char *path = getenv("HOST_MTD_FILE");
+	if (path == NULL || *path == '\0') {
+		path = HOST_MTD_FILE_DEFAULT;
+	}
+	_file = fopen(path, "r+b");
+	if (_file == NULL) {
+		_file = fopen(path, "w+b");
+		if (_file == NULL) {
+			return -EIO;
+		}
+	}
+
+	fseek(_file, 0, SEEK_END);
+	long len = ftell(_file);
+	if (len < (long)_size(mtd)) {
+		uint8_t erased[MTD_SECTOR_SIZE];
+		memset(erased, 0xFF, sizeof(erased));
+		for (long i = len; i < (long)_size(mtd); i += sizeof(erased)) {
+			fwrite(erased, 1, sizeof(erased), _file);
+		}
+		fflush(_file);
+	}
+	return 0;
+}
+
+int mtd_read (mtd_dev_t *mtd, void *dest, uint32_t addr, uint32_t count) {
+	if (mtd != mtd0 || _file == NULL) {
+		return -ENODEV;
+	}
+	if (addr + count > _size(mtd)) {
+		return -EOVERFLOW;
+	}
+	fseek(_file, addr, SEEK_SET);
+	if (fread(dest, 1, count, _file) != count) {
+		return -EIO;
+	}
+	_stats.reads++;
+	_stats.read_bytes += count;
+	return count;
+}
+
+int mtd_write (mtd_dev_t *mtd, const void *src, uint32_t addr,
+		uint32_t count) {
+	if (mtd != mtd0 || _file == NULL) {
+		return -ENODEV;
+	}
+	if (addr + count > _size(mtd) ||
+			(addr % mtd->page_size) + count > mtd->page_size) {
+		return -EOVERFLOW;
+	}
+
+	uint8_t buf[MTD_PAGE_SIZE];
+	fseek(_file, addr, SEEK_SET);
+	if (fread(buf, 1, count, _file) != count) {
+		return -EIO;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		buf[i] &= ((const uint8_t *)src)[i];
+	}
+	fseek(_file, addr, SEEK_SET);
+	if (fwrite(buf, 1, count, _file) != count) {
+		return -EIO;
+	}
+	_stats.writes++;
+	_stats.write_bytes += count;
+	return count;
+}
+
+int mtd_erase (mtd_dev_t *mtd, uint32_t addr, uint32_t count) {
+	if (mtd != mtd0 || _file == NULL) {
+		return -ENODEV;
+	}
+	uint32_t sector_size = mtd->pages_per_sector * mtd->page_size;
+	if (addr + count > _size(mtd) ||
+			addr % sector_size || count % sector_size) {
+		return -EOVERFLOW;
+	}
+
+	uint8_t erased[MTD_SECTOR_SIZE];
+	memset(erased, 0xFF, sizeof(erased));
+	fseek(_file, addr, SEEK_SET);
+	for (uint32_t i = 0; i < count; i += sector_size) {
+		if (fwrite(erased, 1, sector_size, _file) != sector_size) {
+			return -EIO;
+		}
+		_stats.erases++;
+	}
+	return 0;
+}
+
+void mtd_host_get_stats (mtd_host_stats_t *stats) {
+	*stats = _stats;
+}
+
+
+/* Helpers ********************************************************************/
+
+static uint32_t _size (const mtd_dev_t *mtd) {
+	return mtd->sector_count * mtd->pages_per_sector * mtd->page_size;
+}
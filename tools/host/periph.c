@@ -0,0 +1,354 @@
+/* Host stand-in for RIOT (see README, Host tests): startup, idle loop, UART,
+ * flash pages, timer and power management.
+ *  The timer runs on the host's monotonic clock. Its functions are weak, so
+ * sim_clock (virtual time) replaces them when linked in.
+ */
+#define _GNU_SOURCE
+#include "host.h"
+
+#include "xtimer.h"
+#include "periph/timer.h"
+#include "periph/uart.h"
+#include "periph/pm.h"
+#include "periph/flashpage.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+
+#define HOST_UART_RX_CHUNK			64
+
+typedef struct {
+	const char *path;
+	int fd;
+	uint8_t rx_open;				/* fd is readable (tty, pipe, socket) */
+	uart_rx_cb_t rx_cb;
+	void *arg;
+	uint8_t rx_buf[HOST_UART_RX_CHUNK];
+	size_t rx_len;
+} Host_uart;
+
+typedef struct {
+	timer_cb_t cb;
+	void *arg;
+	uint64_t target_us;
+	uint8_t armed;
+	uint8_t running;
+} Host_timer;
+
+static Host_uart _uart[UART_NUMOF];
+static Host_timer _timer;
+static uint64_t _start_ns;
+static uint8_t _flash[FLASHPAGE_NUMOF][FLASHPAGE_SIZE];
+
+
+/* Prototypes *****************************************************************/
+static uint64_t _mono_ns (void);
+static uint64_t _timer_now_us (void);
+static void _timer_isr (void *arg);
+static void _uart_isr (void *arg);
+static int _open_uart (Host_uart *uart);
+
+
+/* Startup ********************************************************************/
+
+/* Like RIOT native: "-c <path>" once per UART, in order. */
+int main (int argc, char **argv) {
+	int uarts = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-c") == 0 && i + 1 < argc &&
+				uarts < UART_NUMOF) {
+			_uart[uarts++].path = argv[++i];
+		}
+		else {
+			fprintf(stderr, "usage: %s [-c <uart path>]...\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	for (int i = 0; i < UART_NUMOF; i++) {
+		_uart[i].fd = -1;
+	}
+
+	memset(_flash, 0xFF, sizeof(_flash));
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	_start_ns = _mono_ns();
+	xtimer_init();
+	host_kernel_init();
+	return EXIT_FAILURE;
+}
+
+
+/* Idle ***********************************************************************/
+
+void host_idle (void) {
+	struct pollfd fds[UART_NUMOF];
+	uart_t devs[UART_NUMOF];
+	nfds_t nfds = 0;
+
+	for (uart_t i = 0; i < UART_NUMOF; i++) {
+		if (_uart[i].rx_open && _uart[i].rx_cb != NULL) {
+			fds[nfds].fd = _uart[i].fd;
+			fds[nfds].events = POLLIN;
+			devs[nfds++] = i;
+		}
+	}
+
+	struct timespec timeout;
+	struct timespec *timeout_p = NULL;
+	if (_timer.armed && _timer.running) {
+		uint64_t now_us = _timer_now_us();
+		uint64_t wait_us = (_timer.target_us > now_us) ?
+				_timer.target_us - now_us : 0;
+		timeout.tv_sec = wait_us / US_PER_SEC;
+		timeout.tv_nsec = (wait_us % US_PER_SEC) * NS_PER_US;
+		timeout_p = &timeout;
+	}
+	else if (nfds == 0) {
+		fprintf(stderr, "host: all threads blocked, nothing to wait for\n");
+		exit(EXIT_FAILURE);
+	}
+
+	int res = ppoll(fds, nfds, timeout_p, NULL);
+	if (res < 0 && errno != EINTR) {
+		perror("host: ppoll");
+		exit(EXIT_FAILURE);
+	}
+
+	if (_timer.armed && _timer.running &&
+			_timer_now_us() >= _timer.target_us) {
+		_timer.armed = 0;
+		host_isr(_timer_isr, NULL);
+	}
+
+	for (nfds_t i = 0; res > 0 && i < nfds; i++) {
+		if (!fds[i].revents) {
+			continue;
+		}
+		Host_uart *uart = &_uart[devs[i]];
+		ssize_t len = read(uart->fd, uart->rx_buf, sizeof(uart->rx_buf));
+		if (len <= 0) {
+			/* EOF, or pty closed by the peer */
+			if (len == 0 || errno != EAGAIN) {
+				uart->rx_open = 0;
+			}
+			continue;
+		}
+		uart->rx_len = len;
+		host_isr(_uart_isr, uart);
+	}
+}
+
+
+/* UART ***********************************************************************/
+
+int uart_init (uart_t dev, uint32_t baudrate, uart_rx_cb_t rx_cb, void *arg) {
+	(void)baudrate;
+	if (dev >= UART_NUMOF) {
+		return UART_NODEV;
+	}
+	Host_uart *uart = &_uart[dev];
+	if (uart->path != NULL && uart->fd < 0 && _open_uart(uart) != 0) {
+		return UART_INTERR;
+	}
+	uart->rx_cb = rx_cb;
+	uart->arg = arg;
+	return UART_OK;
+}
+
+void uart_write (uart_t dev, const uint8_t *data, size_t len) {
+	if (dev >= UART_NUMOF) {
+		return;
+	}
+	Host_uart *uart = &_uart[dev];
+	if (uart->fd < 0) {
+		if (dev == UART_DEV(0)) {
+			fwrite(data, 1, len, stdout);
+		}
+		return;
+	}
+	while (len) {
+		ssize_t n = write(uart->fd, data, len);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EINTR) {
+				struct pollfd fd = { .fd = uart->fd, .events = POLLOUT };
+				poll(&fd, 1, -1);
+				continue;
+			}
+			/* Peer gone, like a disconnected line */
+			return;
+		}
+		data += n;
+		len -= n;
+	}
+}
+
+void host_uart_rx (uart_t dev, const uint8_t *data, size_t len) {
+	Host_uart *uart = &_uart[dev];
+	while (len && uart->rx_cb != NULL) {
+		size_t n = (len < sizeof(uart->rx_buf)) ? len : sizeof(uart->rx_buf);
+		memcpy(uart->rx_buf, data, n);
+		uart->rx_len = n;
+		host_isr(_uart_isr, uart);
+		data += n;
+		len -= n;
+	}
+}
+
+
+/* Flash page *****************************************************************/
+
+void *flashpage_addr (int page) {
+	return _flash[page];
+}
+
+void flashpage_write (int page, const void *data) {
+	if (data == NULL) {
+		memset(_flash[page], 0xFF, FLASHPAGE_SIZE);
+		return;
+	}
+	memcpy(_flash[page], data, FLASHPAGE_SIZE);
+}
+
+int flashpage_write_and_verify (int page, const void *data) {
+	flashpage_write(page, data);
+	if (data != NULL && memcmp(_flash[page], data, FLASHPAGE_SIZE) != 0) {
+		return FLASHPAGE_NOMATCH;
+	}
+	return FLASHPAGE_OK;
+}
+
+
+/* Timer (weak, see above) ****************************************************/
+
+__attribute__((weak))
+int timer_init (tim_t dev, unsigned long freq, timer_cb_t cb, void *arg) {
+	if (dev != TIMER_DEV(0) || freq != XTIMER_HZ) {
+		return -1;
+	}
+	_timer.cb = cb;
+	_timer.arg = arg;
+	_timer.running = 1;
+	return 0;
+}
+
+__attribute__((weak))
+int timer_set (tim_t dev, int channel, unsigned int timeout) {
+	if (dev != TIMER_DEV(0) || channel != 0) {
+		return -1;
+	}
+	_timer.target_us = _timer_now_us() + timeout;
+	_timer.armed = 1;
+	return 0;
+}
+
+__attribute__((weak))
+int timer_set_absolute (tim_t dev, int channel, unsigned int value) {
+	if (dev != TIMER_DEV(0) || channel != 0) {
+		return -1;
+	}
+	uint64_t now_us = _timer_now_us();
+	_timer.target_us = now_us + (uint32_t)(value - (uint32_t)now_us);
+	_timer.armed = 1;
+	return 0;
+}
+
+__attribute__((weak))
+int timer_clear (tim_t dev, int channel) {
+	if (dev != TIMER_DEV(0) || channel != 0) {
+		return -1;
+	}
+	_timer.armed = 0;
+	return 0;
+}
+
+__attribute__((weak))
+unsigned int timer_read (tim_t dev) {
+	(void)dev;
+	return (unsigned int)_timer_now_us();
+}
+
+__attribute__((weak))
+void timer_start (tim_t dev) {
+	(void)dev;
+	_timer.running = 1;
+}
+
+__attribute__((weak))
+void timer_stop (tim_t dev) {
+	(void)dev;
+	_timer.running = 0;
+}
+
+
+/* Power management ***********************************************************/
+
+void pm_off (void) {
+	fflush(stdout);
+	exit(EXIT_SUCCESS);
+}
+
+void pm_reboot (void) {
+	pm_off();
+}
+
+
+/* Helpers ********************************************************************/
+
+static uint64_t _mono_ns (void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * US_PER_SEC * NS_PER_US + ts.tv_nsec;
+}
+
+static uint64_t _timer_now_us (void) {
+	return (_mono_ns() - _start_ns) / NS_PER_US;
+}
+
+static void _timer_isr (void *arg) {
+	(void)arg;
+	_timer.cb(_timer.arg, 0);
+}
+
+static void _uart_isr (void *arg) {
+	Host_uart *uart = arg;
+	for (size_t i = 0; i < uart->rx_len; i++) {
+		uart->rx_cb(uart->arg, uart->rx_buf[i]);
+	}
+}
+
+/* Terminals and pipes are read and written, in raw mode. Anything else is
+ * an output file (e.g. a capture of the data link).
+ */
+static int _open_uart (Host_uart *uart) {
+	struct stat st;
+	if (stat(uart->path, &st) == 0 && !S_ISREG(st.st_mode)) {
+		uart->fd = open(uart->path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+		if (uart->fd < 0) {
+			perror(uart->path);
+			return -1;
+		}
+		struct termios tio;
+		if (tcgetattr(uart->fd, &tio) == 0) {
+			cfmakeraw(&tio);
+			tcsetattr(uart->fd, TCSANOW, &tio);
+		}
+		uart->rx_open = 1;
+		return 0;
+	}
+
+	uart->fd = open(uart->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (uart->fd < 0) {
+		perror(uart->path);
+		return -1;
+	}
+	return 0;
+}
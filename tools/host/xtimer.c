@@ -0,0 +1,190 @@
+/* Host stand-in for RIOT (see README, Host tests): xtimer.
+ *  Timers are kept in a list sorted by target, the periph timer is set to
+ * the first one. Its 32 bit counter is extended to 64 bit on every read.
+ *  On the board, the timer interrupt preempts whatever runs when the first
+ * timer is due. Here it can only run when the time is read (or interrupts
+ * get enabled), which is where a preempted thread would notice.
+ */
+#include "host.h"
+
+#include "xtimer.h"
+#include "thread.h"
+#include "irq.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+static xtimer_t *_list;
+static uint64_t _high;
+static uint32_t _last;
+
+
+/* Prototypes *****************************************************************/
+static uint64_t _now (void);
+static void _insert (xtimer_t *timer);
+static int _unlink (xtimer_t *timer);
+static void _arm (void);
+static void _periph_cb (void *arg, int channel);
+static void _isr (void *arg);
+static void _wake (void *arg);
+static void _send_msg (void *arg);
+
+
+/* Functions ******************************************************************/
+
+/* Called before main, again by applications: keeps timers set. */
+void xtimer_init (void) {
+	timer_init(XTIMER_DEV, XTIMER_HZ, _periph_cb, NULL);
+	_arm();
+}
+
+uint64_t xtimer_now_usec64 (void) {
+	uint64_t now = _now();
+	host_poll_irq();
+	return now;
+}
+
+uint32_t xtimer_now_usec (void) {
+	return (uint32_t)xtimer_now_usec64();
+}
+
+void xtimer_usleep (uint32_t us) {
+	if (irq_is_in()) {
+		/* Busy wait, as RIOT does in ISRs */
+		uint64_t end = _now() + us;
+		while (_now() < end) {}
+		return;
+	}
+	if (us < XTIMER_BACKOFF) {
+		/* Spin, as RIOT does: too short to set a timer. A due timer ISR
+		 * still preempts.
+		 */
+		uint64_t end = _now() + us;
+		while (_now() < end) {
+			host_poll_irq();
+		}
+		return;
+	}
+	xtimer_t timer = {
+		.callback = _wake,
+		.arg = (void *)(intptr_t)thread_getpid(),
+	};
+	xtimer_set(&timer, us);
+	host_thread_block();
+}
+
+void xtimer_sleep (uint32_t s) {
+	xtimer_usleep(s * US_PER_SEC);
+}
+
+void xtimer_set (xtimer_t *timer, uint32_t offset_us) {
+	_unlink(timer);
+	timer->target_us = _now() + offset_us;
+	_insert(timer);
+	if (_list == timer) {
+		_arm();
+	}
+}
+
+/* Like RIOT's: message's sender_pid holds the target until sent. */
+void xtimer_set_msg (xtimer_t *timer, uint32_t offset_us, msg_t *msg,
+		kernel_pid_t target_pid) {
+	msg->sender_pid = target_pid;
+	timer->callback = _send_msg;
+	timer->arg = msg;
+	xtimer_set(timer, offset_us);
+}
+
+void xtimer_remove (xtimer_t *timer) {
+	if (_unlink(timer) && _list == NULL) {
+		timer_clear(XTIMER_DEV, 0);
+	}
+}
+
+/* Timer ISR preempts the running thread, if due. Uses the last time read,
+ * so polling doesn't advance virtual time (sim_clock).
+ */
+void host_poll_irq (void) {
+	if (_list != NULL && host_irq_enabled() &&
+			_list->target_us <= (_high | _last)) {
+		host_isr(_isr, NULL);
+	}
+}
+
+
+/* Helpers ********************************************************************/
+
+static uint64_t _now (void) {
+	uint32_t now = timer_read(XTIMER_DEV);
+	if (now < _last) {
+		_high += (1ULL << 32);
+	}
+	_last = now;
+	return _high | now;
+}
+
+/* After timers with the same target, so they fire in order set. */
+static void _insert (xtimer_t *timer) {
+	xtimer_t **pos = &_list;
+	while (*pos != NULL && (*pos)->target_us <= timer->target_us) {
+		pos = &(*pos)->next;
+	}
+	timer->next = *pos;
+	*pos = timer;
+}
+
+/* return: 1 if timer was set, 0 otherwise */
+static int _unlink (xtimer_t *timer) {
+	for (xtimer_t **pos = &_list; *pos != NULL; pos = &(*pos)->next) {
+		if (*pos == timer) {
+			*pos = timer->next;
+			timer->next = NULL;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Set periph timer to the first target (relative, so a target already
+ * passed fires at once instead of after the counter wraps).
+ */
+static void _arm (void) {
+	if (_list == NULL) {
+		timer_clear(XTIMER_DEV, 0);
+		return;
+	}
+	uint64_t now = _now();
+	uint64_t offset = (_list->target_us > now) ? _list->target_us - now : 0;
+	if (offset > UINT32_MAX / 2) {
+		/* Fires early, and re-arms */
+		offset = UINT32_MAX / 2;
+	}
+	timer_set(XTIMER_DEV, 0, (unsigned int)offset);
+}
+
+static void _periph_cb (void *arg, int channel) {
+	(void)channel;
+	_isr(arg);
+}
+
+static void _isr (void *arg) {
+	(void)arg;
+	uint64_t now = _now();
+	while (_list != NULL && _list->target_us <= now) {
+		xtimer_t *timer = _list;
+		_list = timer->next;
+		timer->next = NULL;
+		timer->callback(timer->arg);
+	}
+	_arm();
+}
+
+static void _wake (void *arg) {
+	host_thread_unblock((kernel_pid_t)(intptr_t)arg);
+}
+
+static void _send_msg (void *arg) {
+	msg_t *msg = arg;
+	msg_send(msg, msg->sender_pid);
+}
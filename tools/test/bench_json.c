@@ -0,0 +1,229 @@
+/* JSON serialization before and after field descriptors (see README, Host
+ * tests), timed by the bench module.
+ *  "snprintf": as the firmware did up to the descriptor tables, a record per
+ * instance formatted into its own buffer with the module's format string,
+ * records joined into the data buffer, and the payload formatted around it.
+ * Format strings are copied from that version.
+ *  "direct": records written in place by payload_json_record(), head and
+ * tail by payload_json_key()/payload_utoa(), as serial_data does.
+ * Typical values of the default modules, one instance each.
+ */
+#include "bench/bench.h"
+#include "payload/payload.h"
+#include "wind_data/wind_data.h"
+#include "env_data/env_data.h"
+#include "el_data/el_data.h"
+
+#include "periph/pm.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/* Module format strings, before field descriptors */
+#define OLD_WIND_DATA_JSON_FORMAT		""\
+	"\"%swind_speed\":%d,"\
+	"\"%swind_direction\":%d,"\
+	"\"%swind_gust_speed\":%d,"\
+	"\"%swind_gust_peak\":%d,"\
+	"\"%swind_skew\":%lu"
+#define OLD_ENV_DATA_JSON_FORMAT	""\
+	"\"%sair_pressure\":%d,"\
+	"\"%sair_temp\":%d,"\
+	"\"%srel_humidity\":%d,"\
+	"\"%senv_skew\":%lu"
+#define OLD_EL_DATA_JSON_FORMAT		""\
+	"\"%svx\":%d,"\
+	"\"%spv_uoc\":%d,"\
+	"\"%spv_isc\":%d,"\
+	"\"%sel_skew\":%lu"
+#define OLD_SERIAL_DATA_JSON_FORMAT		""\
+	"{"\
+		"\"hash\":\"%s\","\
+		"\"status\":%u,"\
+		"\"error\":%u,"\
+		"\"epoch\":%lu,"\
+		"\"period_start\":%lu,"\
+		"\"partial\":%u,"\
+		"\"data\":%s"\
+	"}"\
+	"\n"
+
+#define BENCH_RECORD_LEN		160
+#define BENCH_PAYLOAD_LEN		512
+
+static const char _hash[] = "0123456789abcdef";
+static const Wind_data _wind = {
+	.wind_speed = 523, .wind_direction = 2250, .wind_gust_speed = 811,
+	.wind_gust_peak = 0, .wind_skew = 1234,
+};
+static const Env_data _env = {
+	.air_pressure = 10132, .air_temp = 215, .rel_humidity = 645,
+	.env_skew = 87,
+};
+static const El_data _el = {
+	.vx = 3312, .pv_uoc = 21540, .pv_isc = 412, .el_skew = 63120,
+};
+static const Payload_field _wind_fields[] = {
+	WIND_DATA_FIELDS(PAYLOAD_FIELD_DESC)
+};
+static const Payload_field _env_fields[] = {
+	ENV_DATA_FIELDS(PAYLOAD_FIELD_DESC)
+};
+static const Payload_field _el_fields[] = {
+	EL_DATA_FIELDS(PAYLOAD_FIELD_DESC)
+};
+
+/* Per instance buffers (snprintf), data buffer and payload */
+static char _wind_buf[BENCH_RECORD_LEN];
+static char _env_buf[BENCH_RECORD_LEN];
+static char _el_buf[BENCH_RECORD_LEN];
+static char _data_buf[BENCH_PAYLOAD_LEN];
+static char _payload_buf[BENCH_PAYLOAD_LEN];
+
+
+/* Prototypes *****************************************************************/
+static void _wind_snprintf (void *arg);
+static void _env_snprintf (void *arg);
+static void _el_snprintf (void *arg);
+static void _wind_direct (void *arg);
+static void _env_direct (void *arg);
+static void _el_direct (void *arg);
+static void _payload_snprintf (void *arg);
+static void _payload_direct (void *arg);
+static size_t _tail (char *buf, const char *key, uint32_t val);
+
+
+/* Functions ******************************************************************/
+
+int main (void) {
+	init_bench();
+
+	bench_run("json_wind_data_snprintf", NULL, _wind_snprintf, NULL);
+	bench_run("json_wind_data_direct", NULL, _wind_direct, NULL);
+	bench_run("json_env_data_snprintf", NULL, _env_snprintf, NULL);
+	bench_run("json_env_data_direct", NULL, _env_direct, NULL);
+	bench_run("json_el_data_snprintf", NULL, _el_snprintf, NULL);
+	bench_run("json_el_data_direct", NULL, _el_direct, NULL);
+	bench_run("json_payload_snprintf", NULL, _payload_snprintf, NULL);
+	bench_run("json_payload_direct", NULL, _payload_direct, NULL);
+
+	/* Both must produce the same payload */
+	_payload_snprintf(NULL);
+	_payload_direct(NULL);
+	printf("bench_json: snprintf %u B, direct %u B, %s\n",
+			(unsigned)strlen(_payload_buf), (unsigned)strlen(_data_buf),
+			strcmp(_payload_buf, _data_buf) ? "differ" : "equal");
+
+	pm_off();
+	return 0;
+}
+
+
+/* Helpers ********************************************************************/
+
+static void _wind_snprintf (void *arg) {
+	(void)arg;
+	const char *prefix = "";
+	snprintf(_wind_buf, sizeof(_wind_buf), OLD_WIND_DATA_JSON_FORMAT,
+			prefix, _wind.wind_speed,
+			prefix, _wind.wind_direction,
+			prefix, _wind.wind_gust_speed,
+			prefix, _wind.wind_gust_peak,
+			prefix, (unsigned long)_wind.wind_skew);
+}
+
+static void _env_snprintf (void *arg) {
+	(void)arg;
+	const char *prefix = "";
+	snprintf(_env_buf, sizeof(_env_buf), OLD_ENV_DATA_JSON_FORMAT,
+			prefix, _env.air_pressure,
+			prefix, _env.air_temp,
+			prefix, _env.rel_humidity,
+			prefix, (unsigned long)_env.env_skew);
+}
+
+static void _el_snprintf (void *arg) {
+	(void)arg;
+	const char *prefix = "";
+	snprintf(_el_buf, sizeof(_el_buf), OLD_EL_DATA_JSON_FORMAT,
+			prefix, _el.vx,
+			prefix, _el.pv_uoc,
+			prefix, _el.pv_isc,
+			prefix, (unsigned long)_el.el_skew);
+}
+
+static void _wind_direct (void *arg) {
+	(void)arg;
+	payload_json_record(_wind_buf, sizeof(_wind_buf), "", _wind_fields,
+			WIND_DATA_FIELDS_NUMOF, &_wind);
+}
+
+static void _env_direct (void *arg) {
+	(void)arg;
+	payload_json_record(_env_buf, sizeof(_env_buf), "", _env_fields,
+			ENV_DATA_FIELDS_NUMOF, &_env);
+}
+
+static void _el_direct (void *arg) {
+	(void)arg;
+	payload_json_record(_el_buf, sizeof(_el_buf), "", _el_fields,
+			EL_DATA_FIELDS_NUMOF, &_el);
+}
+
+/* Records, joined into data buffer, payload around it (3 copies). */
+static void _payload_snprintf (void *arg) {
+	_wind_snprintf(arg);
+	_env_snprintf(arg);
+	_el_snprintf(arg);
+
+	char data[BENCH_PAYLOAD_LEN];
+	size_t len = snprintf(data, sizeof(data), "{");
+	len += snprintf(data + len, sizeof(data) - len, "%s%s", "", _wind_buf);
+	len += snprintf(data + len, sizeof(data) - len, "%s%s", ",", _env_buf);
+	len += snprintf(data + len, sizeof(data) - len, "%s%s", ",", _el_buf);
+	len += snprintf(data + len, sizeof(data) - len, "}");
+
+	snprintf(_payload_buf, sizeof(_payload_buf), OLD_SERIAL_DATA_JSON_FORMAT,
+			_hash, 0x0700U, 0U, 123456UL, 1700000000UL, 0U, data);
+}
+
+/* Records written in place, behind the head, tail behind them. */
+static void _payload_direct (void *arg) {
+	(void)arg;
+	char *buf = _data_buf;
+	size_t n = 0;
+	buf[n++] = '{';
+	n += payload_json_key(buf + n, "", "hash");
+	n += payload_json_str(buf + n, _hash);
+	buf[n++] = ',';
+	n += _tail(buf + n - 1, "status", 0x0700U) - 1;
+	n += _tail(buf + n, "error", 0);
+	n += _tail(buf + n, "epoch", 123456UL);
+	n += _tail(buf + n, "period_start", 1700000000UL);
+	n += _tail(buf + n, "partial", 0);
+	buf[n++] = ',';
+	n += payload_json_key(buf + n, "", "data");
+	buf[n++] = '{';
+	n += payload_json_record(buf + n, BENCH_PAYLOAD_LEN - n, "",
+			_wind_fields, WIND_DATA_FIELDS_NUMOF, &_wind);
+	buf[n++] = ',';
+	n += payload_json_record(buf + n, BENCH_PAYLOAD_LEN - n, "",
+			_env_fields, ENV_DATA_FIELDS_NUMOF, &_env);
+	buf[n++] = ',';
+	n += payload_json_record(buf + n, BENCH_PAYLOAD_LEN - n, "",
+			_el_fields, EL_DATA_FIELDS_NUMOF, &_el);
+	buf[n++] = '}';
+	buf[n++] = '}';
+	buf[n++] = '\n';
+	buf[n] = '\0';
+}
+
+/* ,"<key>":<value> */
+static size_t _tail (char *buf, const char *key, uint32_t val) {
+	size_t n = 0;
+	buf[n++] = ',';
+	n += payload_json_key(buf + n, "", key);
+	n += payload_utoa(buf + n, val);
+	return n;
+}
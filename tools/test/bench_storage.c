@@ -0,0 +1,153 @@
+/* Store-and-forward FIFO on the host's file-backed MTD (see README, Host
+ * tests): capacity, write amplification and drain rate of data_storage.
+ *  Region as on SAMD21: 8 blocks of 4 kB (DATA_STORAGE_BLOCK_SECTORS=1 with
+ * the host's 4 kB sectors). Record sizes of a JSON payload (sim_json), a
+ * binary one (sim_bin) and an LZ compressed batch of 10 periods (sim_lz).
+ *  Capacity: records pending when the ring is first full (next push erases
+ * the oldest block). Write amplification: bytes programmed and erased per
+ * payload byte, over 4 passes through the ring, each record drained right
+ * after it is stored. Drain rate: peek and pop of a record, timed by the
+ * bench module (file I/O on the host, not flash timing).
+ */
+#include "bench/bench.h"
+#include "data_storage/data_storage.h"
+
+#include "mtd.h"
+#include "periph/pm.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+#define BENCH_STORAGE_PASSES		4
+#define BENCH_STORAGE_BUF_LEN		512
+
+typedef struct {
+	const char *name;
+	uint16_t len;
+} Record_size;
+
+static const Record_size _sizes[] = {
+	{ "json", 334 },
+	{ "bin", 60 },
+	{ "lz", 278 },
+};
+
+static uint8_t _buf[BENCH_STORAGE_BUF_LEN];
+static size_t _len;
+
+
+/* Prototypes *****************************************************************/
+static void _reset (void);
+static uint32_t _capacity (void);
+static void _amplification (uint32_t capacity);
+static void _push (void *arg);
+static void _drain (void *arg);
+
+
+/* Functions ******************************************************************/
+
+int main (void) {
+	for (size_t i = 0; i < sizeof(_buf); i++) {
+		_buf[i] = (uint8_t)(i * 7 + 1);
+	}
+
+	init_bench();
+	for (size_t i = 0; i < sizeof(_sizes) / sizeof(_sizes[0]); i++) {
+		char name[32];
+		_len = _sizes[i].len;
+
+		_reset();
+		uint32_t capacity = _capacity();
+		printf("bench_storage: %s %u B: capacity %lu records (%lu B)\n",
+				_sizes[i].name, (unsigned)_len, (unsigned long)capacity,
+				(unsigned long)(capacity * _len));
+
+		_reset();
+		_amplification(capacity);
+
+		_reset();
+		snprintf(name, sizeof(name), "storage_push_%s", _sizes[i].name);
+		bench_run(name, NULL, _push, NULL);
+		_reset();
+		snprintf(name, sizeof(name), "storage_drain_%s", _sizes[i].name);
+		bench_run(name, _push, _drain, NULL);
+	}
+
+	pm_off();
+	return 0;
+}
+
+
+/* Helpers ********************************************************************/
+
+/* Erase region and recover the (empty) ring. */
+static void _reset (void) {
+	uint32_t sector_len = DATA_STORAGE_MTD->pages_per_sector *
+			DATA_STORAGE_MTD->page_size;
+	if (mtd_init(DATA_STORAGE_MTD) != 0 ||
+			mtd_erase(DATA_STORAGE_MTD,
+			DATA_STORAGE_FIRST_SECTOR * sector_len,
+			DATA_STORAGE_SECTORS * sector_len) != 0 ||
+			init_data_storage() != 0) {
+		printf("bench_storage: FAIL: reset\n");
+		pm_off();
+	}
+}
+
+/* Push till a record is overwritten. */
+static uint32_t _capacity (void) {
+	Data_storage_stats stats;
+	uint32_t pending;
+	do {
+		get_data_storage_stats(&stats);
+		pending = stats.pending;
+		_push(NULL);
+		get_data_storage_stats(&stats);
+	} while (!stats.overwritten);
+	return pending;
+}
+
+/* Store and drain records, count what the MTD programs and erases. */
+static void _amplification (uint32_t capacity) {
+	mtd_host_stats_t before, after;
+	mtd_host_get_stats(&before);
+
+	uint32_t records = BENCH_STORAGE_PASSES * capacity;
+	for (uint32_t i = 0; i < records; i++) {
+		_push(NULL);
+		_drain(NULL);
+	}
+
+	mtd_host_get_stats(&after);
+	uint64_t payload = (uint64_t)records * _len;
+	uint64_t programmed = after.write_bytes - before.write_bytes;
+	uint64_t erased = (uint64_t)(after.erases - before.erases) *
+			DATA_STORAGE_MTD->pages_per_sector * DATA_STORAGE_MTD->page_size;
+	printf("bench_storage: %u B: %lu records, programmed %lu.%02lu x, "
+			"erased %lu.%02lu x payload, %lu writes per record\n",
+			(unsigned)_len, (unsigned long)records,
+			(unsigned long)(programmed / payload),
+			(unsigned long)(programmed * 100 / payload % 100),
+			(unsigned long)(erased / payload),
+			(unsigned long)(erased * 100 / payload % 100),
+			(unsigned long)((after.writes - before.writes) / records));
+}
+
+static void _push (void *arg) {
+	(void)arg;
+	if (data_storage_push(_buf, _len) != 0) {
+		printf("bench_storage: FAIL: push\n");
+		pm_off();
+	}
+}
+
+static void _drain (void *arg) {
+	(void)arg;
+	uint8_t buf[BENCH_STORAGE_BUF_LEN];
+	if (data_storage_peek(buf, sizeof(buf)) != (int)_len ||
+			memcmp(buf, _buf, _len) != 0 || data_storage_pop() != 0) {
+		printf("bench_storage: FAIL: drain\n");
+		pm_off();
+	}
+}
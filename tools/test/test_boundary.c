@@ -0,0 +1,286 @@
+/* Double-buffered accumulators of the real modules across period boundaries
+ * (see README, Host tests).
+ *  The module table and tasks of the application (tasks.c) run wind_data,
+ * env_data and el_data on the simulated sensors, fed with constant values
+ * (SENSOR_SIM_TRACE), on virtual time (sim_clock). The tick is main.c's:
+ * capture the epoch, close the period every TEST_TICKS_PER_PERIOD ticks,
+ * wake the module tasks and, on a boundary, the finalizing thread at the
+ * serial task's priority (SERIAL_DATA_TASK_PRIORITY).
+ *  INA220 conversions are slowed down (Makefile), so an electrical cycle
+ * spans more than a tick, and cycles started on a period's last tick cross
+ * the boundary, still writing the bank chosen at cycle start.
+ *  Before each get_avg_*, the finalizer checks the closed bank: wind and
+ * environmental banks hold one sample per tick of the period, all banks
+ * are tagged with the closed period, and averages of the constant inputs
+ * stay the same (a cycle split between banks would change them). At the
+ * end, samples in the banks must add up to those the tasks took.
+ */
+#include "tasks/tasks.h"
+#include "sample_epoch/sample_epoch.h"
+#include "sensor_sim/sensor_sim.h"
+#include "sim_clock/sim_clock.h"
+#include "wind_data/wind_data.h"
+#include "env_data/env_data.h"
+#include "el_data/el_data.h"
+#include "sys_control.h"
+
+#include "thread.h"
+#include "xtimer.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/* Tick [us] and period length [ticks] */
+#define TEST_TICK_US				100000U
+#define TEST_TICKS_PER_PERIOD		5U
+/* Periods checked, see sim_clock stop time in Makefile */
+#define TEST_PERIODS_MIN			1000U
+/* Modules in the table, averages compared per instance */
+#define TEST_MODULES_MAX			4
+#define TEST_AVG_NUMOF				3
+
+uint16_t sys_error;
+
+static char _final_stack[THREAD_STACKSIZE_DEFAULT];
+static kernel_pid_t _final_pid;
+static xtimer_t _tick;
+
+/* Samples in finalized banks, per module */
+static uint32_t _finalized[TEST_MODULES_MAX];
+/* Averages of the first period, per instance (inputs are constant) */
+static int32_t _ref[TEST_MODULES_MAX][SYS_MODULE_INSTANCES_MAX]
+		[TEST_AVG_NUMOF];
+static uint8_t _has_ref[TEST_MODULES_MAX];
+static uint32_t _periods;
+static uint32_t _crossed;			/* Cycles started on a period's last tick */
+static uint32_t _errors;
+
+
+/* Prototypes *****************************************************************/
+static void _tick_cb (void *arg);
+static void *_final_thread (void *arg);
+static void _check_bank (size_t i, uint8_t n, const Sample_period *period);
+static int _bank (const Sys_module *module, uint8_t n, uint8_t b,
+		Sample_epoch *epoch);
+static uint8_t _avg (const Sys_module *module, const void *data,
+		int32_t *avg);
+static int8_t _stop (void);
+
+
+/* Functions ******************************************************************/
+
+int main (void) {
+	init_sim_clock(_stop);
+	if (init_sensor_sim() != 0 || sys_modules_numof > TEST_MODULES_MAX) {
+		printf("test_boundary: FAIL: init\n");
+		return 1;
+	}
+	init_sys_modules();
+	if (sys_error) {
+		printf("test_boundary: FAIL: init modules, sys_error 0x%04x\n",
+				sys_error);
+		return 1;
+	}
+	create_sys_module_tasks();
+	_final_pid = thread_create(_final_stack, sizeof(_final_stack),
+			SERIAL_DATA_TASK_PRIORITY, 0, _final_thread, NULL, "final");
+
+	_tick.callback = _tick_cb;
+	xtimer_set(&_tick, TEST_TICK_US);
+	thread_sleep();
+	return 0;
+}
+
+
+/* Helpers ********************************************************************/
+
+/* As main.c: close the period before waking module tasks. */
+static void _tick_cb (void *arg) {
+	(void)arg;
+	static uint16_t ticks;
+	xtimer_set(&_tick, TEST_TICK_US);
+
+	Sample_epoch epoch;
+	sample_epoch_capture();
+	sample_epoch_get(&epoch);
+
+	int8_t is_period_end = 0;
+	if (++ticks >= TEST_TICKS_PER_PERIOD) {
+		Sample_period period;
+		memset(&period, 0, sizeof(period));
+		period.epoch = epoch.sequence;
+		sample_epoch_close_period(&period);
+		ticks = 0;
+		is_period_end = 1;
+	}
+
+	wakeup_sys_module_tasks(epoch.sequence);
+	if (is_period_end) {
+		thread_wakeup(_final_pid);
+	}
+}
+
+static void *_final_thread (void *arg) {
+	(void)arg;
+
+	while (1) {
+		thread_sleep();
+
+		Sample_period period;
+		sample_epoch_get_period(&period);
+		for (size_t i = 0; i < sys_modules_numof; i++) {
+			for (uint8_t n = 0; n < sys_modules[i].numof; n++) {
+				_check_bank(i, n, &period);
+			}
+		}
+		_periods++;
+	}
+	return NULL;
+}
+
+/* Check closed bank of a module instance, then finalize it. */
+static void _check_bank (size_t i, uint8_t n, const Sample_period *period) {
+	const Sys_module *module = &sys_modules[i];
+	void *dev = (char *)module->devs + n * module->dev_size;
+	Sample_epoch epoch;
+	int samples = _bank(module, n, SAMPLE_EPOCH_BANK(period->index), &epoch);
+
+	/* First period misses the tick at 0 */
+	if (samples == 0 && period->index > 0) {
+		printf("FAIL: period %lu: %s[%u]: no samples\n",
+				(unsigned long)period->index, module->name, n);
+		_errors++;
+	}
+	if (samples > 0 && epoch.period != period->index) {
+		printf("FAIL: period %lu: %s[%u]: bank holds samples of period "
+				"%lu\n", (unsigned long)period->index, module->name, n,
+				(unsigned long)epoch.period);
+		_errors++;
+	}
+	if (module->mask == SYS_EL_DATA_MASK) {
+		_crossed += (samples > 0 && epoch.sequence + 1 == period->epoch);
+	}
+	else if (period->index > 0 && samples != TEST_TICKS_PER_PERIOD) {
+		printf("FAIL: period %lu: %s[%u]: %d samples in bank, %u ticks\n",
+				(unsigned long)period->index, module->name, n, samples,
+				TEST_TICKS_PER_PERIOD);
+		_errors++;
+	}
+	_finalized[i] += samples;
+
+	int32_t avg[TEST_AVG_NUMOF];
+	uint8_t numof = _avg(module, module->get_avg(dev), avg);
+	if (numof == 0 || samples == 0) {
+		return;
+	}
+	if (!(_has_ref[i] & (1U << n))) {
+		memcpy(_ref[i][n], avg, sizeof(avg));
+		_has_ref[i] |= (1U << n);
+	}
+	else if (memcmp(_ref[i][n], avg, numof * sizeof(avg[0])) != 0) {
+		printf("FAIL: period %lu: %s[%u]: averages %ld %ld %ld, expected "
+				"%ld %ld %ld\n", (unsigned long)period->index, module->name,
+				n, (long)avg[0], (long)avg[1], (long)avg[2],
+				(long)_ref[i][n][0], (long)_ref[i][n][1],
+				(long)_ref[i][n][2]);
+		_errors++;
+	}
+}
+
+/* Samples in a bank of a module instance, and the epoch of the latest.
+ * return:
+ *  number of samples
+ */
+static int _bank (const Sys_module *module, uint8_t n, uint8_t b,
+		Sample_epoch *epoch) {
+	switch (module->mask) {
+	case SYS_WIND_DATA_MASK: {
+		Intermediate_wind_data *bank =
+				&((Wind_data_dev *)module->devs)[n].intermediate[b];
+		*epoch = bank->epoch;
+		return bank->average_counter;
+	}
+	case SYS_ENV_DATA_MASK: {
+		Intermediate_env_data *bank =
+				&((Env_data_dev *)module->devs)[n].intermediate[b];
+		*epoch = bank->epoch;
+		return bank->average_counter;
+	}
+	case SYS_EL_DATA_MASK: {
+		Intermediate_el_data *bank =
+				&((El_data_dev *)module->devs)[n].intermediate[b];
+		*epoch = bank->epoch;
+		return bank->average_counter;
+	}
+	default:
+		memset(epoch, 0, sizeof(*epoch));
+		return 0;
+	}
+}
+
+/* Averages which must not change with constant inputs (wind speed counts
+ * pulses, which don't align with ticks).
+ * return:
+ *  number of averages
+ */
+static uint8_t _avg (const Sys_module *module, const void *data,
+		int32_t *avg) {
+	memset(avg, 0, TEST_AVG_NUMOF * sizeof(avg[0]));
+	if (module->mask == SYS_ENV_DATA_MASK) {
+		const Env_data *env = data;
+		avg[0] = env->air_pressure;
+		avg[1] = env->air_temp;
+		avg[2] = env->rel_humidity;
+		return 3;
+	}
+	if (module->mask == SYS_EL_DATA_MASK) {
+		const El_data *el = data;
+		avg[0] = el->vx;
+		avg[1] = el->pv_uoc;
+		avg[2] = el->pv_isc;
+		return 3;
+	}
+	return 0;
+}
+
+static int8_t _stop (void) {
+	uint32_t samples = 0;
+
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		const Sys_module *module = &sys_modules[i];
+		Sys_task_stats stats;
+		get_sys_module_task_stats(i, &stats);
+
+		/* Open banks, an electrical cycle in progress counts already */
+		uint32_t banked = _finalized[i];
+		for (uint8_t n = 0; n < module->numof; n++) {
+			Sample_epoch epoch;
+			for (uint8_t b = 0; b < SAMPLE_EPOCH_BANKS; b++) {
+				banked += _bank(module, n, b, &epoch);
+			}
+		}
+		if (banked < stats.samples || banked > stats.samples + module->numof) {
+			printf("FAIL: %s: %lu samples in banks, %lu taken\n",
+					module->name, (unsigned long)banked,
+					(unsigned long)stats.samples);
+			_errors++;
+		}
+		samples += stats.samples;
+	}
+
+	printf("test_boundary: %lu periods, %lu samples, %lu electrical cycles "
+			"across a boundary, %lu errors\n", (unsigned long)_periods,
+			(unsigned long)samples, (unsigned long)_crossed,
+			(unsigned long)_errors);
+
+	/* The test is void, if no cycle was in progress at a boundary */
+	if (_errors || sys_error || _crossed == 0 ||
+			_periods < TEST_PERIODS_MIN) {
+		printf("test_boundary: FAIL\n");
+		return -1;
+	}
+	printf("test_boundary: PASS\n");
+	return 0;
+}
@@ -0,0 +1,69 @@
+/* Device side of the framed data link test (see README, Host tests).
+ *  Queues TEST_LINK_PAYLOADS JSON payloads, one every TEST_LINK_INTERVAL_US
+ * of real time, on the framed link (serial_data, serial_link). Module data
+ * is {"n":<payload number>}, so the peer (test_link.py, on the other end of
+ * the pty) can tell which payloads it got. Then waits till every payload is
+ * acknowledged or given up, and prints the TX statistics.
+ */
+#include "serial_data/serial_data.h"
+
+#include "xtimer.h"
+#include "periph/pm.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+
+#define TEST_LINK_PAYLOADS			1000U
+#define TEST_LINK_INTERVAL_US		2000U
+/* Module data: {"n":<u32>} */
+#define TEST_LINK_DATA_LEN			16
+/* Time to empty the window at the end */
+#define TEST_LINK_DRAIN_US			(100U * SERIAL_DATA_ACK_TIMEOUT_US)
+
+static char _hash[] = "0123456789abcdef";
+static char _buf[SERIAL_DATA_BUF_LEN(TEST_LINK_DATA_LEN)];
+
+
+/* Functions ******************************************************************/
+
+int main (void) {
+	if (init_serial_data(_buf, sizeof(_buf), TEST_LINK_DATA_LEN, _hash,
+			sizeof(_hash)) != 0) {
+		printf("test_link: FAIL: init_serial_data\n");
+		pm_off();
+	}
+
+	uint64_t start_us = xtimer_now_usec64();
+	for (uint32_t n = 0; n < TEST_LINK_PAYLOADS; n++) {
+		size_t len;
+		/* NULL while all slots are in the window (counted as dropped) */
+		char *data = get_serial_data_buf(&len);
+		if (data != NULL) {
+			Sample_period period = { .index = n, .epoch = n };
+			len = snprintf(data, len, "{\"n\":%lu}", (unsigned long)n);
+			send_serial_data(len, 0, 0, &period);
+		}
+		xtimer_usleep(TEST_LINK_INTERVAL_US);
+	}
+
+	Serial_data_tx_stats stats;
+	uint64_t drain_us = xtimer_now_usec64();
+	do {
+		xtimer_usleep(SERIAL_DATA_ACK_TIMEOUT_US);
+		get_serial_data_tx_stats(&stats);
+	} while (stats.depth && xtimer_now_usec64() - drain_us <
+			TEST_LINK_DRAIN_US);
+
+	printf("test_link: payloads %u, queued %lu, sent %lu, dropped %lu, "
+			"lost %lu, retransmits %lu, bytes %lu, depth %u, time %lu ms\n",
+			TEST_LINK_PAYLOADS, (unsigned long)stats.queued,
+			(unsigned long)stats.sent,
+			(unsigned long)stats.dropped, (unsigned long)stats.lost,
+			(unsigned long)stats.retransmits, (unsigned long)stats.bytes,
+			stats.depth,
+			(unsigned long)((xtimer_now_usec64() - start_us) / 1000U));
+	pm_off();
+	return 0;
+}
@@ -0,0 +1,297 @@
+#!/usr/bin/env python3
+"""Framed data link against a lossy peer (see README, Host tests).
+
+Host-side peer of the framed link (serial_link/serial_link.h): runs the
+device side (test_link.c) with its data link UART on a pty, decodes SLIP
+frames, checks their CRC and answers with ACK/NAK like a gateway, keeping
+the next expected sequence number. Errors are injected on the pty, per
+scenario: data frames dropped, corrupted (bit flip, CRC fails, NAK) or
+received twice, replies dropped, a link outage, and a payload the peer
+always rejects. Replies are sent with END on both ends or only at the end,
+some with a time reference ahead, as a gateway may do.
+
+Every scenario checks that payloads are delivered in order and at most
+once, that every payload is either acknowledged, given up or dropped for
+lack of a slot, that given-up payloads are skipped (SKIP frame), and that
+the bytes read equal the device's TX statistics. Throughput and recovery
+figures are printed.
+
+usage: test_link.py PROGRAM [SCENARIO...]
+"""
+
+import json
+import os
+import pty
+import random
+import re
+import select
+import subprocess
+import sys
+import time
+
+END, ESC, ESC_END, ESC_ESC = 0xC0, 0xDB, 0xDC, 0xDD
+
+STATS = re.compile(r"^test_link: payloads (\d+), queued (\d+), sent (\d+), "
+                   r"dropped (\d+), lost (\d+), retransmits (\d+), "
+                   r"bytes (\d+), depth (\d+), time (\d+) ms$", re.M)
+
+# Error injection: drop/corrupt/dup data frames, drop replies [probability],
+# outage (no frame received or answered) [s after first frame, length],
+# payload number rejected on every transmission
+SCENARIOS = {
+    "clean": {},
+    "lossy": {"drop": 0.05, "corrupt": 0.05, "dup": 0.05, "reply_drop": 0.05},
+    "outage": {"outage": (0.5, 0.3)},
+    "reject": {"reject": 100},
+}
+
+
+def crc16(data, crc=0x1D0F):
+    """CRC-16-CCITT as crc16_ccitt_calc() (RIOT)."""
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def slip(data):
+    """SLIP escape."""
+    out = bytearray()
+    for b in data:
+        if b == END:
+            out += bytes((ESC, ESC_END))
+        elif b == ESC:
+            out += bytes((ESC, ESC_ESC))
+        else:
+            out.append(b)
+    return bytes(out)
+
+
+def unslip(data):
+    """SLIP unescape."""
+    out = bytearray()
+    esc = False
+    for b in data:
+        if esc:
+            out.append(END if b == ESC_END else ESC)
+            esc = False
+        elif b == ESC:
+            esc = True
+        else:
+            out.append(b)
+    return bytes(out)
+
+
+def ahead(seq, ref):
+    """Serial arithmetic: seq - ref, as the device does (int16)."""
+    d = (seq - ref) & 0xFFFF
+    return d - 0x10000 if d >= 0x8000 else d
+
+
+class Peer:
+    """Receiving end of the link, like a gateway."""
+
+    def __init__(self, fd, errors, rand):
+        self.fd = fd
+        self.errors = errors
+        self.rand = rand
+        self.expected = 0
+        self.delivered = []         # Payload numbers, in order delivered
+        self.skipped = 0            # Sequence numbers skipped (SKIP)
+        self.skips = 0              # SKIP frames received
+        self.dups = 0               # Duplicates, not delivered
+        self.crc_errors = 0
+        self.naks = 0
+        self.link_bytes = 0
+        self.first = None           # Time of first frame
+        self.recovered = None       # First delivery after outage [s]
+        self.buf = bytearray()
+
+    def feed(self, data):
+        self.link_bytes += len(data)
+        self.buf += data
+        while END in self.buf:
+            i = self.buf.index(END)
+            frame = bytes(self.buf[:i])
+            del self.buf[:i + 1]
+            if frame:
+                self.frame(unslip(frame))
+
+    def in_outage(self):
+        outage = self.errors.get("outage")
+        if outage is None or self.first is None:
+            return False
+        t = time.monotonic() - self.first
+        return outage[0] <= t < outage[0] + outage[1]
+
+    def frame(self, frame):
+        if self.first is None:
+            self.first = time.monotonic()
+        if self.in_outage() or self.rand.random() < self.errors.get("drop", 0):
+            return
+        copies = 2 if self.rand.random() < self.errors.get("dup", 0) else 1
+        if self.rand.random() < self.errors.get("corrupt", 0):
+            frame = bytearray(frame)
+            frame[self.rand.randrange(len(frame))] ^= 1 << self.rand.randrange(8)
+            frame = bytes(frame)
+        for _ in range(copies):
+            self.receive(frame)
+
+    def receive(self, frame):
+        if (len(frame) < 5 or
+                crc16(frame[:-2]) != frame[-2] | frame[-1] << 8):
+            self.crc_errors += 1
+            self.reply(ord("N"), self.expected)
+            return
+        kind, seq = frame[0], frame[1] | frame[2] << 8
+        payload = frame[3:-2]
+
+        if kind == ord("S"):
+            self.skips += 1
+            if ahead(seq, self.expected) > 0:
+                self.skipped += ahead(seq, self.expected)
+                self.expected = seq
+            self.reply(ord("A"), self.expected - 1)
+            return
+        if kind != ord("D"):
+            return
+
+        d = ahead(seq, self.expected)
+        if d < 0:
+            self.dups += 1
+            self.reply(ord("A"), self.expected - 1)
+            return
+        if d > 0:
+            self.reply(ord("N"), self.expected)
+            return
+        n = json.loads(payload)["data"]["n"]
+        if n == self.errors.get("reject"):
+            self.crc_errors += 1
+            self.reply(ord("N"), self.expected)
+            return
+        if self.first is not None and self.recovered is None and \
+                "outage" in self.errors:
+            t = time.monotonic() - self.first
+            if t >= sum(self.errors["outage"]):
+                self.recovered = t - sum(self.errors["outage"])
+        self.delivered.append(n)
+        self.expected = (self.expected + 1) & 0xFFFF
+        self.reply(ord("A"), seq)
+
+    def reply(self, kind, seq):
+        if kind == ord("N"):
+            self.naks += 1
+        if self.rand.random() < self.errors.get("reply_drop", 0):
+            return
+        head = bytes((kind, seq & 0xFF, (seq >> 8) & 0xFF))
+        crc = crc16(head)
+        frame = slip(head + bytes((crc & 0xFF, crc >> 8))) + bytes((END,))
+        # END on both ends, only trailing END (previous one opens the
+        # frame), or a time reference before (text needs the leading END)
+        r = self.rand.random()
+        if r < 0.4:
+            frame = bytes((END,)) + frame
+        elif r < 0.6:
+            frame = b"T1700000000\n" + bytes((END,)) + frame
+        os.write(self.fd, frame)
+
+
+def run(program, name):
+    """Run device against peer; returns list of errors."""
+    errors = SCENARIOS[name]
+    master, slave = pty.openpty()
+    proc = subprocess.Popen([program, "-c", "/dev/null",
+                             "-c", os.ttyname(slave)],
+                            stdout=subprocess.PIPE)
+    peer = Peer(master, errors, random.Random(name))
+    out = bytearray()
+    stdout = proc.stdout.fileno()
+    fds = [master, stdout]
+    # Slave stays open, see test_uart_pty.py
+    while True:
+        ready = select.select(fds, [], [], None if stdout in fds else 0)[0]
+        if master in ready:
+            peer.feed(os.read(master, 65536))
+        elif stdout not in fds:
+            break
+        if stdout in ready:
+            data = os.read(stdout, 65536)
+            out += data
+            if not data:
+                fds.remove(stdout)
+                proc.wait()
+    os.close(slave)
+    os.close(master)
+
+    out = out.decode(errors="replace")
+    match = STATS.search(out)
+    if proc.returncode != 0 or match is None:
+        print(out, end="")
+        return ["exit code %d, no statistics" % proc.returncode]
+    (payloads, queued, sent, dropped, lost, retransmits, nbytes, depth,
+     ms) = map(int, match.groups())
+
+    fails = []
+    delivered = peer.delivered
+    if any(b <= a for a, b in zip(delivered, delivered[1:])):
+        fails.append("payloads delivered out of order or twice")
+    if depth or sent + lost + dropped != payloads:
+        fails.append("sent %d + lost %d + dropped %d != %d, depth %d" %
+                     (sent, lost, dropped, payloads, depth))
+    if queued != sent + lost + depth or queued + dropped != payloads:
+        fails.append("queued %d, sent %d, lost %d, dropped %d, depth %d" %
+                     (queued, sent, lost, dropped, depth))
+    # Acked ones were delivered, given up ones may have been (ACK lost)
+    if not sent <= len(delivered) <= sent + lost:
+        fails.append("%d delivered, %d acked, %d given up" %
+                     (len(delivered), sent, lost))
+    if len(delivered) + peer.skipped > sent + lost:
+        fails.append("%d skipped" % peer.skipped)
+    if nbytes != peer.link_bytes:
+        fails.append("read %d bytes, stats say %d" % (peer.link_bytes, nbytes))
+
+    # Slots may run out on a busy host, the link may not fail
+    if name == "clean" and (lost or retransmits or len(delivered) != sent):
+        fails.append("errors on a clean link")
+    if name == "lossy" and not retransmits:
+        fails.append("no retransmissions")
+    if name == "outage" and (not lost or not peer.skips or
+                             peer.recovered is None):
+        fails.append("no payload given up and skipped, or no recovery")
+    if name == "reject" and (errors["reject"] in delivered or
+                             lost < 1 or peer.skipped < 1 or
+                             errors["reject"] + 1 not in delivered):
+        fails.append("rejected payload not given up and skipped")
+
+    print("test_link: %s: %d/%d delivered, %d dropped (no slot), %d lost, "
+          "%d skipped, %d retransmits, %d NAKs, %d CRC errors, %d dups, "
+          "%d bytes, %d ms, %.0f payloads/s, %.0f B/s" %
+          (name, len(delivered), payloads, dropped, lost, peer.skipped,
+           retransmits, peer.naks, peer.crc_errors, peer.dups, nbytes, ms,
+           len(delivered) * 1000.0 / ms, nbytes * 1000.0 / ms))
+    if peer.recovered is not None:
+        print("test_link: %s: delivering again %.0f ms after the outage" %
+              (name, peer.recovered * 1000))
+    return fails
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__.strip().splitlines()[-1], file=sys.stderr)
+        return 2
+    names = sys.argv[2:] or list(SCENARIOS)
+    failed = False
+    for name in names:
+        for fail in run(sys.argv[1], name):
+            print("test_link: %s: FAIL: %s" % (name, fail))
+            failed = True
+    if failed:
+        return 1
+    print("test_link: PASS")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,259 @@
+/* LZSS round trips (see README, Host tests): inputs of different entropy,
+ * length and window are compressed by lzss_compress() (lzss/lzss.c) and
+ * decompressed by the host decompressor (lzss_decode.c), which must return
+ * the input. Malformed data must be refused.
+ *  Payloads of link captures given as arguments (JSON lines, binary frames)
+ * are compressed as serial_data does (window SERIAL_DATA_LZ_WINDOW, output
+ * no longer than the payload), round tripped, and their compression ratio
+ * and time on the host CPU are printed.
+ *	test_lzss [capture...]
+ */
+#include "../decode/lzss_decode.h"
+#include "payload/payload.h"
+#include "serial_data/serial_data.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define TEST_ROUNDS					20000U
+#define TEST_MAX_LEN				4096
+/* Longest payload of a capture (frame body is at most UINT16_MAX) */
+#define TEST_PAYLOAD_MAX_LEN		(PAYLOAD_FRAME_HEADER_LEN + UINT16_MAX)
+/* Worst case expansion: a flag byte per 8 literals */
+#define TEST_LZ_MAX_LEN(len)		((len) + (len) / 8 + 1)
+
+static uint32_t _rand_state = 2463534242U;
+static uint32_t _errors;
+static uint8_t _in[TEST_PAYLOAD_MAX_LEN];
+static uint8_t _lz[TEST_LZ_MAX_LEN(TEST_PAYLOAD_MAX_LEN)];
+static uint8_t _out[TEST_PAYLOAD_MAX_LEN];
+
+
+/* Prototypes *****************************************************************/
+static uint32_t _rand (void);
+static void _fill (uint8_t *buf, size_t len);
+static void _round_trip (const uint8_t *in, size_t len, uint16_t window);
+static void _malformed (void);
+static int _capture (const char *path);
+static size_t _payload_len (const uint8_t *buf, size_t len);
+static uint64_t _now_ns (void);
+
+
+/* Functions ******************************************************************/
+
+int main (int argc, char **argv) {
+	static const uint16_t windows[] = { 1, 16, SERIAL_DATA_LZ_WINDOW,
+			LZSS_DISTANCE_MAX };
+
+	for (uint32_t r = 0; r < TEST_ROUNDS; r++) {
+		size_t len = _rand() % (TEST_MAX_LEN + 1);
+		_fill(_in, len);
+		_round_trip(_in, len, windows[r % 4]);
+	}
+	_malformed();
+	printf("test_lzss: %u round trips, %lu errors\n", TEST_ROUNDS,
+			(unsigned long)_errors);
+
+	for (int i = 1; i < argc; i++) {
+		if (_capture(argv[i]) != 0) {
+			_errors++;
+		}
+	}
+
+	if (_errors) {
+		printf("test_lzss: FAIL\n");
+		return EXIT_FAILURE;
+	}
+	printf("test_lzss: PASS\n");
+	return EXIT_SUCCESS;
+}
+
+
+/* Helpers ********************************************************************/
+
+/* xorshift32 */
+static uint32_t _rand (void) {
+	_rand_state ^= _rand_state << 13;
+	_rand_state ^= _rand_state >> 17;
+	_rand_state ^= _rand_state << 5;
+	return _rand_state;
+}
+
+/* Random bytes of a random alphabet (1 to 256 symbols), with copies of
+ * earlier parts, near and far, and runs.
+ */
+static void _fill (uint8_t *buf, size_t len) {
+	uint32_t symbols = 1U << (_rand() % 9);
+	size_t n = 0;
+	while (n < len) {
+		size_t left = len - n;
+		size_t chunk = 1 + _rand() % 64;
+		if (chunk > left) {
+			chunk = left;
+		}
+		switch (_rand() % 4) {
+		case 0:
+			if (n) {
+				size_t from = _rand() % n;
+				for (size_t i = 0; i < chunk; i++, n++) {
+					buf[n] = buf[from + i];
+				}
+				break;
+			}
+			/* fall through */
+		case 1:
+			memset(buf + n, (int)(_rand() % symbols), chunk);
+			n += chunk;
+			break;
+		default:
+			for (size_t i = 0; i < chunk; i++) {
+				buf[n++] = (uint8_t)(_rand() % symbols);
+			}
+			break;
+		}
+	}
+}
+
+/* Compress with ample output, decompress and compare. */
+static void _round_trip (const uint8_t *in, size_t len, uint16_t window) {
+	size_t lz_len = lzss_compress(in, len, _lz, TEST_LZ_MAX_LEN(len),
+			window);
+	if (lz_len == 0 && len != 0) {
+		printf("FAIL: %u bytes, window %u: not compressed\n", (unsigned)len,
+				window);
+		_errors++;
+		return;
+	}
+	size_t out_len = lzss_decompress(_lz, lz_len, _out, sizeof(_out));
+	if (out_len != len || memcmp(in, _out, len) != 0) {
+		printf("FAIL: %u bytes, window %u: %u bytes decompressed, "
+				"differ\n", (unsigned)len, window, (unsigned)out_len);
+		_errors++;
+	}
+}
+
+/* Matches before the start, truncated matches and short output. */
+static void _malformed (void) {
+	/* Literal 'a', then match of distance 2 */
+	static const uint8_t before_start[] = { 0x01, 'a', 0x02, 0x00 };
+	static const uint8_t truncated[] = { 0x01, 'a', 0x01 };
+	/* Literal 'a', then match of distance 1, 18 bytes */
+	static const uint8_t run[] = { 0x01, 'a', 0x01, 0x0F };
+	uint8_t out[8];
+
+	if (lzss_decompress(before_start, sizeof(before_start), out,
+			sizeof(out)) != 0 ||
+			lzss_decompress(truncated, sizeof(truncated), out,
+			sizeof(out)) != 0 ||
+			lzss_decompress(run, sizeof(run), out, sizeof(out)) != 0) {
+		printf("FAIL: malformed data decompressed\n");
+		_errors++;
+	}
+}
+
+/* Round trip the payloads of a capture, print ratio and time.
+ * return:
+ *  0 on success, -1 on error
+ */
+static int _capture (const char *path) {
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) {
+		perror(path);
+		return -1;
+	}
+	static uint8_t buf[1 << 20];
+	size_t len = fread(buf, 1, sizeof(buf), f);
+	fclose(f);
+
+	uint32_t payloads = 0;
+	uint32_t compressed = 0;
+	uint64_t in_bytes = 0;
+	uint64_t out_bytes = 0;
+	uint64_t compress_ns = 0;
+	uint64_t compress_max_ns = 0;
+	uint64_t decompress_ns = 0;
+	uint32_t errors = 0;
+	size_t pos = 0;
+
+	while (pos < len) {
+		size_t n = _payload_len(buf + pos, len - pos);
+		if (n == 0) {
+			printf("test_lzss: %s: no payload at %lu\n", path,
+					(unsigned long)pos);
+			return -1;
+		}
+		const uint8_t *payload = buf + pos;
+		pos += n;
+		/* Hello frames aren't compressed */
+		if (payload[0] == PAYLOAD_SYNC && payload[1] == PAYLOAD_FRAME_HELLO) {
+			continue;
+		}
+		payloads++;
+
+		/* As serial_data: the LZ frame may not be longer than the payload */
+		size_t head = PAYLOAD_FRAME_HEADER_LEN + 2;
+		in_bytes += n;
+		if (n <= head) {
+			out_bytes += n;
+			continue;
+		}
+		uint64_t start_ns = _now_ns();
+		size_t lz_len = lzss_compress(payload, n, _lz, n - head,
+				SERIAL_DATA_LZ_WINDOW);
+		uint64_t ns = _now_ns() - start_ns;
+		compress_ns += ns;
+		if (ns > compress_max_ns) {
+			compress_max_ns = ns;
+		}
+		if (lz_len == 0) {
+			out_bytes += n;
+			continue;
+		}
+		compressed++;
+		out_bytes += head + lz_len;
+
+		start_ns = _now_ns();
+		size_t out_len = lzss_decompress(_lz, lz_len, _out, sizeof(_out));
+		decompress_ns += _now_ns() - start_ns;
+		if (out_len != n || memcmp(payload, _out, n) != 0) {
+			errors++;
+		}
+	}
+
+	printf("test_lzss: %s: %lu payloads, %lu compressed, %llu -> %llu "
+			"bytes (%.2fx), compress avg %llu ns (max %llu), decompress avg "
+			"%llu ns, %lu errors\n", path, (unsigned long)payloads,
+			(unsigned long)compressed, (unsigned long long)in_bytes,
+			(unsigned long long)out_bytes,
+			out_bytes ? (double)in_bytes / out_bytes : 0.0,
+			(unsigned long long)(payloads ? compress_ns / payloads : 0),
+			(unsigned long long)compress_max_ns,
+			(unsigned long long)(compressed ? decompress_ns / compressed : 0),
+			(unsigned long)errors);
+	return errors ? -1 : 0;
+}
+
+/* Length of the payload at buf: JSON line or binary frame.
+ * return:
+ *  length, 0 if none (or truncated)
+ */
+static size_t _payload_len (const uint8_t *buf, size_t len) {
+	if (buf[0] == '{') {
+		const uint8_t *end = memchr(buf, '\n', len);
+		return end ? (size_t)(end + 1 - buf) : 0;
+	}
+	if (len < PAYLOAD_FRAME_HEADER_LEN || buf[0] != PAYLOAD_SYNC) {
+		return 0;
+	}
+	size_t n = PAYLOAD_FRAME_HEADER_LEN + (buf[3] | (buf[4] << 8));
+	return (n <= len) ? n : 0;
+}
+
+static uint64_t _now_ns (void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000U + ts.tv_nsec;
+}
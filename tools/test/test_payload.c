@@ -0,0 +1,377 @@
+/* Round trip of binary records (see README, Host tests): module data with
+ * random values over the full range of each field type is encoded by
+ * payload_bin_record() and payload_bin_record_rbe() (random field subsets),
+ * and decoded by the host decoder (payload_decode.c). Decoded fields must
+ * equal the original ones, and so must their JSON records. Fields selected
+ * for report-by-exception count as reported only once committed
+ * (payload_rbe_commit()). Packed values
+ * (payload_put_packed(), delta batches) of every width, in runs, must read
+ * back the same. I8 and I16 values out of range must be found
+ * (payload_out_of_range()) and sent saturated. Frames of the schemas the
+ * decoder knows must decode, those of others not.
+ *  Also measures record size and encoding time, JSON against binary, on
+ * the host CPU.
+ */
+#include "../decode/payload_decode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+#define TEST_ROUNDS					100000U
+#define TEST_BENCH_ROUNDS			1000000U
+#define TEST_BUF_LEN				256
+#define TEST_PACKED_RUNS			100000U
+#define TEST_PACKED_RUN_LEN			32
+
+static uint32_t _rand_state = 2463534242U;
+static uint32_t _errors;
+
+
+/* Prototypes *****************************************************************/
+static uint32_t _rand (void);
+static void _fill (const Payload_decode_module *module, void *data);
+static void _round_trip (const Payload_decode_module *module, uint8_t present,
+		const void *data);
+static void _rbe (const Payload_decode_module *module, const void *data);
+static void _saturation (const Payload_decode_module *module,
+		const void *data);
+static void _bench (const Payload_decode_module *module, const void *data);
+static void _packed_round_trip (void);
+static void _schema (void);
+static uint64_t _now_ns (void);
+
+
+/* Functions ******************************************************************/
+
+int main (void) {
+	uint32_t records = 0;
+	uint8_t modules = 0;
+
+	for (unsigned id = 1; id <= UINT8_MAX; id++) {
+		const Payload_decode_module *module = payload_decode_module(id);
+		if (module == NULL) {
+			continue;
+		}
+		modules++;
+
+		union {
+			uint8_t bytes[PAYLOAD_DECODE_DATA_MAX_LEN];
+			uint32_t align;
+		} data;
+		for (uint32_t r = 0; r < TEST_ROUNDS; r++) {
+			_fill(module, &data);
+			/* Plain record, then a report-by-exception one */
+			_round_trip(module, 0, &data);
+			_round_trip(module, (uint8_t)(_rand() &
+					((1U << module->numof) - 1)), &data);
+			_rbe(module, &data);
+			_saturation(module, &data);
+			records += 2;
+		}
+		_bench(module, &data);
+	}
+
+	for (uint32_t r = 0; r < TEST_PACKED_RUNS; r++) {
+		_packed_round_trip();
+	}
+	_schema();
+
+	printf("test_payload: %u modules, %lu records, %lu packed values, "
+			"%lu errors\n", modules, (unsigned long)records,
+			(unsigned long)TEST_PACKED_RUNS * TEST_PACKED_RUN_LEN,
+			(unsigned long)_errors);
+	if (_errors || modules == 0) {
+		printf("test_payload: FAIL\n");
+		return EXIT_FAILURE;
+	}
+	printf("test_payload: PASS\n");
+	return EXIT_SUCCESS;
+}
+
+
+/* Helpers ********************************************************************/
+
+/* xorshift32 */
+static uint32_t _rand (void) {
+	_rand_state ^= _rand_state << 13;
+	_rand_state ^= _rand_state >> 17;
+	_rand_state ^= _rand_state << 5;
+	return _rand_state;
+}
+
+/* Random field values, over the full range of their wire type, extremes
+ * more often.
+ */
+static void _fill (const Payload_decode_module *module, void *data) {
+	memset(data, 0, PAYLOAD_DECODE_DATA_MAX_LEN);
+	for (uint8_t i = 0; i < module->numof; i++) {
+		const Payload_field *field = &module->fields[i];
+		uint8_t *dst = (uint8_t *)data + field->offset;
+		uint32_t r = _rand();
+		switch (r % 8) {
+		case 0:
+			r = 0;
+			break;
+		case 1:
+			r = UINT32_MAX;
+			break;
+		case 2:
+			r = (field->type == PAYLOAD_TYPE_I8) ? 0x80 :
+					(field->type == PAYLOAD_TYPE_I16) ? 0x8000 : 0x80000000U;
+			break;
+		}
+		switch (field->type) {
+		case PAYLOAD_TYPE_I8:
+			*(int *)dst = (int8_t)r;
+			break;
+		case PAYLOAD_TYPE_I16:
+			*(int *)dst = (int16_t)r;
+			break;
+		case PAYLOAD_TYPE_I32:
+			*(int *)dst = (int32_t)r;
+			break;
+		case PAYLOAD_TYPE_U32:
+			*(uint32_t *)dst = r;
+			break;
+		}
+	}
+}
+
+/* Encode, decode and compare.
+ *  p1: module
+ *  p2: fields of a report-by-exception record, 0 for a plain one
+ *  p3: module data
+ */
+static void _round_trip (const Payload_decode_module *module, uint8_t present,
+		const void *data) {
+	uint8_t buf[TEST_BUF_LEN];
+	uint8_t instance = (uint8_t)(_rand() % module->instances);
+
+	size_t len = present ?
+			payload_bin_record_rbe(buf, sizeof(buf), module->id, instance,
+					module->fields, module->numof, data, present) :
+			payload_bin_record(buf, sizeof(buf), module->id, instance,
+					module->fields, module->numof, data);
+	if (!present) {
+		present = (uint8_t)((1U << module->numof) - 1);
+	}
+
+	Payload_decode_record rec;
+	if (len == 0 || payload_decode_record(buf, len, &rec) != len ||
+			rec.module != module || rec.instance != instance ||
+			rec.present != present) {
+		printf("FAIL: %s: record not decoded\n", module->name);
+		_errors++;
+		return;
+	}
+
+	for (uint8_t i = 0; i < module->numof; i++) {
+		if (!(present & (1U << i))) {
+			continue;
+		}
+		size_t offset = module->fields[i].offset;
+		if (memcmp((const uint8_t *)data + offset, rec.data.bytes + offset,
+				sizeof(uint32_t)) != 0) {
+			printf("FAIL: %s: field %s differs\n", module->name,
+					module->fields[i].key);
+			_errors++;
+		}
+	}
+
+	char json[TEST_BUF_LEN];
+	char json_dec[TEST_BUF_LEN];
+	const char *prefix = module->get_prefix(instance);
+	size_t json_len = payload_json_record_rbe(json, sizeof(json), prefix,
+			module->fields, module->numof, data, present);
+	size_t json_dec_len = payload_json_record_rbe(json_dec, sizeof(json_dec),
+			prefix, module->fields, module->numof, &rec.data, present);
+	if (json_len == 0 || json_len != json_dec_len ||
+			memcmp(json, json_dec, json_len) != 0) {
+		printf("FAIL: %s: JSON record differs\n", module->name);
+		_errors++;
+	}
+}
+
+/* Selection leaves last reported values alone. Commit updates those of
+ * written fields only (a record left out keeps the rest pending), so only
+ * the others are selected again.
+ */
+static void _rbe (const Payload_decode_module *module, const void *data) {
+	int32_t last[PAYLOAD_RBE_FIELDS_MAX];
+	int32_t before[PAYLOAD_RBE_FIELDS_MAX];
+
+	for (uint8_t i = 0; i < module->numof; i++) {
+		last[i] = (int32_t)_rand();
+	}
+	memcpy(before, last, sizeof(last));
+
+	uint8_t present = payload_rbe_select(module->fields, module->numof, data,
+			last, 0);
+	if (memcmp(before, last, module->numof * sizeof(last[0])) != 0) {
+		printf("FAIL: %s: selection changed last reported values\n",
+				module->name);
+		_errors++;
+		return;
+	}
+
+	uint8_t written = present & (uint8_t)_rand();
+	payload_rbe_commit(module->fields, module->numof, data, last, written);
+	uint8_t pending = payload_rbe_select(module->fields, module->numof, data,
+			last, 0);
+	if (pending != (present & ~written)) {
+		printf("FAIL: %s: fields 0x%02x pending, 0x%02x expected\n",
+				module->name, pending, present & ~written);
+		_errors++;
+	}
+}
+
+/* Pack a run of values of random width (0 to 32 bits, signed), read it
+ * back, and compare. */
+static void _packed_round_trip (void) {
+	int32_t vals[TEST_PACKED_RUN_LEN];
+	uint8_t buf[PAYLOAD_PACKED_MAX_LEN(TEST_PACKED_RUN_LEN)];
+	size_t bit = 0;
+
+	for (uint8_t i = 0; i < TEST_PACKED_RUN_LEN; i++) {
+		uint8_t width = _rand() % 33;
+		vals[i] = width ? (int32_t)(_rand() << (32 - width)) >>
+				(32 - width) : 0;
+		bit = payload_put_packed(buf, bit, vals[i]);
+	}
+	size_t len = (bit + 7) / 8;
+
+	bit = 0;
+	for (uint8_t i = 0; i < TEST_PACKED_RUN_LEN; i++) {
+		uint32_t val;
+		if (payload_decode_packed(buf, len, &bit, &val) != 0 ||
+				(int32_t)val != vals[i]) {
+			printf("FAIL: packed value %ld read as %ld\n", (long)vals[i],
+					(long)(int32_t)val);
+			_errors++;
+			return;
+		}
+	}
+	if ((bit + 7) / 8 != len) {
+		printf("FAIL: packed run of %u bytes, %u read\n", (unsigned)len,
+				(unsigned)((bit + 7) / 8));
+		_errors++;
+	}
+}
+
+/* Record size and encoding time, JSON against binary (host CPU). */
+/* Values out of range of narrow wire types: found, and sent saturated. */
+static void _saturation (const Payload_decode_module *module,
+		const void *data) {
+	if (payload_out_of_range(module->fields, module->numof, data) != 0) {
+		printf("FAIL: %s: values in range found out of range\n",
+				module->name);
+		_errors++;
+	}
+
+	for (uint8_t i = 0; i < module->numof; i++) {
+		const Payload_field *field = &module->fields[i];
+		if (field->type != PAYLOAD_TYPE_I8 &&
+				field->type != PAYLOAD_TYPE_I16) {
+			continue;
+		}
+		int max = (field->type == PAYLOAD_TYPE_I8) ? INT8_MAX : INT16_MAX;
+		const int values[] = { max + 1, -max - 2, INT32_MAX, INT32_MIN };
+		for (uint8_t v = 0; v < sizeof(values) / sizeof(values[0]); v++) {
+			union {
+				uint8_t bytes[PAYLOAD_DECODE_DATA_MAX_LEN];
+				uint32_t align;
+			} out;
+			memcpy(&out, data, sizeof(out));
+			*(int *)(out.bytes + field->offset) = values[v];
+
+			uint8_t buf[TEST_BUF_LEN];
+			Payload_decode_record rec;
+			size_t len = payload_bin_record(buf, sizeof(buf), module->id, 0,
+					module->fields, module->numof, &out);
+			int expected = (values[v] > 0) ? max : -max - 1;
+			if (payload_out_of_range(module->fields, module->numof,
+					&out) != (1UL << i) || len == 0 ||
+					payload_decode_record(buf, len, &rec) != len ||
+					*(int *)(rec.data.bytes + field->offset) != expected) {
+				printf("FAIL: %s: field %s = %d not sent saturated\n",
+						module->name, field->key, values[v]);
+				_errors++;
+			}
+		}
+	}
+}
+
+/* Hello frame of each schema around the decoded ones. */
+static void _schema (void) {
+	static const char hash[] = "0123456789abcdef";
+	uint8_t buf[TEST_BUF_LEN];
+	size_t n = payload_bin_frame_header(buf, PAYLOAD_FRAME_HELLO,
+			3 + sizeof(hash) - 1);
+	n += payload_put_u16(buf + n, 0x1234);
+	n += payload_put_u8(buf + n, sizeof(hash) - 1);
+	memcpy(buf + n, hash, sizeof(hash) - 1);
+	n += sizeof(hash) - 1;
+
+	for (unsigned v = PAYLOAD_DECODE_SCHEMA_MIN - 1;
+			v <= PAYLOAD_SCHEMA_VERSION + 1; v++) {
+		Payload_decoder dec;
+		payload_decode_init(&dec);
+		buf[2] = (uint8_t)v;
+		int expected = (v >= PAYLOAD_DECODE_SCHEMA_MIN &&
+				v <= PAYLOAD_SCHEMA_VERSION) ? (int)n : -1;
+		int len = payload_decode_frame(&dec, buf, n, stdout);
+		if (len != expected) {
+			printf("FAIL: schema %u: frame decoded %d, expected %d\n", v,
+					len, expected);
+			_errors++;
+		}
+	}
+}
+
+static void _bench (const Payload_decode_module *module, const void *data) {
+	static volatile size_t sink;
+	char json[TEST_BUF_LEN];
+	uint8_t bin[TEST_BUF_LEN];
+	const char *prefix = module->get_prefix(0);
+
+	uint64_t start_ns = _now_ns();
+	for (uint32_t r = 0; r < TEST_BENCH_ROUNDS; r++) {
+		sink = payload_json_record(json, sizeof(json), prefix,
+				module->fields, module->numof, data);
+	}
+	uint64_t json_ns = _now_ns() - start_ns;
+	size_t json_len = sink;
+
+	start_ns = _now_ns();
+	for (uint32_t r = 0; r < TEST_BENCH_ROUNDS; r++) {
+		sink = payload_bin_record(bin, sizeof(bin), module->id, 0,
+				module->fields, module->numof, data);
+	}
+	uint64_t bin_ns = _now_ns() - start_ns;
+	size_t bin_len = sink;
+
+	/* Delta against zero (first period): values of full width, the most
+	 * bits to pack */
+	int32_t prev[PAYLOAD_DECODE_DATA_MAX_LEN / sizeof(int32_t)];
+	start_ns = _now_ns();
+	for (uint32_t r = 0; r < TEST_BENCH_ROUNDS; r++) {
+		sink = payload_delta_record(bin, sizeof(bin), module->id, 0, 1,
+				module->fields, module->numof, data, prev);
+	}
+	uint64_t delta_ns = _now_ns() - start_ns;
+
+	printf("test_payload: %s: record json %u B %lu ns, bin %u B %lu ns, "
+			"delta %u B %lu ns\n", module->name, (unsigned)json_len,
+			(unsigned long)(json_ns / TEST_BENCH_ROUNDS), (unsigned)bin_len,
+			(unsigned long)(bin_ns / TEST_BENCH_ROUNDS), (unsigned)sink,
+			(unsigned long)(delta_ns / TEST_BENCH_ROUNDS));
+}
+
+static uint64_t _now_ns (void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
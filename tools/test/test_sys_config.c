@@ -0,0 +1,326 @@
+/* Runtime configuration over the data link's RX line (see README, Host
+ * tests).
+ *  The module and serial tasks of the application (tasks.c) run in virtual
+ * time (sim_clock), with main.c's tick; the wall clock isn't set, so a
+ * period lasts its length in ticks. In the middle of a period, a command
+ * is fed byte by byte to serial_data's UART RX callback, as the UART ISR
+ * would (host_uart_rx()). Right after, a valid command must be persisted to
+ * the configuration's flash page (stand-in), and an invalid one leave it
+ * unchanged, while the configuration in effect stays the same. At the next
+ * boundary, it must be in effect: period length, enabled modules, sampling
+ * rate and north offset of wind instance 0, and the samples the tasks take
+ * in the following period.
+ *  At the end, init_sys_config() loads the persisted configuration, as on
+ * reboot, and defaults once its check fails.
+ */
+#include "tasks/tasks.h"
+#include "sample_epoch/sample_epoch.h"
+#include "sensor_sim/sensor_sim.h"
+#include "sim_clock/sim_clock.h"
+#include "serial_data/serial_data.h"
+#include "sys_config/sys_config.h"
+#include "wind_data/wind_data.h"
+#include "sys_control.h"
+
+#include "../host/host.h"
+#include "hash.h"
+#include "thread.h"
+#include "xtimer.h"
+#include "periph/flashpage.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/* Configuration of a step: command, fed in the middle of a period, and the
+ * settings in effect from the next boundary on.
+ */
+typedef struct {
+	const char *cmd;
+	int8_t is_valid;
+	uint16_t period_min;
+	uint8_t enabled;
+	uint8_t wind_ticks;				/* Wind ticks per sample (0: default) */
+	uint16_t north_offset_10e1;		/* Of wind instance 0 */
+} Test_step;
+
+static const Test_step _steps[] = {
+	{ "Cp2\n",			1, 2, 0xFF, 0, SYS_CONFIG_UNSET },
+	{ "Cr1,2\n",		1, 2, 0xFF, 2, SYS_CONFIG_UNSET },
+	{ "Ce3\n",			1, 2, 3, 2, SYS_CONFIG_UNSET },
+	{ "Cn0,900\n",		1, 2, 3, 2, 900 },
+	/* Out of range, not a record id, unknown key, too many values */
+	{ "Cp0\n",			0, 2, 3, 2, 900 },
+	{ "Cp61\n",			0, 2, 3, 2, 900 },
+	{ "Cr3,1\n",		0, 2, 3, 2, 900 },
+	{ "Cn0,3600\n",		0, 2, 3, 2, 900 },
+	{ "Cx1\n",			0, 2, 3, 2, 900 },
+	{ "Cp1,2\n",		0, 2, 3, 2, 900 },
+	/* Longer than a line, dropped */
+	{ "Cp1111111111111111111111111\n", 0, 2, 3, 2, 900 },
+	{ "Cd\n",			1, 1, 0xFF, 0, SYS_CONFIG_UNSET },
+	/* Two lines in a period */
+	{ "Cp3\nCn0,450\n",	1, 3, 0xFF, 0, 450 },
+};
+#define TEST_STEPS_NUMOF	(sizeof(_steps) / sizeof(_steps[0]))
+
+/* Time the TX thread gets to parse a command [us] */
+#define TEST_PARSE_US		(10U * 1000U)
+/* Modules in the table */
+#define TEST_MODULES_MAX	4
+
+uint16_t sys_error;
+
+static kernel_pid_t _main_pid;
+static xtimer_t _tick;
+static uint32_t _errors;
+static uint8_t _is_done;
+
+
+/* Prototypes *****************************************************************/
+static void _tick_cb (void *arg);
+static void _check_config (const char *when, const Test_step *step);
+static void _check_stored (const Test_step *step);
+static void _check_samples (const Test_step *step, const uint32_t *last);
+static void _get_samples (uint32_t *samples);
+static void _check_boot (const Test_step *step);
+static int _cmd_len (const Test_step *step);
+static int8_t _stop (void);
+
+
+/* Functions ******************************************************************/
+
+int main (void) {
+	_main_pid = thread_getpid();
+	init_sim_clock(_stop);
+	if (init_sensor_sim() != 0) {
+		printf("test_sys_config: FAIL: init_sensor_sim\n");
+		return 1;
+	}
+	/* Flash page is erased */
+	if (init_sys_config() == 0) {
+		printf("FAIL: init_sys_config: loaded from erased flash\n");
+		_errors++;
+	}
+	init_sys_modules();
+	if (init_serial_data(sys_payload_buf, sys_payload_buf_len, sys_data_len,
+			DEVICE_HASH, DEVICE_HASH_LEN) != 0 || sys_error) {
+		printf("test_sys_config: FAIL: init, sys_error 0x%04x\n",
+				sys_error);
+		return 1;
+	}
+	create_sys_module_tasks();
+	create_serial_data_task();
+
+	_tick.callback = _tick_cb;
+	xtimer_set(&_tick, ATIMER_PERIOD_S * US_PER_SEC);
+
+	/* Defaults, the first period isn't complete */
+	const Test_step defaults = {
+		"", 1, DATA_SEND_PERIOD_MIN, 0xFF, 0, SYS_CONFIG_UNSET
+	};
+	const Test_step *effect = &defaults;
+	uint32_t samples[TEST_MODULES_MAX];
+	thread_sleep();
+	_check_config("boundary", effect);
+	_get_samples(samples);
+
+	for (size_t i = 0; i < TEST_STEPS_NUMOF; i++) {
+		const Test_step *step = &_steps[i];
+		Sys_config stored = *(const Sys_config *)
+				flashpage_addr(SYS_CONFIG_FLASHPAGE);
+
+		xtimer_usleep(get_sys_period_s() * US_PER_SEC / 2);
+		host_uart_rx(SERIAL_DATA_UART_DEV, (const uint8_t *)step->cmd,
+				strlen(step->cmd));
+		xtimer_usleep(TEST_PARSE_US);
+
+		/* Saved right away, in effect from the next boundary */
+		if (step->is_valid) {
+			_check_stored(step);
+		} else if (memcmp(&stored, flashpage_addr(SYS_CONFIG_FLASHPAGE),
+				sizeof(stored)) != 0) {
+			printf("FAIL: \"%.*s\": invalid command saved\n",
+					_cmd_len(step), step->cmd);
+			_errors++;
+		}
+		_check_config("before boundary", effect);
+
+		thread_sleep();
+		_check_samples(effect, samples);
+		effect = step;
+		_check_config("at boundary", effect);
+		_get_samples(samples);
+	}
+
+	_check_boot(effect);
+	_is_done = 1;
+	thread_sleep();
+	return 0;
+}
+
+
+/* Helpers ********************************************************************/
+
+/* As main.c, periods counted in ticks: close the period before waking
+ * module tasks. Main thread waits for boundaries, after the serial task.
+ */
+static void _tick_cb (void *arg) {
+	(void)arg;
+	static uint16_t ticks;
+	xtimer_set(&_tick, ATIMER_PERIOD_S * US_PER_SEC);
+
+	Sample_epoch epoch;
+	sample_epoch_capture();
+	sample_epoch_get(&epoch);
+
+	int8_t is_period_end = 0;
+	if (++ticks >= get_sys_period_s() / ATIMER_PERIOD_S) {
+		Sample_period period;
+		memset(&period, 0, sizeof(period));
+		period.epoch = epoch.sequence;
+		period.length_s = (uint16_t)get_sys_period_s();
+		period.partial = 1;
+		sample_epoch_close_period(&period);
+		ticks = 0;
+		is_period_end = 1;
+	}
+
+	wakeup_sys_module_tasks(epoch.sequence);
+	if (is_period_end) {
+		wakeup_serial_data_task();
+		thread_wakeup(_main_pid);
+	}
+}
+
+/* Configuration in effect, and as the tasks and instances see it. */
+static void _check_config (const char *when, const Test_step *step) {
+	const Sys_config *config = sys_config_get();
+	int8_t wind_bit = 0;			/* SYS_WIND_DATA_MASK >> 8 */
+
+	if (config->period_min != step->period_min ||
+			get_sys_period_s() != step->period_min * SEC_PER_MIN ||
+			config->enabled != step->enabled ||
+			config->ticks_per_sample[wind_bit] != step->wind_ticks ||
+			config->north_offset_10e1[0] != step->north_offset_10e1) {
+		printf("FAIL: %s \"%.*s\": period %u min, enabled 0x%02x, wind "
+				"ticks %u, north %u\n", when, _cmd_len(step), step->cmd,
+				config->period_min, config->enabled,
+				config->ticks_per_sample[wind_bit],
+				config->north_offset_10e1[0]);
+		_errors++;
+	}
+
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		const Sys_module *module = &sys_modules[i];
+		int8_t is_enabled = (step->enabled & (module->mask >> 8)) != 0;
+		if (sys_config_is_enabled(module->mask) != is_enabled) {
+			printf("FAIL: %s \"%.*s\": %s %s\n", when, _cmd_len(step),
+					step->cmd, module->name,
+					is_enabled ? "disabled" : "enabled");
+			_errors++;
+		}
+		if (module->mask != SYS_WIND_DATA_MASK) {
+			continue;
+		}
+		const Wind_data_dev *wind = module->devs;
+		uint16_t north = (step->north_offset_10e1 == SYS_CONFIG_UNSET) ?
+				wind->params->north_offset_10e1 : step->north_offset_10e1;
+		if (wind->anemo_davis.north_offset_10e1 != north) {
+			printf("FAIL: %s \"%.*s\": wind north offset %u, expected %u\n",
+					when, _cmd_len(step), step->cmd,
+					wind->anemo_davis.north_offset_10e1, north);
+			_errors++;
+		}
+	}
+}
+
+/* Persisted configuration holds the step's settings. */
+static void _check_stored (const Test_step *step) {
+	const Sys_config *stored = flashpage_addr(SYS_CONFIG_FLASHPAGE);
+
+	if (stored->magic != SYS_CONFIG_MAGIC ||
+			stored->version != SYS_CONFIG_VERSION ||
+			stored->period_min != step->period_min ||
+			stored->enabled != step->enabled ||
+			stored->ticks_per_sample[0] != step->wind_ticks ||
+			stored->north_offset_10e1[0] != step->north_offset_10e1) {
+		printf("FAIL: \"%.*s\": not saved\n", _cmd_len(step),
+				step->cmd);
+		_errors++;
+	}
+}
+
+/* Samples taken in the period closed last, with the step's settings. */
+static void _check_samples (const Test_step *step, const uint32_t *last) {
+	uint32_t samples[TEST_MODULES_MAX];
+	uint32_t ticks = step->period_min * SEC_PER_MIN / ATIMER_PERIOD_S;
+	_get_samples(samples);
+
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		const Sys_module *module = &sys_modules[i];
+		uint8_t rate = module->ticks_per_sample;
+		if (module->mask == SYS_WIND_DATA_MASK && step->wind_ticks) {
+			rate = step->wind_ticks;
+		}
+		uint32_t expected = (step->enabled & (module->mask >> 8)) ?
+				module->numof * ticks / rate : 0;
+		if (samples[i] - last[i] != expected) {
+			printf("FAIL: \"%.*s\": %s: %lu samples in a period, expected "
+					"%lu\n", _cmd_len(step), step->cmd, module->name,
+					(unsigned long)(samples[i] - last[i]),
+					(unsigned long)expected);
+			_errors++;
+		}
+	}
+}
+
+static void _get_samples (uint32_t *samples) {
+	for (size_t i = 0; i < sys_modules_numof; i++) {
+		Sys_task_stats stats;
+		get_sys_module_task_stats(i, &stats);
+		samples[i] = stats.samples;
+	}
+}
+
+/* As on reboot: persisted configuration, defaults once it's corrupted. */
+static void _check_boot (const Test_step *step) {
+	const Sys_config *config = sys_config_get();
+
+	if (init_sys_config() != 0) {
+		printf("FAIL: reboot: persisted configuration not loaded\n");
+		_errors++;
+	}
+	if (config->period_min != step->period_min ||
+			config->north_offset_10e1[0] != step->north_offset_10e1) {
+		printf("FAIL: reboot: period %u min, north %u\n",
+				config->period_min, config->north_offset_10e1[0]);
+		_errors++;
+	}
+
+	uint8_t *page = flashpage_addr(SYS_CONFIG_FLASHPAGE);
+	page[offsetof(Sys_config, period_min)] ^= 1;
+	if (init_sys_config() == 0 || config->period_min != DATA_SEND_PERIOD_MIN ||
+			config->north_offset_10e1[0] != SYS_CONFIG_UNSET) {
+		printf("FAIL: reboot: corrupted configuration loaded\n");
+		_errors++;
+	}
+}
+
+/* Command's first line, for messages */
+static int _cmd_len (const Test_step *step) {
+	return (int)strcspn(step->cmd, "\n");
+}
+
+static int8_t _stop (void) {
+	printf("test_sys_config: %u commands, %lu errors\n",
+			(unsigned)TEST_STEPS_NUMOF, (unsigned long)_errors);
+	if (_errors || sys_error || !_is_done) {
+		printf("test_sys_config: FAIL%s\n", _is_done ? "" : ": not done");
+		return -1;
+	}
+	printf("test_sys_config: PASS\n");
+	return 0;
+}
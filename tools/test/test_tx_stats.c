@@ -0,0 +1,254 @@
+/* TX statistics of serial_data add up (see README, Host tests).
+ *  Every round, a burst of TEST_BURST periods is handed to serial_data from
+ * an ISR (host_isr()), so the TX thread can't run in between and slots run
+ * out; every TEST_LONG_EVERY-th period's module data is one byte too long.
+ * The periods lost (get_serial_data_buf() NULL, send_serial_data() -1) must
+ * be the dropped ones, and each queued payload sent, lost or still queued:
+ * queued = sent + lost + depth, checked after every burst and round.
+ *  On the framed link (with data_storage), the data link UART goes to
+ * /dev/null and the test is the peer: it acks all payloads sent, through
+ * serial_data's UART RX callback (host_uart_rx()), but not during an outage
+ * of TEST_OUTAGE_ROUNDS. Payloads given up then are stored, and drained
+ * once the link is back, till every period got through.
+ *  Runs on virtual time (sim_clock), the checks at the end are in _stop().
+ */
+#include "serial_data/serial_data.h"
+#include "sim_clock/sim_clock.h"
+#ifdef MODULE_DATA_STORAGE
+#include "data_storage/data_storage.h"
+#endif
+#if (SERIAL_DATA_LINK == SERIAL_DATA_LINK_FRAMED)
+#include "serial_link/serial_link.h"
+#include "checksum/crc16_ccitt.h"
+#endif
+
+#include "../host/host.h"
+#include "xtimer.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+
+#define TEST_ROUNDS				40U
+#define TEST_ROUND_US			(1000U * 1000U)
+/* Periods per burst, more than the slots hold */
+#define TEST_BURST				\
+	(SERIAL_DATA_TX_SLOTS * SERIAL_DATA_BATCH_PERIODS + 2U)
+/* Every this many periods, module data is too long */
+#define TEST_LONG_EVERY			7U
+/* Rounds w/o ACK (framed link), long enough to give up on payloads */
+#define TEST_OUTAGE_FIRST		5U
+#define TEST_OUTAGE_ROUNDS		10U
+/* Module data: {"n":<u32>} */
+#define TEST_DATA_LEN			16
+
+static char _hash[] = "0123456789abcdef";
+static char _buf[SERIAL_DATA_BUF_LEN(TEST_DATA_LEN)];
+
+static uint32_t _periods;			/* Periods handed to serial_data */
+static uint32_t _no_slot;			/* get_serial_data_buf() NULL */
+static uint32_t _failed;			/* send_serial_data() -1 */
+static uint32_t _errors;
+static uint8_t _is_done;
+
+
+/* Prototypes *****************************************************************/
+static void _burst (void *arg);
+static void _check (const char *when);
+#if (SERIAL_DATA_LINK == SERIAL_DATA_LINK_FRAMED)
+static void _ack (void);
+#endif
+static int8_t _stop (void);
+
+
+/* Functions ******************************************************************/
+
+int main (void) {
+	init_sim_clock(_stop);
+#ifdef MODULE_DATA_STORAGE
+	if (init_data_storage() != 0) {
+		printf("test_tx_stats: FAIL: init_data_storage\n");
+		return 1;
+	}
+#endif
+	if (init_serial_data(_buf, sizeof(_buf), TEST_DATA_LEN, _hash,
+			sizeof(_hash)) != 0) {
+		printf("test_tx_stats: FAIL: init_serial_data\n");
+		return 1;
+	}
+
+	for (uint32_t round = 0; round < TEST_ROUNDS; round++) {
+		host_isr(_burst, NULL);
+		_check("burst");
+		xtimer_usleep(TEST_ROUND_US);
+#if (SERIAL_DATA_LINK == SERIAL_DATA_LINK_FRAMED)
+		if (round < TEST_OUTAGE_FIRST ||
+				round >= TEST_OUTAGE_FIRST + TEST_OUTAGE_ROUNDS) {
+			_ack();
+		}
+#endif
+		_check("round");
+	}
+
+	/* Let the window (and storage) empty */
+	Serial_data_tx_stats stats;
+	do {
+		xtimer_usleep(TEST_ROUND_US / 10U);
+#if (SERIAL_DATA_LINK == SERIAL_DATA_LINK_FRAMED)
+		_ack();
+#endif
+		_check("drain");
+		get_serial_data_tx_stats(&stats);
+	} while (stats.depth
+#ifdef MODULE_DATA_STORAGE
+			|| data_storage_pending()
+#endif
+			);
+
+	/* Virtual time runs on timers, till sim_clock stops */
+	_is_done = 1;
+	while (1) {
+		xtimer_usleep(TEST_ROUND_US);
+	}
+	return 0;
+}
+
+
+/* Helpers ********************************************************************/
+
+/* Hand TEST_BURST periods to serial_data, as if in one go. */
+static void _burst (void *arg) {
+	(void)arg;
+
+	for (uint8_t i = 0; i < TEST_BURST; i++) {
+		uint32_t n = _periods++;
+		size_t len;
+		char *data = get_serial_data_buf(&len);
+		if (data == NULL) {
+			_no_slot++;
+			continue;
+		}
+
+		if (n % TEST_LONG_EVERY == TEST_LONG_EVERY - 1) {
+			len++;
+		}
+		else {
+			len = snprintf(data, len, "{\"n\":%lu}", (unsigned long)n);
+		}
+		Sample_period period = { .index = n, .epoch = n };
+		if (send_serial_data(len, 0, 0, &period) != 0) {
+			_failed++;
+		}
+	}
+}
+
+/* Check that the statistics add up. */
+static void _check (const char *when) {
+	Serial_data_tx_stats stats;
+	get_serial_data_tx_stats(&stats);
+
+	if (stats.queued != stats.sent + stats.lost + stats.depth ||
+			stats.dropped != _no_slot + _failed ||
+			stats.depth > stats.max_depth ||
+			stats.max_depth > SERIAL_DATA_TX_SLOTS) {
+		printf("FAIL: %s, period %lu: queued %lu, sent %lu, lost %lu, "
+				"depth %u (max. %u), dropped %lu, expected %lu\n", when,
+				(unsigned long)_periods, (unsigned long)stats.queued,
+				(unsigned long)stats.sent, (unsigned long)stats.lost,
+				stats.depth, stats.max_depth, (unsigned long)stats.dropped,
+				(unsigned long)(_no_slot + _failed));
+		_errors++;
+	}
+#if (SERIAL_DATA_BATCH_PERIODS <= 1) && !defined(MODULE_DATA_STORAGE)
+	/* A payload per period, unless dropped */
+	if (stats.queued + stats.dropped != _periods) {
+		printf("FAIL: %s: queued %lu + dropped %lu != %lu periods\n", when,
+				(unsigned long)stats.queued, (unsigned long)stats.dropped,
+				(unsigned long)_periods);
+		_errors++;
+	}
+#endif
+}
+
+#if (SERIAL_DATA_LINK == SERIAL_DATA_LINK_FRAMED)
+/* Ack all payloads sent (cumulative): one sequence number per queued
+ * payload, starting at 0. */
+static void _ack (void) {
+	Serial_data_tx_stats stats;
+	get_serial_data_tx_stats(&stats);
+	if (stats.queued == 0) {
+		return;
+	}
+
+	uint16_t seq = (uint16_t)(stats.queued - 1);
+	uint8_t head[SERIAL_LINK_OVERHEAD_LEN] = { SERIAL_LINK_TYPE_ACK,
+			seq & 0xFF, seq >> 8 };
+	uint16_t crc = crc16_ccitt_calc(head, 3);
+	head[3] = crc & 0xFF;
+	head[4] = crc >> 8;
+
+	uint8_t frame[2 + 2 * SERIAL_LINK_OVERHEAD_LEN];
+	size_t n = 0;
+	frame[n++] = SERIAL_LINK_SLIP_END;
+	for (size_t i = 0; i < sizeof(head); i++) {
+		if (head[i] == SERIAL_LINK_SLIP_END) {
+			frame[n++] = SERIAL_LINK_SLIP_ESC;
+			frame[n++] = SERIAL_LINK_SLIP_ESC_END;
+		}
+		else if (head[i] == SERIAL_LINK_SLIP_ESC) {
+			frame[n++] = SERIAL_LINK_SLIP_ESC;
+			frame[n++] = SERIAL_LINK_SLIP_ESC_ESC;
+		}
+		else {
+			frame[n++] = head[i];
+		}
+	}
+	frame[n++] = SERIAL_LINK_SLIP_END;
+	host_uart_rx(SERIAL_DATA_UART_DEV, frame, n);
+}
+#endif
+
+static int8_t _stop (void) {
+	Serial_data_tx_stats stats;
+	get_serial_data_tx_stats(&stats);
+
+	if (_is_done) {
+#if (SERIAL_DATA_BATCH_PERIODS <= 1)
+		/* Every period not dropped got through, if need be from storage */
+		if (stats.sent != _periods - stats.dropped) {
+			printf("FAIL: sent %lu, %lu periods not dropped\n",
+					(unsigned long)stats.sent,
+					(unsigned long)(_periods - stats.dropped));
+			_errors++;
+		}
+#endif
+#ifdef MODULE_DATA_STORAGE
+		Data_storage_stats storage;
+		get_data_storage_stats(&storage);
+		if (stats.lost == 0 || storage.drained != storage.stored) {
+			printf("FAIL: lost %lu, stored %lu, drained %lu\n",
+					(unsigned long)stats.lost,
+					(unsigned long)storage.stored,
+					(unsigned long)storage.drained);
+			_errors++;
+		}
+#endif
+	}
+
+	printf("test_tx_stats: %lu periods, queued %lu, sent %lu, lost %lu, "
+			"dropped %lu (%lu no slot, %lu too long), max. depth %u, "
+			"%lu errors\n", (unsigned long)_periods,
+			(unsigned long)stats.queued, (unsigned long)stats.sent,
+			(unsigned long)stats.lost, (unsigned long)stats.dropped,
+			(unsigned long)_no_slot, (unsigned long)_failed,
+			stats.max_depth, (unsigned long)_errors);
+
+	/* The test is void, if no period was lost either way */
+	if (_errors || !_is_done || _no_slot == 0 || _failed == 0) {
+		printf("test_tx_stats: FAIL%s\n", _is_done ? "" : ": not done");
+		return -1;
+	}
+	printf("test_tx_stats: PASS\n");
+	return 0;
+}
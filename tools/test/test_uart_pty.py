@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""Background UART transmission on a pty (see README, Host tests).
+
+Runs a virtual-time build of the application with the data link UART on a
+pty, as on RIOT native, and reads everything written to it. The bytes read
+must equal the TX statistics of the run summary ("bytes": written to UART,
+after compression and framing), and nothing may be dropped. With --json,
+every line must be a JSON payload, one per sent payload, and their FNV-1a
+hash must equal the summary's digest of delivered payloads.
+
+usage: test_uart_pty.py PROGRAM [--json]
+"""
+
+import json
+import os
+import pty
+import re
+import select
+import subprocess
+import sys
+
+SUMMARY = re.compile(r"^summary: .*sent: (\d+), dropped: (\d+), lost: (\d+), "
+                     r"bytes: (\d+), digest: ([0-9a-f]+)$", re.M)
+
+
+def fnv1a(data, h=2166136261):
+    """FNV-1a hash, as payload_fnv1a()."""
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def run(program):
+    """Run program with UART 1 on a pty; returns its stdout and the link."""
+    master, slave = pty.openpty()
+    proc = subprocess.Popen([program, "-c", "/dev/null",
+                             "-c", os.ttyname(slave)],
+                            stdout=subprocess.PIPE)
+    out = bytearray()
+    link = bytearray()
+    stdout = proc.stdout.fileno()
+    fds = [master, stdout]
+    # Slave stays open here, else the master reads EIO till the program
+    # opens it. The program is done when its stdout closes, the link then
+    # holds whatever is left in the pty.
+    while True:
+        ready = select.select(fds, [], [], None if stdout in fds else 0)[0]
+        if master in ready:
+            link += os.read(master, 65536)
+        elif stdout not in fds:
+            break
+        if stdout in ready:
+            data = os.read(stdout, 65536)
+            out += data
+            if not data:
+                fds.remove(stdout)
+                proc.wait()
+    os.close(slave)
+    os.close(master)
+    return proc.returncode, out.decode(errors="replace"), bytes(link)
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__.strip().splitlines()[-1], file=sys.stderr)
+        return 2
+    program = sys.argv[1]
+    name = os.path.basename(program)
+
+    code, out, link = run(program)
+    match = SUMMARY.search(out)
+    if code != 0 or match is None:
+        print(out, end="")
+        print("%s: FAIL: exit code %d, no summary" % (name, code))
+        return 1
+    sent, dropped, lost, nbytes, digest = match.groups()
+    sent, dropped, lost, nbytes = int(sent), int(dropped), int(lost), int(nbytes)
+    digest = int(digest, 16)
+
+    errors = []
+    if len(link) != nbytes:
+        errors.append("read %d bytes, stats say %d" % (len(link), nbytes))
+    if dropped or lost or sent == 0:
+        errors.append("sent %d, dropped %d, lost %d" % (sent, dropped, lost))
+    if "--json" in sys.argv[2:]:
+        lines = link.split(b"\n")[:-1]
+        if len(lines) != sent:
+            errors.append("%d lines, stats say %d sent" % (len(lines), sent))
+        for line in lines:
+            try:
+                json.loads(line)
+            except ValueError:
+                errors.append("not JSON: %r" % line[:60])
+                break
+        if fnv1a(link) != digest:
+            errors.append("digest %08x, stats say %08x" % (fnv1a(link), digest))
+
+    print("%s: %d payloads, %d bytes on the pty" % (name, sent, len(link)))
+    for error in errors:
+        print("%s: FAIL: %s" % (name, error))
+    if errors:
+        return 1
+    print("%s: PASS" % name)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,56 @@
+#include "wall_clock.h"
+
+#include "xtimer.h"
+#include "irq.h"
+
+#include <stdint.h>
+
+#ifndef ENABLE_DEBUG
+#define ENABLE_DEBUG (0)
+#endif
+#include "debug.h"
+
+
+/* Time reference (Unix time) and uptime, when it was received. */
+static uint32_t _ref_unix_s;
+static uint64_t _ref_uptime_us;
+static int8_t _is_set;
+
+
+/* Set wall-clock time. */
+void wall_clock_set(uint32_t unix_s) {
+	unsigned state = irq_disable();
+	_ref_unix_s = unix_s;
+	_ref_uptime_us = xtimer_now_usec64();
+	_is_set = 1;
+	irq_restore(state);
+
+	DEBUG("wall_clock_set: %lu\n", (unsigned long)unix_s);
+}
+
+/* Check if wall-clock time has been set. */
+int8_t wall_clock_is_set(void) {
+	return _is_set;
+}
+
+/* Convert uptime to wall-clock time. */
+uint32_t wall_clock_unix_s(uint64_t uptime_us) {
+
+	/* Copy reference, since it may be updated by ISR */
+	unsigned state = irq_disable();
+	uint32_t ref_unix_s = _ref_unix_s;
+	uint64_t ref_uptime_us = _ref_uptime_us;
+	int8_t is_set = _is_set;
+	irq_restore(state);
+
+	if (!is_set) {
+		return 0;
+	}
+
+	/* Uptime may precede the reference (e.g. sample taken before sync) */
+	if (uptime_us < ref_uptime_us) {
+		return ref_unix_s -
+				(uint32_t)((ref_uptime_us - uptime_us) / US_PER_SEC);
+	}
+	return ref_unix_s + (uint32_t)((uptime_us - ref_uptime_us) / US_PER_SEC);
+}
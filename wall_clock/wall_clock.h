@@ -0,0 +1,28 @@
+#ifndef WALL_CLOCK_H
+#define WALL_CLOCK_H
+
+#include <stdint.h>
+
+
+/* Set wall-clock time, based on an external time reference (UART).
+ * The reference is paired with the current uptime, so the two can be
+ * converted at any later time. Safe to call from ISR.
+ *  p1: Unix time [s]
+ */
+void wall_clock_set(uint32_t unix_s);
+
+/* Check if wall-clock time has been set since boot.
+ * return:
+ *  1 if set, 0 otherwise
+ */
+int8_t wall_clock_is_set(void);
+
+/* Convert uptime to wall-clock time.
+ *  p1: uptime [us], e.g. sample epoch timestamp
+ * return:
+ *  Unix time [s], 0 if wall clock was not set
+ */
+uint32_t wall_clock_unix_s(uint64_t uptime_us);
+
+
+#endif
@@ -1,8 +1,10 @@
 #include "wind_data.h"
 #include "../anemo_davis/anemo_davis.h"
-#include "../pin_settings.h"
 
 #include "periph/gpio.h"
+#ifdef MODULE_BENCH
+#include "../bench/bench.h"
+#endif
 
 #include <log.h>
 #include <string.h>			// For 'memset'
@@ -16,53 +18,57 @@
 #include "debug.h"
 
 
-/* Statics */
-/* Intermediate data (sum of measurements, avg. counter...). */
-static Intermediate_wind_data _intermediate_wind_data;
-/* Data (measurements, buffer...). */
-static Wind_data _wind_data;
+/* Field descriptors (order is part of binary payload schema). */
+const Payload_field wind_data_fields[WIND_DATA_FIELDS_NUMOF] = {
+	WIND_DATA_FIELDS(PAYLOAD_FIELD_DESC)
+};
 
-/* internal error variable used to set values to 0 on error */
-static int8_t _error_detected;
 
 /* Prototypes *****************************************************************/
-static void _calc_avg_wind_data (void);
+static void _calc_avg_wind_data (Wind_data_dev *dev,
+		Intermediate_wind_data *intermediate);
 
-static void _intermediate_update_dir(int wind_direction);
-static void _intermediate_update_gust(int wind_speed);
-static int _calc_avg_wind_speed (void);
-static int _calc_avg_wind_dir_10e1 (void);
+static void _intermediate_update_dir(Intermediate_wind_data *intermediate,
+		int wind_direction);
+static void _intermediate_update_gust(Intermediate_wind_data *intermediate,
+		int wind_speed);
+static int _calc_avg_wind_speed (Intermediate_wind_data *intermediate);
+static uint32_t _calc_wind_speed_var (Intermediate_wind_data *intermediate);
+static int _calc_avg_wind_dir_10e1 (Intermediate_wind_data *intermediate);
 
-static void _reset_intermediate_data (void);
-static void _reset_avg_data (void);
+static Intermediate_wind_data *_get_closed_bank (Wind_data_dev *dev);
+static void _reset_intermediate_data (Intermediate_wind_data *intermediate);
+static void _reset_avg_data (Wind_data_dev *dev);
 
 /* Functions ******************************************************************/
 
-/* Initiate module. */
-int8_t init_wind_data (uint16_t north_offset_10e1, size_t *buffer_len) {
+/* Initiate module instance. */
+int8_t init_wind_data (Wind_data_dev *dev, const Wind_data_params *params) {
 
 	/* Reset state variables */
-	_error_detected = 0;
+	dev->params = params;
+	dev->error_detected = 0;
 
 	int8_t anemo_init =
 			anemo_davis_init (
-				north_offset_10e1,
-				ANEMO_DAVIS_MUX_OUT,
-				ANEMO_DAVIS_MUX_C,
-				ANEMO_DAVIS_MUX_B,
-				ANEMO_DAVIS_MUX_A,
-				ANEMO_DAVIS_COUNTER_RST,
-				ANEMO_DAVIS_COUNTER_N_EN,
-				ANEMO_DAVIS_ADC_LINE);
-
-	_reset_intermediate_data();
-	_reset_avg_data();
-
-	*buffer_len = WIND_DATA_BUFFER_LEN;
+				&dev->anemo_davis,
+				params->north_offset_10e1,
+				params->mux_out,
+				params->mux_c,
+				params->mux_b,
+				params->mux_a,
+				params->counter_rst,
+				params->counter_n_en,
+				params->adc_line);
+
+	for (int i = 0; i < SAMPLE_EPOCH_BANKS; i++) {
+		_reset_intermediate_data(&dev->intermediate[i]);
+	}
+	_reset_avg_data(dev);
 
 	if (anemo_init != 0) {
 		LOG_ERROR("Failed: anemo_init\n");
-		_error_detected = 1;
+		dev->error_detected = 1;
 		return -1;
 	}
 
@@ -70,80 +76,154 @@ int8_t init_wind_data (uint16_t north_offset_10e1, size_t *buffer_len) {
 }
 
 /* Read environmental data with(!) blocking further execution. */
-int8_t read_intermediate_wind_data(void) {
+int8_t read_intermediate_wind_data(Wind_data_dev *dev) {
 
-	if (_error_detected) {
-		_reset_intermediate_data();
+	/* Get epoch of the tick, which woke the thread */
+	Sample_epoch epoch;
+	sample_epoch_get(&epoch);
+
+	/* Write whole sample to the bank of epoch's period, even if the period
+	 * is closed meanwhile (serial thread waits for this one to finish).
+	 */
+	Intermediate_wind_data *intermediate =
+			&dev->intermediate[SAMPLE_EPOCH_BANK(epoch.period)];
+
+	if (dev->error_detected) {
+		_reset_intermediate_data(intermediate);
 		return -1;
 	}
 
-	int wind_speed = anemo_davis_calc_speed_ms_10e2();
-	int wind_direction = anemo_get_wind_direction_10e1();
+	int wind_speed = anemo_davis_calc_speed_ms_10e2(&dev->anemo_davis);
+	uint32_t skew_us = sample_epoch_skew_us(&epoch);
+	int wind_direction = anemo_get_wind_direction_10e1(&dev->anemo_davis);
 
 	if (wind_speed == -1 || wind_direction == -1) {
 		LOG_ERROR("Failed: "
 				"anemo_davis_calc_speed_ms_10e2 || "
 				"anemo_get_wind_direction_10e1\n");
-		_error_detected = 1;
+		dev->error_detected = 1;
 		return -1;
 	}
 
 	DEBUG("wind_speed: %d, wind_direction: %d\n",
 			wind_speed, wind_direction);
 
-	_intermediate_wind_data.wind_speed_sum += wind_speed;
-	_intermediate_update_dir(wind_direction);
-	_intermediate_update_gust(wind_speed);
-	_intermediate_wind_data.average_counter++;
+	intermediate->wind_speed_sum += wind_speed;
+	intermediate->wind_speed_sq_sum += (uint64_t)(wind_speed * wind_speed);
+	_intermediate_update_dir(intermediate, wind_direction);
+	_intermediate_update_gust(intermediate, wind_speed);
+	intermediate->average_counter++;
+
+	/* Tag sample with epoch and keep the worst skew within period */
+	intermediate->epoch = epoch;
+	if (skew_us > intermediate->max_skew_us) {
+		intermediate->max_skew_us = skew_us;
+	}
 
 	return 0;
 }
 
-/* Format measurements to JSON and write to internal buffer. */
-char *get_avg_json_wind_data(void) {
+/* Finalize the closed period and get its averages. */
+const Wind_data *get_avg_wind_data(Wind_data_dev *dev) {
 
-	_calc_avg_wind_data();
-	_reset_intermediate_data();
+	/* Finalize and clear bank of the closed period */
+	Intermediate_wind_data *intermediate = _get_closed_bank(dev);
+	_calc_avg_wind_data(dev, intermediate);
+	_reset_intermediate_data(intermediate);
 
-	snprintf(_wind_data.buffer, WIND_DATA_BUFFER_LEN, WIND_DATA_JSON_FORMAT,
-			_wind_data.wind_speed,
-			_wind_data.wind_direction,
-			_wind_data.wind_gust_speed,
-			_wind_data.wind_gust_peak);
+	return &dev->data;
+}
 
-	DEBUG("%s\n",_wind_data.buffer);
+/* Variance of the last finalized period (adaptive period). */
+uint32_t get_var_wind_data(const Wind_data_dev *dev) {
+	return dev->wind_speed_var;
+}
 
-	return _wind_data.buffer;
+/* Change offset from north (runtime configuration). */
+void wind_data_set_north_offset(Wind_data_dev *dev,
+		uint16_t north_offset_10e1) {
+	dev->anemo_davis.north_offset_10e1 = north_offset_10e1;
 }
 
 
+
+#ifdef MODULE_BENCH
+/* Scratch data, so the instance's banks stay untouched */
+static Intermediate_wind_data _bench_intermediate;
+
+/* Period of 20 samples, spread over a few sectors. */
+static void _bench_fill(void *arg) {
+	Intermediate_wind_data *intermediate = arg;
+	_reset_intermediate_data(intermediate);
+	for (int i = 0; i < 20; i++) {
+		intermediate->wind_speed_sum += 500 + 13 * i;
+		_intermediate_update_dir(intermediate, (2250 + 97 * i) % 3600);
+		intermediate->average_counter++;
+	}
+}
+
+static void _bench_update_dir(void *arg) {
+	static int wind_direction;
+	_intermediate_update_dir(arg, wind_direction);
+	wind_direction = (wind_direction + 337) % 3600;
+}
+
+static void _bench_calc_avg_wind_speed(void *arg) {
+	_calc_avg_wind_speed(arg);
+}
+
+static void _bench_calc_avg_wind_dir(void *arg) {
+	_calc_avg_wind_dir_10e1(arg);
+}
+
+/* Time sampling and averaging steps, incl. anemometer. */
+void wind_data_bench(Wind_data_dev *dev) {
+	anemo_davis_bench(&dev->anemo_davis);
+
+	_reset_intermediate_data(&_bench_intermediate);
+	bench_run("_intermediate_update_dir", NULL, _bench_update_dir,
+			&_bench_intermediate);
+	bench_run("_calc_avg_wind_speed", _bench_fill,
+			_bench_calc_avg_wind_speed, &_bench_intermediate);
+	bench_run("_calc_avg_wind_dir_10e1", _bench_fill,
+			_bench_calc_avg_wind_dir, &_bench_intermediate);
+}
+#endif
+
+
+
 /* Helpers ********************************************************************/
 
-static void _calc_avg_wind_data(void) {
+static void _calc_avg_wind_data(Wind_data_dev *dev,
+		Intermediate_wind_data *intermediate) {
 
-	if (_error_detected) {
+	/* No samples in period (e.g. error), avoid dividing by zero */
+	if (dev->error_detected || intermediate->average_counter == 0) {
 		/* Set values to zero */
-		_reset_avg_data();
+		_reset_avg_data(dev);
 		return;
 	}
 
 	/* Calculate wind speed without cutting away decimals (round them) */
-	_wind_data.wind_speed = _calc_avg_wind_speed();
-	_wind_data.wind_direction = _calc_avg_wind_dir_10e1();
-	_wind_data.wind_gust_speed = _intermediate_wind_data.max_wind_gust_speed;
-	_wind_data.wind_gust_peak = _intermediate_wind_data.wind_gust_peak;
+	dev->data.wind_speed = _calc_avg_wind_speed(intermediate);
+	dev->wind_speed_var = _calc_wind_speed_var(intermediate);
+	dev->data.wind_direction = _calc_avg_wind_dir_10e1(intermediate);
+	dev->data.wind_gust_speed = intermediate->max_wind_gust_speed;
+	dev->data.wind_gust_peak = intermediate->wind_gust_peak;
+	dev->data.wind_skew = intermediate->max_skew_us;
 
 	DEBUG(	"wind_speed: %d, wind_direction: %d, "
 			"wind_gust_speed: %d, wind_gust_peak: %d\n",
-			_wind_data.wind_speed, _wind_data.wind_direction,
-			_wind_data.wind_gust_speed, _wind_data.wind_gust_peak);
+			dev->data.wind_speed, dev->data.wind_direction,
+			dev->data.wind_gust_speed, dev->data.wind_gust_peak);
 }
 
 /* On intermediate sampling time, add direction to array. */
-static void _intermediate_update_dir(int wind_direction) {
+static void _intermediate_update_dir(Intermediate_wind_data *intermediate,
+		int wind_direction) {
 	int dir_idx = ((wind_direction + WIND_DIR_SECTOR_OFFSET_10E1) % 3600) \
 			/ WIND_DIR_SECTOR_WIDTH_10E1;
-	_intermediate_wind_data.wind_direction_sum[dir_idx] += 1;
+	intermediate->wind_direction_sum[dir_idx] += 1;
 
 	DEBUG("dir_idx: %d, wind_direction: %d, WIND_DIR_SECTOR_OFFSET_10E1: %d,\
 		WIND_DIR_SECTOR_WIDTH_10E1: %d\n",
@@ -151,38 +231,50 @@ static void _intermediate_update_dir(int wind_direction) {
 }
 
 /* On intermediate sampling time, add gust speed, if greater than preceeding */
-static void _intermediate_update_gust(int wind_speed) {
+static void _intermediate_update_gust(Intermediate_wind_data *intermediate,
+		int wind_speed) {
 	/* Update gust speed */
-	if (wind_speed - _intermediate_wind_data.max_wind_gust_speed > 0) {
+	if (wind_speed - intermediate->max_wind_gust_speed > 0) {
 		/* Update gust peak */
 		/*if (wind_speed_ms_10e2 - _intermediate_wind_data.max_wind_gust_speed
 				> GUST_PEAK_TRESHOLD) {
 			_intermediate_wind_data.wind_gust_peak = 1;
 		}*/
-		_intermediate_wind_data.max_wind_gust_speed = wind_speed;
+		intermediate->max_wind_gust_speed = wind_speed;
 	}
 }
 
 /* */
-static int _calc_avg_wind_speed (void) {
-	float f_wind_speed = (float)_intermediate_wind_data.wind_speed_sum
-				/ _intermediate_wind_data.average_counter;
+static int _calc_avg_wind_speed (Intermediate_wind_data *intermediate) {
+	float f_wind_speed = (float)intermediate->wind_speed_sum
+				/ intermediate->average_counter;
 	return (int)roundf(f_wind_speed);
 }
 
+/* Variance of wind speed samples (population), from sum and sum of squares */
+static uint32_t _calc_wind_speed_var (Intermediate_wind_data *intermediate) {
+	int64_t sum = intermediate->wind_speed_sum;
+	int64_t n = intermediate->average_counter;
+	int64_t var = ((int64_t)intermediate->wind_speed_sq_sum - sum * sum / n) / n;
+	if (var < 0) {
+		return 0;
+	}
+	return (var > UINT32_MAX) ? UINT32_MAX : (uint32_t)var;
+}
+
 /* */
-static int _calc_avg_wind_dir_10e1 (void) {
+static int _calc_avg_wind_dir_10e1 (Intermediate_wind_data *intermediate) {
 	int max_wind_dir_idx = 0;
 	int max_wind_dir_count = 0;
 
 	int i;
 	for (i=0; i<WIND_DIRECTION_RESOLUTION; i++) {
-		if (_intermediate_wind_data.wind_direction_sum[i] > max_wind_dir_count) {
-			max_wind_dir_count = _intermediate_wind_data.wind_direction_sum[i];
+		if (intermediate->wind_direction_sum[i] > max_wind_dir_count) {
+			max_wind_dir_count = intermediate->wind_direction_sum[i];
 			max_wind_dir_idx = i;
 		}
 		/* Clear after assessing */
-		_intermediate_wind_data.wind_direction_sum[i] = 0;
+		intermediate->wind_direction_sum[i] = 0;
 	}
 
 	/* Round to one decimal and return as int */
@@ -191,17 +283,26 @@ static int _calc_avg_wind_dir_10e1 (void) {
 	return (int)roundf(f_avg_wind_dir * 10);
 }
 
+/* Get bank of the last closed period. */
+static Intermediate_wind_data *_get_closed_bank (Wind_data_dev *dev) {
+	Sample_period period;
+	sample_epoch_get_period(&period);
+	return &dev->intermediate[SAMPLE_EPOCH_BANK(period.index)];
+}
+
 /* (re)Set avg structure values to 0. */
-static void _reset_intermediate_data (void) {
-	memset (&_intermediate_wind_data, 0, sizeof(_intermediate_wind_data));
+static void _reset_intermediate_data (Intermediate_wind_data *intermediate) {
+	memset (intermediate, 0, sizeof(*intermediate));
 }
 
 /* (re)Set avg structure values to 0. */
-static void _reset_avg_data (void) {
+static void _reset_avg_data (Wind_data_dev *dev) {
 	//memset (&_wind_data, 0, sizeof(_wind_data));
-	_wind_data.wind_speed = 0;
-	_wind_data.wind_direction = 0;
-	_wind_data.wind_gust_speed = 0;
-	_wind_data.wind_gust_peak = 0;
+	dev->data.wind_speed = 0;
+	dev->data.wind_direction = 0;
+	dev->data.wind_gust_speed = 0;
+	dev->data.wind_gust_peak = 0;
+	dev->data.wind_skew = 0;
+	dev->wind_speed_var = 0;
 }
 
@@ -1,6 +1,13 @@
 #ifndef ANEMOMETER_H
 #define ANEMOMETER_H
 
+#include "../sample_epoch/sample_epoch.h"
+#include "../payload/payload.h"
+#include "../anemo_davis/anemo_davis.h"
+
+#include "periph/gpio.h"
+#include "periph/adc.h"
+
 #include <stdint.h>
 #include <stddef.h>				// size_t
 
@@ -10,24 +17,44 @@
 #define WIND_DIR_SECTOR_WIDTH_10E1		(3600 / WIND_DIRECTION_RESOLUTION)
 #define WIND_DIR_SECTOR_OFFSET_10E1		(int)(WIND_DIR_SECTOR_WIDTH_10E1 / 2.0)
 
-#define WIND_DATA_BUFFER_LEN		128
+/* WCET budgets (see tasks.h) [us]: a sample call reads the counter through
+ * the mux and converts the vane ADC line, a pass samples all instances.
+ * A step spins on 22 mux waits (MUX_PROPAGATION_DELAY_US) and reads the time
+ * about 70 times: 70 us in virtual time on the host, 1400 with timer reads
+ * of 20 us (test-wcet, see README).
+ */
+#define WIND_DATA_WCET_STEP_US		(2U * 1000U)
+#define WIND_DATA_WCET_PASS_US		(10U * 1000U)
+
+/* Adaptive period (see sys_control.h): period is variable, when variance of
+ * wind speed exceeds (1.5 m/s)^2 [(m/s * 10e2)^2]
+ */
+#define WIND_DATA_VAR_MAX			(150UL * 150UL)
+
+/* Longest JSON key prefix of an instance (e.g. "h2_") */
+#define WIND_DATA_PREFIX_MAX_LEN	PAYLOAD_PREFIX_MAX_LEN
 
-/* JSON format doesn't support zero padding at beginning. Either include only
- * number, or wrap in quotes (0012 -> 12, or "0012") to avoid back end errors.
+/* Averaged data fields, X(struct, member, type, decimals, dead-band). JSON
+ * format doesn't support zero padding, so values are plain integers. Order
+ * is part of binary payload schema. Direction moves by whole sectors.
+ *  wind_speed : [m/s * 10e2]
+ *  wind_direction : [deg * 10e1]
+ *  wind_gust_speed : [m/s * 10e2]
+ *  wind_gust_peak : 0/1
+ *  wind_skew : [us]
  */
-#define WIND_DATA_JSON_FORMAT		""\
-	"\"wind_speed\":%d,"\
-	"\"wind_direction\":%d,"\
-	"\"wind_gust_speed\":%d,"\
-	"\"wind_gust_peak\":%d"
-	/*"\"wind_speed\":%04d,"\
-	"\"wind_direction\":%04d,"\
-	"\"wind_gust_speed\":%04d,"\
-	"\"wind_gust_peak\":%01d"*/
-	/*"\"w_speed\":%04d,"\
-	"\"w_dir\":%04d,"\
-	"\"w_gust_max\":%04d,"\
-	"\"w_gust_peak\":%01d"*/
+#define WIND_DATA_FIELDS(X)								\
+	X(Wind_data, wind_speed, I16, 2, 20)				\
+	X(Wind_data, wind_direction, I16, 1, 0)				\
+	X(Wind_data, wind_gust_speed, I16, 2, 50)			\
+	X(Wind_data, wind_gust_peak, I8, 0, 0)				\
+	X(Wind_data, wind_skew, U32, 0, 1000)
+
+#define WIND_DATA_FIELDS_NUMOF		PAYLOAD_FIELDS_NUMOF(WIND_DATA_FIELDS)
+
+/* Max. JSON length of an instance's data (derived from fields) */
+#define WIND_DATA_JSON_MAX_LEN		\
+	PAYLOAD_JSON_RECORD_MAX_LEN(WIND_DATA_FIELDS, WIND_DATA_PREFIX_MAX_LEN)
 
 
 typedef struct {
@@ -35,38 +62,101 @@ typedef struct {
 	int wind_direction;
 	int wind_gust_speed;
 	int wind_gust_peak;
-	char buffer[WIND_DATA_BUFFER_LEN];
+	uint32_t wind_skew;
 } Wind_data;
 
+/* Field descriptors of Wind_data. */
+extern const Payload_field wind_data_fields[WIND_DATA_FIELDS_NUMOF];
+
 typedef struct {
 	int wind_speed_sum;
+	uint64_t wind_speed_sq_sum;		/* Sum of squares, for variance */
 	int wind_direction_sum [WIND_DIRECTION_RESOLUTION];
 	int max_wind_gust_speed;
 	int wind_gust_peak;
 	int average_counter;
+	Sample_epoch epoch;				/* Epoch of the latest sample */
+	uint32_t max_skew_us;			/* Worst delay between epoch and sample */
 } Intermediate_wind_data;
 
+/* Instance parameters (see wind_data_params.h). */
+typedef struct {
+	const char *prefix;				/* JSON key prefix */
+	uint16_t north_offset_10e1;		/* Offset from north [deg * 10] */
+	gpio_t mux_out;
+	gpio_t mux_c;
+	gpio_t mux_b;
+	gpio_t mux_a;
+	gpio_t counter_rst;
+	gpio_t counter_n_en;
+	adc_t adc_line;
+} Wind_data_params;
+
+/* Module instance, one per anemometer.
+ *  RAM: ~290 B on SAMD21 (2 intermediate banks ~2 x 104 B, anemometer
+ * interface 48 B, averages and bookkeeping).
+ */
+typedef struct {
+	const Wind_data_params *params;
+	Anemo_davis anemo_davis;
+	/* Intermediate data (sum of measurements, avg. counter...).
+	 * One bank is written by the sensor thread, while the other (closed
+	 * period) is being finalized by the serial thread.
+	 */
+	Intermediate_wind_data intermediate[SAMPLE_EPOCH_BANKS];
+	/* Data (measurements, buffer...). */
+	Wind_data data;
+	/* Variance of wind speed in the last finalized period [(m/s * 10e2)^2] */
+	uint32_t wind_speed_var;
+	/* internal error variable used to set values to 0 on error */
+	int8_t error_detected;
+} Wind_data_dev;
+
 
-/* Initiate module.
- *  p1: offset from north in degrees * 10
- *  p2: pointer to where the module's buffer lenght will be written
+/* Initiate module instance.
+ *  p1: instance
+ *  p2: instance parameters (pins, offset from north, JSON prefix)
  * return:
  *  0 on success, -1 on error
  */
-int8_t init_wind_data (uint16_t north_offset_10e1, size_t *buffer_len);
+int8_t init_wind_data (Wind_data_dev *dev, const Wind_data_params *params);
 
 /* Read environmental data with (minor, [us]) blocking further execution.
+ *  p1: instance
  * return:
  *  0: Finished
  *  -1: error
  */
-int8_t read_intermediate_wind_data(void);
+int8_t read_intermediate_wind_data(Wind_data_dev *dev);
+
+/* Finalize the closed period (averages, all zero on error) and reset its
+ * intermediate data.
+ *  p1: instance
+ * return:
+ *  pointer to instance's averaged data
+ */
+const Wind_data *get_avg_wind_data(Wind_data_dev *dev);
 
-/* Format measurements to JSON and write to internal buffer.
+/* Get variance of wind speed in the last finalized period.
+ *  p1: instance
  * return:
- *  pointer to array's (string's) start address
+ *  variance [(m/s * 10e2)^2]
  */
-char *get_avg_json_wind_data(void);
+uint32_t get_var_wind_data(const Wind_data_dev *dev);
+
+/* Set offset from north, in place of the instance parameter.
+ *  p1: instance
+ *  p2: offset from north [deg * 10]
+ */
+void wind_data_set_north_offset(Wind_data_dev *dev,
+		uint16_t north_offset_10e1);
+
+#ifdef MODULE_BENCH
+/* Time sampling and averaging steps (bench module), incl. anemometer.
+ *  p1: initialized instance
+ */
+void wind_data_bench(Wind_data_dev *dev);
+#endif
 
 
 #endif
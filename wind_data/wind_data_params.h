@@ -0,0 +1,40 @@
+#ifndef WIND_DATA_PARAMS_H
+#define WIND_DATA_PARAMS_H
+
+#include "wind_data.h"
+#include "../sys_control.h"
+#include "../pin_settings.h"
+
+
+/* Default instance: single anemometer, wired as in pin_settings.h.
+ *  To run more anemometers (e.g. at different heights), define
+ * WIND_DATA_PARAMS in pin_settings.h as a list of instances, each with its own
+ * pins and a unique JSON key prefix, e.g.:
+ *
+ *  #define WIND_DATA_PARAMS \
+ *      { .prefix = "", ... }, \
+ *      { .prefix = "h2_", ... }
+ */
+#ifndef WIND_DATA_PARAMS
+#define WIND_DATA_PARAMS	{								\
+		.prefix = "",										\
+		.north_offset_10e1 = NORTH_OFFSET_10E1,				\
+		.mux_out = ANEMO_DAVIS_MUX_OUT,						\
+		.mux_c = ANEMO_DAVIS_MUX_C,							\
+		.mux_b = ANEMO_DAVIS_MUX_B,							\
+		.mux_a = ANEMO_DAVIS_MUX_A,							\
+		.counter_rst = ANEMO_DAVIS_COUNTER_RST,				\
+		.counter_n_en = ANEMO_DAVIS_COUNTER_N_EN,			\
+		.adc_line = ANEMO_DAVIS_ADC_LINE,					\
+	}
+#endif
+
+static const Wind_data_params wind_data_params[] = {
+	WIND_DATA_PARAMS
+};
+
+#define WIND_DATA_NUMOF		\
+	(sizeof(wind_data_params) / sizeof(wind_data_params[0]))
+
+
+#endif